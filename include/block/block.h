@@ -58,6 +58,7 @@ namespace programmerjake
 namespace voxels
 {
 class Player;
+struct ParticleBatch;
 
 struct BlockEffects final
 {
@@ -97,6 +98,24 @@ struct BlockEffects final
     }
 };
 
+/** @brief collects a chunk's ready block updates so they can be run together
+ *
+ * the block update thread adds every ready update whose block's descriptor returns this batch
+ * from BlockDescriptor::getBlockUpdateBatch instead of calling BlockDescriptor::tick, then calls
+ * run once it has dispatched the chunk's ready updates.
+ */
+class BlockUpdateBatch
+{
+public:
+    virtual ~BlockUpdateBatch() = default;
+    virtual void add(const Block &block,
+                     BlockIterator blockIterator,
+                     WorldLockManager &lock_manager,
+                     BlockUpdateKind kind) = 0;
+    /** @brief run and then clear the added updates */
+    virtual void run(World &world, WorldLockManager &lock_manager) = 0;
+};
+
 class BlockDescriptor
 {
     BlockDescriptor(const BlockDescriptor &) = delete;
@@ -172,6 +191,42 @@ public:
     const bool isStaticMesh;
     enum_array<bool, BlockFace> isFaceBlocked;
     enum_array<bool, BlockUpdateKind> handledUpdateKinds;
+
+private:
+    BlockDescriptorTraits traits;
+    BlockDescriptorKindId kindId;
+
+public:
+    BlockDescriptorTraits getTraits() const
+    {
+        return traits;
+    }
+    bool hasTraits(BlockDescriptorTraits traits) const
+    {
+        return (this->traits & traits) == traits;
+    }
+    BlockDescriptorKindId getKindId() const
+    {
+        return kindId;
+    }
+
+protected:
+    /** @brief add to this descriptor's traits; only call from constructors */
+    void addTraits(BlockDescriptorTraits newTraits)
+    {
+        traits |= newTraits;
+        bdIndex.setTraits(traits);
+    }
+    /** @brief set the kind id shared by this descriptor's family; only call from constructors */
+    void setKindId(BlockDescriptorKindId newKindId)
+    {
+        kindId = newKindId;
+    }
+    /** @brief allocate a new kind id; should only be called before any threads other than the main
+     * thread are started */
+    static BlockDescriptorKindId makeKindId();
+
+public:
     /** generate dynamic mesh
      the generated mesh is at the absolute position of the block
      */
@@ -321,6 +376,14 @@ public:
                       BlockUpdateKind kind) const
     {
     }
+    /** @brief get this thread's batch for updates of kind
+     *
+     * @return nullptr to tick each block separately
+     */
+    virtual BlockUpdateBatch *getBlockUpdateBatch(BlockUpdateKind kind, TLS &tls) const
+    {
+        return nullptr;
+    }
     virtual void randomTick(const Block &block,
                             World &world,
                             BlockIterator blockIterator,
@@ -408,12 +471,17 @@ public:
     {
         return false;
     }
+    /** @brief generate the particles for the time from currentTime to currentTime + deltaTime
+     *
+     * the new particles should be added to newParticles instead of directly to world
+     */
     virtual void generateParticles(World &world,
                                    Block b,
                                    BlockIterator bi,
                                    WorldLockManager &lock_manager,
                                    double currentTime,
-                                   double deltaTime) const
+                                   double deltaTime,
+                                   ParticleBatch &newParticles) const
     {
     }
     virtual bool canTransmitRedstoneSignal() const
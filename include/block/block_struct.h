@@ -55,10 +55,27 @@ struct WorldLockManager;
 
 typedef const BlockDescriptor *BlockDescriptorPointer;
 
+/** @brief bitmask of what a block descriptor is, so hot paths don't need dynamic_cast */
+typedef std::uint32_t BlockDescriptorTraits;
+constexpr BlockDescriptorTraits BlockDescriptorTraitsNone = 0;
+constexpr BlockDescriptorTraits BlockDescriptorTraitTicksRandomly = 1 << 0;
+constexpr BlockDescriptorTraits BlockDescriptorTraitFluid = 1 << 1;
+constexpr BlockDescriptorTraits BlockDescriptorTraitRedstoneDust = 1 << 2;
+constexpr BlockDescriptorTraits BlockDescriptorTraitDirtBlock = 1 << 3;
+constexpr BlockDescriptorTraits BlockDescriptorTraitWoodLog = 1 << 4;
+constexpr BlockDescriptorTraits BlockDescriptorTraitWoodLeaves = 1 << 5;
+constexpr BlockDescriptorTraits BlockDescriptorTraitPlant = 1 << 6;
+constexpr BlockDescriptorTraits BlockDescriptorTraitFallingBlock = 1 << 7;
+
+/** @brief identifies a family of block descriptors, like all the levels of water */
+typedef std::uint16_t BlockDescriptorKindId;
+constexpr BlockDescriptorKindId BlockDescriptorKindIdNone = 0;
+
 struct BlockDescriptorIndex
 {
 private:
     static const BlockDescriptor **blockDescriptorTable;
+    static BlockDescriptorTraits *blockDescriptorTraitsTable;
     static std::size_t blockDescriptorTableSize, blockDescriptorTableAllocated;
     friend class BlockDescriptor;
     explicit BlockDescriptorIndex(std::uint16_t index) : index(index)
@@ -75,10 +92,17 @@ private:
             blockDescriptorTableAllocated += 1024;
             const BlockDescriptor **newTable =
                 new const BlockDescriptor *[blockDescriptorTableAllocated];
+            BlockDescriptorTraits *newTraitsTable =
+                new BlockDescriptorTraits[blockDescriptorTableAllocated];
             for(std::size_t i = 0; i < blockDescriptorTableSize; i++)
+            {
                 newTable[i] = blockDescriptorTable[i];
+                newTraitsTable[i] = blockDescriptorTraitsTable[i];
+            }
             delete[] blockDescriptorTable;
+            delete[] blockDescriptorTraitsTable;
             blockDescriptorTable = newTable;
+            blockDescriptorTraitsTable = newTraitsTable;
         }
         std::size_t index = blockDescriptorTableSize++;
         if(index >= static_cast<std::size_t>(NullIndex))
@@ -86,8 +110,14 @@ private:
             throw std::runtime_error("too many BlockDescriptor instances");
         }
         blockDescriptorTable[index] = bd;
+        blockDescriptorTraitsTable[index] = BlockDescriptorTraitsNone;
         return make(static_cast<std::uint16_t>(index));
     }
+    void setTraits(BlockDescriptorTraits traits) const // should only be called while registering
+    {
+        assert(index < blockDescriptorTableSize);
+        blockDescriptorTraitsTable[index] = traits;
+    }
 
 public:
     static BlockDescriptorIndex make(std::uint16_t index)
@@ -125,6 +155,21 @@ public:
     {
         return get();
     }
+    BlockDescriptorTraits getTraits() const
+    {
+        if(index == NullIndex)
+            return BlockDescriptorTraitsNone;
+        assert(index < blockDescriptorTableSize);
+        return blockDescriptorTraitsTable[index];
+    }
+    bool hasTraits(BlockDescriptorTraits traits) const
+    {
+        return (getTraits() & traits) == traits;
+    }
+    bool ticksRandomly() const
+    {
+        return hasTraits(BlockDescriptorTraitTicksRandomly);
+    }
     explicit operator bool() const
     {
         return index != NullIndex;
@@ -405,6 +450,12 @@ struct Block final
                                            WorldLightingProperties wlp);
     static Block read(stream::Reader &reader);
     void write(stream::Writer &writer) const;
+    /** @brief read just a block descriptor, sharing the stream's descriptor table with read
+     * @return the read descriptor or nullptr */
+    static BlockDescriptorPointer readDescriptor(stream::Reader &reader);
+    /** @brief write just a block descriptor, sharing the stream's descriptor table with write
+     */
+    static void writeDescriptor(stream::Writer &writer, BlockDescriptorPointer descriptor);
 };
 
 struct PackedBlock final
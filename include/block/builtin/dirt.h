@@ -64,6 +64,7 @@ private:
                     TextureDescriptor(),
                     TextureDescriptor())
     {
+        addTraits(BlockDescriptorTraitTicksRandomly);
     }
 
 public:
@@ -70,6 +70,7 @@ protected:
           meshGrassFace(),
           meshGrassCenter()
     {
+        addTraits(BlockDescriptorTraitDirtBlock);
         meshFace[BlockFace::NX] = makeFaceMeshNX(nxDirt);
         meshFace[BlockFace::PX] = makeFaceMeshPX(pxDirt);
         meshFace[BlockFace::NY] = makeFaceMeshNY(nyDirt);
@@ -118,6 +119,17 @@ protected:
                     pzGrass)
     {
     }
+
+public:
+    /** @return descriptor as a DirtBlock or nullptr if it isn't one */
+    static const DirtBlock *fromDescriptor(BlockDescriptorPointer descriptor)
+    {
+        if(descriptor == nullptr || !descriptor->hasTraits(BlockDescriptorTraitDirtBlock))
+            return nullptr;
+        return static_cast<const DirtBlock *>(descriptor);
+    }
+
+protected:
     virtual ColorF getGrassShading(const Block &block,
                                    BlockIterator blockIterator,
                                    WorldLockManager &lock_manager) const
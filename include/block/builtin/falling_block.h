@@ -76,6 +76,7 @@ public:
                           staticRenderLayer)
     {
         handledUpdateKinds[BlockUpdateKind::UpdateNotify] = true;
+        addTraits(BlockDescriptorTraitFallingBlock);
     }
     FallingBlock(std::wstring name,
                  BlockShape blockShape,
@@ -99,14 +100,28 @@ public:
                           isFaceBlockedPZ)
     {
         handledUpdateKinds[BlockUpdateKind::UpdateNotify] = true;
+        addTraits(BlockDescriptorTraitFallingBlock);
+    }
+
+    static const FallingBlock *fromDescriptor(BlockDescriptorPointer descriptor)
+    {
+        if(descriptor == nullptr || !descriptor->hasTraits(BlockDescriptorTraitFallingBlock))
+            return nullptr;
+        return static_cast<const FallingBlock *>(descriptor);
     }
 
 protected:
-    virtual Entity *makeFallingBlockEntity(World &world,
-                                           PositionF position,
-                                           WorldLockManager &lock_manager) const = 0;
+    virtual const Entities::builtin::FallingBlock *getFallingBlockEntity() const = 0;
 
 public:
+    /** @brief makes the column of falling blocks starting at blockIterator fall
+     *
+     * the column falls as one entity if it's in view, otherwise the blocks are moved straight to
+     * where they land.
+     */
+    static void makeColumnFall(World &world,
+                               BlockIterator blockIterator,
+                               WorldLockManager &lock_manager);
     virtual void tick(World &world,
                       const Block &block,
                       BlockIterator blockIterator,
@@ -120,9 +135,7 @@ public:
             Block b = bi.get(lock_manager);
             if(b.good() && b.descriptor->isReplaceableByFallingBlock())
             {
-                world.setBlock(blockIterator, lock_manager, Block(Air::descriptor()));
-                makeFallingBlockEntity(
-                    world, blockIterator.position() + VectorF(0.5f), lock_manager);
+                makeColumnFall(world, blockIterator, lock_manager);
             }
         }
     }
@@ -37,8 +37,12 @@ namespace Blocks
 {
 namespace builtin
 {
+class FluidSimulation;
+
 class Fluid : public BlockDescriptor
 {
+    friend class FluidSimulation;
+
 public:
     bool isSource() const
     {
@@ -65,6 +69,13 @@ public:
         return interpolate<float>((float)level / (float)getMaxLevel(d), 0.95f, 0.01f);
     }
     virtual Item getFilledBucket() const = 0;
+    /** @return descriptor as a Fluid or nullptr if it isn't one */
+    static const Fluid *fromDescriptor(BlockDescriptorPointer descriptor)
+    {
+        if(descriptor == nullptr || !descriptor->hasTraits(BlockDescriptorTraitFluid))
+            return nullptr;
+        return static_cast<const Fluid *>(descriptor);
+    }
 
 private:
     TextureDescriptor td;
@@ -100,6 +111,7 @@ protected:
           td(td),
           fluidUpdateKind(fluidUpdateKind)
     {
+        addTraits(BlockDescriptorTraitFluid);
         handledUpdateKinds[BlockUpdateKind::UpdateNotify] = true;
         handledUpdateKinds[fluidUpdateKind] = true;
     }
@@ -122,7 +134,7 @@ private:
                     BlockIterator bi = blockIterator;
                     bi.moveBy(VectorI(dx, dy, dz), lock_manager);
                     Block b = bi.get(lock_manager);
-                    const Fluid *descriptor = dynamic_cast<const Fluid *>(b.descriptor);
+                    const Fluid *descriptor = fromDescriptor(b.descriptor);
                     if(descriptor == nullptr || !isSameKind(descriptor))
                         fluidHeights[dx + 1][dy][dz + 1] = -1;
                     else
@@ -195,7 +207,7 @@ private:
         }
         if(b.descriptor->isFaceBlocked[getOppositeBlockFace(bf)])
             return false;
-        const Fluid *descriptor = dynamic_cast<const Fluid *>(b.descriptor);
+        const Fluid *descriptor = fromDescriptor(b.descriptor);
         if(descriptor == nullptr || !isSameKind(descriptor))
             return true;
         return false;
@@ -399,7 +411,7 @@ private:
         Block b = bi.get(lock_manager);
         if(!b.good())
             return false;
-        const Fluid *bd = dynamic_cast<const Fluid *>(b.descriptor);
+        const Fluid *bd = fromDescriptor(b.descriptor);
         if(bd != nullptr)
         {
             if(isSameKind(bd))
@@ -412,6 +424,13 @@ private:
     }
 
 public:
+    /** @brief fluid updates are stepped for a whole chunk at a time by FluidSimulation */
+    virtual BlockUpdateBatch *getBlockUpdateBatch(BlockUpdateKind kind, TLS &tls) const override;
+    /** @brief update a single fluid block
+     *
+     * the block update thread runs fluid updates through getBlockUpdateBatch, so this is only the
+     * per-block reference for FluidSimulation's rules.
+     */
     virtual void tick(World &world,
                       const Block &block,
                       BlockIterator blockIterator,
@@ -450,7 +469,7 @@ public:
                 bi = blockIterator;
                 bi.moveTowardPY(lock_manager);
                 b = bi.get(lock_manager);
-                if(isSameKind(dynamic_cast<const Fluid *>(b.descriptor)))
+                if(isSameKind(fromDescriptor(b.descriptor)))
                 {
                     newLevel = 1;
                     setBlock(world,
@@ -465,7 +484,7 @@ public:
                     bi = blockIterator;
                     bi.moveTowardNX(lock_manager);
                     b = bi.get(lock_manager);
-                    bd = dynamic_cast<const Fluid *>(b.descriptor);
+                    bd = fromDescriptor(b.descriptor);
                     if(b.good() && isSameKind(bd))
                     {
                         if(!bd->falling && bd->level < minLevel)
@@ -476,7 +495,7 @@ public:
                     bi = blockIterator;
                     bi.moveTowardPX(lock_manager);
                     b = bi.get(lock_manager);
-                    bd = dynamic_cast<const Fluid *>(b.descriptor);
+                    bd = fromDescriptor(b.descriptor);
                     if(b.good() && isSameKind(bd))
                     {
                         if(!bd->falling && bd->level < minLevel)
@@ -487,7 +506,7 @@ public:
                     bi = blockIterator;
                     bi.moveTowardNZ(lock_manager);
                     b = bi.get(lock_manager);
-                    bd = dynamic_cast<const Fluid *>(b.descriptor);
+                    bd = fromDescriptor(b.descriptor);
                     if(b.good() && isSameKind(bd))
                     {
                         if(!bd->falling && bd->level < minLevel)
@@ -498,7 +517,7 @@ public:
                     bi = blockIterator;
                     bi.moveTowardPZ(lock_manager);
                     b = bi.get(lock_manager);
-                    bd = dynamic_cast<const Fluid *>(b.descriptor);
+                    bd = fromDescriptor(b.descriptor);
                     if(b.good() && isSameKind(bd))
                     {
                         if(!bd->falling && bd->level < minLevel)
@@ -528,7 +547,7 @@ public:
                 bi = blockIterator;
                 bi.moveTowardNX(lock_manager);
                 b = bi.get(lock_manager);
-                if(b.good() && dynamic_cast<const Fluid *>(b.descriptor) == nullptr
+                if(b.good() && fromDescriptor(b.descriptor) == nullptr
                    && b.descriptor->isReplaceableByFluid())
                 {
                     b.descriptor->onReplace(world, b, bi, lock_manager);
@@ -541,7 +560,7 @@ public:
                 bi = blockIterator;
                 bi.moveTowardPX(lock_manager);
                 b = bi.get(lock_manager);
-                if(b.good() && dynamic_cast<const Fluid *>(b.descriptor) == nullptr
+                if(b.good() && fromDescriptor(b.descriptor) == nullptr
                    && b.descriptor->isReplaceableByFluid())
                 {
                     b.descriptor->onReplace(world, b, bi, lock_manager);
@@ -554,7 +573,7 @@ public:
                 bi = blockIterator;
                 bi.moveTowardNZ(lock_manager);
                 b = bi.get(lock_manager);
-                if(b.good() && dynamic_cast<const Fluid *>(b.descriptor) == nullptr
+                if(b.good() && fromDescriptor(b.descriptor) == nullptr
                    && b.descriptor->isReplaceableByFluid())
                 {
                     b.descriptor->onReplace(world, b, bi, lock_manager);
@@ -567,7 +586,7 @@ public:
                 bi = blockIterator;
                 bi.moveTowardPZ(lock_manager);
                 b = bi.get(lock_manager);
-                if(b.good() && dynamic_cast<const Fluid *>(b.descriptor) == nullptr
+                if(b.good() && fromDescriptor(b.descriptor) == nullptr
                    && b.descriptor->isReplaceableByFluid())
                 {
                     b.descriptor->onReplace(world, b, bi, lock_manager);
@@ -581,7 +600,7 @@ public:
             bi = blockIterator;
             bi.moveTowardNY(lock_manager);
             b = bi.get(lock_manager);
-            if(b.good() && dynamic_cast<const Fluid *>(b.descriptor) == nullptr
+            if(b.good() && fromDescriptor(b.descriptor) == nullptr
                && b.descriptor->isReplaceableByFluid())
             {
                 b.descriptor->onReplace(world, b, bi, lock_manager);
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef FLUID_SIMULATION_H_INCLUDED
+#define FLUID_SIMULATION_H_INCLUDED
+
+#include "block/builtin/fluid.h"
+#include <vector>
+#include <cstdint>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace Blocks
+{
+namespace builtin
+{
+/** @brief steps all of a chunk's ready updates for one kind of fluid together
+ *
+ * the blocks around the updated fluid are read once into a dense level/flow array, every updated
+ * block is stepped against that snapshot using the same rules as Fluid::tick, and only the blocks
+ * whose level or flow actually changes are written back. Blocks that were changed by something
+ * else after they were read aren't overwritten. When several blocks flow into the same block, the
+ * one with the most fluid wins, instead of the one Fluid::tick would run last.
+ */
+class FluidSimulation final : public BlockUpdateBatch
+{
+    FluidSimulation(const FluidSimulation &) = delete;
+    FluidSimulation &operator=(const FluidSimulation &) = delete;
+
+private:
+    struct Cell final
+    {
+        enum class Kind : std::uint8_t
+        {
+            Unloaded,
+            Blocked,
+            Replaceable,
+            SameFluid,
+            OtherFluid,
+        };
+        Kind kind = Kind::Unloaded;
+        std::uint8_t level = 0;
+        bool falling = false;
+        std::size_t writeIndex = 0; /// index + 1 of this cell's entry in writes or 0 if none
+    };
+    struct Write final
+    {
+        BlockIterator blockIterator;
+        const BlockDescriptor *newDescriptor;
+        bool replacesNonFluid;
+        unsigned level;
+        std::uint8_t readLevel; /// the fluid's level when it was read, if !replacesNonFluid
+        bool readFalling; /// if the fluid was falling when it was read, if !replacesNonFluid
+        Write(BlockIterator blockIterator,
+              const BlockDescriptor *newDescriptor,
+              bool replacesNonFluid,
+              unsigned level,
+              const Cell &cell)
+            : blockIterator(std::move(blockIterator)),
+              newDescriptor(newDescriptor),
+              replacesNonFluid(replacesNonFluid),
+              level(level),
+              readLevel(cell.level),
+              readFalling(cell.falling)
+        {
+        }
+    };
+    const Fluid *const fluid;
+    std::vector<BlockIterator> updatedBlocks;
+    std::vector<Cell> cells;
+    std::vector<Write> writes;
+    VectorI minCorner;
+    VectorI size;
+
+public:
+    explicit FluidSimulation(const Fluid *fluid)
+        : fluid(fluid), updatedBlocks(), cells(), writes(), minCorner(0), size(0)
+    {
+    }
+    virtual void add(const Block &block,
+                     BlockIterator blockIterator,
+                     WorldLockManager &lock_manager,
+                     BlockUpdateKind kind) override
+    {
+        updatedBlocks.push_back(std::move(blockIterator));
+    }
+    virtual void run(World &world, WorldLockManager &lock_manager) override;
+
+private:
+    Cell &getCell(VectorI position, WorldLockManager &lock_manager);
+    bool getIsFalling(VectorI position, unsigned newLevel, WorldLockManager &lock_manager);
+    void addWrite(VectorI position,
+                  const BlockIterator &blockIterator,
+                  const BlockDescriptor *newDescriptor,
+                  bool replacesNonFluid,
+                  unsigned level,
+                  WorldLockManager &lock_manager);
+};
+}
+}
+}
+}
+
+#endif // FLUID_SIMULATION_H_INCLUDED
@@ -64,6 +64,7 @@ private:
                     TextureAtlas::GrassMask.td(),
                     TextureAtlas::GrassMask.td())
     {
+        addTraits(BlockDescriptorTraitTicksRandomly);
     }
 
 public:
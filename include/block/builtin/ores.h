@@ -235,6 +235,7 @@ private:
                      TextureAtlas::ActiveRedstoneOre.td(),
                      LightProperties(Lighting::makeArtificialLighting(9), Lighting::makeMaxLight()))
     {
+        addTraits(BlockDescriptorTraitTicksRandomly);
     }
 
 public:
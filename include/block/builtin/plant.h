@@ -109,6 +109,9 @@ protected:
     {
         assert(animationFrame < animationFrameCount);
         handledUpdateKinds[BlockUpdateKind::UpdateNotify] = true;
+        addTraits(BlockDescriptorTraitPlant);
+        if(animationFrame + 1 < animationFrameCount)
+            addTraits(BlockDescriptorTraitTicksRandomly);
     }
     virtual const Plant *getPlantFrame(unsigned frame) const = 0;
     virtual void dropItems(BlockIterator bi,
@@ -121,6 +124,13 @@ protected:
                                  WorldLockManager &lock_manager) const = 0;
 
 public:
+    /** @return descriptor as a Plant or nullptr if it isn't one */
+    static const Plant *fromDescriptor(BlockDescriptorPointer descriptor)
+    {
+        if(descriptor == nullptr || !descriptor->hasTraits(BlockDescriptorTraitPlant))
+            return nullptr;
+        return static_cast<const Plant *>(descriptor);
+    }
     virtual RayCasting::Collision getRayCollision(const Block &block,
                                                   BlockIterator blockIterator,
                                                   WorldLockManager &lock_manager,
@@ -273,6 +273,7 @@ private:
           edgeAttachedStateNZ(edgeAttachedStateNZ),
           edgeAttachedStatePZ(edgeAttachedStatePZ)
     {
+        addTraits(BlockDescriptorTraitRedstoneDust);
         handledUpdateKinds[BlockUpdateKind::UpdateNotify] = true;
         handledUpdateKinds[BlockUpdateKind::Redstone] = true;
     }
@@ -376,6 +377,13 @@ public:
     {
         return pointer();
     }
+    /** @return descriptor as a RedstoneDust or nullptr if it isn't one */
+    static const RedstoneDust *fromDescriptor(BlockDescriptorPointer descriptor)
+    {
+        if(descriptor == nullptr || !descriptor->hasTraits(BlockDescriptorTraitRedstoneDust))
+            return nullptr;
+        return static_cast<const RedstoneDust *>(descriptor);
+    }
 
 private:
     static RedstoneSignal calculateRedstoneSignal(BlockFace inputThroughBlockFace,
@@ -419,7 +427,7 @@ private:
         Block b = bi.get(lock_manager);
         if(b.good())
         {
-            const RedstoneDust *sideDescriptor = dynamic_cast<const RedstoneDust *>(b.descriptor);
+            const RedstoneDust *sideDescriptor = fromDescriptor(b.descriptor);
             if(sideDescriptor != nullptr)
             {
                 if(sideDescriptor->signalStrength > signal + 1)
@@ -435,8 +443,7 @@ private:
                     b = bi.get(lock_manager);
                     if(b.good())
                     {
-                        const RedstoneDust *downDescriptor =
-                            dynamic_cast<const RedstoneDust *>(b.descriptor);
+                        const RedstoneDust *downDescriptor = fromDescriptor(b.descriptor);
                         if(downDescriptor != nullptr)
                         {
                             if(downDescriptor->signalStrength > signal + 1)
@@ -460,8 +467,7 @@ private:
                 b = bi.get(lock_manager);
                 if(b.good())
                 {
-                    const RedstoneDust *upDescriptor =
-                        dynamic_cast<const RedstoneDust *>(b.descriptor);
+                    const RedstoneDust *upDescriptor = fromDescriptor(b.descriptor);
                     if(upDescriptor != nullptr)
                     {
                         if(upDescriptor->signalStrength > signal + 1)
@@ -473,6 +479,15 @@ private:
         }
         return std::pair<unsigned, EdgeAttachedState>(signal, edgeAttachedState);
     }
+    struct SignalGraph;
+    /** @brief compile the network of connected redstone dust containing blockIterator into a
+     * SignalGraph, evaluate it, and set only the dust that changed
+     *
+     * @return false if the network is too big, so the dust should be updated by itself
+     */
+    static bool updateNetwork(World &world,
+                              BlockIterator blockIterator,
+                              WorldLockManager &lock_manager);
 
 public:
     static const RedstoneDust *calcOrientationAndSignalStrength(BlockIterator blockIterator,
@@ -533,7 +548,8 @@ public:
                                    BlockIterator bi,
                                    WorldLockManager &lock_manager,
                                    double currentTime,
-                                   double deltaTime) const override;
+                                   double deltaTime,
+                                   ParticleBatch &newParticles) const override;
     virtual void onReplace(World &world,
                            Block b,
                            BlockIterator bi,
@@ -571,6 +587,8 @@ public:
         }
         else if(kind == BlockUpdateKind::Redstone)
         {
+            if(updateNetwork(world, blockIterator, lock_manager))
+                return;
             const RedstoneDust *newDescriptor =
                 calcOrientationAndSignalStrength(blockIterator, lock_manager);
             if(newDescriptor != this)
@@ -793,7 +811,8 @@ public:
                                    BlockIterator bi,
                                    WorldLockManager &lock_manager,
                                    double currentTime,
-                                   double deltaTime) const override;
+                                   double deltaTime,
+                                   ParticleBatch &newParticles) const override;
     virtual RedstoneSignal getRedstoneSignal(BlockFace outputThroughBlockFace) const
     {
         auto signal = RedstoneSignalComponent(isOn ? RedstoneSignalComponent::maxStrength : 0);
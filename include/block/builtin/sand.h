@@ -85,9 +85,7 @@ public:
     }
 
 protected:
-    virtual Entity *makeFallingBlockEntity(World &world,
-                                           PositionF position,
-                                           WorldLockManager &lock_manager) const override;
+    virtual const Entities::builtin::FallingBlock *getFallingBlockEntity() const override;
 };
 class Gravel final : public FallingFullBlock
 {
@@ -141,9 +139,7 @@ public:
     }
 
 protected:
-    virtual Entity *makeFallingBlockEntity(World &world,
-                                           PositionF position,
-                                           WorldLockManager &lock_manager) const override;
+    virtual const Entities::builtin::FallingBlock *getFallingBlockEntity() const override;
 };
 }
 }
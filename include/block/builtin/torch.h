@@ -396,7 +396,8 @@ public:
                                    BlockIterator bi,
                                    WorldLockManager &lock_manager,
                                    double currentTime,
-                                   double deltaTime) const override;
+                                   double deltaTime,
+                                   ParticleBatch &newParticles) const override;
     virtual void writeBlockData(stream::Writer &writer,
                                 BlockDataPointer<BlockData> data) const override
     {
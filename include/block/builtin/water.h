@@ -70,6 +70,8 @@ private:
                 TextureAtlas::WaterSide0.td(),
                 BlockUpdateKind::Water)
     {
+        static const BlockDescriptorKindId waterKindId = makeKindId();
+        setKindId(waterKindId);
     }
 
 public:
@@ -95,7 +97,7 @@ protected:
     }
     virtual bool isSameKind(const Fluid *other) const override
     {
-        return dynamic_cast<const Water *>(other) != nullptr;
+        return other != nullptr && other->getKindId() == getKindId();
     }
     virtual ColorF getColorizeColor(BlockIterator bi, WorldLockManager &lock_manager) const override
     {
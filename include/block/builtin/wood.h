@@ -127,6 +127,7 @@ public:
           woodDescriptor(woodDescriptor),
           logOrientation(logOrientation)
     {
+        addTraits(BlockDescriptorTraitWoodLog);
         switch(logOrientation)
         {
         case LogOrientation::AllBark:
@@ -339,11 +340,11 @@ protected:
                         currentSupported = 1;
                         currentPropagates = 1;
                     }
-                    else if(dynamic_cast<const WoodLeaves *>(b.descriptor) != nullptr)
+                    else if(b.descriptor->hasTraits(BlockDescriptorTraitWoodLeaves))
                     {
                         currentPropagates = 1;
                     }
-                    else if(dynamic_cast<const WoodLog *>(b.descriptor) != nullptr)
+                    else if(b.descriptor->hasTraits(BlockDescriptorTraitWoodLog))
                     {
                         currentPropagates = 1;
                         currentSupported = 1;
@@ -428,6 +429,9 @@ public:
         meshBlockedFace[BlockFace::PY] = makeFaceMeshPY(td);
         meshBlockedFace[BlockFace::NZ] = makeFaceMeshNZ(td);
         meshBlockedFace[BlockFace::PZ] = makeFaceMeshPZ(td);
+        addTraits(BlockDescriptorTraitWoodLeaves);
+        if(canDecay)
+            addTraits(BlockDescriptorTraitTicksRandomly);
     }
     WoodDescriptorPointer getWoodDescriptor() const
     {
@@ -595,9 +599,9 @@ protected:
     }
     virtual const Plant *getPlantFrame(unsigned frame) const override
     {
-        BlockDescriptorPointer retval = woodDescriptor->getSaplingBlockDescriptor(frame);
-        assert(dynamic_cast<const Plant *>(retval) != nullptr);
-        return static_cast<const Plant *>(retval);
+        const Plant *retval = fromDescriptor(woodDescriptor->getSaplingBlockDescriptor(frame));
+        assert(retval != nullptr);
+        return retval;
     }
     virtual void dropItems(BlockIterator bi,
                            Block b,
@@ -703,7 +707,7 @@ protected:
         Block b = bi.get(lock_manager);
         if(!b.good())
             return false;
-        const DirtBlock *dirtDescriptor = dynamic_cast<const DirtBlock *>(b.descriptor);
+        const DirtBlock *dirtDescriptor = DirtBlock::fromDescriptor(b.descriptor);
         if(dirtDescriptor == nullptr)
             return false;
         if(!dirtDescriptor->canGrowTreeOn())
@@ -757,6 +761,7 @@ public:
                 1.0f),
           woodDescriptor(woodDescriptor)
     {
+        addTraits(BlockDescriptorTraitTicksRandomly);
     }
     virtual void randomTick(const Block &block,
                             World &world,
@@ -25,18 +25,33 @@
 #include "block/block.h"
 #include "item/item.h"
 #include <atomic>
+#include <vector>
 #include "render/generate.h"
+#include "util/global_instance_maker.h"
 
 namespace programmerjake
 {
 namespace voxels
 {
+namespace Blocks
+{
+namespace builtin
+{
+class FallingBlock;
+}
+}
+
 namespace Entities
 {
 namespace builtin
 {
+class FallingBlockColumn;
+
 class FallingBlock : public EntityDescriptor
 {
+    friend class FallingBlockColumn;
+    friend class Blocks::builtin::FallingBlock;
+
 protected:
     Mesh blockMesh;
     FallingBlock(std::wstring name, Mesh blockMesh) : EntityDescriptor(name), blockMesh(blockMesh)
@@ -210,6 +225,93 @@ public:
         return std::shared_ptr<void>(new FallingBlockData(timeLeft));
     }
 };
+
+/** @brief a column of falling blocks that falls and lands as one entity
+ *
+ * used instead of one FallingBlock entity per block, so undermining a large area doesn't make a
+ * physics object for every block.
+ */
+class FallingBlockColumn final : public EntityDescriptor
+{
+    friend class global_instance_maker<FallingBlockColumn>;
+
+public:
+    static constexpr std::size_t maxHeight = 64;
+
+private:
+    struct ColumnData final
+    {
+        double timeLeft = 30.0f;
+        std::atomic_bool collided;
+        std::vector<const FallingBlock *> blocks; /// from the bottom up
+        explicit ColumnData(std::vector<const FallingBlock *> blocks)
+            : collided(false), blocks(std::move(blocks))
+        {
+        }
+        ColumnData(double timeLeft, std::vector<const FallingBlock *> blocks)
+            : timeLeft(timeLeft), collided(false), blocks(std::move(blocks))
+        {
+        }
+    };
+    static ColumnData &getColumnData(const std::shared_ptr<void> &data)
+    {
+        assert(data != nullptr);
+        return *static_cast<ColumnData *>(data.get());
+    }
+    static float getBottomOffset(const ColumnData &data)
+    {
+        return -0.5f * static_cast<float>(data.blocks.size() - 1);
+    }
+    FallingBlockColumn() : EntityDescriptor(L"builtin.falling_block_column")
+    {
+    }
+
+public:
+    static const FallingBlockColumn *pointer()
+    {
+        return global_instance_maker<FallingBlockColumn>::getInstance();
+    }
+    static EntityDescriptorPointer descriptor()
+    {
+        return pointer();
+    }
+    /** @brief add a falling column to world
+     *
+     * @param bottomPosition the center of the bottom block
+     * @param blocks the falling block entities for each block, from the bottom up
+     */
+    static Entity *addToWorld(World &world,
+                              WorldLockManager &lock_manager,
+                              PositionF bottomPosition,
+                              std::vector<const FallingBlock *> blocks);
+    virtual void moveStep(Entity &entity,
+                          World &world,
+                          WorldLockManager &lock_manager,
+                          double deltaTime) const override;
+    virtual void render(Entity &entity,
+                        Mesh &dest,
+                        RenderLayer rl,
+                        const Transform &cameraToWorldMatrix) const override;
+    virtual Transform getSelectionBoxTransform(const Entity &entity) const override;
+    virtual void makeData(Entity &entity,
+                          World &world,
+                          WorldLockManager &lock_manager) const override
+    {
+        assert(entity.data != nullptr);
+    }
+    virtual std::shared_ptr<PhysicsObject> makePhysicsObject(
+        Entity &entity,
+        PositionF position,
+        VectorF velocity,
+        std::shared_ptr<PhysicsWorld> physicsWorld) const override;
+    virtual void write(PositionF position,
+                       VectorF velocity,
+                       std::shared_ptr<void> data,
+                       stream::Writer &writer) const override;
+    virtual std::shared_ptr<void> read(PositionF position,
+                                       VectorF velocity,
+                                       stream::Reader &reader) const override;
+};
 }
 }
 }
@@ -93,6 +93,7 @@ private:
         std::weak_ptr<Player> ignorePlayer = std::weak_ptr<Player>();
         bool followingPlayer = false;
         ItemStack itemStack;
+        double mergeTimeLeft = 0; /// time until the next check for items to merge with; not saved
         void init(uint32_t seed)
         {
             std::minstd_rand generator(seed);
@@ -154,8 +155,13 @@ private:
             return true;
         return false;
     }
+    void mergeNearbyItems(Entity &entity, World &world, WorldLockManager &lock_manager) const;
 
 public:
+    /** @brief how often item entities check for identical item entities to merge with */
+    static constexpr double mergeInterval = 0.5;
+    /** @brief how close identical item entities need to be to merge */
+    static constexpr float mergeDistance = 0.75f;
     virtual void render(Entity &entity,
                         Mesh &dest,
                         RenderLayer rl,
@@ -31,12 +31,15 @@ namespace programmerjake
 {
 namespace voxels
 {
+class ParticleSystem;
 namespace Entities
 {
 namespace builtin
 {
 class Particle : public EntityDescriptor
 {
+    friend class ::programmerjake::voxels::ParticleSystem;
+
 public:
     const bool collideWithBlocks;
     const VectorF gravity;
@@ -90,6 +93,52 @@ protected:
         assert(data != nullptr);
         return *static_cast<ParticleData *>(data.get());
     }
+    /** @brief append the quad for a particle that has existed for time seconds
+     *
+     * @param center the center of the particle
+     * @param upVector the camera's up direction, with a length of 1
+     * @param rightVector the camera's right direction, with a length of 1
+     */
+    void appendQuad(Mesh &dest,
+                    VectorF center,
+                    double time,
+                    float existDuration,
+                    VectorF upVector,
+                    VectorF rightVector) const
+    {
+        std::size_t frameIndex = (std::size_t)(int)std::floor(time * framesPerSecond);
+        if(loop)
+            frameIndex %= frames.size();
+        else if(frameIndex >= frames.size())
+            return;
+        const TextureDescriptor &frame = frames[frameIndex];
+        upVector *= extent;
+        rightVector *= extent;
+        ParticleData data(existDuration);
+        data.time = time;
+        ColorF c = colorizeColor(data);
+        VectorF normal = normalizeNoThrow(cross(rightVector, upVector));
+        if(frame.image != nullptr)
+            dest.image = frame.image;
+        auto v1 = dest.addVertex(Vertex(TextureCoord(frame.minU, frame.minV),
+                                        center - upVector - rightVector,
+                                        c,
+                                        normal));
+        auto v2 = dest.addVertex(Vertex(TextureCoord(frame.maxU, frame.minV),
+                                        center - upVector + rightVector,
+                                        c,
+                                        normal));
+        auto v3 = dest.addVertex(Vertex(TextureCoord(frame.maxU, frame.maxV),
+                                        center + upVector + rightVector,
+                                        c,
+                                        normal));
+        auto v4 = dest.addVertex(Vertex(TextureCoord(frame.minU, frame.maxV),
+                                        center + upVector - rightVector,
+                                        c,
+                                        normal));
+        dest.addTriangle(IndexedTriangle(v1, v2, v3));
+        dest.addTriangle(IndexedTriangle(v3, v4, v1));
+    }
 
 public:
     Particle(std::wstring name,
@@ -160,25 +209,15 @@ public:
     {
         if(rl != RenderLayer::Opaque)
             return;
-        double time = getParticleData(entity.data).getTime();
-        std::size_t frameIndex = (std::size_t)(int)std::floor(time * framesPerSecond);
-        if(loop)
-            frameIndex %= frames.size();
-        else if(frameIndex >= frames.size())
-            return;
-        TextureDescriptor frame = frames[frameIndex];
-
-        VectorF upVector = cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(0, extent, 0));
-        VectorF rightVector =
-            cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(extent, 0, 0));
-        VectorF center = entity.physicsObject->getPosition();
-
-        VectorF nxny = center - upVector - rightVector;
-        VectorF nxpy = center + upVector - rightVector;
-        VectorF pxny = center - upVector + rightVector;
-        VectorF pxpy = center + upVector + rightVector;
-        ColorF c = colorizeColor(static_cast<float>(time));
-        dest.append(Generate::quadrilateral(frame, nxny, c, pxny, c, pxpy, c, nxpy, c));
+        const ParticleData &data = getParticleData(entity.data);
+        VectorF upVector = cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(0, 1, 0));
+        VectorF rightVector = cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(1, 0, 0));
+        appendQuad(dest,
+                   entity.physicsObject->getPosition(),
+                   data.getTime(),
+                   data.existDuration,
+                   upVector,
+                   rightVector);
     }
 };
 }
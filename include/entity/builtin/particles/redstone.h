@@ -76,10 +76,15 @@ public:
     {
         return pointer();
     }
-    static Entity *addToWorld(World &world, WorldLockManager &lock_manager, PositionF position)
+    static void addToWorld(World &world, PositionF position)
     {
         VectorF v = VectorF::random(world.getRandomGenerator()) * 0.25f;
-        return world.addEntity(descriptor(), position, v, lock_manager);
+        world.getParticleSystem().add(pointer(), position, v, world);
+    }
+    static void addToBatch(World &world, ParticleBatch &batch, PositionF position)
+    {
+        VectorF v = VectorF::random(world.getRandomGenerator()) * 0.25f;
+        batch.add(pointer(), position, v);
     }
     virtual void write(PositionF position,
                        VectorF velocity,
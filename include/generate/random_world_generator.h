@@ -32,6 +32,7 @@
 #include <exception>
 #include "util/blocks_generate_array.h"
 #include <tuple>
+#include <vector>
 #include "util/tls.h"
 #include "util/xorshiftplus.h"
 #include "util/util.h"
@@ -356,6 +357,93 @@ private:
             return blocks[relativePosition.x][relativePosition.y][relativePosition.z].lighting;
         return World::getDefaultBlockLighting(relativePosition + chunkBasePosition, isTopFace);
     }
+    static bool updateBlockLighting(BlocksGenerateArray &blocks,
+                                    const VectorI &relativePosition,
+                                    const PositionI &chunkBasePosition)
+    {
+        auto &block = blocks[relativePosition.x][relativePosition.y][relativePosition.z];
+        assert(block.good());
+        Lighting newLighting = block.descriptor->lightProperties.eval(
+            getBlockLighting(blocks, relativePosition + VectorI(-1, 0, 0), chunkBasePosition, false),
+            getBlockLighting(blocks, relativePosition + VectorI(1, 0, 0), chunkBasePosition, false),
+            getBlockLighting(blocks, relativePosition + VectorI(0, -1, 0), chunkBasePosition, false),
+            getBlockLighting(blocks, relativePosition + VectorI(0, 1, 0), chunkBasePosition, true),
+            getBlockLighting(blocks, relativePosition + VectorI(0, 0, -1), chunkBasePosition, false),
+            getBlockLighting(blocks, relativePosition + VectorI(0, 0, 1), chunkBasePosition, false));
+        if(newLighting == block.lighting)
+            return false;
+        block.lighting = newLighting;
+        return true;
+    }
+    /** @brief light the generated blocks until they don't change anymore
+     *
+     * does one full pass from the top down, so direct skylight reaches the bottom of every column,
+     * then only revisits the neighbors of blocks that changed.
+     */
+    static void lightBlocks(BlocksGenerateArray &blocks,
+                            const PositionI &chunkBasePosition,
+                            const std::atomic_bool *abortFlag)
+    {
+        const std::size_t blockCount =
+            BlockChunk::chunkSizeX * BlockChunk::chunkSizeY * BlockChunk::chunkSizeZ;
+        auto getIndex = [](VectorI relativePosition) -> std::size_t
+        {
+            return (static_cast<std::size_t>(relativePosition.x) * BlockChunk::chunkSizeY
+                    + relativePosition.y) * BlockChunk::chunkSizeZ
+                   + relativePosition.z;
+        };
+        std::vector<bool> queued(blockCount, false);
+        std::vector<VectorI> currentQueue, nextQueue;
+        auto queueNeighbors = [&](VectorI relativePosition)
+        {
+            static const VectorI neighborOffsets[] = {VectorI(-1, 0, 0),
+                                                      VectorI(1, 0, 0),
+                                                      VectorI(0, -1, 0),
+                                                      VectorI(0, 1, 0),
+                                                      VectorI(0, 0, -1),
+                                                      VectorI(0, 0, 1)};
+            for(VectorI offset : neighborOffsets)
+            {
+                VectorI p = relativePosition + offset;
+                if(p.x < 0 || p.x >= BlockChunk::chunkSizeX || p.y < 0
+                   || p.y >= BlockChunk::chunkSizeY
+                   || p.z < 0
+                   || p.z >= BlockChunk::chunkSizeZ)
+                    continue;
+                std::size_t index = getIndex(p);
+                if(queued[index])
+                    continue;
+                queued[index] = true;
+                nextQueue.push_back(p);
+            }
+        };
+        for(VectorI relativePosition(0, BlockChunk::chunkSizeY - 1, 0); relativePosition.y >= 0;
+            relativePosition.y--)
+        {
+            for(relativePosition.x = 0; relativePosition.x < BlockChunk::chunkSizeX;
+                relativePosition.x++)
+            {
+                for(relativePosition.z = 0; relativePosition.z < BlockChunk::chunkSizeZ;
+                    relativePosition.z++)
+                {
+                    if(updateBlockLighting(blocks, relativePosition, chunkBasePosition))
+                        queueNeighbors(relativePosition);
+                }
+            }
+        }
+        while(!nextQueue.empty())
+        {
+            checkForAbort(abortFlag);
+            currentQueue.swap(nextQueue);
+            nextQueue.clear();
+            for(VectorI relativePosition : currentQueue)
+            {
+                queued[getIndex(relativePosition)] = false;
+                if(updateBlockLighting(blocks, relativePosition, chunkBasePosition))
+                    queueNeighbors(relativePosition);
+            }
+        }
+    }
 
 public:
     virtual void generateChunk(PositionI chunkBasePosition,
@@ -371,64 +459,15 @@ public:
             thread_local_variable<BlocksGenerateArray, blocks_tls_tag> blocks(lock_manager.tls);
             RandomSource randomSource(world.getWorldGeneratorSeed());
             generate(chunkBasePosition, blocks.get(), world, lock_manager, randomSource, abortFlag);
-            for(bool anyChange = true; anyChange;)
-            {
-                anyChange = false;
-                for(VectorI relativePosition(0, BlockChunk::chunkSizeY - 1, 0);
-                    relativePosition.y >= 0;
-                    relativePosition.y--)
-                {
-                    for(relativePosition.x = 0; relativePosition.x < BlockChunk::chunkSizeX;
-                        relativePosition.x++)
-                    {
-                        for(relativePosition.z = 0; relativePosition.z < BlockChunk::chunkSizeZ;
-                            relativePosition.z++)
-                        {
-                            auto &block =
-                                blocks.get()[relativePosition.x][relativePosition
-                                                                     .y][relativePosition.z];
-                            assert(block.good());
-                            Lighting newLighting = block.descriptor->lightProperties.eval(
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(-1, 0, 0),
-                                                 chunkBasePosition,
-                                                 false),
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(1, 0, 0),
-                                                 chunkBasePosition,
-                                                 false),
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(0, -1, 0),
-                                                 chunkBasePosition,
-                                                 false),
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(0, 1, 0),
-                                                 chunkBasePosition,
-                                                 true),
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(0, 0, -1),
-                                                 chunkBasePosition,
-                                                 false),
-                                getBlockLighting(blocks.get(),
-                                                 relativePosition + VectorI(0, 0, 1),
-                                                 chunkBasePosition,
-                                                 false));
-                            if(newLighting != block.lighting)
-                            {
-                                block.lighting = newLighting;
-                                anyChange = true;
-                            }
-                        }
-                    }
-                }
-            }
+            lightBlocks(blocks.get(), chunkBasePosition, abortFlag);
             world.setBlockRange(chunkBasePosition,
                                 chunkBasePosition + VectorI(BlockChunk::chunkSizeX - 1,
                                                             BlockChunk::chunkSizeY - 1,
                                                             BlockChunk::chunkSizeZ - 1),
                                 lock_manager,
                                 blocks.get(),
-                                VectorI(0));
+                                VectorI(0),
+                                true);
             for(std::size_t x = 0; x < blocks.get().size(); x++)
             {
                 for(std::size_t z = 0; z < blocks.get()[x][0].size(); z++)
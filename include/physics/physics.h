@@ -38,6 +38,7 @@
 #include <cmath>
 #include <tuple>
 #include <mutex>
+#include <atomic>
 #include "util/cached_variable.h"
 #include "util/logging.h"
 #include "util/object_counter.h"
@@ -232,6 +233,9 @@ private:
     checked_array<BlockEffects, 2> blockEffects;
     std::shared_ptr<const std::vector<PhysicsConstraint>> constraints;
     std::shared_ptr<PhysicsCollisionHandler> collisionHandler;
+    /// the order this was made in, for breaking ties when sorting objects that are in the same
+    /// place so the order doesn't depend on the hash table
+    const std::uint64_t creationIndex;
     PhysicsObject(const PhysicsObject &) = delete;
     const PhysicsObject &operator=(const PhysicsObject &) = delete;
     PhysicsObject(PositionF position,
@@ -409,7 +413,8 @@ public:
           objects(),
           eventsQueue(),
           eventsSet(),
-          changedObjects()
+          changedObjects(),
+          nextObjectCreationIndex(0)
     {
     }
     BlockChunkMap chunks; // not locked by theLock
@@ -558,6 +563,7 @@ private:
         eventsQueue;
     std::unordered_set<CollisionEvent, CollisionEventHash> eventsSet;
     std::unordered_set<ordered_weak_ptr<PhysicsObject>> changedObjects;
+    std::atomic<std::uint64_t> nextObjectCreationIndex;
     void swapVariableSetIndex()
     {
         variableSetIndex = (variableSetIndex != 0 ? 0 : 1);
@@ -704,7 +710,8 @@ inline PhysicsObject::PhysicsObject(PositionF position,
       properties(properties),
       blockEffects(),
       constraints(),
-      collisionHandler(collisionHandler)
+      collisionHandler(collisionHandler),
+      creationIndex(world->nextObjectCreationIndex++)
 {
 }
 
@@ -47,6 +47,22 @@ const float defaultFPS = 60;
 std::shared_ptr<stream::Reader> getResourceReader(std::wstring resource);
 std::shared_ptr<stream::Reader> readUserSpecificFile(std::wstring name);
 std::shared_ptr<stream::Writer> createOrWriteUserSpecificFile(std::wstring name);
+/** @brief open an existing user specific file for writing at its end
+ *
+ * the returned writer is seekable, so bytes already in the file can be overwritten too.
+ */
+std::shared_ptr<stream::Writer> appendUserSpecificFile(std::wstring name);
+/** @brief rename a user specific file, replacing the file named newName if there is one
+ *
+ * the replacement is atomic where the platform supports it, so newName is always either the old
+ * or the new file.
+ */
+void renameUserSpecificFile(std::wstring oldName, std::wstring newName);
+/** @brief delete a user specific file
+ *
+ * @return false if there is no file named name
+ */
+bool removeUserSpecificFile(std::wstring name);
 
 /** returns reader/writer pair
  @note Writer::flush should be called after writing before attempting to read
@@ -78,6 +78,8 @@ private:
     {
         generateMeshes();
     }
+
+public:
     std::shared_ptr<Player> getPlayer(const Entity &entity) const
     {
         return getPlayer(entity.data);
@@ -86,6 +88,8 @@ private:
     {
         return std::static_pointer_cast<std::weak_ptr<Player>>(data)->lock();
     }
+
+private:
     virtual std::shared_ptr<PhysicsObject> makePhysicsObject(
         Entity &entity,
         PositionF position,
@@ -146,6 +150,28 @@ public:
 }
 }
 
+/** @brief one player's game input for one step of a deterministic world */
+struct PlayerInputFrame final
+{
+    std::wstring playerName;
+    bool isCreativeMode = false;
+    bool jump = false;
+    bool fly = false;
+    VectorF moveDirectionPlayerRelative = VectorF(0);
+    bool attack = false;
+    bool sneak = false;
+    float viewTheta = 0;
+    float viewPhi = 0;
+    float viewPsi = 0;
+    bool gotJump = false; /// if jump was pressed since the last step
+    bool gotAttack = false; /// if attack was pressed since the last step
+    std::uint32_t actionCount = 0;
+    std::uint32_t dropCount = 0;
+    std::uint32_t currentItemIndex = 0;
+    void write(stream::Writer &writer) const;
+    static PlayerInputFrame read(stream::Reader &reader);
+};
+
 GCC_PRAGMA(diagnostic push)
 GCC_PRAGMA(diagnostic ignored "-Weffc++")
 class Player final : public std::enable_shared_from_this<Player>
@@ -389,6 +415,14 @@ public:
             return retval;
         return Item();
     }
+    /** @brief take the game input for the next step of a deterministic world
+     *
+     * the presses since the last call are moved into the returned frame, so the frame must be
+     * passed to applyInputFrame before the step runs.
+     */
+    PlayerInputFrame takeInputFrame();
+    /** @brief set the game input that the next step of a deterministic world uses */
+    void applyInputFrame(const PlayerInputFrame &frame);
     static void writeReference(stream::Writer &writer, std::shared_ptr<Player> player);
     static std::shared_ptr<Player> readReference(stream::Reader &reader);
     void write(stream::Writer &writer);
@@ -38,6 +38,12 @@ public:
     }
 };
 
+/** @brief compute the CRC-32 that zlib and gzip use
+ *
+ * @param crc the CRC-32 of the preceding bytes, to compute it over several calls
+ */
+std::uint32_t computeCRC32(const std::uint8_t *bytes, std::size_t count, std::uint32_t crc = 0);
+
 class ExpandReader final : public Reader
 {
 private:
@@ -46,7 +52,6 @@ private:
     std::shared_ptr<void> state;
     static constexpr std::size_t bufferSize = 1 << 16;
     std::vector<std::uint8_t> buffer, compressedBuffer;
-    std::size_t bufferPointer = 0;
     bool moreAvailable = false, gotEOF = false;
     void readBuffer();
     void readCompressedBuffer();
@@ -62,17 +67,15 @@ public:
     }
     virtual bool dataAvailable() override
     {
-        if(bufferPointer < buffer.size())
-            return true;
-        return false;
+        return readBufferPointer != readBufferEnd;
     }
     virtual std::uint8_t readByte() override
     {
-        if(dataAvailable())
-            return buffer[bufferPointer++];
-        readBuffer();
-        return buffer[bufferPointer++];
+        if(readBufferPointer == readBufferEnd)
+            readBuffer();
+        return *readBufferPointer++;
     }
+    virtual std::size_t readBytes(std::uint8_t *array, std::size_t maxCount) override;
 };
 
 class CompressWriter final : public Writer
@@ -87,11 +90,16 @@ private:
     void writeCompressedBuffer();
 
 public:
-    CompressWriter(std::shared_ptr<Writer> pwriter) : CompressWriter(*pwriter)
+    static constexpr int DefaultLevel = 2;
+    static constexpr int MinLevel = 0; /// no compression
+    static constexpr int MaxLevel = 9; /// best compression
+    /** @param level the zlib compression level, from MinLevel to MaxLevel */
+    CompressWriter(std::shared_ptr<Writer> pwriter, int level = DefaultLevel)
+        : CompressWriter(*pwriter, level)
     {
         this->pwriter = pwriter;
     }
-    CompressWriter(Writer &writer);
+    CompressWriter(Writer &writer, int level = DefaultLevel);
     virtual ~CompressWriter()
     {
     }
@@ -107,13 +115,12 @@ public:
         {
             writeBuffer();
         }
-        buffer.push_back(v);
+        *writeBufferPointer++ = v;
     }
+    virtual void writeBytes(const std::uint8_t *array, std::size_t count) override;
     virtual bool writeWaits() override
     {
-        if(buffer.size() >= bufferSize)
-            return true;
-        return false;
+        return writeBufferPointer == writeBufferEnd;
     }
 };
 }
@@ -44,26 +44,30 @@ public:
     NetworkEventType type;
 
 private:
-    std::vector<std::uint8_t> bytes;
+    stream::SharedBytes bytes;
 
 public:
     NetworkEvent(NetworkEventType type = NetworkEventType::Keepalive) : type(type), bytes()
     {
     }
     NetworkEvent(NetworkEventType type, const stream::MemoryWriter &writer)
-        : type(type), bytes(writer.getBuffer())
+        : type(type), bytes(std::vector<std::uint8_t>(writer.getBuffer()))
     {
     }
     NetworkEvent(NetworkEventType type, stream::MemoryWriter &&writer)
-        : type(type), bytes(std::move(writer).getBuffer())
+        : type(type), bytes(std::move(writer).getSharedBuffer())
     {
     }
     NetworkEvent(NetworkEventType type, const std::vector<std::uint8_t> &bytes)
-        : type(type), bytes(bytes)
+        : type(type), bytes(std::vector<std::uint8_t>(bytes))
     {
     }
     NetworkEvent(NetworkEventType type, std::vector<std::uint8_t> &&bytes)
-        : type(type), bytes(bytes)
+        : type(type), bytes(std::move(bytes))
+    {
+    }
+    NetworkEvent(NetworkEventType type, stream::SharedBytes bytes)
+        : type(type), bytes(std::move(bytes))
     {
     }
     void write(stream::Writer &writer) const
@@ -72,25 +76,19 @@ public:
         std::uint32_t eventSize = bytes.size();
         assert((std::size_t)eventSize == bytes.size());
         stream::write<std::uint32_t>(writer, eventSize);
-        writer.writeBytes(&bytes[0], bytes.size());
+        writer.writeBytes(bytes.data(), bytes.size());
     }
     static NetworkEvent read(stream::Reader &reader)
     {
         NetworkEventType type = stream::read<NetworkEventType>(reader);
         std::uint32_t eventSize = stream::read<std::uint32_t>(reader);
-        std::vector<std::uint8_t> bytes;
-        bytes.resize((std::size_t)eventSize);
-        reader.readBytes(&bytes[0], (std::size_t)eventSize);
-        return NetworkEvent(type, std::move(bytes));
+        return NetworkEvent(type, reader.readSharedBytes((std::size_t)eventSize));
     }
-    std::shared_ptr<stream::Reader> getReader() const &
+    /** @brief get a reader for the event's bytes; the bytes are shared, not copied */
+    std::shared_ptr<stream::Reader> getReader() const
     {
         return std::make_shared<stream::MemoryReader>(bytes);
     }
-    std::shared_ptr<stream::Reader> getReader() &&
-    {
-        return std::make_shared<stream::MemoryReader>(std::move(bytes));
-    }
 };
 }
 }
@@ -37,6 +37,7 @@
 #include <unordered_map>
 #include <atomic>
 #include <utility>
+#include <algorithm>
 #include "util/string_cast.h"
 #include "util/enum_traits.h"
 #include "util/circular_deque.h"
@@ -171,6 +172,14 @@ public:
     {
         valueMap[getIndex<T, TagType>()] = std::static_pointer_cast<void>(value);
     }
+    /** @brief share all the values associated with other, like its descriptor tables
+     *
+     * so what's written to this stream can be copied into other as if it was written there
+     */
+    void shareAssociatedValues(const Stream &other)
+    {
+        valueMap = other.valueMap;
+    }
 };
 
 enum class SeekPosition
@@ -180,6 +189,74 @@ enum class SeekPosition
     End
 };
 
+/** @brief a reference-counted view of immutable bytes
+ *
+ * copies and slices share the bytes instead of copying them.
+ */
+class SharedBytes final
+{
+private:
+    std::shared_ptr<const std::uint8_t> bytes;
+    std::size_t byteCount;
+
+public:
+    SharedBytes() : bytes(), byteCount(0)
+    {
+    }
+    SharedBytes(std::shared_ptr<const std::uint8_t> bytes, std::size_t byteCount)
+        : bytes(std::move(bytes)), byteCount(byteCount)
+    {
+    }
+    explicit SharedBytes(std::shared_ptr<const std::vector<std::uint8_t>> bytes)
+        : bytes(bytes, bytes->data()), byteCount(bytes->size())
+    {
+    }
+    explicit SharedBytes(std::vector<std::uint8_t> &&bytes)
+        : SharedBytes(std::make_shared<const std::vector<std::uint8_t>>(std::move(bytes)))
+    {
+    }
+    const std::uint8_t *data() const
+    {
+        return bytes.get();
+    }
+    std::size_t size() const
+    {
+        return byteCount;
+    }
+    bool empty() const
+    {
+        return byteCount == 0;
+    }
+    const std::uint8_t *begin() const
+    {
+        return bytes.get();
+    }
+    const std::uint8_t *end() const
+    {
+        return bytes.get() + byteCount;
+    }
+    std::uint8_t operator[](std::size_t index) const
+    {
+        assert(index < byteCount);
+        return bytes.get()[index];
+    }
+    /** @brief get the bytes starting at offset without copying them */
+    SharedBytes slice(std::size_t offset, std::size_t count) const
+    {
+        assert(offset <= byteCount && count <= byteCount - offset);
+        return SharedBytes(std::shared_ptr<const std::uint8_t>(bytes, bytes.get() + offset), count);
+    }
+    SharedBytes slice(std::size_t offset) const
+    {
+        assert(offset <= byteCount);
+        return slice(offset, byteCount - offset);
+    }
+    std::vector<std::uint8_t> toVector() const
+    {
+        return std::vector<std::uint8_t>(begin(), end());
+    }
+};
+
 class Reader : public Stream
 {
 private:
@@ -194,6 +271,31 @@ private:
         }
         return v;
     }
+    template <typename T>
+    T readBigEndian()
+    {
+        T retval = 0;
+        if(static_cast<std::size_t>(readBufferEnd - readBufferPointer) >= sizeof(T))
+        {
+            for(std::size_t i = 0; i < sizeof(T); i++)
+                retval = static_cast<T>(retval << 8 | readBufferPointer[i]);
+            readBufferPointer += sizeof(T);
+            return retval;
+        }
+        for(std::size_t i = 0; i < sizeof(T); i++)
+            retval = static_cast<T>(retval << 8 | readU8());
+        return retval;
+    }
+
+protected:
+    /** @brief the bytes that can be read without calling readByte
+     *
+     * a derived class that keeps its data in memory points these at the bytes it has ready, and
+     * the inline reads advance readBufferPointer. The derived class's virtual functions must
+     * then use readBufferPointer as the current position.
+     */
+    const std::uint8_t *readBufferPointer = nullptr;
+    const std::uint8_t *readBufferEnd = nullptr;
 
 public:
     Reader()
@@ -259,22 +361,31 @@ public:
             throw EOFException();
         }
     }
+    /** @brief read count bytes, without copying them if this reader already has them in memory
+     */
+    virtual SharedBytes readSharedBytes(std::size_t count)
+    {
+        std::vector<std::uint8_t> bytes;
+        bytes.resize(count);
+        readAllBytes(bytes.data(), count);
+        return SharedBytes(std::move(bytes));
+    }
     std::uint8_t readU8()
     {
-        std::uint8_t retval = readByte();
+        std::uint8_t retval =
+            readBufferPointer != readBufferEnd ? *readBufferPointer++ : readByte();
         DUMP_V(readU8, (unsigned)retval);
         return retval;
     }
     std::int8_t readS8()
     {
-        std::int8_t retval = readByte();
+        std::int8_t retval = readBufferPointer != readBufferEnd ? *readBufferPointer++ : readByte();
         DUMP_V(readS8, (int)retval);
         return retval;
     }
     std::uint16_t readU16()
     {
-        std::uint16_t v = readU8();
-        std::uint16_t retval = (v << 8) | readU8();
+        std::uint16_t retval = readBigEndian<std::uint16_t>();
         DUMP_V(readU16, retval);
         return retval;
     }
@@ -286,8 +397,7 @@ public:
     }
     std::uint32_t readU32()
     {
-        std::uint32_t v = readU16();
-        std::uint32_t retval = (v << 16) | readU16();
+        std::uint32_t retval = readBigEndian<std::uint32_t>();
         DUMP_V(readU32, retval);
         return retval;
     }
@@ -299,8 +409,7 @@ public:
     }
     std::uint64_t readU64()
     {
-        std::uint64_t v = readU32();
-        std::uint64_t retval = (v << 32) | readU32();
+        std::uint64_t retval = readBigEndian<std::uint64_t>();
         DUMP_V(readU64, retval);
         return retval;
     }
@@ -463,6 +572,31 @@ public:
 
 class Writer : public Stream
 {
+private:
+    template <typename T>
+    void writeBigEndian(T v)
+    {
+        if(static_cast<std::size_t>(writeBufferEnd - writeBufferPointer) >= sizeof(T))
+        {
+            for(std::size_t i = 0; i < sizeof(T); i++)
+                writeBufferPointer[i] = static_cast<std::uint8_t>(v >> 8 * (sizeof(T) - 1 - i));
+            writeBufferPointer += sizeof(T);
+            return;
+        }
+        for(std::size_t i = 0; i < sizeof(T); i++)
+            writeU8(static_cast<std::uint8_t>(v >> 8 * (sizeof(T) - 1 - i)));
+    }
+
+protected:
+    /** @brief the space that can be written to without calling writeByte
+     *
+     * a derived class that collects its output in memory points these at its free space, and
+     * the inline writes advance writeBufferPointer. The derived class's virtual functions must
+     * then use writeBufferPointer as the current position.
+     */
+    std::uint8_t *writeBufferPointer = nullptr;
+    std::uint8_t *writeBufferEnd = nullptr;
+
 public:
     Writer()
     {
@@ -476,6 +610,19 @@ public:
     virtual void flush()
     {
     }
+    /** @brief flush, then wait until the written bytes are on permanent storage */
+    virtual void sync()
+    {
+        flush();
+    }
+    /** @brief change the size of the written data to size
+     *
+     * the position written to next isn't changed.
+     */
+    virtual void truncate(std::int64_t size)
+    {
+        throw NonSeekableException();
+    }
     virtual bool writeWaits()
     {
         return true;
@@ -487,16 +634,18 @@ public:
     }
     void writeU8(std::uint8_t v)
     {
-        writeByte(v);
+        if(writeBufferPointer != writeBufferEnd)
+            *writeBufferPointer++ = v;
+        else
+            writeByte(v);
     }
     void writeS8(std::int8_t v)
     {
-        writeByte(v);
+        writeU8(v);
     }
     void writeU16(std::uint16_t v)
     {
-        writeU8(static_cast<std::uint8_t>(v >> 8));
-        writeU8(static_cast<std::uint8_t>(v & 0xFF));
+        writeBigEndian(v);
     }
     void writeS16(std::int16_t v)
     {
@@ -504,8 +653,7 @@ public:
     }
     void writeU32(std::uint32_t v)
     {
-        writeU16(static_cast<std::uint16_t>(v >> 16));
-        writeU16(static_cast<std::uint16_t>(v & 0xFFFF));
+        writeBigEndian(v);
     }
     void writeS32(std::int32_t v)
     {
@@ -513,8 +661,7 @@ public:
     }
     void writeU64(std::uint64_t v)
     {
-        writeU32(static_cast<std::uint64_t>(v >> 32));
-        writeU32(static_cast<std::uint64_t>(v & 0xFFFFFFFFU));
+        writeBigEndian(v);
     }
     void writeS64(std::int64_t v)
     {
@@ -905,6 +1052,8 @@ public:
         if(EOF == fflush(f))
             IOException::throwErrorFromErrno("fflush");
     }
+    virtual void sync() override;
+    virtual void truncate(std::int64_t size) override;
     virtual void writeBytes(const std::uint8_t *array, std::size_t count) override;
     virtual std::int64_t tell() override;
     virtual void seek(std::int64_t offset, SeekPosition seekPosition) override;
@@ -913,33 +1062,36 @@ public:
 class MemoryReader final : public Reader
 {
 private:
-    std::shared_ptr<const std::uint8_t> mem;
-    std::size_t offset;
-    const std::size_t length;
+    SharedBytes mem;
+    void setOffset(std::size_t offset)
+    {
+        readBufferPointer = mem.begin() + offset;
+        readBufferEnd = mem.end();
+    }
+    std::size_t getOffset() const
+    {
+        return readBufferPointer - mem.begin();
+    }
 
 public:
+    explicit MemoryReader(SharedBytes mem) : mem(std::move(mem))
+    {
+        setOffset(0);
+    }
     explicit MemoryReader(std::shared_ptr<const std::uint8_t> mem, std::size_t length)
-        : mem(mem), offset(0), length(length)
+        : MemoryReader(SharedBytes(std::move(mem), length))
     {
     }
     explicit MemoryReader(std::shared_ptr<const std::vector<std::uint8_t>> mem)
-        : mem(mem, mem->data()), offset(0), length(mem->size())
+        : MemoryReader(SharedBytes(std::move(mem)))
     {
     }
     explicit MemoryReader(const std::vector<std::uint8_t> &mem)
-        : mem(), offset(0), length(mem.size())
+        : MemoryReader(SharedBytes(std::vector<std::uint8_t>(mem)))
     {
-        std::uint8_t *memory = new std::uint8_t[mem.size()];
-        for(std::size_t i = 0; i < mem.size(); i++)
-            memory[i] = mem[i];
-        this->mem = std::shared_ptr<std::uint8_t>(memory,
-                                                  [](std::uint8_t *memory)
-                                                  {
-                                                      delete[] memory;
-                                                  });
     }
     explicit MemoryReader(std::vector<std::uint8_t> &&mem)
-        : MemoryReader(std::make_shared<std::vector<std::uint8_t>>(std::move(mem)))
+        : MemoryReader(SharedBytes(std::move(mem)))
     {
     }
     template <std::size_t length>
@@ -953,47 +1105,63 @@ public:
     }
     virtual bool dataAvailable() override
     {
-        return offset < length;
+        return readBufferPointer != readBufferEnd;
     }
     virtual std::uint8_t readByte() override
     {
-        if(offset >= length)
+        if(readBufferPointer == readBufferEnd)
             throw EOFException();
-        return mem.get()[offset++];
+        return *readBufferPointer++;
     }
     virtual std::size_t readAvailableBytes(std::uint8_t *array, std::size_t maxCount) override
     {
-        if(maxCount > length - offset)
-            maxCount = length - offset;
-        for(std::size_t i = 0; i < maxCount; i++)
-        {
-            *array++ = mem.get()[offset++];
-        }
+        if(maxCount > static_cast<std::size_t>(readBufferEnd - readBufferPointer))
+            maxCount = readBufferEnd - readBufferPointer;
+        std::copy(readBufferPointer, readBufferPointer + maxCount, array);
+        readBufferPointer += maxCount;
         return maxCount;
     }
+    virtual std::size_t readBytes(std::uint8_t *array, std::size_t maxCount) override
+    {
+        return readAvailableBytes(array, maxCount);
+    }
+    virtual SharedBytes readSharedBytes(std::size_t count) override
+    {
+        if(count > static_cast<std::size_t>(readBufferEnd - readBufferPointer))
+            throw EOFException();
+        SharedBytes retval = mem.slice(getOffset(), count);
+        readBufferPointer += count;
+        return retval;
+    }
+    /** @brief get all the bytes this reader reads from */
+    const SharedBytes &getBytes() const
+    {
+        return mem;
+    }
     virtual std::int64_t tell() override
     {
-        return offset;
+        return getOffset();
     }
     virtual void seek(std::int64_t o, SeekPosition seekPosition) override
     {
+        std::size_t offset = getOffset();
         switch(seekPosition)
         {
         case SeekPosition::Start:
-            if(static_cast<std::uint64_t>(o) > length || o < 0)
+            if(static_cast<std::uint64_t>(o) > mem.size() || o < 0)
                 throw SeekOutOfRangeException();
-            offset = static_cast<std::size_t>(o);
+            setOffset(static_cast<std::size_t>(o));
             break;
         case SeekPosition::Current:
-            if(static_cast<std::uint64_t>(o + offset) > length
+            if(static_cast<std::uint64_t>(o + offset) > mem.size()
                || static_cast<std::int64_t>(o + offset) < 0)
                 throw SeekOutOfRangeException();
-            offset = static_cast<std::size_t>(offset + o);
+            setOffset(static_cast<std::size_t>(offset + o));
             break;
         case SeekPosition::End:
-            if(o > 0 || static_cast<std::uint64_t>(-o) > length)
+            if(o > 0 || static_cast<std::uint64_t>(-o) > mem.size())
                 throw SeekOutOfRangeException();
-            offset = static_cast<std::size_t>(length + o);
+            setOffset(static_cast<std::size_t>(mem.size() + o));
             break;
         default:
             UNREACHABLE();
@@ -1035,6 +1203,11 @@ public:
     {
         return std::move(memory);
     }
+    /** @brief move the written bytes into a SharedBytes without copying them */
+    SharedBytes getSharedBuffer() &&
+    {
+        return SharedBytes(std::move(memory));
+    }
     virtual bool writeWaits() override
     {
         return false;
@@ -1044,10 +1217,8 @@ public:
         if(count == 0)
             return;
         expandBuffer(count);
-        for(; count > 0; count--, array++)
-        {
-            memory[writeOffset++] = *array;
-        }
+        std::copy(array, array + count, memory.begin() + writeOffset);
+        writeOffset += count;
     }
     virtual std::int64_t tell() override
     {
@@ -31,6 +31,7 @@
 #include "ui/image.h"
 #include "texture/texture_atlas.h"
 #include "world/view_point.h"
+#include "world/session_recording.h"
 #include "ui/dynamic_label.h"
 #include <mutex>
 #include <sstream>
@@ -137,6 +138,9 @@ private:
     std::vector<std::shared_ptr<Element>> worldDependantElements;
     std::atomic_bool generatingWorld;
     std::thread worldGenerateThread;
+    std::thread worldSaveThread;
+    std::wstring savedWorldFileName; /// the file that savedWorldChunkIndex is for, or empty
+    World::FileChunkIndex savedWorldChunkIndex; /// only used when worldSaveThread isn't running
     std::shared_ptr<World> generatedWorld;
     std::weak_ptr<Element> worldCreationMessage;
     std::atomic_bool abortWorldCreation;
@@ -150,6 +154,8 @@ private:
     Transform overridingViewMatrix = Transform();
     bool viewMatrixOverridden = false;
     std::weak_ptr<ImageElement> crosshairsW;
+    std::wstring sessionRecordingFileName; /// empty if loaded worlds aren't recorded
+    std::shared_ptr<SessionRecorder> sessionRecorder;
     void addUi();
     void finalizeCreateWorld()
     {
@@ -209,9 +215,26 @@ public:
     GameUi();
     void createNewWorld();
     void loadWorld(std::wstring fileName);
+    /** @brief save the current world
+     *
+     * the world is only paused while it's copied; the copy is written on a background thread.
+     * @param fileName the user specific file to write to
+     */
+    void saveWorld(std::wstring fileName);
+    /** @brief record the sessions of worlds loaded from now on
+     *
+     * the recording is written to the user specific file fileName when the world is closed.
+     * @param fileName the file to write to or empty to stop recording
+     */
+    void setSessionRecordingFileName(std::wstring fileName)
+    {
+        sessionRecordingFileName = std::move(fileName);
+    }
     ~GameUi()
     {
         abortWorldCreation = true;
+        if(worldSaveThread.joinable())
+            worldSaveThread.join();
         if(worldGenerateThread.joinable())
         {
             worldGenerateThread.join();
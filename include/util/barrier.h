@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef BARRIER_H_INCLUDED
+#define BARRIER_H_INCLUDED
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cassert>
+#include "util/cpu_relax.h"
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief a sense-reversing barrier for a fixed number of threads
+ *
+ * each thread keeps its own sense flag, initialized to false, and passes it to every call to
+ * wait. Arriving is lock-free; waiting threads spin briefly, then block so they don't use a whole
+ * processor while a slow thread finishes.
+ */
+class sense_reversing_barrier final
+{
+    sense_reversing_barrier(const sense_reversing_barrier &) = delete;
+    sense_reversing_barrier &operator=(const sense_reversing_barrier &) = delete;
+
+private:
+    const std::size_t threadCount;
+    std::atomic_size_t arrivedCount;
+    std::atomic_bool sense;
+    std::atomic_size_t blockedCount; /// the number of threads waiting on blockedCond
+    std::mutex blockedLock;
+    std::condition_variable blockedCond;
+
+public:
+    explicit sense_reversing_barrier(std::size_t threadCount)
+        : threadCount(threadCount),
+          arrivedCount(0),
+          sense(false),
+          blockedCount(0),
+          blockedLock(),
+          blockedCond()
+    {
+        assert(threadCount > 0);
+    }
+    std::size_t getThreadCount() const
+    {
+        return threadCount;
+    }
+    /** @brief wait for all the threads to arrive
+     *
+     * @param localSense this thread's sense flag
+     * @param lastThreadFn called by the last thread to arrive before any thread is released
+     * @param waitFn called periodically while blocked waiting; return false to stop waiting
+     * @return false if waitFn stopped the wait
+     */
+    template <typename LastThreadFn, typename WaitFn>
+    bool wait(bool &localSense, LastThreadFn lastThreadFn, WaitFn waitFn)
+    {
+        localSense = !localSense;
+        if(arrivedCount.fetch_add(1, std::memory_order_acq_rel) + 1 == threadCount)
+        {
+            arrivedCount.store(0, std::memory_order_relaxed);
+            lastThreadFn();
+            sense.store(localSense, std::memory_order_seq_cst);
+            if(blockedCount.load(std::memory_order_seq_cst) != 0)
+            {
+                // locking makes sure a thread that's about to block either sees the new sense
+                // or is already waiting for the notification
+                std::unique_lock<std::mutex> lockIt(blockedLock);
+                blockedCond.notify_all();
+            }
+            return true;
+        }
+        std::size_t spinCount = 0;
+        constexpr std::size_t relaxCount = 1000;
+        constexpr std::chrono::milliseconds waitFnPeriod(5);
+        while(sense.load(std::memory_order_acquire) != localSense)
+        {
+            if(spinCount < relaxCount)
+            {
+                spinCount++;
+                cpu_relax();
+                continue;
+            }
+            {
+                std::unique_lock<std::mutex> lockIt(blockedLock);
+                blockedCount.fetch_add(1, std::memory_order_seq_cst);
+                if(sense.load(std::memory_order_seq_cst) != localSense)
+                    blockedCond.wait_for(lockIt, waitFnPeriod);
+                blockedCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if(!waitFn())
+                return false;
+        }
+        return true;
+    }
+};
+}
+}
+
+#endif // BARRIER_H_INCLUDED
@@ -43,11 +43,15 @@
 #include "util/linked_map.h"
 #include <vector>
 #include <chrono>
+#include <cmath>
 #include <thread>
 #include <iostream>
 #include "util/tls.h"
 #include "util/util.h"
 #include "util/semaphore.h"
+#include "util/slab_allocator.h"
+#include "util/object_counter.h"
+#include <new>
 
 //#define USE_SEMAPHORE_FOR_BLOCK_CHUNK
 
@@ -57,6 +61,7 @@ namespace voxels
 {
 struct BlockChunkSubchunk;
 struct BlockChunk;
+struct LightingRegion;
 }
 }
 
@@ -66,29 +71,36 @@ namespace programmerjake
 {
 namespace voxels
 {
+class BlockUpdateTimingWheel;
+
 class BlockUpdate final
 {
     friend class World;
     friend class BlockUpdateIterator;
     friend struct BlockChunkChunkVariables;
+    friend class BlockUpdateTimingWheel;
 
 private:
     BlockUpdate *chunk_prev = nullptr;
     BlockUpdate *chunk_next = nullptr;
+    BlockUpdate **chunk_list = nullptr; /// the head of the timing wheel list this is in
     BlockUpdate *block_next = nullptr;
+    const BlockUpdateTimingWheel *wheel = nullptr;
+    std::uint64_t dueTick = 0;
     PositionI position = PositionI();
-    float time_left = 0;
     BlockUpdateKind kind = BlockUpdateKind();
     BlockUpdate()
     {
     }
-    void init(BlockUpdateKind kind, PositionI position, float time_left, BlockUpdate *block_next)
+    void init(BlockUpdateKind kind, PositionI position, BlockUpdate *block_next)
     {
         this->chunk_prev = nullptr;
         this->chunk_next = nullptr;
+        this->chunk_list = nullptr;
         this->block_next = block_next;
+        this->wheel = nullptr;
+        this->dueTick = 0;
         this->position = position;
-        this->time_left = time_left;
         this->kind = kind;
     }
     BlockUpdate(const BlockUpdate &) = delete;
@@ -96,90 +108,270 @@ private:
     ~BlockUpdate()
     {
     }
-    struct FreeList final
+    typedef shared_slab_allocator<BlockUpdate> Allocator;
+    static BlockUpdate *allocate(TLS &tls,
+                                 BlockUpdateKind kind,
+                                 PositionI position,
+                                 BlockUpdate *block_next = nullptr)
+    {
+        BlockUpdate *retval = new(Allocator::allocate(tls)) BlockUpdate;
+        retval->init(kind, position, block_next);
+        return retval;
+    }
+    static void free(BlockUpdate *v, TLS &tls)
     {
-        BlockUpdate *head = nullptr;
-        std::size_t size = 0;
-        ~FreeList()
+        if(v == nullptr)
+            return;
+        v->~BlockUpdate();
+        Allocator::free(v, tls);
+    }
+
+public:
+    PositionI getPosition() const
+    {
+        return position;
+    }
+    float getTimeLeft() const;
+    BlockUpdateKind getKind() const
+    {
+        return kind;
+    }
+};
+
+/** @brief a chunk's pending block updates, bucketed by the tick they are due on in a hierarchical
+ * timing wheel
+ *
+ * updates that are due are moved to a list for their phase, so finding the ready updates only
+ * touches updates that are due. Must be locked with BlockChunkChunkVariables::blockUpdateListLock.
+ */
+class BlockUpdateTimingWheel final
+{
+    BlockUpdateTimingWheel(const BlockUpdateTimingWheel &) = delete;
+    BlockUpdateTimingWheel &operator=(const BlockUpdateTimingWheel &) = delete;
+
+public:
+    static constexpr std::uint64_t ticksPerSecond = 100;
+    static constexpr int slotShift = 6;
+    static constexpr std::size_t slotCount = static_cast<std::size_t>(1) << slotShift;
+    static constexpr int levelCount = 3;
+
+private:
+    double currentTime = 0;
+    std::uint64_t currentTick = 0;
+    checked_array<checked_array<BlockUpdate *, slotCount>, levelCount> slots;
+    BlockUpdate *overflowList = nullptr; /// updates due after the last level wraps around
+    enum_array<BlockUpdate *, BlockUpdatePhase> readyLists;
+    enum_array<std::size_t, BlockUpdateKind> scheduledCounts; /// updates not in a ready list
+    std::size_t scheduledCount = 0;
+    static void pushFront(BlockUpdate *&head, BlockUpdate *node)
+    {
+        node->chunk_list = &head;
+        node->chunk_prev = nullptr;
+        node->chunk_next = head;
+        if(head != nullptr)
+            head->chunk_prev = node;
+        head = node;
+    }
+    void unlink(BlockUpdate *node)
+    {
+        assert(node->chunk_list != nullptr);
+        if(node->dueTick > currentTick)
         {
-            while(head != nullptr)
-            {
-                BlockUpdate *deleteMe = head;
-                head = head->block_next;
-                delete deleteMe;
-            }
+            scheduledCount--;
+            scheduledCounts[node->kind]--;
         }
-    };
-    struct freeList_tls_tag
-    {
-    };
-    static void allocateAndFree(BlockUpdate *blockUpdateToFree,
-                                BlockUpdate **pBlockUpdateToAllocate,
-                                TLS &tls)
+        if(node->chunk_prev != nullptr)
+            node->chunk_prev->chunk_next = node->chunk_next;
+        else
+            *node->chunk_list = node->chunk_next;
+        if(node->chunk_next != nullptr)
+            node->chunk_next->chunk_prev = node->chunk_prev;
+        node->chunk_prev = nullptr;
+        node->chunk_next = nullptr;
+        node->chunk_list = nullptr;
+    }
+    void link(BlockUpdate *node)
     {
-        thread_local_variable<FreeList, freeList_tls_tag> freeList(tls);
-        if(pBlockUpdateToAllocate)
+        if(node->dueTick <= currentTick)
         {
-            if(blockUpdateToFree)
-            {
-                *pBlockUpdateToAllocate = blockUpdateToFree;
-            }
-            else if(freeList.get().head == nullptr)
-            {
-                *pBlockUpdateToAllocate = new BlockUpdate;
-            }
-            else
-            {
-                *pBlockUpdateToAllocate = freeList.get().head;
-                freeList.get().head = freeList.get().head->block_next;
-                freeList.get().size--;
-            }
+            pushFront(readyLists[BlockUpdateKindPhase(node->kind)], node);
+            return;
         }
-        else if(blockUpdateToFree)
+        scheduledCount++;
+        scheduledCounts[node->kind]++;
+        for(int level = 0; level < levelCount; level++)
         {
-            if(freeList.get().size > static_cast<std::size_t>(1 << 20) / sizeof(BlockUpdate))
-            {
-                delete blockUpdateToFree;
-            }
-            else
+            int shift = slotShift * (level + 1);
+            if((node->dueTick >> shift) == (currentTick >> shift))
             {
-                blockUpdateToFree->block_next = freeList.get().head;
-                freeList.get().head = blockUpdateToFree;
-                freeList.get().size++;
+                pushFront(slots[level][(node->dueTick >> (slotShift * level)) & (slotCount - 1)],
+                          node);
+                return;
             }
         }
+        pushFront(overflowList, node);
     }
-    static BlockUpdate *allocate(TLS &tls,
-                                 BlockUpdateKind kind,
-                                 PositionI position,
-                                 float time_left,
-                                 BlockUpdate *block_next = nullptr)
+    void relinkList(BlockUpdate *&head)
     {
-        BlockUpdate *retval;
-        allocateAndFree(nullptr, &retval, tls);
-        retval->init(kind, position, time_left, block_next);
-        return retval;
+        BlockUpdate *node = head;
+        head = nullptr;
+        while(node != nullptr)
+        {
+            BlockUpdate *nextNode = node->chunk_next;
+            scheduledCount--;
+            scheduledCounts[node->kind]--;
+            link(node);
+            node = nextNode;
+        }
     }
-    static void free(BlockUpdate *v, TLS &tls)
+    template <typename Fn>
+    void forEachList(Fn fn)
     {
-        allocateAndFree(v, nullptr, tls);
+        for(BlockUpdatePhase phase : enum_traits<BlockUpdatePhase>())
+            fn(readyLists[phase]);
+        for(auto &level : slots)
+        {
+            for(BlockUpdate *&head : level)
+                fn(head);
+        }
+        fn(overflowList);
     }
 
 public:
-    PositionI getPosition() const
+    BlockUpdateTimingWheel() : slots(), readyLists(), scheduledCounts()
     {
-        return position;
+        for(auto &level : slots)
+        {
+            for(BlockUpdate *&head : level)
+                head = nullptr;
+        }
+        for(BlockUpdate *&head : readyLists)
+            head = nullptr;
     }
-    float getTimeLeft() const
+    float getTimeLeft(const BlockUpdate *node) const
     {
-        return time_left;
+        if(node->dueTick <= currentTick)
+            return 0;
+        double retval = static_cast<double>(node->dueTick) / ticksPerSecond - currentTime;
+        return retval < 0 ? 0 : static_cast<float>(retval);
     }
-    BlockUpdateKind getKind() const
+    /** @brief add a new block update that isn't in any list yet */
+    void insert(BlockUpdate *node, float timeFromNow)
     {
-        return kind;
+        node->wheel = this;
+        if(timeFromNow <= 0)
+            node->dueTick = currentTick;
+        else
+            node->dueTick = static_cast<std::uint64_t>(
+                std::ceil((currentTime + timeFromNow) * ticksPerSecond));
+        link(node);
+    }
+    void reschedule(BlockUpdate *node, float timeFromNow)
+    {
+        unlink(node);
+        insert(node, timeFromNow);
+    }
+    void remove(BlockUpdate *node)
+    {
+        unlink(node);
+        node->wheel = nullptr;
+    }
+    /** @brief advance the current time, moving all the block updates that are now due to the ready
+     * lists
+     */
+    void advance(double deltaTime)
+    {
+        if(deltaTime > 0)
+            currentTime += deltaTime;
+        std::uint64_t newTick = static_cast<std::uint64_t>(currentTime * ticksPerSecond);
+        while(currentTick < newTick)
+        {
+            if(scheduledCount == 0)
+            {
+                currentTick = newTick;
+                break;
+            }
+            currentTick++;
+            for(int level = levelCount; level > 0; level--)
+            {
+                std::uint64_t mask = (static_cast<std::uint64_t>(1) << (slotShift * level)) - 1;
+                if((currentTick & mask) != 0)
+                    continue;
+                if(level == levelCount)
+                    relinkList(overflowList);
+                else
+                    relinkList(
+                        slots[level][(currentTick >> (slotShift * level)) & (slotCount - 1)]);
+            }
+            relinkList(slots[0][currentTick & (slotCount - 1)]);
+        }
+    }
+    /** @brief remove all the ready block updates for phase
+     * @return the removed block updates, linked through chunk_next
+     */
+    BlockUpdate *takeReady(BlockUpdatePhase phase)
+    {
+        BlockUpdate *retval = readyLists[phase];
+        readyLists[phase] = nullptr;
+        for(BlockUpdate *node = retval; node != nullptr; node = node->chunk_next)
+        {
+            node->chunk_list = nullptr;
+            node->wheel = nullptr;
+        }
+        return retval;
+    }
+    /** @brief remove all the block updates of kind, ready or not
+     * @return the removed block updates, linked through chunk_next
+     */
+    BlockUpdate *takeAll(BlockUpdateKind kind)
+    {
+        BlockUpdate *retval = nullptr;
+        auto takeFromList = [&](BlockUpdate *&head)
+        {
+            for(BlockUpdate *node = head; node != nullptr;)
+            {
+                BlockUpdate *nextNode = node->chunk_next;
+                if(node->kind == kind)
+                {
+                    remove(node);
+                    node->chunk_next = retval;
+                    if(retval != nullptr)
+                        retval->chunk_prev = node;
+                    retval = node;
+                }
+                node = nextNode;
+            }
+        };
+        if(scheduledCounts[kind] == 0)
+            takeFromList(readyLists[BlockUpdateKindPhase(kind)]);
+        else
+            forEachList(takeFromList);
+        return retval;
+    }
+    void freeAll(TLS &tls)
+    {
+        forEachList([&](BlockUpdate *&head)
+                    {
+                        while(head != nullptr)
+                        {
+                            BlockUpdate *deleteMe = head;
+                            head = head->chunk_next;
+                            BlockUpdate::free(deleteMe, tls);
+                        }
+                    });
+        scheduledCount = 0;
+        for(std::size_t &count : scheduledCounts)
+            count = 0;
     }
 };
 
+inline float BlockUpdate::getTimeLeft() const
+{
+    if(wheel == nullptr)
+        return 0;
+    return wheel->getTimeLeft(this);
+}
+
 GCC_PRAGMA(diagnostic push)
 GCC_PRAGMA(diagnostic ignored "-Weffc++")
 class BlockUpdateIterator final : public std::iterator<std::forward_iterator_tag, const BlockUpdate>
@@ -292,73 +484,23 @@ private:
     ~BlockOptionalData()
     {
     }
-    void init()
-    {
-        hashNext = nullptr;
-        updateListHead = nullptr;
-        data = nullptr;
-    }
-    struct Allocator final
-    {
-        Allocator(const Allocator &) = delete;
-        Allocator &operator=(const Allocator &) = delete;
 
-    private:
-        BlockOptionalData *freeListHead = nullptr;
-        std::size_t freeListSize = 0;
+public:
+    /// each subchunk's BlockOptionalDataHashTable allocates from its own pool, so the memory goes
+    /// away with the chunk instead of staying in some thread's free list
+    typedef slab_pool<BlockOptionalData, 16> Pool;
 
-    public:
-        Allocator() = default;
-        ~Allocator()
-        {
-            while(freeListHead != nullptr)
-            {
-                BlockOptionalData *deleteMe = freeListHead;
-                freeListHead = freeListHead->hashNext;
-                delete deleteMe;
-            }
-        }
-        void free(BlockOptionalData *p)
-        {
-            if(!p)
-                return;
-            if(freeListSize > 1 << 16)
-            {
-                delete p;
-                return;
-            }
-            p->init();
-            p->hashNext = freeListHead;
-            freeListHead = p;
-            freeListSize++;
-        }
-        BlockOptionalData *allocate()
-        {
-            if(freeListHead)
-            {
-                BlockOptionalData *retval = freeListHead;
-                freeListHead = retval->hashNext;
-                freeListSize--;
-                return retval;
-            }
-            return new BlockOptionalData();
-        }
-    };
-    static Allocator &getAllocator(TLS &tls)
-    {
-        struct a_tls_tag
-        {
-        };
-        thread_local_variable<Allocator, a_tls_tag> a(tls);
-        return a.get();
-    }
-    static void free(BlockOptionalData *p, TLS &tls)
+private:
+    static BlockOptionalData *allocate(Pool &pool)
     {
-        getAllocator(tls).free(p);
+        return new(pool.allocate()) BlockOptionalData();
     }
-    static BlockOptionalData *allocate(TLS &tls)
+    static void free(BlockOptionalData *p, Pool &pool)
     {
-        return getAllocator(tls).allocate();
+        if(!p)
+            return;
+        p->~BlockOptionalData();
+        pool.free(p);
     }
     std::uint8_t posX : BlockChunkSubchunkShiftXYZ,
                         posY : BlockChunkSubchunkShiftXYZ,
@@ -377,15 +519,7 @@ class BlockOptionalDataHashTable final
 {
 private:
     checked_array<BlockOptionalData *, (1 << 8)> table;
-    static std::thread::id getThreadId(TLS &tls)
-    {
-        struct retval_tls_tag
-        {
-        };
-        thread_local_variable<std::thread::id, retval_tls_tag> retval(tls,
-                                                                      std::this_thread::get_id());
-        return retval.get();
-    }
+    BlockOptionalData::Pool pool;
     std::size_t hashPos(VectorI pos) const
     {
         assert(pos.x >= 0 && pos.x < BlockChunkSubchunkSizeXYZ);
@@ -395,10 +529,10 @@ private:
     }
 
 public:
-    BlockOptionalDataHashTable() : table{}
+    BlockOptionalDataHashTable() : table{}, pool()
     {
     }
-    void clear(TLS &tls)
+    void clear()
     {
         for(BlockOptionalData *&i : table)
         {
@@ -408,22 +542,22 @@ public:
             {
                 BlockOptionalData *freeMe = node;
                 node = node->hashNext;
-                BlockOptionalData::free(freeMe, tls);
+                BlockOptionalData::free(freeMe, pool);
             }
         }
     }
     ~BlockOptionalDataHashTable()
     {
-        clear(TLS::getSlow());
+        clear();
     }
-    BlockOptionalDataHashTable(const BlockOptionalDataHashTable &rt) : table{}
+    BlockOptionalDataHashTable(const BlockOptionalDataHashTable &rt) : table{}, pool()
     {
         for(std::size_t i = 0; i < table.size(); i++)
         {
             BlockOptionalData **pNewNode = &table[i];
             for(BlockOptionalData *node = rt.table[i]; node != nullptr; node = node->hashNext)
             {
-                BlockOptionalData *newNode = BlockOptionalData::allocate(TLS::getSlow());
+                BlockOptionalData *newNode = BlockOptionalData::allocate(pool);
                 *pNewNode = newNode;
                 pNewNode = &newNode->hashNext;
                 newNode->data = node->data;
@@ -432,7 +566,7 @@ public:
         }
     }
     BlockOptionalDataHashTable &operator=(const BlockOptionalDataHashTable &) = delete;
-    void erase(VectorI pos, TLS &tls)
+    void erase(VectorI pos)
     {
         BlockOptionalData **pNode = &table[hashPos(pos)];
         while(*pNode != nullptr)
@@ -441,14 +575,14 @@ public:
             if(node->posX == pos.x && node->posY == pos.y && node->posZ == pos.z)
             {
                 *pNode = node->hashNext;
-                BlockOptionalData::free(node, tls);
+                BlockOptionalData::free(node, pool);
                 return;
             }
             assert(node != node->hashNext);
             pNode = &node->hashNext;
         }
     }
-    BlockOptionalData *get_or_make(VectorI pos, TLS &tls)
+    BlockOptionalData *get_or_make(VectorI pos)
     {
         BlockOptionalData **pNode = &table[hashPos(pos)];
         BlockOptionalData **pTableEntry = pNode;
@@ -464,7 +598,7 @@ public:
             }
             pNode = &node->hashNext;
         }
-        BlockOptionalData *node = BlockOptionalData::allocate(tls);
+        BlockOptionalData *node = BlockOptionalData::allocate(pool);
         node->posX = pos.x;
         node->posY = pos.y;
         node->posZ = pos.z;
@@ -497,11 +631,11 @@ public:
             return nullptr;
         return node->data;
     }
-    bool setData(VectorI pos, BlockDataPointer<BlockData> data, TLS &tls)
+    bool setData(VectorI pos, BlockDataPointer<BlockData> data)
     {
         BlockOptionalData *node;
         if(data != nullptr)
-            node = get_or_make(pos, tls);
+            node = get_or_make(pos);
         else
             node = get(pos);
         if(node == nullptr)
@@ -509,16 +643,16 @@ public:
         node->data = std::move(data);
         if(node->empty())
         {
-            erase(pos, tls);
+            erase(pos);
             return false;
         }
         return true;
     }
-    bool setUpdateListHead(VectorI pos, BlockUpdate *updateListHead, TLS &tls)
+    bool setUpdateListHead(VectorI pos, BlockUpdate *updateListHead)
     {
         BlockOptionalData *node;
         if(updateListHead != nullptr)
-            node = get_or_make(pos, tls);
+            node = get_or_make(pos);
         else
             node = get(pos);
         if(node == nullptr)
@@ -526,7 +660,7 @@ public:
         node->updateListHead = updateListHead;
         if(node->empty())
         {
-            erase(pos, tls);
+            erase(pos);
             return false;
         }
         return true;
@@ -616,6 +750,8 @@ struct BlockChunkSubchunk final
     BlockOptionalDataHashTable blockOptionalData;
     std::vector<BlockDescriptorIndex> blockKinds;
     std::unordered_map<BlockDescriptorIndex, unsigned> blockKindsMap;
+    std::atomic<std::uint32_t> randomlyTickingBlockCount; /// number of blocks in this subchunk
+    /// whose descriptor ticks randomly; written with the subchunk locked
     BlockDescriptorPointer getBlockKind(const BlockChunkBlock &block) const
     {
         if(blockKinds.empty() || block.blockKind >= blockKinds.size())
@@ -625,6 +761,16 @@ struct BlockChunkSubchunk final
     void setBlockKind(BlockChunkBlock &block, BlockDescriptorPointer bd)
     {
         BlockDescriptorIndex bdi(bd);
+        bool ticksRandomly = bdi.ticksRandomly();
+        bool ticksRandomlyBefore =
+            block.blockKind < blockKinds.size() && blockKinds[block.blockKind].ticksRandomly();
+        if(ticksRandomly != ticksRandomlyBefore)
+        {
+            if(ticksRandomly)
+                randomlyTickingBlockCount.fetch_add(1, std::memory_order_relaxed);
+            else
+                randomlyTickingBlockCount.fetch_sub(1, std::memory_order_relaxed);
+        }
         if(blockKinds.size()
            >= static_cast<std::size_t>(1)
                   << BlockChunkBlock::blockKindBitWidth) // every block kind is different : so we
@@ -660,19 +806,24 @@ struct BlockChunkSubchunk final
     std::atomic_bool generatingCachedMeshes;
     std::atomic_bool cachedMeshesInvalidated;
     WrappedEntity::SubchunkListType entityList;
+    std::atomic_size_t entityCount; /// size of entityList, readable without locking the subchunk
     BlockChunkInvalidateCountType invalidateCount = 0;
     BlockChunkInvalidateCountType cachedMeshesInvalidateCount = 0;
     linked_map<PositionI, char> particleGeneratingSet; /// holds positions of blocks in this
     /// subchunk that generate particles
+    std::atomic_size_t particleGeneratingBlockCount; /// size of particleGeneratingSet, readable
+    /// without locking the subchunk
     void addParticleGeneratingBlock(PositionI position) /// must be locked first
     {
         particleGeneratingSet[position] = '\0';
+        particleGeneratingBlockCount.store(particleGeneratingSet.size(), std::memory_order_relaxed);
     }
     void removeParticleGeneratingBlock(PositionI position) /// must be locked first
     {
         particleGeneratingSet.erase(position);
         if(particleGeneratingSet.empty())
             particleGeneratingSet.clear(); // frees more memory
+        particleGeneratingBlockCount.store(particleGeneratingSet.size(), std::memory_order_relaxed);
     }
     void addToParticleGeneratingBlockList(
         std::vector<PositionI> &dest) const /// must be locked first
@@ -693,13 +844,16 @@ struct BlockChunkSubchunk final
           blockOptionalData(rt.blockOptionalData),
           blockKinds(rt.blockKinds),
           blockKindsMap(rt.blockKindsMap),
+          randomlyTickingBlockCount(rt.randomlyTickingBlockCount.load(std::memory_order_relaxed)),
           cachedMeshes(nullptr),
           generatingCachedMeshes(false),
           cachedMeshesInvalidated(true),
           entityList([](WrappedEntity *)
                      {
                      }),
-          particleGeneratingSet()
+          entityCount(0),
+          particleGeneratingSet(),
+          particleGeneratingBlockCount(0)
     {
     }
     explicit BlockChunkSubchunk(
@@ -716,13 +870,16 @@ struct BlockChunkSubchunk final
           blockOptionalData(),
           blockKinds(),
           blockKindsMap(),
+          randomlyTickingBlockCount(0),
           cachedMeshes(nullptr),
           generatingCachedMeshes(false),
           cachedMeshesInvalidated(true),
           entityList([](WrappedEntity *)
                      {
                      }),
-          particleGeneratingSet()
+          entityCount(0),
+          particleGeneratingSet(),
+          particleGeneratingBlockCount(0)
     {
     }
     void invalidate()
@@ -745,14 +902,16 @@ struct BlockChunkChunkVariables final
     std::atomic_bool cachedMeshesUpToDate;
     WorldLightingProperties wlp;
     std::mutex blockUpdateListLock;
-    BlockUpdate *blockUpdateListHead = nullptr;
-    BlockUpdate *blockUpdateListTail = nullptr;
+    BlockUpdateTimingWheel blockUpdates;
     enum_array<std::size_t, BlockUpdatePhase> blockUpdatesPerPhase;
     std::chrono::steady_clock::time_point lastBlockUpdateTime;
     bool lastBlockUpdateTimeValid = false;
     std::recursive_mutex entityListLock;
     WrappedEntity::ChunkListType entityList;
+    std::atomic_size_t entityCount; /// size of entityList, readable without entityListLock
     std::atomic_bool generated, generateStarted;
+    std::atomic_bool saveDirty; /// if this chunk changed since World::makeSnapshot last copied it
+    std::atomic<LightingRegion *> lightingRegion; /// owned by World; set once
     ~BlockChunkChunkVariables();
     void invalidate()
     {
@@ -784,6 +943,7 @@ struct BlockChunkChunkVariables final
           cachedMeshesUpToDate(false),
           wlp(),
           blockUpdateListLock(),
+          blockUpdates(),
           blockUpdatesPerPhase(),
           lastBlockUpdateTime(),
           entityListLock(),
@@ -791,8 +951,11 @@ struct BlockChunkChunkVariables final
                      {
                          delete v;
                      }),
+          entityCount(0),
           generated(false),
-          generateStarted(false)
+          generateStarted(false),
+          saveDirty(false),
+          lightingRegion(nullptr)
     {
     }
 };
@@ -836,7 +999,7 @@ struct BlockChunk final
         subchunk.setBlockKind(blockChunkBlock, newBlock.descriptor);
         blockChunkBlock.setLighting(newBlock.lighting);
         blockChunkBlock.hasOptionalData = subchunk.blockOptionalData.setData(
-            subchunkRelativePosition, std::move(newBlock.data), tls);
+            subchunkRelativePosition, std::move(newBlock.data));
     }
     IndirectBlockChunk *const indirectBlockChunk;
     BlockChunkChunkVariables &getChunkVariables();
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef SLAB_ALLOCATOR_H_INCLUDED
+#define SLAB_ALLOCATOR_H_INCLUDED
+
+#include <cstddef>
+#include <cassert>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include "util/tls.h"
+#include "util/object_counter.h"
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief hands out uninitialized storage for objects of type T from slabs of ObjectsPerSlab
+ * objects
+ *
+ * not thread-safe. Each slab counts its free objects; when every object in a slab is freed the
+ * slab goes back to the heap, except for one empty slab kept so that allocating and freeing
+ * around a slab boundary doesn't allocate a new slab every time. The remaining slabs are released
+ * when the slab_pool is destroyed, so the objects must all be destroyed before then. The number
+ * of slabs in existence is tracked by ObjectCounter<slab_pool, 0>.
+ */
+template <typename T, std::size_t ObjectsPerSlab>
+class slab_pool final
+{
+    static_assert(ObjectsPerSlab > 0, "slabs must hold at least one object");
+    slab_pool(const slab_pool &) = delete;
+    slab_pool &operator=(const slab_pool &) = delete;
+
+private:
+    struct Slab;
+    struct Node final
+    {
+        Slab *slab;
+        union
+        {
+            Node *next;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        };
+        static Node *fromStorage(void *p)
+        {
+            return reinterpret_cast<Node *>(static_cast<char *>(p) - offsetof(Node, storage));
+        }
+    };
+    struct Slab final
+    {
+        Slab *prev = nullptr; /// in the list of slabs with free objects
+        Slab *next = nullptr;
+        Node *freeList = nullptr;
+        std::size_t freeCount = ObjectsPerSlab;
+        Node nodes[ObjectsPerSlab];
+        ObjectCounter<slab_pool, 0> objectCounter;
+        Slab()
+        {
+            for(std::size_t i = ObjectsPerSlab; i > 0; i--)
+            {
+                Node *node = &nodes[i - 1];
+                node->slab = this;
+                node->next = freeList;
+                freeList = node;
+            }
+        }
+    };
+    Slab *availableSlabs = nullptr; /// the slabs with free objects
+    std::size_t slabCount = 0;
+    std::size_t emptySlabCount = 0;
+    std::size_t allocatedCount = 0;
+    void linkAvailable(Slab *slab)
+    {
+        slab->prev = nullptr;
+        slab->next = availableSlabs;
+        if(availableSlabs != nullptr)
+            availableSlabs->prev = slab;
+        availableSlabs = slab;
+    }
+    void unlinkAvailable(Slab *slab)
+    {
+        if(slab->prev != nullptr)
+            slab->prev->next = slab->next;
+        else
+            availableSlabs = slab->next;
+        if(slab->next != nullptr)
+            slab->next->prev = slab->prev;
+        slab->prev = nullptr;
+        slab->next = nullptr;
+    }
+
+public:
+    slab_pool() = default;
+    slab_pool(slab_pool &&rt)
+        : availableSlabs(rt.availableSlabs),
+          slabCount(rt.slabCount),
+          emptySlabCount(rt.emptySlabCount),
+          allocatedCount(rt.allocatedCount)
+    {
+        rt.availableSlabs = nullptr;
+        rt.slabCount = 0;
+        rt.emptySlabCount = 0;
+        rt.allocatedCount = 0;
+    }
+    ~slab_pool()
+    {
+        assert(allocatedCount == 0);
+        while(availableSlabs != nullptr)
+        {
+            Slab *deleteMe = availableSlabs;
+            availableSlabs = availableSlabs->next;
+            delete deleteMe;
+        }
+    }
+    void *allocate()
+    {
+        Slab *slab = availableSlabs;
+        if(slab == nullptr)
+        {
+            slab = new Slab;
+            slabCount++;
+            emptySlabCount++;
+            linkAvailable(slab);
+        }
+        if(slab->freeCount == ObjectsPerSlab)
+            emptySlabCount--;
+        Node *retval = slab->freeList;
+        slab->freeList = retval->next;
+        if(--slab->freeCount == 0)
+            unlinkAvailable(slab);
+        allocatedCount++;
+        return static_cast<void *>(&retval->storage);
+    }
+    void free(void *p)
+    {
+        if(p == nullptr)
+            return;
+        Node *node = Node::fromStorage(p);
+        Slab *slab = node->slab;
+        node->next = slab->freeList;
+        slab->freeList = node;
+        allocatedCount--;
+        if(slab->freeCount++ == 0)
+            linkAvailable(slab);
+        if(slab->freeCount == ObjectsPerSlab)
+        {
+            if(emptySlabCount > 0)
+            {
+                unlinkAvailable(slab);
+                delete slab;
+                slabCount--;
+            }
+            else
+            {
+                emptySlabCount++;
+            }
+        }
+    }
+    std::size_t getSlabCount() const
+    {
+        return slabCount;
+    }
+    std::size_t getAllocatedCount() const
+    {
+        return allocatedCount;
+    }
+};
+
+/** @brief a thread-safe allocator for uninitialized storage for objects of type T, shared by all
+ * threads
+ *
+ * storage comes from a global slab_pool. Each thread caches freed storage in at most two
+ * magazines of MagazineSize objects; a thread that frees more than that hands full magazines
+ * back to the global depot, where threads that run out can pick them up. The depot keeps at most
+ * about 1MB of objects in full magazines and empties the rest into the slab pool, which frees
+ * slabs that have no objects left, so memory goes back to the heap after a burst of allocations.
+ * The number of magazines in existence is tracked by ObjectCounter<shared_slab_allocator, 0>.
+ */
+template <typename T, std::size_t ObjectsPerSlab = 256, std::size_t MagazineSize = 128>
+class shared_slab_allocator final
+{
+    shared_slab_allocator() = delete;
+
+private:
+    struct Magazine final
+    {
+        Magazine *next = nullptr;
+        std::size_t size = 0;
+        void *objects[MagazineSize];
+        ObjectCounter<shared_slab_allocator, 0> objectCounter;
+        bool full() const
+        {
+            return size >= MagazineSize;
+        }
+        bool empty() const
+        {
+            return size == 0;
+        }
+    };
+    struct Depot final
+    {
+        static constexpr std::size_t maxFullMagazineCount =
+            (std::size_t)1 << 20 >= sizeof(T) * MagazineSize * 2 ?
+                ((std::size_t)1 << 20) / (sizeof(T) * MagazineSize) :
+                2;
+        static constexpr std::size_t maxEmptyMagazineCount = 16;
+        std::mutex lock;
+        slab_pool<T, ObjectsPerSlab> pool;
+        Magazine *fullMagazines = nullptr;
+        std::size_t fullMagazineCount = 0;
+        Magazine *emptyMagazines = nullptr;
+        std::size_t emptyMagazineCount = 0;
+        static void push(Magazine *&head, Magazine *magazine)
+        {
+            magazine->next = head;
+            head = magazine;
+        }
+        static Magazine *pop(Magazine *&head)
+        {
+            Magazine *retval = head;
+            if(retval != nullptr)
+                head = retval->next;
+            return retval;
+        }
+        /** @brief get an empty magazine
+         * @note must be called with lock locked */
+        Magazine *takeEmpty()
+        {
+            Magazine *retval = pop(emptyMagazines);
+            if(retval == nullptr)
+                retval = new Magazine;
+            else
+                emptyMagazineCount--;
+            return retval;
+        }
+        /** @brief get a full magazine, filling one from the slab pool if there aren't any
+         * @note must be called with lock locked */
+        Magazine *takeFull()
+        {
+            Magazine *retval = pop(fullMagazines);
+            if(retval != nullptr)
+            {
+                fullMagazineCount--;
+                return retval;
+            }
+            retval = takeEmpty();
+            while(!retval->full())
+                retval->objects[retval->size++] = pool.allocate();
+            return retval;
+        }
+        /** @brief give back a magazine; partially full magazines and full magazines past the
+         * limit are emptied into the slab pool
+         * @note must be called with lock locked */
+        void returnMagazine(Magazine *magazine)
+        {
+            if(magazine == nullptr)
+                return;
+            if(magazine->full() && fullMagazineCount < maxFullMagazineCount)
+            {
+                push(fullMagazines, magazine);
+                fullMagazineCount++;
+                return;
+            }
+            while(!magazine->empty())
+                pool.free(magazine->objects[--magazine->size]);
+            if(emptyMagazineCount >= maxEmptyMagazineCount)
+            {
+                delete magazine;
+                return;
+            }
+            push(emptyMagazines, magazine);
+            emptyMagazineCount++;
+        }
+    };
+    static Depot &getDepot()
+    {
+        // never destroyed so that threads exiting during shutdown can still return their magazines
+        static Depot *depot = new Depot;
+        return *depot;
+    }
+    struct ThreadCache final
+    {
+        Magazine *loaded = nullptr;
+        Magazine *previous = nullptr;
+        ThreadCache() = default;
+        ThreadCache(const ThreadCache &) = delete;
+        ThreadCache &operator=(const ThreadCache &) = delete;
+        ~ThreadCache()
+        {
+            Depot &depot = getDepot();
+            std::unique_lock<std::mutex> lockIt(depot.lock);
+            depot.returnMagazine(loaded);
+            depot.returnMagazine(previous);
+        }
+    };
+    struct thread_cache_tls_tag
+    {
+    };
+    static ThreadCache &getThreadCache(TLS &tls)
+    {
+        thread_local_variable<ThreadCache, thread_cache_tls_tag> threadCache(tls);
+        return threadCache.get();
+    }
+
+public:
+    static void *allocate(TLS &tls)
+    {
+        ThreadCache &threadCache = getThreadCache(tls);
+        if(threadCache.loaded == nullptr || threadCache.loaded->empty())
+        {
+            if(threadCache.previous != nullptr && !threadCache.previous->empty())
+            {
+                std::swap(threadCache.loaded, threadCache.previous);
+            }
+            else
+            {
+                Depot &depot = getDepot();
+                std::unique_lock<std::mutex> lockIt(depot.lock);
+                depot.returnMagazine(threadCache.previous);
+                threadCache.previous = threadCache.loaded;
+                threadCache.loaded = depot.takeFull();
+            }
+        }
+        Magazine *magazine = threadCache.loaded;
+        return magazine->objects[--magazine->size];
+    }
+    static void free(void *p, TLS &tls)
+    {
+        if(p == nullptr)
+            return;
+        ThreadCache &threadCache = getThreadCache(tls);
+        if(threadCache.loaded == nullptr || threadCache.loaded->full())
+        {
+            if(threadCache.previous != nullptr && !threadCache.previous->full())
+            {
+                std::swap(threadCache.loaded, threadCache.previous);
+            }
+            else
+            {
+                Depot &depot = getDepot();
+                std::unique_lock<std::mutex> lockIt(depot.lock);
+                depot.returnMagazine(threadCache.previous);
+                threadCache.previous = threadCache.loaded;
+                threadCache.loaded = depot.takeEmpty();
+            }
+        }
+        Magazine *magazine = threadCache.loaded;
+        magazine->objects[magazine->size++] = p;
+    }
+    /** @brief the number of slabs allocated by all threads */
+    static std::size_t getSlabCount()
+    {
+        Depot &depot = getDepot();
+        std::unique_lock<std::mutex> lockIt(depot.lock);
+        return depot.pool.getSlabCount();
+    }
+};
+}
+}
+
+#endif // SLAB_ALLOCATOR_H_INCLUDED
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef FILE_UPGRADES_H_INCLUDED
+#define FILE_UPGRADES_H_INCLUDED
+
+#include "stream/stream.h"
+#include "util/block_update.h"
+#include "util/enum_traits.h"
+#include <cstdint>
+#include <string>
+#include <functional>
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief the registry of steps that upgrade the contents of older world files as they're read
+ *
+ * each step is registered with the file version that made the change, so reading a file applies
+ * every step newer than the file's version, oldest first. Steps are registered during static
+ * initialization, before any world is read. The chunks of an older file are upgraded as they're
+ * read, and the next save writes them in the current format.
+ *
+ * the layout of the file itself is built the other way around: starting from the layout of
+ * MinimumFileVersion, every layout step up to the file's version is applied, and the readers and
+ * writers only look at the resulting FileLayout.
+ */
+class FileUpgrades final
+{
+    FileUpgrades() = delete;
+
+public:
+    typedef enum_traits<BlockUpdateKind>::rwtype BlockUpdateKindValue;
+    /** @brief the oldest world file version that can be read */
+    static constexpr std::uint32_t MinimumFileVersion = 5;
+    /** @brief how a world file is laid out; the layout of MinimumFileVersion is all false */
+    struct FileLayout final
+    {
+        /** @brief all the chunk positions and entities come before all the chunk blocks */
+        bool chunkEntitiesBeforeBlocks = false;
+        /** @brief each chunk is a separately compressed record, found through an index record at
+         * the end of the file */
+        bool chunkRecords = false;
+        /** @brief the blocks of each subchunk are a palette with run-length encoded palette
+         * indexes and lighting, instead of every block written on its own */
+        bool subchunkPalettes = false;
+        /** @brief every record ends with the CRC-32 of its compressed contents */
+        bool recordChecksums = false;
+    };
+    typedef std::function<void(FileLayout &layout)> LayoutStep;
+    /** @brief register a change to the layout of world files
+     *
+     * @param version the first file version with the change
+     * @param step changes the layout of the previous version to the layout of version
+     */
+    static void changeLayout(std::uint32_t version, LayoutStep step);
+    /** @brief get the layout of a world file
+     *
+     * @exception stream::InvalidDataValueException fileVersion is older than MinimumFileVersion
+     * or newer than GameVersion::FILE_VERSION
+     */
+    static FileLayout getLayout(std::uint32_t fileVersion);
+    /** @brief get the layout of the world file the data read from reader is in */
+    static FileLayout getStreamLayout(stream::Reader &reader)
+    {
+        return getLayout(getStreamFileVersion(reader));
+    }
+    /** @brief register that the block descriptor named oldName was renamed to newName
+     *
+     * @param version the first file version that has newName
+     */
+    static void renameBlock(std::uint32_t version, std::wstring oldName, std::wstring newName);
+    /** @brief register that the entity descriptor named oldName was renamed to newName
+     *
+     * @param version the first file version that has newName
+     */
+    static void renameEntity(std::uint32_t version, std::wstring oldName, std::wstring newName);
+    /** @brief register that the block update kind written as oldValue is now written as newValue
+     *
+     * @param version the first file version that has newValue
+     */
+    static void renumberBlockUpdateKind(std::uint32_t version,
+                                        BlockUpdateKindValue oldValue,
+                                        BlockUpdateKindValue newValue);
+    static std::wstring upgradeBlockName(std::uint32_t fileVersion, std::wstring name);
+    static std::wstring upgradeEntityName(std::uint32_t fileVersion, std::wstring name);
+    /** @brief upgrade a block update kind as written in a file
+     *
+     * @exception stream::InvalidDataValueException the upgraded value isn't a BlockUpdateKind
+     */
+    static BlockUpdateKind upgradeBlockUpdateKind(std::uint32_t fileVersion,
+                                                  BlockUpdateKindValue value);
+    /** @brief set the file version of the data read from reader */
+    static void setStreamFileVersion(stream::Reader &reader, std::uint32_t fileVersion);
+    /** @brief get the file version of the data read from reader
+     *
+     * @return the version set by setStreamFileVersion, or GameVersion::FILE_VERSION if it wasn't
+     * set
+     */
+    static std::uint32_t getStreamFileVersion(stream::Reader &reader);
+    /** @brief read a block update kind, upgrading it to the current file version */
+    static BlockUpdateKind readBlockUpdateKind(stream::Reader &reader)
+    {
+        return upgradeBlockUpdateKind(getStreamFileVersion(reader),
+                                      stream::read<BlockUpdateKindValue>(reader));
+    }
+};
+}
+}
+
+#endif // FILE_UPGRADES_H_INCLUDED
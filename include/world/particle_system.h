@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef PARTICLE_SYSTEM_H_INCLUDED
+#define PARTICLE_SYSTEM_H_INCLUDED
+
+#include "util/position.h"
+#include "util/vector.h"
+#include "util/world_lock_manager.h"
+#include "render/mesh.h"
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+namespace programmerjake
+{
+namespace voxels
+{
+class World;
+namespace Entities
+{
+namespace builtin
+{
+class Particle;
+}
+}
+
+/** @brief particles waiting to be added to a ParticleSystem all at once
+ *
+ * @see ParticleSystem::addBatch
+ */
+struct ParticleBatch final
+{
+    struct NewParticle final
+    {
+        const Entities::builtin::Particle *kind;
+        PositionF position;
+        VectorF velocity;
+        NewParticle(const Entities::builtin::Particle *kind, PositionF position, VectorF velocity)
+            : kind(kind), position(position), velocity(velocity)
+        {
+        }
+    };
+    std::vector<NewParticle> newParticles;
+    void add(const Entities::builtin::Particle *kind, PositionF position, VectorF velocity)
+    {
+        newParticles.emplace_back(kind, position, velocity);
+    }
+    bool empty() const
+    {
+        return newParticles.empty();
+    }
+    void clear()
+    {
+        newParticles.clear();
+    }
+};
+
+/** @brief the particles in a World
+ *
+ * particles aren't entities: they don't have a PhysicsObject and aren't in any chunk's entity
+ * list. They are stored as structures of arrays, one per chunk, and only collide with the block
+ * they are moving into. Particles aren't saved with the world.
+ */
+class ParticleSystem final
+{
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+private:
+    struct Region final
+    {
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> velocityX, velocityY, velocityZ;
+        std::vector<float> age, existDuration;
+        std::vector<std::uint16_t> kindIndex;
+        std::size_t size() const
+        {
+            return kindIndex.size();
+        }
+        void add(
+            std::uint16_t kind, VectorF position, VectorF velocity, float age, float existDuration);
+        void removeAt(std::size_t index);
+        void clear(); /// remove all the particles, keeping the allocated memory
+    };
+    struct NewParticle final
+    {
+        std::uint16_t kindIndex;
+        PositionF position;
+        VectorF velocity;
+        float age;
+        float existDuration;
+        NewParticle(std::uint16_t kindIndex,
+                    PositionF position,
+                    VectorF velocity,
+                    float age,
+                    float existDuration)
+            : kindIndex(kindIndex),
+              position(position),
+              velocity(velocity),
+              age(age),
+              existDuration(existDuration)
+        {
+        }
+    };
+    std::mutex stepLock; /// held for all of step, so only one thread steps at a time
+    mutable std::mutex regionsLock; /// locks swapping regions; never held while a block is locked
+    std::unordered_map<PositionI, Region> regions; /// indexed by chunk base position; only step
+    /// changes it, so step reads it without locking regionsLock
+    std::unordered_map<PositionI, Region> backRegions; /// step writes the moved particles here
+    /// then swaps it with regions; only used while stepLock is locked
+    mutable std::mutex newParticlesLock; /// locks newParticles and the kind tables; nothing else is
+    /// locked while this is locked, so particles can be added from anywhere
+    std::vector<NewParticle> newParticles;
+    std::vector<const Entities::builtin::Particle *> kinds;
+    std::unordered_map<const Entities::builtin::Particle *, std::uint16_t> kindIndexes;
+    std::uint16_t getKindIndex(const Entities::builtin::Particle *kind); /// newParticlesLock must be
+    /// locked
+    /// move newParticles into regions
+    void addNewParticles(std::unordered_map<PositionI, Region> &regions);
+    static Region &getRegion(std::unordered_map<PositionI, Region> &regions, PositionI position);
+
+public:
+    ParticleSystem();
+    ~ParticleSystem();
+    void add(const Entities::builtin::Particle *kind,
+             PositionF position,
+             VectorF velocity,
+             World &world);
+    /** @brief add all the particles in batch, then clear it */
+    void addBatch(ParticleBatch &batch, World &world);
+    void step(World &world, WorldLockManager &lock_manager, double deltaTime);
+    /** @brief append the particles within viewDistance of viewPosition to dest */
+    void render(Mesh &dest,
+                PositionF viewPosition,
+                std::int32_t viewDistance,
+                const Transform &cameraToWorldMatrix) const;
+    std::size_t size() const;
+};
+}
+}
+
+#endif // PARTICLE_SYSTEM_H_INCLUDED
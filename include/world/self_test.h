@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef SELF_TEST_H_INCLUDED
+#define SELF_TEST_H_INCLUDED
+
+#include <vector>
+#include <string>
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief run headless checks of the world simulation and world files, without starting the
+ * graphics
+ *
+ * the checks are:
+ * <ul>
+ * <li><code>snapshot-save</code> saves a snapshot while the world keeps running block updates,
+ * then reads it back; the saved chunk has a dropped item and a chest holding items</li>
+ * <li><code>undermine-sand</code> removes the blocks under a 64 by 64 area of sand, then checks
+ * that every column fell without losing sand</li>
+ * <li><code>undermine-sand-in-view</code> does the same in view of a ViewPoint, then checks that
+ * each column falls as one FallingBlockColumn entity with a physics box that fits it, that the
+ * falling columns are saved and read back, and that every column lands intact in both worlds</li>
+ * <li><code>flood-basin</code> floods a basin with FluidSimulation and with Fluid::tick, then
+ * compares where the water ends up</li>
+ * <li><code>item-pit</code> drops 10000 items into a one block pit, then checks that they merged
+ * into about as many item entities and physics objects as full stacks</li>
+ * <li><code>world-file-faults</code> corrupts and truncates a world file at random offsets and
+ * interrupts appending to it, then checks that bad chunks are generated again and that the journal
+ * rolls the append back</li>
+ * <li><code>file-versions</code> writes a world with blocks, block updates, a chest, and a dropped
+ * item in every file version from FileUpgrades::MinimumFileVersion on, then checks the blocks and
+ * entities read from each file and from the file upgraded to the current version</li>
+ * <li><code>particle-step</code> times ParticleSystem::step with 100000 particles, refilling
+ * the particles that expire between steps</li>
+ * <li><code>world-save-format</code> saves and loads a world with 32 by 32 generated chunks in
+ * file version 7 and in the current version, then compares the file sizes and times</li>
+ * <li><code>world-save-throughput</code> times stream::write and stream::read through the
+ * compressed streams, then saves and loads a world uncompressed on one thread, and prints the
+ * throughputs</li>
+ * <li><code>entity-queries</code> adds 50000 item entities, then times sphere queries with
+ * World::forEachEntityInSphere against checking every item, and compares the results</li>
+ * <li><code>block-update-wheel</code> adds, reschedules, and deletes a million water and redstone
+ * block updates, and times world steps with and without them pending</li>
+ * <li><code>descriptor-type-tests</code> times the fluid, redstone dust, and plant trait tests
+ * against dynamic_cast over every block descriptor, and checks that they agree</li>
+ * </ul>
+ * the worlds are deterministic. The timing checks print their times and only fail if the work they
+ * time goes wrong. world-file-faults uses the user specific file
+ * <code>self-test-world.vw</code> and removes it when it passes.
+ * @param args the names of the checks to run, or <code>all</code>
+ * @return the exit code
+ */
+int runSelfTests(std::vector<std::wstring> args);
+}
+}
+
+#endif // SELF_TEST_H_INCLUDED
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef SESSION_RECORDING_H_INCLUDED
+#define SESSION_RECORDING_H_INCLUDED
+
+#include "world/world.h"
+#include "player/player.h"
+#include "stream/stream.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief the hash of a deterministic world's state after a step */
+struct SessionCheckpoint final
+{
+    std::uint64_t stepIndex = 0;
+    std::uint64_t worldHash = 0;
+    SessionCheckpoint() = default;
+    SessionCheckpoint(std::uint64_t stepIndex, std::uint64_t worldHash)
+        : stepIndex(stepIndex), worldHash(worldHash)
+    {
+    }
+    void write(stream::Writer &writer) const;
+    static SessionCheckpoint read(stream::Reader &reader);
+};
+
+/** @brief a recorded session of a deterministic world
+ *
+ * holds the saved world the session started from and the player input for every step, so
+ * replaying the input on the loaded world must reproduce the checkpoint hashes.
+ */
+struct SessionRecording final
+{
+    static constexpr std::uint32_t fileVersion = 0;
+    stream::SharedBytes initialWorld; /// the bytes of the world file the session started from
+    std::vector<std::vector<PlayerInputFrame>> steps; /// the input for every step, sorted by name
+    std::vector<SessionCheckpoint> checkpoints;
+    void write(stream::Writer &writer) const;
+    static SessionRecording read(stream::Reader &reader);
+};
+
+/** @brief records the player input of a deterministic world */
+class SessionRecorder final : public DeterministicStepListener
+{
+    SessionRecorder(const SessionRecorder &) = delete;
+    SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+public:
+    static constexpr std::uint64_t DefaultCheckpointInterval = 600;
+
+private:
+    SessionRecording recording;
+    const std::uint64_t checkpointInterval;
+
+public:
+    explicit SessionRecorder(stream::SharedBytes initialWorld,
+                             std::uint64_t checkpointInterval = DefaultCheckpointInterval)
+        : recording(), checkpointInterval(checkpointInterval)
+    {
+        recording.initialWorld = std::move(initialWorld);
+    }
+    /** @brief load a world and start recording it
+     *
+     * @param initialWorld the bytes of the saved world
+     * @param recorder set to the new recorder
+     * @return the loaded world, in deterministic mode
+     */
+    static std::shared_ptr<World> startRecording(
+        stream::SharedBytes initialWorld,
+        std::shared_ptr<SessionRecorder> &recorder,
+        std::uint64_t checkpointInterval = DefaultCheckpointInterval);
+    virtual void beforeStep(World &world,
+                            std::uint64_t stepIndex,
+                            WorldLockManager &lock_manager) override;
+    virtual void afterStep(World &world,
+                           std::uint64_t stepIndex,
+                           WorldLockManager &lock_manager) override;
+    const SessionRecording &getRecording() const
+    {
+        return recording;
+    }
+};
+
+struct SessionReplayResult final
+{
+    bool matched = true;
+    std::uint64_t stepCount = 0; /// the number of steps that were replayed
+    std::uint64_t mismatchStepIndex = 0; /// the step of the first checkpoint that didn't match
+    std::uint64_t expectedHash = 0;
+    std::uint64_t actualHash = 0;
+};
+
+/** @brief load the recorded session's world and replay all of its input
+ *
+ * stops at the first checkpoint that doesn't match.
+ */
+SessionReplayResult replaySession(const SessionRecording &recording);
+}
+}
+
+#endif // SESSION_RECORDING_H_INCLUDED
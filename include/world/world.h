@@ -35,7 +35,10 @@
 #include <cwchar>
 #include <string>
 #include <thread>
+#include <chrono>
 #include <list>
+#include <vector>
+#include <unordered_map>
 #include "render/renderer.h"
 #include "util/cached_variable.h"
 #include "platform/platform.h"
@@ -44,6 +47,7 @@
 #include "ray_casting/ray_casting.h"
 #include "util/flag.h"
 #include "util/spin_lock.h"
+#include "util/barrier.h"
 #include "util/parallel_map.h"
 #include "generate/biome/biome_descriptor.h"
 #include <algorithm>
@@ -51,9 +55,12 @@
 #include <stdexcept>
 #include "util/math_constants.h"
 #include "stream/stream.h"
+#include "stream/compressed_stream.h"
 #include "util/rc4_random_engine.h"
 #include "util/util.h"
 #include "util/tls.h"
+#include "util/game_version.h"
+#include "world/particle_system.h"
 
 namespace programmerjake
 {
@@ -62,6 +69,8 @@ namespace voxels
 class WorldGenerator;
 class ViewPoint;
 class PlayerList;
+class World;
+class BlockUpdateBatch;
 
 struct WorldConstructionAborted final : public std::runtime_error
 {
@@ -70,6 +79,85 @@ struct WorldConstructionAborted final : public std::runtime_error
     }
 };
 
+/** @brief a group of chunk columns that is lit by one lighting thread at a time
+ *
+ * lighting updates that cross into another region are queued on that region's boundary queue
+ * instead of being written into the other region's chunks directly.
+ */
+struct LightingRegion final
+{
+    LightingRegion(const LightingRegion &) = delete;
+    LightingRegion &operator=(const LightingRegion &) = delete;
+    static constexpr std::int32_t regionSizeInChunks = 4;
+    static constexpr std::int32_t regionSizeX = regionSizeInChunks * BlockChunk::chunkSizeX;
+    static constexpr std::int32_t regionSizeZ = regionSizeInChunks * BlockChunk::chunkSizeZ;
+    const PositionI basePosition;
+    std::mutex chunksLock;
+    std::vector<IndirectBlockChunk *> chunks;
+    std::mutex boundaryQueueLock;
+    std::vector<PositionI> boundaryQueue;
+    std::atomic_bool claimed;
+    std::atomic_bool stable;
+    /** @brief incremented when a lighting thread claims and when it releases this region, so it
+     * is odd while being processed
+     */
+    std::atomic<std::uint64_t> generation;
+    explicit LightingRegion(PositionI basePosition)
+        : basePosition(basePosition),
+          chunksLock(),
+          chunks(),
+          boundaryQueueLock(),
+          boundaryQueue(),
+          claimed(false),
+          stable(false),
+          generation(0)
+    {
+    }
+    static PositionI getRegionBasePosition(PositionI pos)
+    {
+        PositionI chunkBasePosition = BlockChunk::getChunkBasePosition(pos);
+        return PositionI(chunkBasePosition.x & ~(regionSizeX - 1),
+                         chunkBasePosition.y,
+                         chunkBasePosition.z & ~(regionSizeZ - 1),
+                         chunkBasePosition.d);
+    }
+    bool tryClaim()
+    {
+        if(claimed.exchange(true, std::memory_order_acquire))
+            return false;
+        generation.fetch_add(1);
+        return true;
+    }
+    void release(bool isStable)
+    {
+        stable = isStable;
+        generation.fetch_add(1);
+        claimed.store(false, std::memory_order_release);
+    }
+    void addBoundaryUpdate(PositionI pos)
+    {
+        std::unique_lock<std::mutex> lockIt(boundaryQueueLock);
+        boundaryQueue.push_back(pos);
+        stable = false;
+    }
+};
+
+/** @brief gets notified around every step that World::stepDeterministic runs
+ *
+ * used to capture player input while recording a session and to apply it while replaying one.
+ */
+class DeterministicStepListener
+{
+public:
+    virtual ~DeterministicStepListener() = default;
+    /** @brief called before the step runs, after the step count is incremented */
+    virtual void beforeStep(World &world,
+                            std::uint64_t stepIndex,
+                            WorldLockManager &lock_manager) = 0;
+    /** @brief called after the step has run */
+    virtual void afterStep(World &world, std::uint64_t stepIndex, WorldLockManager &lock_manager) = 0;
+};
+
 GCC_PRAGMA(diagnostic push)
 GCC_PRAGMA(diagnostic ignored "-Weffc++")
 class World final : public std::enable_shared_from_this<World>
@@ -132,12 +220,21 @@ private:
 
     private:
         World &world;
+        const bool pauseWhenDeterministic;
+        bool shouldPause() const
+        {
+            return world.isPaused || (pauseWhenDeterministic && world.deterministic);
+        }
 
     public:
-        explicit ThreadPauseGuard(World &world) : world(world)
+        /** @param pauseWhenDeterministic if this thread runs work that World::stepDeterministic
+         * does instead while the world is deterministic
+         */
+        explicit ThreadPauseGuard(World &world, bool pauseWhenDeterministic = false)
+            : world(world), pauseWhenDeterministic(pauseWhenDeterministic)
         {
             std::unique_lock<std::mutex> lockIt(world.stateLock);
-            while(world.isPaused && !world.destructing)
+            while(shouldPause() && !world.destructing)
             {
                 world.stateCond.wait(lockIt);
             }
@@ -151,11 +248,11 @@ private:
         }
         void checkForPause(std::unique_lock<std::mutex> &lockedStateLock)
         {
-            if(world.isPaused && !world.destructing)
+            if(shouldPause() && !world.destructing)
             {
                 world.unpausedThreadCount--;
                 world.stateCond.notify_all();
-                while(world.isPaused && !world.destructing)
+                while(shouldPause() && !world.destructing)
                 {
                     world.stateCond.wait(lockedStateLock);
                 }
@@ -260,6 +357,12 @@ public:
     static constexpr float timeOfDayDuskStart = 600.0f;
     static constexpr float timeOfDayNightStart = 690.0f;
     static constexpr float timeOfDayDawnStart = 1110.0f;
+    static constexpr double DefaultBlockUpdateTicksPerSecond = 100;
+    static constexpr double DeterministicStepsPerSecond = 60;
+    /// how far from each player, in chunks, a deterministic world simulates
+    static constexpr std::int32_t DeterministicSimulationDistance = 3;
+    /// how far from each player, in chunks, readLazily loads chunks in the background
+    static constexpr std::int32_t LazyChunkPreloadDistance = 8;
 
 public:
     // public functions
@@ -369,12 +472,12 @@ public:
         else
         {
             blockOptionalData = subchunk.blockOptionalData.get_or_make(
-                BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition),
-                lock_manager.tls);
+                BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition));
             block.hasOptionalData = true;
         }
         if(blockOptionalData == nullptr)
             return -1;
+        bi.chunk->getChunkVariables().saveDirty = true;
         BlockUpdate **ppnode = &blockOptionalData->updateListHead;
         BlockUpdate *pnode = *ppnode;
         std::unique_lock<decltype(bi.chunk->getChunkVariables().blockUpdateListLock)> lockIt(
@@ -384,32 +487,25 @@ public:
         {
             if(pnode->kind == kind)
             {
-                retval = pnode->time_left;
+                retval = pnode->getTimeLeft();
                 if(updateTimeFromNow < 0)
                 {
                     *ppnode = pnode->block_next;
-                    if(pnode->chunk_prev == nullptr)
-                        bi.chunk->getChunkVariables().blockUpdateListHead = pnode->chunk_next;
-                    else
-                        pnode->chunk_prev->chunk_next = pnode->chunk_next;
-                    if(pnode->chunk_next == nullptr)
-                        bi.chunk->getChunkVariables().blockUpdateListTail = pnode->chunk_prev;
-                    else
-                        pnode->chunk_next->chunk_prev = pnode->chunk_prev;
+                    bi.chunk->getChunkVariables().blockUpdates.remove(pnode);
                     bi.chunk->getChunkVariables()
                         .blockUpdatesPerPhase[BlockUpdateKindPhase(kind)]--;
                     BlockUpdate::free(pnode, lock_manager.tls);
                     if(blockOptionalData->empty())
                     {
                         subchunk.blockOptionalData.erase(
-                            BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition),
-                            lock_manager.tls);
+                            BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition));
                         block.hasOptionalData = false;
                     }
                 }
                 else
                 {
-                    pnode->time_left = updateTimeFromNow;
+                    bi.chunk->getChunkVariables().blockUpdates.reschedule(pnode,
+                                                                          updateTimeFromNow);
                 }
                 return retval;
             }
@@ -418,19 +514,10 @@ public:
         }
         if(updateTimeFromNow >= 0)
         {
-            pnode = BlockUpdate::allocate(lock_manager.tls,
-                                          kind,
-                                          bi.position(),
-                                          updateTimeFromNow,
-                                          blockOptionalData->updateListHead);
+            pnode = BlockUpdate::allocate(
+                lock_manager.tls, kind, bi.position(), blockOptionalData->updateListHead);
             blockOptionalData->updateListHead = pnode;
-            pnode->chunk_next = bi.chunk->getChunkVariables().blockUpdateListHead;
-            pnode->chunk_prev = nullptr;
-            if(bi.chunk->getChunkVariables().blockUpdateListHead != nullptr)
-                bi.chunk->getChunkVariables().blockUpdateListHead->chunk_prev = pnode;
-            else
-                bi.chunk->getChunkVariables().blockUpdateListTail = pnode;
-            bi.chunk->getChunkVariables().blockUpdateListHead = pnode;
+            bi.chunk->getChunkVariables().blockUpdates.insert(pnode, updateTimeFromNow);
             bi.chunk->getChunkVariables().blockUpdatesPerPhase[BlockUpdateKindPhase(kind)]++;
         }
         return retval;
@@ -465,20 +552,21 @@ public:
         else
         {
             blockOptionalData = subchunk.blockOptionalData.get_or_make(
-                BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition),
-                lock_manager.tls);
+                BlockChunk::getSubchunkRelativePosition(bi.currentRelativePosition));
             block.hasOptionalData = true;
         }
         if(blockOptionalData == nullptr)
             return false;
+        bi.chunk->getChunkVariables().saveDirty = true;
         BlockUpdate **ppnode = &blockOptionalData->updateListHead;
         BlockUpdate *pnode = *ppnode;
         while(pnode != nullptr)
         {
             if(pnode->kind == kind)
             {
-                if(pnode->time_left > updateTimeFromNow)
-                    pnode->time_left = updateTimeFromNow;
+                if(pnode->getTimeLeft() > updateTimeFromNow)
+                    bi.chunk->getChunkVariables().blockUpdates.reschedule(pnode,
+                                                                          updateTimeFromNow);
                 return true;
             }
             ppnode = &pnode->block_next;
@@ -486,19 +574,10 @@ public:
         }
         if(updateTimeFromNow >= 0)
         {
-            pnode = BlockUpdate::allocate(lock_manager.tls,
-                                          kind,
-                                          bi.position(),
-                                          updateTimeFromNow,
-                                          blockOptionalData->updateListHead);
+            pnode = BlockUpdate::allocate(
+                lock_manager.tls, kind, bi.position(), blockOptionalData->updateListHead);
             blockOptionalData->updateListHead = pnode;
-            pnode->chunk_next = bi.chunk->getChunkVariables().blockUpdateListHead;
-            pnode->chunk_prev = nullptr;
-            if(bi.chunk->getChunkVariables().blockUpdateListHead != nullptr)
-                bi.chunk->getChunkVariables().blockUpdateListHead->chunk_prev = pnode;
-            else
-                bi.chunk->getChunkVariables().blockUpdateListTail = pnode;
-            bi.chunk->getChunkVariables().blockUpdateListHead = pnode;
+            bi.chunk->getChunkVariables().blockUpdates.insert(pnode, updateTimeFromNow);
             bi.chunk->getChunkVariables().blockUpdatesPerPhase[BlockUpdateKindPhase(kind)]++;
         }
         return false;
@@ -544,6 +623,7 @@ public:
         {
             subchunk.addParticleGeneratingBlock(bi.position());
         }
+        bi.chunk->getChunkVariables().saveDirty = true;
         lightingStable = false;
         for(int dx = -1; dx <= 1; dx++)
         {
@@ -580,6 +660,7 @@ public:
         bi.updateLock(lock_manager);
         BlockChunkBiome &b = bi.getBiome();
         b.biomeProperties = std::move(newBiomeProperties);
+        bi.chunk->getChunkVariables().saveDirty = true;
         lightingStable = false;
         PositionI pos = bi.position();
         pos.y = 0;
@@ -617,6 +698,7 @@ public:
                 BlockChunkBiome &b = biXZ.getBiome();
                 VectorI inputP = p - minCorner + newBiomesOrigin;
                 b.biomeProperties = newBiomes[inputP.x][inputP.z];
+                biXZ.chunk->getChunkVariables().saveDirty = true;
             }
         }
         lightingStable = false;
@@ -658,6 +740,8 @@ public:
      * @param lock_manager this thread's <code>WorldLockManager</code>
      * @param newBlocks the array of new blocks
      * @param newBlocksOrigin the minimum corner in the array of new blocks
+     * @param lightingPrecomputed if the lighting in newBlocks is already consistent for every block
+     *not on the surface of the range, so only surface blocks need lighting updates
      *
      *
      */
@@ -667,7 +751,8 @@ public:
                        VectorI maxCorner,
                        WorldLockManager &lock_manager,
                        const T &newBlocks,
-                       VectorI newBlocksOrigin)
+                       VectorI newBlocksOrigin,
+                       bool lightingPrecomputed = false)
     {
         PositionI adjustedMinCorner = minCorner - VectorI(1);
         VectorI adjustedMaxCorner = maxCorner + VectorI(1);
@@ -698,6 +783,7 @@ public:
                         std::min(maxSubchunkRelativePos.z, maxCorner.z - subchunkPos.z);
                     BlockIterator sbi = blockIterator;
                     sbi.moveTo(subchunkPos, lock_manager);
+                    sbi.chunk->getChunkVariables().saveDirty = true;
                     for(VectorI subchunkRelativePos = minSubchunkRelativePos;
                         subchunkRelativePos.x <= maxSubchunkRelativePos.x;
                         subchunkRelativePos.x++)
@@ -752,7 +838,11 @@ public:
                 }
             }
         }
-        invalidateBlockRange(blockIterator, adjustedMinCorner, adjustedMaxCorner, lock_manager);
+        invalidateBlockRange(blockIterator,
+                             adjustedMinCorner,
+                             adjustedMaxCorner,
+                             lock_manager,
+                             lightingPrecomputed);
         lightingStable = false;
     }
     /** @brief set a block range
@@ -789,6 +879,8 @@ public:
      * @param lock_manager this thread's <code>WorldLockManager</code>
      * @param newBlocks the array of new blocks
      * @param newBlocksOrigin the minimum corner in the array of new blocks
+     * @param lightingPrecomputed if the lighting in newBlocks is already consistent for every block
+     *not on the surface of the range, so only surface blocks need lighting updates
      *
      *
      */
@@ -797,14 +889,16 @@ public:
                        VectorI maxCorner,
                        WorldLockManager &lock_manager,
                        const T &newBlocks,
-                       VectorI newBlocksOrigin)
+                       VectorI newBlocksOrigin,
+                       bool lightingPrecomputed = false)
     {
         setBlockRange(getBlockIterator(minCorner, lock_manager.tls),
                       minCorner,
                       maxCorner,
                       lock_manager,
                       newBlocks,
-                      newBlocksOrigin);
+                      newBlocksOrigin,
+                      lightingPrecomputed);
     }
     /** @brief create a <code>BlockIterator</code>
      *
@@ -828,17 +922,125 @@ public:
                       VectorF velocity,
                       WorldLockManager &lock_manager,
                       std::shared_ptr<void> entityData = nullptr);
+    ParticleSystem &getParticleSystem()
+    {
+        return particleSystem;
+    }
+    /** @brief check if position is within the view distance of any ViewPoint */
+    bool isInView(PositionF position);
     RayCasting::Collision castRay(RayCasting::Ray ray,
                                   WorldLockManager &lock_manager,
                                   float maxSearchDistance,
                                   RayCasting::BlockCollisionMask blockRayCollisionMask =
                                       RayCasting::BlockCollisionMaskDefault,
                                   const Entity *ignoreEntity = nullptr);
+    /** @brief how far an entity can be outside of the subchunk whose entity list it's in, because
+     * entities only change lists once per move step */
+    static constexpr float entityIndexMargin = 2.0f;
+    /** @brief call fn(Entity &) for every good entity whose position is in the box from minCorner
+     * to maxCorner
+     *
+     * chunks and subchunks without entities are skipped using their entity counts, without locking
+     * them. fn is called with the entity's subchunk locked, so it must not add or remove entities
+     * or lock any blocks.
+     */
+    template <typename Fn>
+    void forEachEntityInBox(PositionF minCorner,
+                            VectorF maxCorner,
+                            WorldLockManager &lock_manager,
+                            Fn fn)
+    {
+        PositionI minSubchunk = BlockChunk::getSubchunkBaseAbsolutePosition(
+            static_cast<PositionI>(minCorner - VectorF(entityIndexMargin)));
+        PositionI maxSubchunk = BlockChunk::getSubchunkBaseAbsolutePosition(
+            static_cast<PositionI>(PositionF(maxCorner + VectorF(entityIndexMargin), minCorner.d)));
+        BlockIterator bi = getBlockIterator(minSubchunk, lock_manager.tls);
+        for(PositionI position = minSubchunk; position.x <= maxSubchunk.x;
+            position.x += BlockChunk::subchunkSizeXYZ)
+        {
+            for(position.y = minSubchunk.y; position.y <= maxSubchunk.y;
+                position.y += BlockChunk::subchunkSizeXYZ)
+            {
+                for(position.z = minSubchunk.z; position.z <= maxSubchunk.z;
+                    position.z += BlockChunk::subchunkSizeXYZ)
+                {
+                    bi.moveTo(position, lock_manager);
+                    if(bi.chunk->getChunkVariables().entityCount.load(std::memory_order_relaxed)
+                       == 0)
+                        continue;
+                    BlockChunkSubchunk &subchunk = bi.getSubchunk();
+                    if(subchunk.entityCount.load(std::memory_order_relaxed) == 0)
+                        continue;
+                    bi.updateLock(lock_manager);
+                    for(WrappedEntity &wrappedEntity : subchunk.entityList)
+                    {
+                        Entity &entity = wrappedEntity.entity;
+                        if(!entity.good())
+                            continue;
+                        PositionF entityPosition = entity.physicsObject->getPosition();
+                        if(entityPosition.d != minCorner.d || entityPosition.x < minCorner.x
+                           || entityPosition.y < minCorner.y || entityPosition.z < minCorner.z
+                           || entityPosition.x > maxCorner.x || entityPosition.y > maxCorner.y
+                           || entityPosition.z > maxCorner.z)
+                            continue;
+                        fn(entity);
+                    }
+                }
+            }
+        }
+    }
+    /** @brief call fn(Entity &) for every good entity whose position is within radius of center
+     *
+     * @see forEachEntityInBox
+     */
+    template <typename Fn>
+    void forEachEntityInSphere(PositionF center,
+                               float radius,
+                               WorldLockManager &lock_manager,
+                               Fn fn)
+    {
+        float radiusSquared = radius * radius;
+        forEachEntityInBox(center - VectorF(radius),
+                           static_cast<VectorF>(center) + VectorF(radius),
+                           lock_manager,
+                           [&](Entity &entity)
+                           {
+                               if(absSquared(static_cast<VectorF>(
+                                      entity.physicsObject->getPosition() - center))
+                                  <= radiusSquared)
+                                   fn(entity);
+                           });
+    }
     void move(double deltaTime, WorldLockManager &lock_manager);
     bool isLightingStable()
     {
         return lightingStable;
     }
+    /** @brief set how many times per second the block update threads run both block update phases
+     *
+     * @param ticksPerSecond the new tick rate; must be positive
+     */
+    void setBlockUpdateTickRate(double ticksPerSecond)
+    {
+        assert(ticksPerSecond > 0);
+        blockUpdateTicksPerSecond = ticksPerSecond;
+    }
+    double getBlockUpdateTickRate() const
+    {
+        return blockUpdateTicksPerSecond;
+    }
+    /** @return the number of block update ticks completed since this world started */
+    std::uint64_t getBlockUpdateTickCount() const
+    {
+        return blockUpdateTickCount;
+    }
+    /** @brief check if lighting has finished in every lighting region that overlaps the box from
+     * minCorner to maxCorner, inclusive
+     *
+     * @return false if any overlapping region has pending lighting work or hasn't been seen by a
+     * lighting thread yet
+     */
+    bool isLightingStable(PositionI minCorner, PositionI maxCorner);
     float getTimeOfDayInSeconds()
     {
         std::unique_lock<std::recursive_mutex> lockIt(timeOfDayLock);
@@ -1016,8 +1218,219 @@ public:
             }
         }
     }
-    void write(stream::Writer &writer, WorldLockManager &lock_manager);
-    static std::shared_ptr<World> read(stream::Reader &reader);
+    /** @brief check if this world is in deterministic mode
+     *
+     * in deterministic mode, the lighting, block update, move entities, and particle generating
+     * threads are parked and World::move instead runs World::stepDeterministic on the calling
+     * thread at a fixed rate.
+     */
+    bool isDeterministic() const
+    {
+        return deterministic;
+    }
+    void setDeterministic(bool newDeterministic, WorldLockManager &lock_manager);
+    /** @brief run one fixed-length step of the world simulation in a defined order
+     *
+     * the chunks within DeterministicSimulationDistance of any player are simulated, in order of
+     * position: first lighting is run until it's stable, then both block update phases, then
+     * physics, random ticks, and entities. Waits for any of those chunks that aren't generated
+     * yet. Must only be called while the world is deterministic.
+     */
+    void stepDeterministic(WorldLockManager &lock_manager);
+    /** @return the number of steps World::stepDeterministic has run */
+    std::uint64_t getDeterministicStepCount() const
+    {
+        return deterministicStepCount;
+    }
+    /** @brief set the listener that World::stepDeterministic calls around every step
+     *
+     * @param listener the new listener or nullptr for none
+     */
+    void setDeterministicStepListener(std::shared_ptr<DeterministicStepListener> listener)
+    {
+        deterministicStepListener = std::move(listener);
+    }
+    /** @brief set if block updates are run through BlockDescriptor::getBlockUpdateBatch
+     *
+     * when disabled, every block update runs BlockDescriptor::tick, so the batched paths can be
+     * checked against the per-block ones. Enabled by default.
+     */
+    void setBlockUpdateBatchesEnabled(bool enabled)
+    {
+        blockUpdateBatchesEnabled = enabled;
+    }
+    /** @brief hash the state of the chunks that World::stepDeterministic simulates
+     *
+     * covers the blocks, lighting, entities, and time of day; positions are rounded so the hash
+     * doesn't depend on the last bits of floating point values.
+     */
+    std::uint64_t hashDeterministicState(WorldLockManager &lock_manager);
+    /** @brief where a world file keeps each chunk's record
+     *
+     * world files are a file version, then a record per chunk, then an index record, then the
+     * offset of the index record. Each record is a size followed by an independently compressed
+     * stream, so chunks can be read one at a time and changed chunks can be appended to the file
+     * with a new index record after them.
+     */
+    struct FileChunkIndex final
+    {
+        struct Record final
+        {
+            std::uint64_t offset = 0; /// the offset of the record in the file
+            std::uint32_t size = 0; /// the size of the record, including its size and checksum
+            Record() = default;
+            Record(std::uint64_t offset, std::uint32_t size) : offset(offset), size(size)
+            {
+            }
+        };
+        std::unordered_map<PositionI, Record> records;
+        std::uint64_t fileSize = 0;
+        std::uint32_t fileVersion = 0; /// the version of the file's records
+        std::uint64_t getRecordsSize() const
+        {
+            std::uint64_t retval = 0;
+            for(const auto &v : records)
+                retval += std::get<1>(v).size;
+            return retval;
+        }
+        /** @return if most of the file is records that were replaced by appended records */
+        bool isMostlyGarbage() const
+        {
+            return fileSize > 2 * getRecordsSize();
+        }
+        /** @return if new records can be appended to the file instead of rewriting it */
+        bool canAppend() const;
+    };
+    /** @brief the write-ahead journal for appending to a world file
+     *
+     * it's written and synced before Snapshot::append changes the file, then removed once the
+     * appended records are synced. If it's still there when the world is loaded, the append might
+     * not have finished, so the file is truncated back to fileSize.
+     */
+    struct FileAppendJournal final
+    {
+        std::uint64_t fileSize = 0; /// the size of the world file before appending
+        FileAppendJournal() = default;
+        explicit FileAppendJournal(std::uint64_t fileSize) : fileSize(fileSize)
+        {
+        }
+        void write(stream::Writer &writer) const;
+        /** @brief read a journal
+         *
+         * @exception stream::IOException the journal is incomplete or corrupted, so the append
+         * never started
+         */
+        static FileAppendJournal read(stream::Reader &reader);
+        /** @return the name of the journal file for the world file worldFileName */
+        static std::wstring getFileName(const std::wstring &worldFileName)
+        {
+            return worldFileName + L".journal";
+        }
+        /** @brief undo an append to the world file worldFileName that didn't finish, then remove
+         * its journal
+         *
+         * call before reading or replacing the world file
+         */
+        static void rollBackInterruptedAppend(const std::wstring &worldFileName);
+    };
+    /** @brief how the chunk records of a world file are compressed */
+    struct SaveOptions final
+    {
+        enum class Codec
+        {
+            Deflate,
+            Uncompressed, /// stored deflate blocks, so old readers can still read it
+        };
+        Codec codec;
+        int compressionLevel; /// for Codec::Deflate
+        std::size_t threadCount; /// threads compressing chunk records, 0 for one per processor
+        std::uint32_t
+            fileVersion; /// the file version to write; older versions are for testing the readers
+        SaveOptions(Codec codec = Codec::Deflate,
+                    int compressionLevel = stream::CompressWriter::DefaultLevel,
+                    std::size_t threadCount = 0,
+                    std::uint32_t fileVersion = GameVersion::FILE_VERSION)
+            : codec(codec),
+              compressionLevel(compressionLevel),
+              threadCount(threadCount),
+              fileVersion(fileVersion)
+        {
+        }
+    };
+    class Snapshot;
+    /** @brief copy the state of this world so it can be written while the world keeps running
+     *
+     * the world is only paused while the blocks, entities, and players are copied; the
+     * serialization and compression happen in Snapshot::write or Snapshot::append.
+     * @param lock_manager this thread's <code>WorldLockManager</code>
+     * @param savedChunks the chunks already in the file that Snapshot::append is going to be called
+     * for, or nullptr to copy every chunk. The chunks in savedChunks that haven't changed since the
+     * last snapshot aren't copied.
+     * @return the new snapshot
+     */
+    std::shared_ptr<Snapshot> makeSnapshot(WorldLockManager &lock_manager,
+                                           const FileChunkIndex *savedChunks = nullptr);
+    /** @brief write this world
+     *
+     * same as makeSnapshot(lock_manager)->write(writer, options), except that file versions
+     * without FileUpgrades::FileLayout::subchunkPalettes are written from the running world
+     */
+    void write(stream::Writer &writer,
+               WorldLockManager &lock_manager,
+               const SaveOptions &options = SaveOptions());
+    /** @brief read a world
+     *
+     * @param reader the reader to read from; must be seekable for files with chunk records
+     * @param deterministic if the world should start in deterministic mode; the simulation threads
+     * never run before it does
+     * @param fileChunkIndex if not nullptr, set to the index of the file's chunk records, or to an
+     * empty index if the file is an older version without chunk records
+     */
+    static std::shared_ptr<World> read(stream::Reader &reader,
+                                       bool deterministic = false,
+                                       FileChunkIndex *fileChunkIndex = nullptr);
+    /** @brief read a world, only reading each chunk when it's first used
+     *
+     * reads the players and the chunk index, then reads each chunk's record the first time the
+     * chunk is loaded. The chunks near the players are loaded on a background thread. Files older
+     * than version 7 don't have chunk records, so they're read all at once like read does.
+     * @param reader the seekable reader of the world file; kept until the world is destroyed
+     * @param fileChunkIndex if not nullptr, set to the index of the file's chunk records, or to an
+     * empty index if the file is an older version without chunk records
+     * @param deterministic if the world should start in deterministic mode; then chunks are only
+     * loaded when they're used, not in the background
+     */
+    static std::shared_ptr<World> readLazily(std::shared_ptr<stream::Reader> reader,
+                                             FileChunkIndex *fileChunkIndex = nullptr,
+                                             bool deterministic = false);
+    /** @brief load a chunk, reading it from the world file if it wasn't read yet
+     *
+     * @param chunkBasePosition the base position of the chunk
+     * @param lock_manager this thread's <code>WorldLockManager</code>
+     * @return if the chunk is generated; a saved chunk isn't if its record couldn't be read
+     */
+    bool loadChunk(PositionI chunkBasePosition, WorldLockManager &lock_manager);
+    /** @brief drop a saved chunk that hasn't been read from the world file yet
+     *
+     * the chunk isn't written when this world is saved, and it's generated again if it's used.
+     * The world must be paused so no thread loads the chunk.
+     * @param chunkBasePosition the base position of the chunk
+     * @return false if the chunk was already loaded
+     */
+    bool pruneChunk(PositionI chunkBasePosition);
+    /** @brief read one chunk from a world file
+     *
+     * @param reader the seekable reader of the world file
+     * @param fileChunkIndex the index of the file's chunk records
+     * @param chunkBasePosition the base position of the chunk to read
+     * @param lock_manager this thread's <code>WorldLockManager</code>
+     * @return false if the file doesn't have the chunk
+     */
+    bool readChunk(stream::Reader &reader,
+                   const FileChunkIndex &fileChunkIndex,
+                   PositionI chunkBasePosition,
+                   WorldLockManager &lock_manager);
+    /** @brief same as FileUpgrades::getStreamFileVersion */
     static std::uint32_t getStreamFileVersion(stream::Reader &reader);
     static Lighting getDefaultBlockLighting(PositionI position, bool isTopFace)
     {
@@ -1044,9 +1457,14 @@ private:
     std::list<std::thread> lightingThreads;
     std::list<std::thread> blockUpdateThreads;
     std::thread particleGeneratingThread;
+    ParticleSystem particleSystem;
     std::thread moveEntitiesThread;
     std::list<std::thread> chunkGeneratingThreads;
     std::atomic_bool destructing, lightingStable;
+    std::mutex lightingRegionsLock;
+    std::unordered_map<PositionI, std::unique_ptr<LightingRegion>> lightingRegions;
+    std::vector<LightingRegion *> lightingRegionList;
+    std::mutex lightingRegionScanLock;
     std::mutex viewPointsLock;
     std::list<ViewPoint *> viewPoints;
     bool waitingForMoveEntities = false;
@@ -1060,13 +1478,88 @@ private:
     bool isPaused = false;
     std::size_t unpausedThreadCount = 0;
     std::thread chunkUnloaderThread;
-    BlockUpdatePhase blockUpdateCurrentPhase;
-    std::size_t blockUpdateCurrentPhaseCount;
-    std::size_t blockUpdateNextPhaseCount;
-    bool blockUpdateDidAnything;
+    std::thread chunkPreloadThread;
+    sense_reversing_barrier blockUpdateBarrier;
+    std::chrono::steady_clock::time_point
+        blockUpdateNextTickTime; /// written by the last thread to arrive at blockUpdateBarrier
+    std::atomic<double> blockUpdateTicksPerSecond;
+    std::atomic<std::uint64_t> blockUpdateTickCount;
+    std::atomic_bool deterministic;
+    double deterministicTimeAccumulator = 0; /// only used by World::move
+    std::atomic<std::uint64_t> deterministicStepCount;
+    std::shared_ptr<DeterministicStepListener> deterministicStepListener;
+    std::atomic_bool blockUpdateBatchesEnabled;
     // private functions
     void lightingThreadFn(TLS &tls);
-    void blockUpdateThreadFn(TLS &tls, bool isPhaseManager);
+    LightingRegion &getLightingRegion(IndirectBlockChunk &chunk);
+    bool lightRegion(LightingRegion &region,
+                     WorldLockManager &lock_manager,
+                     ThreadPauseGuard *pauseGuard);
+    void setBlockLighting(BlockIterator bi,
+                          WorldLockManager &lock_manager,
+                          Lighting newLighting,
+                          LightingRegion &region);
+    void blockUpdateThreadFn(TLS &tls, std::size_t workerIndex);
+    /** @param fixedDeltaTime how far to advance the chunk's block update clock or < 0 to advance
+     * it by the real time since it was last advanced
+     */
+    void runBlockUpdatesInChunk(std::shared_ptr<BlockChunk> chunk,
+                                BlockUpdatePhase phase,
+                                WorldLockManager &lock_manager,
+                                std::vector<BlockUpdateBatch *> &batches,
+                                double fixedDeltaTime);
+    template <typename RandomGenerator>
+    void runRandomTicksInChunk(std::shared_ptr<BlockChunk> chunk,
+                               double deltaTime,
+                               WorldLockManager &lock_manager,
+                               RandomGenerator &randomGenerator);
+    void moveEntitiesInChunk(std::shared_ptr<BlockChunk> chunk,
+                             double deltaTime,
+                             WorldLockManager &lock_manager);
+    /** @brief get the generated chunks within DeterministicSimulationDistance of any player,
+     * sorted by position, waiting for them and the chunks around them to be generated
+     */
+    std::vector<std::shared_ptr<BlockChunk>> getDeterministicSimulationChunks(
+        WorldLockManager &lock_manager);
+    void runLightingUntilStable(WorldLockManager &lock_manager);
+    struct LazyChunkSource;
+    static std::shared_ptr<World> read(stream::Reader &reader,
+                                       bool deterministic,
+                                       FileChunkIndex *fileChunkIndex,
+                                       std::shared_ptr<LazyChunkSource> lazyChunkSource);
+    void readChunkEntities(stream::Reader &reader, WorldLockManager &lock_manager);
+    /** @brief read a chunk's position and entities, in the format Snapshot writes them
+     * @return the chunk's base position */
+    PositionI readChunkPositionAndEntities(stream::Reader &reader, WorldLockManager &lock_manager);
+    static void writeChunkPositionAndEntities(stream::Writer &writer, BlockChunk &chunk);
+    /** @brief write a chunk's biomes, blocks, and block updates a column at a time, the way files
+     * without FileUpgrades::FileLayout::subchunkPalettes have them */
+    void writeLegacyChunkBlocks(stream::Writer &writer,
+                                std::shared_ptr<BlockChunk> chunk,
+                                WorldLockManager &lock_manager);
+    /** @brief write this world in a file version without
+     * FileUpgrades::FileLayout::subchunkPalettes, which Snapshot can't write */
+    void writeLegacy(stream::Writer &writer,
+                     WorldLockManager &lock_manager,
+                     const SaveOptions &options);
+    /** @brief read a decompressed chunk record of a world file into chunk
+     *
+     * doesn't look up chunk in the chunk map, so it can be used to load chunk.
+     */
+    void readChunkRecord(std::vector<std::uint8_t> bytes,
+                         std::uint32_t fileVersion,
+                         std::shared_ptr<BlockChunk> chunk,
+                         WorldLockManager &lock_manager);
+    /** @brief read a chunk's biomes, blocks, and block updates, in the format Snapshot writes them
+     *
+     * @param cbi a <code>BlockIterator</code> at the chunk's base position
+     */
+    void readChunkBlocks(stream::Reader &reader, BlockIterator cbi, WorldLockManager &lock_manager);
+    /** @brief the loadFn of a chunk that hasn't been read from the world file yet */
+    void loadChunkLazily(LazyChunkSource &source,
+                         FileChunkIndex::Record record,
+                         std::shared_ptr<BlockChunk> chunk);
+    void chunkPreloadThreadFn(std::vector<PositionI> chunkBasePositions, TLS &tls);
     void generateChunk(std::shared_ptr<BlockChunk> chunk,
                        WorldLockManager &lock_manager,
                        const std::atomic_bool *abortFlag,
@@ -1075,12 +1568,17 @@ private:
         std::shared_ptr<InitialChunkGenerateStruct> initialChunkGenerateStruct, TLS &tls);
     void particleGeneratingThreadFn(TLS &tls);
     void moveEntitiesThreadFn(TLS &tls);
+    static void removeBlockUpdatesFromBlocks(BlockChunk &chunk, BlockUpdate *list, TLS &tls);
     static BlockUpdate *removeAllBlockUpdatesInChunk(BlockUpdateKind kind,
                                                      BlockIterator bi,
                                                      WorldLockManager &lock_manager);
+    /** @param fixedDeltaTime how far to advance the chunk's block update clock or < 0 to advance
+     * it by the real time since it was last advanced
+     */
     static BlockUpdate *removeAllReadyBlockUpdatesInChunk(BlockUpdatePhase phase,
                                                           BlockIterator bi,
-                                                          WorldLockManager &lock_manager);
+                                                          WorldLockManager &lock_manager,
+                                                          double fixedDeltaTime = -1);
     static Lighting getBlockLighting(BlockIterator bi,
                                      WorldLockManager &lock_manager,
                                      bool isTopFace);
@@ -1097,7 +1595,8 @@ private:
                                      WorldLockManager &lock_manager,
                                      double currentTime,
                                      double deltaTime,
-                                     std::vector<PositionI> &positions);
+                                     std::vector<PositionI> &positions,
+                                     ParticleBatch &newParticles);
     static void setStreamWorld(stream::Stream &stream, StreamWorld streamWorld)
     {
         std::shared_ptr<StreamWorld> p =
@@ -1132,14 +1631,112 @@ private:
                 addBlockUpdate(bi, lock_manager, kind, defaultPeriod);
         }
     }
+    /** @param lightingPrecomputed if blocks more than one block inside the range have correct
+     * lighting already. setBlockRange passes its range expanded by one block on every side, so these
+     * are the blocks whose neighbors were all set along with them.
+     */
     void invalidateBlockRange(BlockIterator bi,
                               VectorI minCorner,
                               VectorI maxCorner,
-                              WorldLockManager &lock_manager);
+                              WorldLockManager &lock_manager,
+                              bool lightingPrecomputed = false);
     bool isChunkCloseEnoughToPlayerToGetRandomUpdates(PositionI chunkBasePosition);
     void chunkUnloaderThreadFn(TLS &tls);
     BlockIterator getBlockIteratorForWorldAddEntity(PositionI pos, TLS &tls);
 };
+
+/** @brief a copy of a world's state made by World::makeSnapshot
+ *
+ * doesn't reference the world, so it can be written on any thread while the world keeps running.
+ * The players, entities, and block data are serialized when the snapshot is made, so items moved
+ * between them during a save are saved in exactly one place; the rest of the blocks are copied in
+ * a compact form and serialized by write or append.
+ */
+class World::Snapshot final
+{
+    friend class World;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+private:
+    struct BlockUpdateRecord final
+    {
+        PositionI position;
+        float timeLeft;
+        BlockUpdateKind kind;
+        BlockUpdateRecord(PositionI position, float timeLeft, BlockUpdateKind kind)
+            : position(position), timeLeft(timeLeft), kind(kind)
+        {
+        }
+    };
+    struct Chunk final
+    {
+        PositionI basePosition;
+        std::unique_ptr<stream::MemoryWriter> record; /// holds the position and the entities
+        std::vector<BiomeProperties> biomes; /// one per column, x major
+        std::vector<BlockDescriptorIndex>
+            blockKinds; /// one per block, y major then z then x, so subchunks are contiguous
+        std::vector<PackedLighting> blockLighting; /// one per block, in the same order
+        std::vector<std::pair<std::uint32_t, std::size_t>>
+            blockData; /// the blocks that have data, by block index, with where their data ends
+        std::unique_ptr<stream::MemoryWriter>
+            blockDataRecord; /// the data of the blocks in blockData, serialized in order
+        std::vector<BlockUpdateRecord> blockUpdates; /// in write order
+        explicit Chunk(PositionI basePosition)
+            : basePosition(basePosition),
+              record(new stream::MemoryWriter),
+              biomes(),
+              blockKinds(),
+              blockLighting(),
+              blockData(),
+              blockDataRecord(new stream::MemoryWriter),
+              blockUpdates()
+        {
+        }
+    };
+    std::mutex writeLock;
+    bool written = false;
+    stream::MemoryWriter indexRecord; /// holds the seed, the random generator, and the players
+    std::vector<PositionI> chunkPositions; /// every generated chunk
+    std::vector<Chunk> chunks; /// the copied chunks
+    bool copiedAllChunks = true;
+    float timeOfDayInSeconds = 0;
+    std::uint8_t moonPhase = 0;
+    Snapshot();
+    /** @brief write a chunk's biomes, blocks, and block updates to the end of its record */
+    static void writeChunkBlocks(Chunk &chunk);
+    FileChunkIndex writeRecords(stream::Writer &writer,
+                                std::uint64_t offset,
+                                const FileChunkIndex *savedChunks,
+                                std::uint32_t fileVersion,
+                                const SaveOptions &options);
+
+public:
+    ~Snapshot();
+    /** @brief write a new world file
+     *
+     * can only be called once for each snapshot, and only if no savedChunks were passed to
+     * World::makeSnapshot.
+     * the chunk records are compressed in parallel, but written in a deterministic order.
+     * @param writer the writer to write to
+     * @param options how to compress the chunk records
+     * @return the index of the written file
+     * @exception stream::IOException options.fileVersion doesn't have
+     * FileUpgrades::FileLayout::subchunkPalettes
+     */
+    FileChunkIndex write(stream::Writer &writer, const SaveOptions &options = SaveOptions());
+    /** @brief append the copied chunks and a new index to an existing world file
+     *
+     * can only be called once for each snapshot.
+     * @param writer the writer to write to, positioned at the end of the file
+     * @param savedChunks the index of the file, as passed to World::makeSnapshot
+     * @param options how to compress the chunk records
+     * @return the new index of the file
+     */
+    FileChunkIndex append(stream::Writer &writer,
+                          const FileChunkIndex &savedChunks,
+                          const SaveOptions &options = SaveOptions());
+};
 }
 }
 
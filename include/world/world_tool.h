@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef WORLD_TOOL_H_INCLUDED
+#define WORLD_TOOL_H_INCLUDED
+
+#include <vector>
+#include <string>
+
+namespace programmerjake
+{
+namespace voxels
+{
+/** @brief run the offline world tool on a saved world, without starting the graphics
+ *
+ * the commands are:
+ * <ul>
+ * <li><code>list &lt;file&gt;</code> lists every chunk record</li>
+ * <li><code>stats &lt;file&gt;</code> counts the blocks of every block descriptor</li>
+ * <li><code>validate &lt;file&gt;</code> reads every chunk record</li>
+ * <li><code>recompress &lt;file&gt; [level]</code> rewrites the file with a zlib compression
+ * level</li>
+ * <li><code>prune &lt;file&gt; &lt;radius&gt;</code> removes the chunks more than radius chunks
+ * from every player</li>
+ * </ul>
+ * recompress and prune drop the chunk records that can't be read, so those chunks are generated
+ * again when the world is played, and report how many were dropped.
+ * file is a user specific file, like the files GameUi saves to.
+ * It's run with <code>voxels --world-tool</code> : the blocks and entities need the same
+ * platform layer as the game, so there isn't a separate executable.
+ * @param args the command and its arguments
+ * @return the exit code
+ */
+int runWorldTool(std::vector<std::wstring> args);
+}
+}
+
+#endif // WORLD_TOOL_H_INCLUDED
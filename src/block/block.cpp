@@ -20,6 +20,7 @@
  */
 #include "block/block.h"
 #include "item/builtin/tools/tool.h"
+#include "world/file_upgrades.h"
 #include <initializer_list>
 #include <unordered_map>
 
@@ -29,6 +30,7 @@ namespace programmerjake
 namespace voxels
 {
 const BlockDescriptor **BlockDescriptorIndex::blockDescriptorTable = nullptr;
+BlockDescriptorTraits *BlockDescriptorIndex::blockDescriptorTraitsTable = nullptr;
 std::size_t BlockDescriptorIndex::blockDescriptorTableSize = 0,
             BlockDescriptorIndex::blockDescriptorTableAllocated = 0;
 
@@ -60,6 +62,8 @@ BlockDescriptor::BlockDescriptor(std::wstring name,
       isStaticMesh(isStaticMesh),
       isFaceBlocked(),
       handledUpdateKinds(),
+      traits(BlockDescriptorTraitsNone),
+      kindId(BlockDescriptorKindIdNone),
       meshCenter(),
       meshFace(),
       staticRenderLayer(staticRenderLayer)
@@ -84,6 +88,12 @@ BlockDescriptor::BlockDescriptor(std::wstring name,
     BlockDescriptors.add(this);
 }
 
+BlockDescriptorKindId BlockDescriptor::makeKindId()
+{
+    static BlockDescriptorKindId lastKindId = BlockDescriptorKindIdNone;
+    return ++lastKindId;
+}
+
 BlockDescriptor::~BlockDescriptor()
 {
     BlockDescriptors.remove(this);
@@ -338,7 +348,8 @@ struct StreamBlockDescriptors final
             return me.descriptorToBlockDescriptorPointerMap[descriptor];
         assert(descriptor == me.descriptorCount + 1); // check for overflow
         me.descriptorCount++;
-        std::wstring name = stream::read<std::wstring>(reader);
+        std::wstring name = FileUpgrades::upgradeBlockName(
+            FileUpgrades::getStreamFileVersion(reader), stream::read<std::wstring>(reader));
         BlockDescriptorPointer retval = BlockDescriptors[name];
         if(retval == nullptr)
             throw stream::InvalidDataValueException("block name not found");
@@ -393,6 +404,16 @@ void Block::write(stream::Writer &writer) const
     stream::write<Lighting>(writer, lighting);
     descriptor->writeBlockData(writer, data);
 }
+
+BlockDescriptorPointer Block::readDescriptor(stream::Reader &reader)
+{
+    return StreamBlockDescriptors::read(reader);
+}
+
+void Block::writeDescriptor(stream::Writer &writer, BlockDescriptorPointer descriptor)
+{
+    StreamBlockDescriptors::write(writer, descriptor);
+}
 }
 }
 
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "block/builtin/falling_block.h"
+#include <vector>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace Blocks
+{
+namespace builtin
+{
+void FallingBlock::makeColumnFall(World &world,
+                                  BlockIterator blockIterator,
+                                  WorldLockManager &lock_manager)
+{
+    std::vector<const Entities::builtin::FallingBlock *> entityBlocks;
+    std::vector<BlockIterator> blockIterators;
+    BlockIterator bi = blockIterator;
+    while(entityBlocks.size() < Entities::builtin::FallingBlockColumn::maxHeight)
+    {
+        const FallingBlock *descriptor = fromDescriptor(bi.get(lock_manager).descriptor);
+        if(descriptor == nullptr)
+            break;
+        entityBlocks.push_back(descriptor->getFallingBlockEntity());
+        blockIterators.push_back(bi);
+        bi.moveTowardPY(lock_manager);
+    }
+    if(entityBlocks.empty())
+        return;
+    for(std::size_t i = blockIterators.size(); i > 0; i--)
+    {
+        world.setBlock(blockIterators[i - 1], lock_manager, Block(Air::descriptor()));
+    }
+    PositionF bottomPosition = blockIterator.position() + VectorF(0.5f);
+    // isInView locks the view points, which lock entity lists, which are locked before blocks; the
+    // iterators lock their blocks again when they're used
+    lock_manager.clear();
+    if(world.isInView(bottomPosition))
+    {
+        if(entityBlocks.size() == 1)
+            world.addEntity(entityBlocks.front(), bottomPosition, VectorF(0), lock_manager);
+        else
+            Entities::builtin::FallingBlockColumn::addToWorld(
+                world, lock_manager, bottomPosition, std::move(entityBlocks));
+        return;
+    }
+    // nobody can see it fall, so move the column straight to where it lands
+    BlockIterator landingBlockIterator = blockIterator;
+    for(;;)
+    {
+        BlockIterator belowBlockIterator = landingBlockIterator;
+        belowBlockIterator.moveTowardNY(lock_manager);
+        Block b = belowBlockIterator.get(lock_manager);
+        if(!b.good() || !b.descriptor->isReplaceableByFallingBlock())
+            break;
+        landingBlockIterator = belowBlockIterator;
+    }
+    PositionF landingPosition = landingBlockIterator.position() + VectorF(0.5f);
+    for(std::size_t i = 0; i < entityBlocks.size(); i++)
+    {
+        entityBlocks[i]->placeBlock(
+            landingPosition + VectorF(0, static_cast<float>(i), 0), world, lock_manager);
+    }
+}
+}
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "block/builtin/fluid.h"
+#include "block/builtin/fluid_simulation.h"
+#include <unordered_map>
+#include <memory>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace Blocks
+{
+namespace builtin
+{
+BlockUpdateBatch *Fluid::getBlockUpdateBatch(BlockUpdateKind kind, TLS &tls) const
+{
+    if(kind != fluidUpdateKind)
+        return nullptr;
+    struct simulations_tls_tag
+    {
+    };
+    thread_local_variable<std::unordered_map<const Fluid *, std::unique_ptr<FluidSimulation>>,
+                          simulations_tls_tag> simulations(tls);
+    const Fluid *source = getBlockDescriptorForFluidLevel(0, false);
+    std::unique_ptr<FluidSimulation> &retval = simulations.get()[source];
+    if(!retval)
+        retval.reset(new FluidSimulation(source));
+    return retval.get();
+}
+}
+}
+}
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "block/builtin/fluid_simulation.h"
+#include "world/world.h"
+#include <algorithm>
+#include <cassert>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace Blocks
+{
+namespace builtin
+{
+FluidSimulation::Cell &FluidSimulation::getCell(VectorI position, WorldLockManager &lock_manager)
+{
+    VectorI relativePosition = position - minCorner;
+    assert(relativePosition.x >= 0 && relativePosition.x < size.x);
+    assert(relativePosition.y >= 0 && relativePosition.y < size.y);
+    assert(relativePosition.z >= 0 && relativePosition.z < size.z);
+    Cell &cell =
+        cells[(relativePosition.x * size.y + relativePosition.y) * size.z + relativePosition.z];
+    if(cell.kind != Cell::Kind::Unloaded)
+        return cell;
+    BlockIterator bi = updatedBlocks.front();
+    bi.moveTo(position, lock_manager);
+    Block b = bi.get(lock_manager);
+    cell.kind = Cell::Kind::Blocked;
+    if(b.good())
+    {
+        const Fluid *descriptor = Fluid::fromDescriptor(b.descriptor);
+        if(descriptor == nullptr)
+        {
+            if(b.descriptor->isReplaceableByFluid())
+                cell.kind = Cell::Kind::Replaceable;
+        }
+        else if(fluid->isSameKind(descriptor))
+        {
+            cell.kind = Cell::Kind::SameFluid;
+            cell.level = descriptor->level;
+            cell.falling = descriptor->falling;
+        }
+        else
+        {
+            cell.kind = Cell::Kind::OtherFluid;
+        }
+    }
+    return cell;
+}
+
+bool FluidSimulation::getIsFalling(VectorI position,
+                                   unsigned newLevel,
+                                   WorldLockManager &lock_manager)
+{
+    const Cell &below = getCell(position - VectorI(0, 1, 0), lock_manager);
+    switch(below.kind)
+    {
+    case Cell::Kind::SameFluid:
+        return below.level > 0 || newLevel > 0;
+    case Cell::Kind::Replaceable:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void FluidSimulation::addWrite(VectorI position,
+                               const BlockIterator &blockIterator,
+                               const BlockDescriptor *newDescriptor,
+                               bool replacesNonFluid,
+                               unsigned level,
+                               WorldLockManager &lock_manager)
+{
+    Cell &cell = getCell(position, lock_manager);
+    if(cell.writeIndex != 0)
+    {
+        // several blocks flowed into the same block: the one with the most fluid wins
+        Write &write = writes[cell.writeIndex - 1];
+        if(replacesNonFluid && write.replacesNonFluid && level < write.level)
+        {
+            write.newDescriptor = newDescriptor;
+            write.level = level;
+        }
+        return;
+    }
+    writes.push_back(Write(blockIterator, newDescriptor, replacesNonFluid, level, cell));
+    cell.writeIndex = writes.size();
+}
+
+void FluidSimulation::run(World &world, WorldLockManager &lock_manager)
+{
+    if(updatedBlocks.empty())
+        return;
+    VectorI minPosition = static_cast<VectorI>(updatedBlocks.front().position());
+    VectorI maxPosition = minPosition;
+    for(const BlockIterator &blockIterator : updatedBlocks)
+    {
+        VectorI position = static_cast<VectorI>(blockIterator.position());
+        minPosition.x = std::min(minPosition.x, position.x);
+        minPosition.y = std::min(minPosition.y, position.y);
+        minPosition.z = std::min(minPosition.z, position.z);
+        maxPosition.x = std::max(maxPosition.x, position.x);
+        maxPosition.y = std::max(maxPosition.y, position.y);
+        maxPosition.z = std::max(maxPosition.z, position.z);
+    }
+    // updated blocks read their sides and the blocks above and below them; the blocks they flow
+    // into read the blocks below those
+    minCorner = minPosition - VectorI(1, 2, 1);
+    size = maxPosition + VectorI(1, 1, 1) - minCorner + VectorI(1);
+    cells.assign(static_cast<std::size_t>(size.x) * size.y * size.z, Cell());
+    writes.clear();
+    const unsigned maxLevel = fluid->getMaxLevel(updatedBlocks.front().position().d);
+    const BlockFace sides[] = {BlockFace::NX, BlockFace::PX, BlockFace::NZ, BlockFace::PZ};
+    for(std::size_t i = 0; i < updatedBlocks.size(); i++)
+    {
+        const BlockIterator &blockIterator = updatedBlocks[i];
+        VectorI position = static_cast<VectorI>(blockIterator.position());
+        const Cell cell = getCell(position, lock_manager);
+        if(cell.kind != Cell::Kind::SameFluid)
+            continue; // replaced since the update was scheduled
+        bool isFalling = getIsFalling(position, cell.level, lock_manager);
+        unsigned newLevel = cell.level;
+        if(cell.level > 0)
+        {
+            if(getCell(position + VectorI(0, 1, 0), lock_manager).kind == Cell::Kind::SameFluid)
+            {
+                newLevel = 1;
+            }
+            else
+            {
+                unsigned minLevel = maxLevel;
+                for(BlockFace side : sides)
+                {
+                    const Cell &sideCell =
+                        getCell(position + getBlockFaceOutDirection(side), lock_manager);
+                    if(sideCell.kind == Cell::Kind::SameFluid && !sideCell.falling
+                       && sideCell.level < minLevel)
+                        minLevel = sideCell.level;
+                }
+                newLevel = minLevel + 1;
+            }
+        }
+        if(newLevel > maxLevel)
+            addWrite(position, blockIterator, Air::pointer(), false, newLevel, lock_manager);
+        else if(newLevel != cell.level || isFalling != cell.falling)
+            addWrite(position,
+                     blockIterator,
+                     fluid->getBlockDescriptorForFluidLevel(newLevel, isFalling),
+                     false,
+                     newLevel,
+                     lock_manager);
+        if(!isFalling && newLevel < maxLevel)
+        {
+            for(BlockFace side : sides)
+            {
+                VectorI sidePosition = position + getBlockFaceOutDirection(side);
+                if(getCell(sidePosition, lock_manager).kind != Cell::Kind::Replaceable)
+                    continue;
+                BlockIterator bi = blockIterator;
+                bi.moveToward(side, lock_manager);
+                addWrite(sidePosition,
+                         bi,
+                         fluid->getBlockDescriptorForFluidLevel(
+                             newLevel + 1, getIsFalling(sidePosition, newLevel + 1, lock_manager)),
+                         true,
+                         newLevel + 1,
+                         lock_manager);
+            }
+        }
+        VectorI belowPosition = position - VectorI(0, 1, 0);
+        if(getCell(belowPosition, lock_manager).kind == Cell::Kind::Replaceable)
+        {
+            BlockIterator bi = blockIterator;
+            bi.moveTowardNY(lock_manager);
+            addWrite(belowPosition,
+                     bi,
+                     fluid->getBlockDescriptorForFluidLevel(
+                         1, getIsFalling(belowPosition, 1, lock_manager)),
+                     true,
+                     1,
+                     lock_manager);
+        }
+    }
+    for(Write &write : writes)
+    {
+        Block b = write.blockIterator.get(lock_manager);
+        if(!b.good())
+            continue;
+        const Fluid *currentFluid = Fluid::fromDescriptor(b.descriptor);
+        if(write.replacesNonFluid)
+        {
+            if(currentFluid != nullptr || !b.descriptor->isReplaceableByFluid())
+                continue;
+            b.descriptor->onReplace(world, b, write.blockIterator, lock_manager);
+        }
+        else if(currentFluid == nullptr || !fluid->isSameKind(currentFluid)
+                || currentFluid->level != write.readLevel
+                || currentFluid->falling != write.readFalling)
+        {
+            continue; // changed since it was read, so the new level is stale
+        }
+        if(b.descriptor == write.newDescriptor)
+            continue;
+        world.setBlock(write.blockIterator, lock_manager, Block(write.newDescriptor, b.lighting));
+    }
+    updatedBlocks.clear();
+    writes.clear();
+}
+}
+}
+}
+}
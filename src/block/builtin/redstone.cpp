@@ -22,6 +22,9 @@
 #include "item/builtin/minerals.h"
 #include "item/builtin/torch.h"
 #include "entity/builtin/particles/redstone.h"
+#include <vector>
+#include <unordered_map>
+#include <cstdlib>
 
 namespace programmerjake
 {
@@ -68,12 +71,281 @@ void RedstoneDust::onDisattach(World &world,
     world.setBlock(blockIterator, lock_manager, Block(Air::descriptor(), block.lighting));
 }
 
+struct RedstoneDust::SignalGraph final
+{
+    static constexpr std::size_t maxNodeCount = 4096;
+    struct Node final
+    {
+        BlockIterator blockIterator;
+        const RedstoneDust *descriptor;
+        unsigned externalSignal;
+        unsigned signalStrength;
+        EdgeAttachedState edgeAttachedStateNX;
+        EdgeAttachedState edgeAttachedStatePX;
+        EdgeAttachedState edgeAttachedStateNZ;
+        EdgeAttachedState edgeAttachedStatePZ;
+        std::vector<PositionI> inputPositions; /// dust that this dust takes its signal from
+        std::vector<std::size_t> outputs; /// nodes that take their signal from this dust
+        Node(BlockIterator blockIterator, const RedstoneDust *descriptor)
+            : blockIterator(std::move(blockIterator)),
+              descriptor(descriptor),
+              externalSignal(0),
+              signalStrength(0),
+              edgeAttachedStateNX(EdgeAttachedState::None),
+              edgeAttachedStatePX(EdgeAttachedState::None),
+              edgeAttachedStateNZ(EdgeAttachedState::None),
+              edgeAttachedStatePZ(EdgeAttachedState::None),
+              inputPositions(),
+              outputs()
+        {
+        }
+        EdgeAttachedState &edgeAttachedState(BlockFace side)
+        {
+            switch(side)
+            {
+            case BlockFace::NX:
+                return edgeAttachedStateNX;
+            case BlockFace::PX:
+                return edgeAttachedStatePX;
+            case BlockFace::NZ:
+                return edgeAttachedStateNZ;
+            default: // PZ
+                return edgeAttachedStatePZ;
+            }
+        }
+    };
+    std::vector<Node> nodes;
+    std::unordered_map<PositionI, std::size_t> nodeIndices;
+    SignalGraph() : nodes(), nodeIndices()
+    {
+    }
+    /** @brief add the dust at bi to the graph if it isn't already a member
+     *
+     * @return false if the graph would be too big
+     */
+    bool addNode(const BlockIterator &bi, const RedstoneDust *descriptor)
+    {
+        if(nodeIndices.count(bi.position()) != 0)
+            return true;
+        if(nodes.size() >= maxNodeCount)
+            return false;
+        nodeIndices.emplace(bi.position(), nodes.size());
+        nodes.push_back(Node(bi, descriptor));
+        return true;
+    }
+    /** @brief calculate the external signal, edge state and dust inputs for one side of a node;
+     * mirrors calcOrientationAndSignalStrengthSide without reading the neighboring dust's signal
+     */
+    static void compileSide(Node &node,
+                            WorldLockManager &lock_manager,
+                            BlockFace side,
+                            bool blockAboveCutsRedstoneDust)
+    {
+        EdgeAttachedState edgeAttachedState = EdgeAttachedState::None;
+        RedstoneSignal redstoneSignal =
+            calculateRedstoneSignal(side, node.blockIterator, lock_manager);
+        BlockIterator bi = node.blockIterator;
+        bi.moveToward(side, lock_manager);
+        Block b = bi.get(lock_manager);
+        if(b.good())
+        {
+            if(fromDescriptor(b.descriptor) != nullptr)
+            {
+                node.inputPositions.push_back(bi.position());
+                edgeAttachedState = EdgeAttachedState::Bottom;
+            }
+            else
+            {
+                node.externalSignal =
+                    std::max<unsigned>(node.externalSignal, redstoneSignal.weakComponent.strength);
+                if(!b.descriptor->breaksRedstoneDust())
+                {
+                    BlockIterator downBI = bi;
+                    downBI.moveTowardNY(lock_manager);
+                    Block downBlock = downBI.get(lock_manager);
+                    if(downBlock.good()
+                       && fromDescriptor(downBlock.descriptor) != nullptr)
+                    {
+                        node.inputPositions.push_back(downBI.position());
+                        edgeAttachedState = EdgeAttachedState::Bottom;
+                    }
+                }
+            }
+            if(redstoneSignal.weakComponent.connected)
+                edgeAttachedState = EdgeAttachedState::Bottom;
+            if(!blockAboveCutsRedstoneDust && b.descriptor->transmitsRedstoneSignalDown())
+            {
+                bi.moveTowardPY(lock_manager);
+                b = bi.get(lock_manager);
+                if(b.good() && fromDescriptor(b.descriptor) != nullptr)
+                {
+                    node.inputPositions.push_back(bi.position());
+                    edgeAttachedState = EdgeAttachedState::BottomAndTop;
+                }
+            }
+        }
+        else if(redstoneSignal.weakComponent.connected)
+        {
+            edgeAttachedState = EdgeAttachedState::Bottom;
+        }
+        node.edgeAttachedState(side) = edgeAttachedState;
+    }
+    /** @brief flood fill the dust network starting at the dust at bi
+     *
+     * every dust block that a member can read from or be read by is a member, so the network is
+     * closed: changing a member can't change any dust outside it.
+     * @return false if the network is too big
+     */
+    bool compile(const BlockIterator &startBI,
+                 const RedstoneDust *startDescriptor,
+                 WorldLockManager &lock_manager)
+    {
+        addNode(startBI, startDescriptor);
+        for(std::size_t i = 0; i < nodes.size(); i++)
+        {
+            for(BlockFace side : {BlockFace::NX, BlockFace::PX, BlockFace::NZ, BlockFace::PZ})
+            {
+                for(int dy = -1; dy <= 1; dy++)
+                {
+                    BlockIterator bi = nodes[i].blockIterator;
+                    bi.moveBy(getBlockFaceOutDirection(side) + VectorI(0, dy, 0), lock_manager);
+                    Block b = bi.get(lock_manager);
+                    if(!b.good())
+                        continue;
+                    const RedstoneDust *descriptor = fromDescriptor(b.descriptor);
+                    if(descriptor != nullptr && !addNode(bi, descriptor))
+                        return false;
+                }
+            }
+            Node &node = nodes[i];
+            BlockIterator bi = node.blockIterator;
+            bi.moveTowardPY(lock_manager);
+            Block b = bi.get(lock_manager);
+            bool blockAboveCutsRedstoneDust = true;
+            if(b.good())
+                blockAboveCutsRedstoneDust = b.descriptor->breaksRedstoneDust();
+            for(BlockFace side : {BlockFace::NX, BlockFace::PX, BlockFace::NZ, BlockFace::PZ})
+                compileSide(node, lock_manager, side, blockAboveCutsRedstoneDust);
+            node.externalSignal = std::max<unsigned>(
+                node.externalSignal,
+                calculateRedstoneSignal(BlockFace::NY, node.blockIterator, lock_manager)
+                    .weakComponent.strength);
+            node.externalSignal = std::max<unsigned>(
+                node.externalSignal,
+                calculateRedstoneSignal(BlockFace::PY, node.blockIterator, lock_manager)
+                    .weakComponent.strength);
+        }
+        for(std::size_t i = 0; i < nodes.size(); i++)
+        {
+            for(const PositionI &inputPosition : nodes[i].inputPositions)
+            {
+                auto iter = nodeIndices.find(inputPosition);
+                assert(iter != nodeIndices.end());
+                nodes[std::get<1>(*iter)].outputs.push_back(i);
+            }
+        }
+        return true;
+    }
+    /** @brief calculate every node's signal strength as the maximum of its external signal and
+     * its inputs' signal strengths minus one, visiting nodes from strongest to weakest
+     */
+    void evaluate()
+    {
+        checked_array<std::vector<std::size_t>, RedstoneSignalComponent::maxStrength + 1> buckets;
+        for(std::size_t i = 0; i < nodes.size(); i++)
+        {
+            nodes[i].signalStrength = nodes[i].externalSignal;
+            if(nodes[i].signalStrength > 0)
+                buckets[nodes[i].signalStrength].push_back(i);
+        }
+        for(unsigned strength = RedstoneSignalComponent::maxStrength; strength > 1; strength--)
+        {
+            for(std::size_t i : buckets[strength])
+            {
+                if(nodes[i].signalStrength != strength)
+                    continue;
+                for(std::size_t output : nodes[i].outputs)
+                {
+                    if(nodes[output].signalStrength < strength - 1)
+                    {
+                        nodes[output].signalStrength = strength - 1;
+                        buckets[strength - 1].push_back(output);
+                    }
+                }
+            }
+        }
+    }
+};
+
+bool RedstoneDust::updateNetwork(World &world,
+                                 BlockIterator blockIterator,
+                                 WorldLockManager &lock_manager)
+{
+    Block block = blockIterator.get(lock_manager);
+    const RedstoneDust *startDescriptor = fromDescriptor(block.descriptor);
+    if(startDescriptor == nullptr)
+        return true;
+    SignalGraph graph;
+    if(!graph.compile(blockIterator, startDescriptor, lock_manager))
+        return false;
+    graph.evaluate();
+    std::vector<std::size_t> changedNodes;
+    for(std::size_t i = 0; i < graph.nodes.size(); i++)
+    {
+        SignalGraph::Node &node = graph.nodes[i];
+        const RedstoneDust *newDescriptor = pointer(node.signalStrength,
+                                                    node.edgeAttachedStateNX,
+                                                    node.edgeAttachedStatePX,
+                                                    node.edgeAttachedStateNZ,
+                                                    node.edgeAttachedStatePZ);
+        if(newDescriptor == node.descriptor)
+            continue;
+        Block b = node.blockIterator.get(lock_manager);
+        world.setBlock(node.blockIterator, lock_manager, Block(newDescriptor, b.lighting));
+        changedNodes.push_back(i);
+    }
+    // the whole network is up to date now, so drop the updates that setting its dust queued on
+    // the other members; otherwise every member would recompile the network. Only the members in
+    // this chunk are touched: the other chunks' updates belong to the workers running them, and
+    // their members just find the network already up to date
+    const PositionI chunkBasePosition = BlockChunk::getChunkBasePosition(blockIterator.position());
+    for(SignalGraph::Node &node : graph.nodes)
+    {
+        if(BlockChunk::getChunkBasePosition(node.blockIterator.position()) != chunkBasePosition)
+            continue;
+        world.deleteBlockUpdate(node.blockIterator, lock_manager, BlockUpdateKind::UpdateNotify);
+        world.deleteBlockUpdate(node.blockIterator, lock_manager, BlockUpdateKind::Redstone);
+    }
+    const int distanceI = 2;
+    for(std::size_t i : changedNodes)
+    {
+        for(VectorI delta = VectorI(-distanceI); delta.x <= distanceI; delta.x++)
+        {
+            int yDistance = distanceI - std::abs(delta.x);
+            for(delta.y = -yDistance; delta.y <= yDistance; delta.y++)
+            {
+                int zDistance = yDistance - std::abs(delta.y);
+                for(delta.z = -zDistance; delta.z <= zDistance; delta.z++)
+                {
+                    BlockIterator bi = graph.nodes[i].blockIterator;
+                    bi.moveBy(delta, lock_manager);
+                    if(graph.nodeIndices.count(bi.position()) != 0)
+                        continue;
+                    world.addBlockUpdate(bi, lock_manager, BlockUpdateKind::Redstone, 0);
+                }
+            }
+        }
+    }
+    return true;
+}
+
 void RedstoneDust::generateParticles(World &world,
                                      Block b,
                                      BlockIterator bi,
                                      WorldLockManager &lock_manager,
                                      double currentTime,
-                                     double deltaTime) const
+                                     double deltaTime,
+                                     ParticleBatch &newParticles) const
 {
     if(signalStrength <= 0)
         return;
@@ -87,8 +359,8 @@ void RedstoneDust::generateParticles(World &world,
     int generateRedstoneCount = limit<int>((int)(nextRedstoneCount - currentRedstoneCount), 0, 10);
     for(int i = 0; i < generateRedstoneCount; i++)
     {
-        Entities::builtin::particles::Redstone::addToWorld(
-            world, lock_manager, bi.position() + VectorF(0.5f, 0.15f, 0.5f));
+        Entities::builtin::particles::Redstone::addToBatch(
+            world, newParticles, bi.position() + VectorF(0.5f, 0.15f, 0.5f));
     }
 }
 
@@ -131,7 +403,8 @@ void RedstoneTorch::generateParticles(World &world,
                                       BlockIterator bi,
                                       WorldLockManager &lock_manager,
                                       double currentTime,
-                                      double deltaTime) const
+                                      double deltaTime,
+                                      ParticleBatch &newParticles) const
 {
     if(!isOn)
         return;
@@ -145,8 +418,8 @@ void RedstoneTorch::generateParticles(World &world,
     int generateRedstoneCount = limit<int>((int)(nextRedstoneCount - currentRedstoneCount), 0, 10);
     for(int i = 0; i < generateRedstoneCount; i++)
     {
-        Entities::builtin::particles::Redstone::addToWorld(
-            world, lock_manager, bi.position() + headPosition);
+        Entities::builtin::particles::Redstone::addToBatch(
+            world, newParticles, bi.position() + headPosition);
     }
 }
 }
@@ -46,12 +46,9 @@ void Sand::onBreak(
     }
     handleToolDamage(tool);
 }
-Entity *Sand::makeFallingBlockEntity(World &world,
-                                     PositionF position,
-                                     WorldLockManager &lock_manager) const
+const Entities::builtin::FallingBlock *Sand::getFallingBlockEntity() const
 {
-    return world.addEntity(
-        Entities::builtin::FallingSand::descriptor(), position, VectorF(0), lock_manager);
+    return Entities::builtin::FallingSand::pointer();
 }
 void Gravel::onBreak(
     World &world, Block b, BlockIterator bi, WorldLockManager &lock_manager, Item &tool) const
@@ -71,12 +68,9 @@ void Gravel::onBreak(
     }
     handleToolDamage(tool);
 }
-Entity *Gravel::makeFallingBlockEntity(World &world,
-                                       PositionF position,
-                                       WorldLockManager &lock_manager) const
+const Entities::builtin::FallingBlock *Gravel::getFallingBlockEntity() const
 {
-    return world.addEntity(
-        Entities::builtin::FallingGravel::descriptor(), position, VectorF(0), lock_manager);
+    return Entities::builtin::FallingGravel::pointer();
 }
 }
 }
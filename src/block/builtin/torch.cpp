@@ -68,7 +68,8 @@ void Torch::generateParticles(World &world,
                               BlockIterator bi,
                               WorldLockManager &lock_manager,
                               double currentTime,
-                              double deltaTime) const
+                              double deltaTime,
+                              ParticleBatch &newParticles) const
 {
     const double generateSmokePerSecond = 1.0;
     double nextTime = currentTime + deltaTime;
@@ -80,8 +81,8 @@ void Torch::generateParticles(World &world,
     int generateSmokeCount = limit<int>((int)(nextSmokeCount - currentSmokeCount), 0, 10);
     for(int i = 0; i < generateSmokeCount; i++)
     {
-        Entities::builtin::particles::Smoke::addToWorld(
-            world, lock_manager, bi.position() + headPosition);
+        Entities::builtin::particles::Smoke::addToBatch(
+            world, newParticles, bi.position() + headPosition);
     }
 }
 }
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "entity/builtin/falling_block.h"
+#include "physics/physics.h"
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace Entities
+{
+namespace builtin
+{
+Entity *FallingBlockColumn::addToWorld(World &world,
+                                       WorldLockManager &lock_manager,
+                                       PositionF bottomPosition,
+                                       std::vector<const FallingBlock *> blocks)
+{
+    assert(!blocks.empty() && blocks.size() <= maxHeight);
+    std::shared_ptr<ColumnData> data = std::make_shared<ColumnData>(std::move(blocks));
+    PositionF centerPosition = bottomPosition - VectorF(0, getBottomOffset(*data), 0);
+    return world.addEntity(descriptor(), centerPosition, VectorF(0), lock_manager, data);
+}
+
+void FallingBlockColumn::moveStep(Entity &entity,
+                                  World &world,
+                                  WorldLockManager &lock_manager,
+                                  double deltaTime) const
+{
+    ColumnData &data = getColumnData(entity.data);
+    PositionF bottomPosition =
+        entity.physicsObject->getPosition() + VectorF(0, getBottomOffset(data), 0);
+    if(data.collided.load(std::memory_order_relaxed))
+    {
+        // land the whole column at once, from the bottom up
+        for(std::size_t i = 0; i < data.blocks.size(); i++)
+        {
+            data.blocks[i]->placeBlock(
+                bottomPosition + VectorF(0, static_cast<float>(i), 0), world, lock_manager);
+        }
+        entity.destroy();
+        return;
+    }
+    data.timeLeft -= deltaTime;
+    if(data.timeLeft <= 0)
+    {
+        for(std::size_t i = 0; i < data.blocks.size(); i++)
+        {
+            data.blocks[i]->dropItem(
+                bottomPosition + VectorF(0, static_cast<float>(i), 0), world, lock_manager);
+        }
+        entity.destroy();
+        return;
+    }
+}
+
+void FallingBlockColumn::render(Entity &entity,
+                                Mesh &dest,
+                                RenderLayer rl,
+                                const Transform &cameraToWorldMatrix) const
+{
+    if(rl != RenderLayer::Opaque)
+        return;
+    const ColumnData &data = getColumnData(entity.data);
+    PositionF bottomPosition =
+        entity.physicsObject->getPosition() + VectorF(0, getBottomOffset(data), 0);
+    for(std::size_t i = 0; i < data.blocks.size(); i++)
+    {
+        dest.append(transform(
+            Transform::translate(-0.5f, -0.5f, -0.5f)
+                .concat(Transform::scale(0.98f))
+                .concat(Transform::translate(bottomPosition + VectorF(0, static_cast<float>(i), 0))),
+            data.blocks[i]->blockMesh));
+    }
+}
+
+Transform FallingBlockColumn::getSelectionBoxTransform(const Entity &entity) const
+{
+    const ColumnData &data = getColumnData(entity.data);
+    float height = static_cast<float>(data.blocks.size());
+    return Transform::translate(-0.5f, -0.5f * height, -0.5f)
+        .concat(Transform::scale(VectorF(0.98f, 0.98f * height, 0.98f)))
+        .concat(Transform::translate(entity.physicsObject->getPosition()));
+}
+
+std::shared_ptr<PhysicsObject> FallingBlockColumn::makePhysicsObject(
+    Entity &entity,
+    PositionF position,
+    VectorF velocity,
+    std::shared_ptr<PhysicsWorld> physicsWorld) const
+{
+    std::shared_ptr<ColumnData> data = std::static_pointer_cast<ColumnData>(entity.data);
+    assert(data != nullptr);
+    std::shared_ptr<PhysicsCollisionHandler> collisionHandler =
+        std::make_shared<FallingBlock::MyCollisionHandler>(
+            std::shared_ptr<std::atomic_bool>(data, &data->collided));
+    float height = static_cast<float>(data->blocks.size());
+    return PhysicsObject::makeBox(
+        position,
+        velocity,
+        true,
+        false,
+        VectorF(0.49f, 0.5f * height - 0.01f, 0.49f),
+        PhysicsProperties(PhysicsProperties::blockCollisionMask, 0, 0, 1),
+        physicsWorld,
+        collisionHandler);
+}
+
+void FallingBlockColumn::write(PositionF position,
+                               VectorF velocity,
+                               std::shared_ptr<void> dataIn,
+                               stream::Writer &writer) const
+{
+    const ColumnData &data = getColumnData(dataIn);
+    stream::write<float64_t>(writer, data.timeLeft);
+    stream::write<std::uint8_t>(writer, static_cast<std::uint8_t>(data.blocks.size()));
+    for(const FallingBlock *block : data.blocks)
+    {
+        Entity::writeDescriptor(writer, block);
+    }
+}
+
+std::shared_ptr<void> FallingBlockColumn::read(PositionF position,
+                                               VectorF velocity,
+                                               stream::Reader &reader) const
+{
+    double timeLeft = stream::read<float64_t>(reader);
+    std::size_t height = stream::read_limited<std::uint8_t>(reader, 1, maxHeight);
+    std::vector<const FallingBlock *> blocks;
+    blocks.reserve(height);
+    for(std::size_t i = 0; i < height; i++)
+    {
+        const FallingBlock *block =
+            dynamic_cast<const FallingBlock *>(Entity::readDescriptor(reader));
+        if(block == nullptr)
+            throw stream::InvalidDataValueException("falling block column has invalid block");
+        blocks.push_back(block);
+    }
+    return std::make_shared<ColumnData>(timeLeft, std::move(blocks));
+}
+}
+}
+}
+}
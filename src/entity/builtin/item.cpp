@@ -81,6 +81,39 @@ std::shared_ptr<PhysicsObject> EntityItem::makePhysicsObject(
 }
 
 
+void EntityItem::mergeNearbyItems(Entity &entity,
+                                  World &world,
+                                  WorldLockManager &lock_manager) const
+{
+    std::shared_ptr<ItemData> data = getItemData(entity);
+    if(data->ignorePlayerTime > 0 || data->itemStack.count >= data->itemStack.getMaxCount())
+        return;
+    world.forEachEntityInSphere(
+        entity.physicsObject->getPosition(),
+        mergeDistance,
+        lock_manager,
+        [&](Entity &otherEntity)
+        {
+            if(&otherEntity == &entity || otherEntity.descriptor != this)
+                return;
+            std::shared_ptr<ItemData> otherData = getItemData(otherEntity);
+            if(otherData->followingPlayer || otherData->ignorePlayerTime > 0
+               || otherData->itemStack.item != data->itemStack.item)
+                return;
+            unsigned maxCount = data->itemStack.getMaxCount();
+            if(data->itemStack.count >= maxCount)
+                return;
+            unsigned movedCount = std::min(maxCount - data->itemStack.count,
+                                           otherData->itemStack.count);
+            data->itemStack.count += movedCount;
+            otherData->itemStack.count -= movedCount;
+            data->timeLeft = std::max(data->timeLeft, otherData->timeLeft);
+            if(otherData->itemStack.count == 0)
+                otherEntity.destroy(); // retires its physics object too
+        });
+    lock_manager.block_biome_lock.clear();
+}
+
 void EntityItem::moveStep(Entity &entity,
                           World &world,
                           WorldLockManager &lock_manager,
@@ -96,7 +129,34 @@ void EntityItem::moveStep(Entity &entity,
     std::shared_ptr<Player> closestPlayer = nullptr;
     float distanceSquared = 0;
     PositionF playerPosition;
-    for(std::shared_ptr<Player> player : world.players().lock())
+    constexpr float pickupDistance = 2;
+    std::vector<std::shared_ptr<Player>> nearbyPlayers;
+    if(!data->followingPlayer)
+    {
+        // only players close enough to pick this item up matter, so just search nearby subchunks
+        world.forEachEntityInSphere(
+            position,
+            pickupDistance + World::entityIndexMargin,
+            lock_manager,
+            [&](Entity &otherEntity)
+            {
+                if(otherEntity.descriptor != Entities::builtin::PlayerEntity::descriptor())
+                    return;
+                std::shared_ptr<Player> player =
+                    Entities::builtin::PlayerEntity::descriptor()->getPlayer(otherEntity);
+                if(player != nullptr)
+                    nearbyPlayers.push_back(std::move(player));
+            });
+        lock_manager.block_biome_lock.clear();
+    }
+    else
+    {
+        for(std::shared_ptr<Player> player : world.players().lock())
+        {
+            nearbyPlayers.push_back(std::move(player));
+        }
+    }
+    for(std::shared_ptr<Player> player : nearbyPlayers)
     {
         PositionF currentPlayerPosition = player->getPosition();
         if(currentPlayerPosition.d != position.d)
@@ -111,7 +171,8 @@ void EntityItem::moveStep(Entity &entity,
             distanceSquared = absSquared(currentPlayerPosition - position);
         }
     }
-    if(!data->followingPlayer && closestPlayer != nullptr && distanceSquared < 2 * 2)
+    if(!data->followingPlayer && closestPlayer != nullptr
+       && distanceSquared < pickupDistance * pickupDistance)
     {
         data->followingPlayer = true;
         auto oldPhysicsObject = entity.physicsObject;
@@ -150,6 +211,12 @@ void EntityItem::moveStep(Entity &entity,
     }
     else
     {
+        data->mergeTimeLeft -= deltaTime;
+        if(data->mergeTimeLeft <= 0)
+        {
+            data->mergeTimeLeft = mergeInterval;
+            mergeNearbyItems(entity, world, lock_manager);
+        }
         VectorF gravity = VectorF(0, -16, 0);
         if(entity.physicsObject->getBlockEffects().canSwim)
         {
@@ -21,6 +21,7 @@
 #include "entity/entity.h"
 #include "physics/physics.h"
 #include "util/util.h"
+#include "world/file_upgrades.h"
 
 using namespace std;
 
@@ -75,7 +76,8 @@ struct StreamEntityDescriptors final
             return me.descriptorToEntityDescriptorPointerMap[descriptor];
         assert(descriptor == me.descriptorCount + 1); // check for overflow
         me.descriptorCount++;
-        std::wstring name = stream::read<std::wstring>(reader);
+        std::wstring name = FileUpgrades::upgradeEntityName(
+            FileUpgrades::getStreamFileVersion(reader), stream::read<std::wstring>(reader));
         EntityDescriptorPointer retval = EntityDescriptors[name];
         if(retval == nullptr)
             throw stream::InvalidDataValueException("entity name not found");
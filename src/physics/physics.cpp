@@ -19,6 +19,7 @@
  *
  */
 #include "physics/physics.h"
+#include <tuple>
 
 namespace programmerjake
 {
@@ -68,10 +69,35 @@ void PhysicsWorld::runToTime(double stopTime, WorldLockManager &lock_manager)
                     objectsVector[i]);
             std::sort(temporaryObjectsVector.begin(),
                       temporaryObjectsVector.end(),
-                      [](std::pair<float, std::shared_ptr<PhysicsObject>> a,
-                         std::pair<float, std::shared_ptr<PhysicsObject>> b)
+                      [](const std::pair<float, std::shared_ptr<PhysicsObject>> &a,
+                         const std::pair<float, std::shared_ptr<PhysicsObject>> &b)
                       {
-                          return std::get<0>(a) < std::get<0>(b);
+                          if(std::get<0>(a) != std::get<0>(b))
+                              return std::get<0>(a) < std::get<0>(b);
+                          // break ties by position, size, then creation order instead of by
+                          // where the objects happen to be in the hash table, so deterministic
+                          // worlds step the same every time, even with objects resting on top
+                          // of each other
+                          const PhysicsObject &aObject = *std::get<1>(a);
+                          const PhysicsObject &bObject = *std::get<1>(b);
+                          PositionF aPosition = aObject.getPosition();
+                          PositionF bPosition = bObject.getPosition();
+                          return std::tie(aPosition.x,
+                                          aPosition.y,
+                                          aPosition.z,
+                                          aPosition.d,
+                                          aObject.extents.x,
+                                          aObject.extents.y,
+                                          aObject.extents.z,
+                                          aObject.creationIndex)
+                                 < std::tie(bPosition.x,
+                                            bPosition.y,
+                                            bPosition.z,
+                                            bPosition.d,
+                                            bObject.extents.x,
+                                            bObject.extents.y,
+                                            bObject.extents.z,
+                                            bObject.creationIndex);
                       });
             for(std::size_t i = 0; i < temporaryObjectsVector.size(); i++)
                 objectsVector[i] = std::get<1>(temporaryObjectsVector[i]);
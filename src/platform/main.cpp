@@ -21,6 +21,10 @@
 #include "platform/platform.h"
 #include "platform/audio.h"
 #include "world/world.h"
+#include "world/session_recording.h"
+#include "world/world_tool.h"
+#include "world/self_test.h"
+#include "stream/stream.h"
 #include "util/logging.h"
 #include "ui/gameui.h"
 #include <vector>
@@ -37,10 +41,45 @@ namespace voxels
 {
 int main(std::vector<std::wstring> args)
 {
+    std::wstring recordFileName;
+    for(std::size_t i = 1; i + 1 < args.size(); i++)
+    {
+        if(args[i] == L"--world-tool")
+            return runWorldTool(std::vector<std::wstring>(args.begin() + i + 1, args.end()));
+        if(args[i] == L"--self-test")
+            return runSelfTests(std::vector<std::wstring>(args.begin() + i + 1, args.end()));
+        if(args[i] == L"--replay")
+        {
+            SessionReplayResult result;
+            try
+            {
+                auto preader = readUserSpecificFile(args[i + 1]);
+                result = replaySession(SessionRecording::read(*preader));
+            }
+            catch(stream::IOException &e)
+            {
+                getDebugLog() << L"Session Replay Error : " << e.what() << postnl;
+                return 1;
+            }
+            if(!result.matched)
+            {
+                getDebugLog() << L"Session Replay Mismatch at step " << result.mismatchStepIndex
+                              << L" : expected " << result.expectedHash << L" got "
+                              << result.actualHash << postnl;
+                return 1;
+            }
+            getDebugLog() << L"Session Replay Matched after " << result.stepCount << L" steps"
+                          << postnl;
+            return 0;
+        }
+        if(args[i] == L"--record")
+            recordFileName = args[++i];
+    }
     // globalRenderSettings.useFancyLeaves = true;
     startGraphics();
     Renderer renderer = Renderer::make();
     std::shared_ptr<ui::GameUi> theUi = std::make_shared<ui::GameUi>();
+    theUi->setSessionRecordingFileName(recordFileName);
     theUi->run(renderer);
     theUi = nullptr;
     endGraphics();
@@ -443,6 +443,42 @@ std::shared_ptr<stream::Writer> createOrWriteUserSpecificFile(std::wstring name)
     return std::make_shared<stream::FileWriter>(makeUserSpecificFilePath(name));
 }
 
+std::shared_ptr<stream::Writer> appendUserSpecificFile(std::wstring name)
+{
+    std::shared_ptr<stream::Writer> retval = std::make_shared<stream::FileWriter>(
+        stream::FileReader::openFile(makeUserSpecificFilePath(name), true));
+    retval->seek(0, stream::SeekPosition::End);
+    return retval;
+}
+
+void renameUserSpecificFile(std::wstring oldName, std::wstring newName)
+{
+    std::string oldPath = string_cast<std::string>(makeUserSpecificFilePath(std::move(oldName)));
+    std::string newPath = string_cast<std::string>(makeUserSpecificFilePath(std::move(newName)));
+#if _WIN64 || _WIN32
+    if(!MoveFileExA(oldPath.c_str(),
+                    newPath.c_str(),
+                    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        throw stream::IOException("MoveFileEx failed");
+#else
+    errno = 0;
+    if(0 != std::rename(oldPath.c_str(), newPath.c_str()))
+        stream::IOException::throwErrorFromErrno("rename");
+#endif
+}
+
+bool removeUserSpecificFile(std::wstring name)
+{
+    std::string path = string_cast<std::string>(makeUserSpecificFilePath(std::move(name)));
+    errno = 0;
+    if(0 == std::remove(path.c_str()))
+        return true;
+    if(errno == ENOENT)
+        return false;
+    stream::IOException::throwErrorFromErrno("remove");
+    return false;
+}
+
 namespace
 {
 atomic_bool simulatingTouchInput(false);
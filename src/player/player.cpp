@@ -260,8 +260,8 @@ void PlayerEntity::moveStep(Entity &entity,
                             std::uniform_real_distribution<float>(0, 1)(world.getRandomGenerator()),
                             std::uniform_real_distribution<float>(0,
                                                                   1)(world.getRandomGenerator()));
-                        Entities::builtin::particles::Smoke::addToWorld(
-                            world, lock_manager, bi.position() + p);
+                        Entities::builtin::particles::Smoke::addToWorld(world,
+                                                                        bi.position() + p);
                     }
                     player->destructingTime = 0;
                     player->cooldownTimeLeft = 0.25f;
@@ -481,6 +481,88 @@ std::shared_ptr<Player> Player::readReference(stream::Reader &reader)
     return std::get<1>(*iter);
 }
 
+void PlayerInputFrame::write(stream::Writer &writer) const
+{
+    stream::write<std::wstring>(writer, playerName);
+    stream::write<bool>(writer, isCreativeMode);
+    stream::write<bool>(writer, jump);
+    stream::write<bool>(writer, fly);
+    stream::write<VectorF>(writer, moveDirectionPlayerRelative);
+    stream::write<bool>(writer, attack);
+    stream::write<bool>(writer, sneak);
+    stream::write<float32_t>(writer, viewTheta);
+    stream::write<float32_t>(writer, viewPhi);
+    stream::write<float32_t>(writer, viewPsi);
+    stream::write<bool>(writer, gotJump);
+    stream::write<bool>(writer, gotAttack);
+    stream::write<std::uint32_t>(writer, actionCount);
+    stream::write<std::uint32_t>(writer, dropCount);
+    stream::write<std::uint32_t>(writer, currentItemIndex);
+}
+
+PlayerInputFrame PlayerInputFrame::read(stream::Reader &reader)
+{
+    PlayerInputFrame retval;
+    retval.playerName = stream::read<std::wstring>(reader);
+    retval.isCreativeMode = stream::read<bool>(reader);
+    retval.jump = stream::read<bool>(reader);
+    retval.fly = stream::read<bool>(reader);
+    retval.moveDirectionPlayerRelative = stream::read<VectorF>(reader);
+    retval.attack = stream::read<bool>(reader);
+    retval.sneak = stream::read<bool>(reader);
+    retval.viewTheta = stream::read_finite<float32_t>(reader);
+    retval.viewPhi = stream::read_finite<float32_t>(reader);
+    retval.viewPsi = stream::read_finite<float32_t>(reader);
+    retval.gotJump = stream::read<bool>(reader);
+    retval.gotAttack = stream::read<bool>(reader);
+    retval.actionCount = stream::read<std::uint32_t>(reader);
+    retval.dropCount = stream::read<std::uint32_t>(reader);
+    retval.currentItemIndex = stream::read<std::uint32_t>(reader);
+    return retval;
+}
+
+PlayerInputFrame Player::takeInputFrame()
+{
+    PlayerInputFrame retval;
+    retval.playerName = name;
+    retval.isCreativeMode = gameInput->isCreativeMode.get();
+    retval.jump = gameInput->jump.get();
+    retval.fly = gameInput->fly.get();
+    retval.moveDirectionPlayerRelative = gameInput->moveDirectionPlayerRelative.get();
+    retval.attack = gameInput->attack.get();
+    retval.sneak = gameInput->sneak.get();
+    retval.viewTheta = gameInput->viewTheta.get();
+    retval.viewPhi = gameInput->viewPhi.get();
+    retval.viewPsi = gameInput->viewPsi.get();
+    retval.gotJump = gameInputMonitoring->retrieveGotJump();
+    retval.gotAttack = gameInputMonitoring->retrieveGotAttack();
+    retval.actionCount = static_cast<std::uint32_t>(gameInputMonitoring->retrieveActionCount());
+    retval.dropCount = static_cast<std::uint32_t>(gameInputMonitoring->retrieveDropCount());
+    std::unique_lock<std::recursive_mutex> lockIt(itemsLock);
+    retval.currentItemIndex = static_cast<std::uint32_t>(currentItemIndex);
+    return retval;
+}
+
+void Player::applyInputFrame(const PlayerInputFrame &frame)
+{
+    gameInput->isCreativeMode.set(frame.isCreativeMode);
+    gameInput->jump.set(frame.jump);
+    gameInput->fly.set(frame.fly);
+    gameInput->moveDirectionPlayerRelative.set(frame.moveDirectionPlayerRelative);
+    gameInput->attack.set(frame.attack);
+    gameInput->sneak.set(frame.sneak);
+    gameInput->viewTheta.set(frame.viewTheta);
+    gameInput->viewPhi.set(frame.viewPhi);
+    gameInput->viewPsi.set(frame.viewPsi);
+    // after setting jump and attack, because their change handlers set these too
+    gameInputMonitoring->gotJump = frame.gotJump;
+    gameInputMonitoring->gotAttack = frame.gotAttack;
+    gameInputMonitoring->actionCount = static_cast<int>(frame.actionCount);
+    gameInputMonitoring->dropCount = static_cast<int>(frame.dropCount);
+    std::unique_lock<std::recursive_mutex> lockIt(itemsLock);
+    currentItemIndex = frame.currentItemIndex % items.itemStacks.size();
+}
+
 void Player::write(stream::Writer &writer)
 {
     PositionF lastPosition;
@@ -20,6 +20,7 @@
  */
 #include "stream/compressed_stream.h"
 #include <new>
+#include <algorithm>
 #include <zlib.h>
 
 namespace programmerjake
@@ -59,13 +60,13 @@ z_streamp getStream(const std::shared_ptr<void> &ptr)
 {
     return (z_streamp)ptr.get();
 }
-z_streamp makeDeflateStream()
+z_streamp makeDeflateStream(int level)
 {
     z_streamp retval = new z_stream;
     retval->zalloc = &myalloc;
     retval->zfree = &myfree;
     retval->opaque = nullptr;
-    if(deflateInit(retval, 2) != Z_OK)
+    if(deflateInit(retval, level) != Z_OK)
     {
         std::string msg = "zlib error";
         if(retval->msg != nullptr)
@@ -113,20 +114,43 @@ void inflateDeleter(void *stream)
 
 namespace stream
 {
-CompressWriter::CompressWriter(Writer &writer)
+constexpr int CompressWriter::DefaultLevel;
+constexpr int CompressWriter::MinLevel;
+constexpr int CompressWriter::MaxLevel;
+
+CompressWriter::CompressWriter(Writer &writer, int level)
     : pwriter(),
       writer(writer),
-      state(std::shared_ptr<void>((void *)makeDeflateStream(), deflateDeleter)),
+      state(std::shared_ptr<void>((void *)makeDeflateStream(level), deflateDeleter)),
       buffer(),
       compressedBuffer()
 {
-    buffer.reserve(bufferSize);
+    buffer.resize(bufferSize);
+    writeBufferPointer = buffer.data();
+    writeBufferEnd = buffer.data() + buffer.size();
     compressedBuffer.resize(bufferSize);
     z_streamp s = getStream(state);
     s->next_out = &compressedBuffer[0];
     s->avail_out = bufferSize;
 }
 
+void CompressWriter::writeBytes(const std::uint8_t *array, std::size_t count)
+{
+    while(count > 0)
+    {
+        if(writeWaits())
+        {
+            writeBuffer();
+        }
+        std::size_t copyCount =
+            std::min<std::size_t>(count, writeBufferEnd - writeBufferPointer);
+        std::copy(array, array + copyCount, writeBufferPointer);
+        writeBufferPointer += copyCount;
+        array += copyCount;
+        count -= copyCount;
+    }
+}
+
 void CompressWriter::writeCompressedBuffer()
 {
     z_streamp s = getStream(state);
@@ -145,7 +169,7 @@ void CompressWriter::finish()
 {
     z_streamp s = getStream(state);
     s->next_in = &buffer[0];
-    s->avail_in = buffer.size();
+    s->avail_in = writeBufferPointer - buffer.data();
     for(;;)
     {
         switch(deflate(s, Z_SYNC_FLUSH))
@@ -154,7 +178,7 @@ void CompressWriter::finish()
             writeCompressedBuffer();
             break;
         case Z_BUF_ERROR:
-            buffer.clear();
+            writeBufferPointer = buffer.data();
             return;
         default:
         {
@@ -169,11 +193,11 @@ void CompressWriter::finish()
 
 void CompressWriter::writeBuffer()
 {
-    if(buffer.size() == 0)
+    if(writeBufferPointer == buffer.data())
         return;
     z_streamp s = getStream(state);
     s->next_in = &buffer[0];
-    s->avail_in = buffer.size();
+    s->avail_in = writeBufferPointer - buffer.data();
     for(;;)
     {
         switch(deflate(s, Z_NO_FLUSH))
@@ -183,7 +207,7 @@ void CompressWriter::writeBuffer()
                 writeCompressedBuffer();
             break;
         case Z_BUF_ERROR:
-            buffer.clear();
+            writeBufferPointer = buffer.data();
             return;
         default:
         {
@@ -235,9 +259,10 @@ void ExpandReader::readCompressedBuffer()
 
 void ExpandReader::readBuffer()
 {
+    readBufferPointer = nullptr;
+    readBufferEnd = nullptr;
     if(gotEOF)
         throw EOFException();
-    bufferPointer = 0;
     buffer.resize(bufferSize);
     z_streamp s = getStream(state);
     for(;;)
@@ -255,6 +280,8 @@ void ExpandReader::readBuffer()
             if(s->avail_out < bufferSize)
             {
                 buffer.resize(bufferSize - s->avail_out);
+                readBufferPointer = buffer.data();
+                readBufferEnd = buffer.data() + buffer.size();
                 return;
             }
             assert(!moreAvailable);
@@ -264,6 +291,8 @@ void ExpandReader::readBuffer()
             if(s->avail_out < bufferSize)
             {
                 buffer.resize(bufferSize - s->avail_out);
+                readBufferPointer = buffer.data();
+                readBufferEnd = buffer.data() + buffer.size();
                 return;
             }
             throw EOFException();
@@ -273,6 +302,44 @@ void ExpandReader::readBuffer()
         }
     }
 }
+
+std::size_t ExpandReader::readBytes(std::uint8_t *array, std::size_t maxCount)
+{
+    std::size_t retval = 0;
+    while(retval < maxCount)
+    {
+        if(readBufferPointer == readBufferEnd)
+        {
+            try
+            {
+                readBuffer();
+            }
+            catch(EOFException &)
+            {
+                break;
+            }
+        }
+        std::size_t copyCount =
+            std::min<std::size_t>(maxCount - retval, readBufferEnd - readBufferPointer);
+        std::copy(readBufferPointer, readBufferPointer + copyCount, array + retval);
+        readBufferPointer += copyCount;
+        retval += copyCount;
+    }
+    return retval;
+}
+
+std::uint32_t computeCRC32(const std::uint8_t *bytes, std::size_t count, std::uint32_t crc)
+{
+    uLong retval = crc;
+    while(count > 0)
+    {
+        uInt currentCount = static_cast<uInt>(std::min<std::size_t>(count, 1UL << 30));
+        retval = crc32(retval, static_cast<const Bytef *>(bytes), currentCount);
+        bytes += currentCount;
+        count -= currentCount;
+    }
+    return static_cast<std::uint32_t>(retval);
+}
 }
 }
 }
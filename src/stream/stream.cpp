@@ -54,6 +54,11 @@
 #include "util/util.h"
 #include <stdio.h>
 #include <sys/types.h>
+#if defined(_WIN64) || defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -333,6 +338,34 @@ void FileWriter::seek(std::int64_t offset, SeekPosition seekPosition)
         IOException::throwErrorFromErrno("fseek");
 }
 
+void FileWriter::sync()
+{
+    flush();
+    errno = 0;
+#if defined(_WIN64) || defined(_WIN32)
+    if(0 != _commit(_fileno(f)))
+        IOException::throwErrorFromErrno("_commit");
+#else
+    if(0 != fsync(fileno(f)))
+        IOException::throwErrorFromErrno("fsync");
+#endif
+}
+
+void FileWriter::truncate(std::int64_t size)
+{
+    if(size < 0)
+        throw SeekOutOfRangeException();
+    flush();
+    errno = 0;
+#if defined(_WIN64) || defined(_WIN32)
+    if(0 != _chsize_s(_fileno(f), size))
+        IOException::throwErrorFromErrno("_chsize_s");
+#else
+    if(0 != ftruncate(fileno(f), static_cast<off_t>(size)))
+        IOException::throwErrorFromErrno("ftruncate");
+#endif
+}
+
 #if 0
 namespace
 {
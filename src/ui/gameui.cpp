@@ -388,6 +388,24 @@ void GameUi::clearWorld(bool stopSound)
         remove(e);
     }
     world->paused(false, lock_manager);
+    if(worldSaveThread.joinable())
+        worldSaveThread.join();
+    savedWorldFileName.clear();
+    savedWorldChunkIndex = World::FileChunkIndex();
+    if(sessionRecorder)
+    {
+        world->setDeterministicStepListener(nullptr);
+        try
+        {
+            sessionRecorder->getRecording().write(
+                *createOrWriteUserSpecificFile(sessionRecordingFileName));
+        }
+        catch(stream::IOException &e)
+        {
+            getDebugLog() << L"Session Recording Save Error : " << e.what() << postnl;
+        }
+        sessionRecorder = nullptr;
+    }
     std::shared_ptr<World> theWorld = world; // to extend life
     std::shared_ptr<Player> player = playerW.lock();
     player->gameUi = nullptr;
@@ -1059,19 +1077,119 @@ void GameUi::createNewWorld()
     }
 }
 
+void GameUi::saveWorld(std::wstring fileName)
+{
+    if(!world)
+        return;
+    if(worldSaveThread.joinable())
+        worldSaveThread.join();
+    // only the changed chunks need to be written if the file already has the rest
+    bool incremental = fileName == savedWorldFileName && savedWorldChunkIndex.canAppend();
+    savedWorldFileName.clear(); // set again once the save succeeds
+    std::shared_ptr<World::Snapshot> snapshot;
+    try
+    {
+        snapshot = world->makeSnapshot(lock_manager, incremental ? &savedWorldChunkIndex : nullptr);
+    }
+    catch(stream::IOException &e)
+    {
+        getDebugLog() << L"Save Error : " << e.what() << postnl;
+        return;
+    }
+    worldSaveThread = std::thread([this, snapshot, fileName, incremental]()
+                                  {
+                                      setThreadName(L"save world");
+                                      TLS tls;
+                                      try
+                                      {
+                                          World::FileAppendJournal::rollBackInterruptedAppend(
+                                              fileName);
+                                          World::FileChunkIndex index;
+                                          if(incremental)
+                                          {
+                                              // the journal lets loading undo a partial append
+                                              std::wstring journalFileName =
+                                                  World::FileAppendJournal::getFileName(fileName);
+                                              {
+                                                  auto pjwriter = createOrWriteUserSpecificFile(
+                                                      journalFileName);
+                                                  World::FileAppendJournal(
+                                                      savedWorldChunkIndex.fileSize)
+                                                      .write(*pjwriter);
+                                                  pjwriter->sync();
+                                              }
+                                              auto pfwriter = appendUserSpecificFile(fileName);
+                                              index = snapshot->append(*pfwriter,
+                                                                       savedWorldChunkIndex);
+                                              pfwriter->sync();
+                                              pfwriter = nullptr;
+                                              removeUserSpecificFile(journalFileName);
+                                          }
+                                          else
+                                          {
+                                              // write a new file then replace the old one, so
+                                              // there's always a complete file
+                                              std::wstring tempFileName = fileName + L".tmp";
+                                              {
+                                                  auto pfwriter =
+                                                      createOrWriteUserSpecificFile(tempFileName);
+                                                  index = snapshot->write(*pfwriter);
+                                                  pfwriter->sync();
+                                              }
+                                              renameUserSpecificFile(tempFileName, fileName);
+                                          }
+                                          savedWorldChunkIndex = std::move(index);
+                                          savedWorldFileName = fileName;
+                                      }
+                                      catch(stream::IOException &e)
+                                      {
+                                          getDebugLog() << L"Save Error : " << e.what() << postnl;
+                                      }
+                                  });
+}
+
 void GameUi::loadWorld(std::wstring fileName)
 {
+    if(worldSaveThread.joinable())
+        worldSaveThread.join();
     clearWorld();
     generatingWorld = true;
     generatedWorld = nullptr;
-    worldGenerateThread = std::thread([this, fileName]()
+    std::wstring recordingFileName = sessionRecordingFileName;
+    worldGenerateThread = std::thread([this, fileName, recordingFileName]()
                                       {
                                           setThreadName(L"load world");
                                           TLS tls;
                                           try
                                           {
+                                              World::FileAppendJournal::rollBackInterruptedAppend(
+                                              fileName);
                                               auto preader = readUserSpecificFile(fileName);
-                                              generatedWorld = World::read(*preader);
+                                              if(recordingFileName.empty())
+                                              {
+                                                  World::FileChunkIndex index;
+                                                  generatedWorld =
+                                                      World::readLazily(preader, &index);
+                                                  if(!index.records.empty())
+                                                  {
+                                                      savedWorldChunkIndex = std::move(index);
+                                                      savedWorldFileName = fileName;
+                                                  }
+                                              }
+                                              else
+                                              {
+                                                  std::vector<std::uint8_t> bytes;
+                                                  std::uint8_t buffer[0x10000];
+                                                  while(std::size_t count = preader->readBytes(
+                                                            buffer, sizeof(buffer)))
+                                                  {
+                                                      bytes.insert(
+                                                          bytes.end(), buffer, buffer + count);
+                                                  }
+                                                  generatedWorld = SessionRecorder::startRecording(
+                                                      stream::SharedBytes(std::move(bytes)),
+                                                      sessionRecorder);
+                                              }
                                           }
                                           catch(stream::IOException &e)
                                           {
@@ -1109,6 +1227,9 @@ GameUi::GameUi()
       worldDependantElements(),
       generatingWorld(false),
       worldGenerateThread(),
+      worldSaveThread(),
+      savedWorldFileName(),
+      savedWorldChunkIndex(),
       generatedWorld(nullptr),
       worldCreationMessage(),
       abortWorldCreation(false),
@@ -1120,6 +1241,8 @@ GameUi::GameUi()
       backgroundCameraBuffer(),
       virtualRealityCallbacks(),
       crosshairsW(),
+      sessionRecordingFileName(),
+      sessionRecorder(),
       blockDestructProgress(-1.0f)
 {
     gameInput->paused.set(true);
@@ -85,17 +85,7 @@ std::shared_ptr<Element> MainMenu::setupMainMenu()
             {
                 std::shared_ptr<GameUi> gameUi =
                     std::dynamic_pointer_cast<GameUi>(get(shared_from_this()));
-                try
-                {
-                    stream::MemoryWriter writer;
-                    gameUi->world->write(writer, gameUi->lock_manager);
-                    auto pfwriter = createOrWriteUserSpecificFile(fileName);
-                    pfwriter->writeBytes(writer.getBuffer().data(), writer.getBuffer().size());
-                }
-                catch(stream::IOException &e)
-                {
-                    getDebugLog() << L"Save Error : " << e.what() << postnl;
-                }
+                gameUi->saveWorld(fileName);
                 return Event::ReturnType::Propagate;
             });
         focusedElement = returnToWorldButton;
@@ -31,13 +31,7 @@ namespace voxels
 {
 BlockChunkChunkVariables::~BlockChunkChunkVariables()
 {
-    TLS &tls = TLS::getSlow();
-    while(blockUpdateListHead != nullptr)
-    {
-        BlockUpdate *deleteMe = blockUpdateListHead;
-        blockUpdateListHead = blockUpdateListHead->chunk_next;
-        BlockUpdate::free(deleteMe, tls);
-    }
+    blockUpdates.freeAll(TLS::getSlow());
 }
 
 BlockChunk::BlockChunk(PositionI basePosition, IndirectBlockChunk *indirectBlockChunk)
@@ -22,7 +22,7 @@
 #include "util/game_version.h"
 
 const std::wstring programmerjake::voxels::GameVersion::VERSION = L"0.7.6.1";
-const std::uint32_t programmerjake::voxels::GameVersion::FILE_VERSION = 5;
+const std::uint32_t programmerjake::voxels::GameVersion::FILE_VERSION = 9;
 
 #ifdef COMPILE_DUMP_VERSION
 #include <iostream>
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "world/file_upgrades.h"
+#include "util/game_version.h"
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <sstream>
+#include <cassert>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace
+{
+template <typename T>
+class UpgradeSteps final
+{
+private:
+    std::mutex lock;
+    std::map<std::uint32_t, std::unordered_map<T, T>> steps; /// the changes by version
+
+public:
+    UpgradeSteps() : lock(), steps()
+    {
+    }
+    void add(std::uint32_t version, T oldValue, T newValue)
+    {
+        assert(version <= GameVersion::FILE_VERSION);
+        std::unique_lock<std::mutex> lockIt(lock);
+        steps[version][std::move(oldValue)] = std::move(newValue);
+    }
+    T upgrade(std::uint32_t fileVersion, T value)
+    {
+        if(fileVersion >= GameVersion::FILE_VERSION)
+            return value;
+        std::unique_lock<std::mutex> lockIt(lock);
+        for(auto stepIter = steps.upper_bound(fileVersion); stepIter != steps.end(); ++stepIter)
+        {
+            auto iter = std::get<1>(*stepIter).find(value);
+            if(iter != std::get<1>(*stepIter).end())
+                value = std::get<1>(*iter);
+        }
+        return value;
+    }
+};
+
+UpgradeSteps<std::wstring> &getBlockNameSteps()
+{
+    static UpgradeSteps<std::wstring> retval;
+    return retval;
+}
+
+UpgradeSteps<std::wstring> &getEntityNameSteps()
+{
+    static UpgradeSteps<std::wstring> retval;
+    return retval;
+}
+
+UpgradeSteps<FileUpgrades::BlockUpdateKindValue> &getBlockUpdateKindSteps()
+{
+    static UpgradeSteps<FileUpgrades::BlockUpdateKindValue> retval;
+    return retval;
+}
+
+class LayoutSteps final
+{
+private:
+    std::mutex lock;
+    std::map<std::uint32_t, std::vector<FileUpgrades::LayoutStep>> steps; /// by version
+
+public:
+    LayoutSteps() : lock(), steps()
+    {
+    }
+    void add(std::uint32_t version, FileUpgrades::LayoutStep step)
+    {
+        assert(version > FileUpgrades::MinimumFileVersion
+               && version <= GameVersion::FILE_VERSION);
+        std::unique_lock<std::mutex> lockIt(lock);
+        steps[version].push_back(std::move(step));
+    }
+    FileUpgrades::FileLayout getLayout(std::uint32_t fileVersion)
+    {
+        FileUpgrades::FileLayout retval;
+        std::unique_lock<std::mutex> lockIt(lock);
+        for(auto stepIter = steps.begin();
+            stepIter != steps.end() && std::get<0>(*stepIter) <= fileVersion;
+            ++stepIter)
+        {
+            for(const FileUpgrades::LayoutStep &step : std::get<1>(*stepIter))
+                step(retval);
+        }
+        return retval;
+    }
+};
+
+LayoutSteps &getLayoutSteps()
+{
+    static LayoutSteps retval;
+    return retval;
+}
+
+struct BuiltinLayoutSteps final
+{
+    BuiltinLayoutSteps()
+    {
+        FileUpgrades::changeLayout(6,
+                                   [](FileUpgrades::FileLayout &layout)
+                                   {
+                                       layout.chunkEntitiesBeforeBlocks = true;
+                                   });
+        FileUpgrades::changeLayout(7,
+                                   [](FileUpgrades::FileLayout &layout)
+                                   {
+                                       layout.chunkRecords = true;
+                                   });
+        FileUpgrades::changeLayout(8,
+                                   [](FileUpgrades::FileLayout &layout)
+                                   {
+                                       layout.subchunkPalettes = true;
+                                   });
+        FileUpgrades::changeLayout(9,
+                                   [](FileUpgrades::FileLayout &layout)
+                                   {
+                                       layout.recordChecksums = true;
+                                   });
+    }
+} builtinLayoutSteps;
+
+struct file_version_tag_t
+{
+};
+}
+
+constexpr std::uint32_t FileUpgrades::MinimumFileVersion;
+
+void FileUpgrades::changeLayout(std::uint32_t version, LayoutStep step)
+{
+    getLayoutSteps().add(version, std::move(step));
+}
+
+FileUpgrades::FileLayout FileUpgrades::getLayout(std::uint32_t fileVersion)
+{
+    if(fileVersion < MinimumFileVersion)
+        throw stream::InvalidDataValueException("old file version not supported");
+    if(fileVersion > GameVersion::FILE_VERSION)
+        throw stream::InvalidDataValueException("newer file version not supported");
+    return getLayoutSteps().getLayout(fileVersion);
+}
+
+void FileUpgrades::renameBlock(std::uint32_t version, std::wstring oldName, std::wstring newName)
+{
+    getBlockNameSteps().add(version, std::move(oldName), std::move(newName));
+}
+
+void FileUpgrades::renameEntity(std::uint32_t version, std::wstring oldName, std::wstring newName)
+{
+    getEntityNameSteps().add(version, std::move(oldName), std::move(newName));
+}
+
+void FileUpgrades::renumberBlockUpdateKind(std::uint32_t version,
+                                           BlockUpdateKindValue oldValue,
+                                           BlockUpdateKindValue newValue)
+{
+    getBlockUpdateKindSteps().add(version, oldValue, newValue);
+}
+
+std::wstring FileUpgrades::upgradeBlockName(std::uint32_t fileVersion, std::wstring name)
+{
+    return getBlockNameSteps().upgrade(fileVersion, std::move(name));
+}
+
+std::wstring FileUpgrades::upgradeEntityName(std::uint32_t fileVersion, std::wstring name)
+{
+    return getEntityNameSteps().upgrade(fileVersion, std::move(name));
+}
+
+BlockUpdateKind FileUpgrades::upgradeBlockUpdateKind(std::uint32_t fileVersion,
+                                                     BlockUpdateKindValue value)
+{
+    value = getBlockUpdateKindSteps().upgrade(fileVersion, value);
+    if(value < static_cast<BlockUpdateKindValue>(enum_traits<BlockUpdateKind>::minimum)
+       || value > static_cast<BlockUpdateKindValue>(enum_traits<BlockUpdateKind>::maximum))
+    {
+        std::ostringstream ss;
+        ss << "read value out of range : " << static_cast<unsigned>(value);
+        throw stream::InvalidDataValueException(ss.str());
+    }
+    return static_cast<BlockUpdateKind>(value);
+}
+
+void FileUpgrades::setStreamFileVersion(stream::Reader &reader, std::uint32_t fileVersion)
+{
+    reader.setAssociatedValue<std::uint32_t, file_version_tag_t>(
+        std::make_shared<std::uint32_t>(fileVersion));
+}
+
+std::uint32_t FileUpgrades::getStreamFileVersion(stream::Reader &reader)
+{
+    std::shared_ptr<std::uint32_t> version =
+        reader.getAssociatedValue<std::uint32_t, file_version_tag_t>();
+    if(!version)
+        return GameVersion::FILE_VERSION;
+    return *version;
+}
+}
+}
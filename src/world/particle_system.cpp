@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "world/particle_system.h"
+#include "entity/builtin/particle.h"
+#include "world/world.h"
+#include <cassert>
+#include <limits>
+
+namespace programmerjake
+{
+namespace voxels
+{
+void ParticleSystem::Region::add(
+    std::uint16_t kind, VectorF position, VectorF velocity, float age, float existDuration)
+{
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    this->age.push_back(age);
+    this->existDuration.push_back(existDuration);
+    kindIndex.push_back(kind);
+}
+
+void ParticleSystem::Region::removeAt(std::size_t index)
+{
+    std::size_t last = size() - 1;
+    positionX[index] = positionX[last];
+    positionY[index] = positionY[last];
+    positionZ[index] = positionZ[last];
+    velocityX[index] = velocityX[last];
+    velocityY[index] = velocityY[last];
+    velocityZ[index] = velocityZ[last];
+    age[index] = age[last];
+    existDuration[index] = existDuration[last];
+    kindIndex[index] = kindIndex[last];
+    positionX.pop_back();
+    positionY.pop_back();
+    positionZ.pop_back();
+    velocityX.pop_back();
+    velocityY.pop_back();
+    velocityZ.pop_back();
+    age.pop_back();
+    existDuration.pop_back();
+    kindIndex.pop_back();
+}
+
+void ParticleSystem::Region::clear()
+{
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    velocityX.clear();
+    velocityY.clear();
+    velocityZ.clear();
+    age.clear();
+    existDuration.clear();
+    kindIndex.clear();
+}
+
+ParticleSystem::ParticleSystem()
+    : stepLock(),
+      regionsLock(),
+      regions(),
+      backRegions(),
+      newParticlesLock(),
+      newParticles(),
+      kinds(),
+      kindIndexes()
+{
+}
+
+ParticleSystem::~ParticleSystem()
+{
+}
+
+std::uint16_t ParticleSystem::getKindIndex(const Entities::builtin::Particle *kind)
+{
+    auto iter = kindIndexes.find(kind);
+    if(iter != kindIndexes.end())
+        return std::get<1>(*iter);
+    assert(kinds.size() < std::numeric_limits<std::uint16_t>::max());
+    std::uint16_t retval = static_cast<std::uint16_t>(kinds.size());
+    kinds.push_back(kind);
+    kindIndexes.emplace(kind, retval);
+    return retval;
+}
+
+ParticleSystem::Region &ParticleSystem::getRegion(std::unordered_map<PositionI, Region> &regions,
+                                                  PositionI position)
+{
+    return regions[BlockChunk::getChunkBasePosition(position)];
+}
+
+void ParticleSystem::add(const Entities::builtin::Particle *kind,
+                         PositionF position,
+                         VectorF velocity,
+                         World &world)
+{
+    assert(kind != nullptr);
+    float existDuration = kind->getExistDuration(world);
+    std::unique_lock<std::mutex> lockIt(newParticlesLock);
+    newParticles.emplace_back(getKindIndex(kind), position, velocity, 0, existDuration);
+}
+
+void ParticleSystem::addBatch(ParticleBatch &batch, World &world)
+{
+    if(batch.empty())
+        return;
+    std::vector<float> existDurations;
+    existDurations.reserve(batch.newParticles.size());
+    for(const ParticleBatch::NewParticle &newParticle : batch.newParticles)
+    {
+        assert(newParticle.kind != nullptr);
+        existDurations.push_back(newParticle.kind->getExistDuration(world));
+    }
+    std::unique_lock<std::mutex> lockIt(newParticlesLock);
+    newParticles.reserve(newParticles.size() + batch.newParticles.size());
+    for(std::size_t i = 0; i < batch.newParticles.size(); i++)
+    {
+        const ParticleBatch::NewParticle &newParticle = batch.newParticles[i];
+        newParticles.emplace_back(getKindIndex(newParticle.kind),
+                                  newParticle.position,
+                                  newParticle.velocity,
+                                  0,
+                                  existDurations[i]);
+    }
+    lockIt.unlock();
+    batch.clear();
+}
+
+void ParticleSystem::addNewParticles(std::unordered_map<PositionI, Region> &regions)
+{
+    std::unique_lock<std::mutex> lockIt(newParticlesLock);
+    for(const NewParticle &newParticle : newParticles)
+    {
+        getRegion(regions, (PositionI)newParticle.position)
+            .add(newParticle.kindIndex,
+                 newParticle.position,
+                 newParticle.velocity,
+                 newParticle.age,
+                 newParticle.existDuration);
+    }
+    newParticles.clear();
+}
+
+void ParticleSystem::step(World &world, WorldLockManager &lock_manager, double deltaTimeIn)
+{
+    std::unique_lock<std::mutex> lockStep(stepLock);
+    // the moved particles are written to backRegions, reusing the memory from two steps ago, then
+    // it's swapped with regions, so render doesn't wait for the block lookups and regionsLock is
+    // never held while a block is locked
+    for(auto &regionPair : backRegions)
+    {
+        std::get<1>(regionPair).clear();
+    }
+    std::vector<const Entities::builtin::Particle *> kinds;
+    {
+        std::unique_lock<std::mutex> lockIt(newParticlesLock);
+        kinds = this->kinds;
+    }
+    float deltaTime = static_cast<float>(deltaTimeIn);
+    for(const auto &regionPair : regions)
+    {
+        PositionI regionPosition = std::get<0>(regionPair);
+        const Region &region = std::get<1>(regionPair);
+        Region &destRegion = getRegion(backRegions, regionPosition);
+        BlockIterator bi = world.getBlockIterator(regionPosition, lock_manager.tls);
+        for(std::size_t i = 0; i < region.size(); i++)
+        {
+            float age = region.age[i] + deltaTime;
+            if(age >= region.existDuration[i] || region.positionY[i] < -64)
+                continue;
+            const Entities::builtin::Particle *kind = kinds[region.kindIndex[i]];
+            VectorF velocity(region.velocityX[i], region.velocityY[i], region.velocityZ[i]);
+            velocity += kind->gravity * deltaTime;
+            VectorF position(region.positionX[i], region.positionY[i], region.positionZ[i]);
+            VectorF newPosition = position + velocity * deltaTime;
+            if(kind->collideWithBlocks)
+            {
+                PositionI blockPosition((VectorI)newPosition, regionPosition.d);
+                bi.moveTo(blockPosition, lock_manager);
+                Block b = bi.get(lock_manager);
+                BlockShape shape =
+                    b.good() ? b.descriptor->blockShape : BlockShape(VectorF(0.5f), VectorF(0.5f));
+                if(!shape.empty())
+                {
+                    VectorF displacement = newPosition - (shape.offset + (VectorF)blockPosition);
+                    if(std::fabs(displacement.x) < shape.extents.x + kind->extent
+                       && std::fabs(displacement.y) < shape.extents.y + kind->extent
+                       && std::fabs(displacement.z) < shape.extents.z + kind->extent)
+                    {
+                        // particles just stop when they hit a block
+                        velocity = VectorF(0);
+                        newPosition = position;
+                    }
+                }
+            }
+            PositionI newBlockPosition((VectorI)newPosition, regionPosition.d);
+            Region &newRegion =
+                BlockChunk::getChunkBasePosition(newBlockPosition) == regionPosition ?
+                    destRegion :
+                    getRegion(backRegions, newBlockPosition);
+            newRegion.add(
+                region.kindIndex[i], newPosition, velocity, age, region.existDuration[i]);
+        }
+        lock_manager.clear();
+    }
+    addNewParticles(backRegions);
+    for(auto regionIter = backRegions.begin(); regionIter != backRegions.end();)
+    {
+        if(std::get<1>(*regionIter).size() == 0)
+            regionIter = backRegions.erase(regionIter);
+        else
+            ++regionIter;
+    }
+    std::unique_lock<std::mutex> lockRegions(regionsLock);
+    regions.swap(backRegions);
+    lockRegions.unlock();
+}
+
+void ParticleSystem::render(Mesh &dest,
+                            PositionF viewPosition,
+                            std::int32_t viewDistance,
+                            const Transform &cameraToWorldMatrix) const
+{
+    VectorF upVector = cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(0, 1, 0));
+    VectorF rightVector = cameraToWorldMatrix.normalMatrix.applyNoTranslate(VectorF(1, 0, 0));
+    PositionI minChunkPosition =
+        BlockChunk::getChunkBasePosition((PositionI)viewPosition - VectorI(viewDistance));
+    PositionI maxChunkPosition =
+        BlockChunk::getChunkBasePosition((PositionI)viewPosition + VectorI(viewDistance));
+    std::unique_lock<std::mutex> lockRegions(regionsLock);
+    std::vector<const Entities::builtin::Particle *> kinds;
+    {
+        std::unique_lock<std::mutex> lockIt(newParticlesLock);
+        kinds = this->kinds;
+    }
+    for(const auto &regionPair : regions)
+    {
+        PositionI regionPosition = std::get<0>(regionPair);
+        if(regionPosition.d != viewPosition.d || regionPosition.x < minChunkPosition.x
+           || regionPosition.y < minChunkPosition.y || regionPosition.z < minChunkPosition.z
+           || regionPosition.x > maxChunkPosition.x || regionPosition.y > maxChunkPosition.y
+           || regionPosition.z > maxChunkPosition.z)
+            continue;
+        const Region &region = std::get<1>(regionPair);
+        dest.vertices.reserve(dest.vertices.size() + 4 * region.size());
+        dest.indexedTriangles.reserve(dest.indexedTriangles.size() + 2 * region.size());
+        for(std::size_t i = 0; i < region.size(); i++)
+        {
+            kinds[region.kindIndex[i]]->appendQuad(
+                dest,
+                VectorF(region.positionX[i], region.positionY[i], region.positionZ[i]),
+                region.age[i],
+                region.existDuration[i],
+                upVector,
+                rightVector);
+        }
+    }
+}
+
+std::size_t ParticleSystem::size() const
+{
+    std::unique_lock<std::mutex> lockRegions(regionsLock);
+    std::size_t retval = 0;
+    for(const auto &regionPair : regions)
+        retval += std::get<1>(regionPair).size();
+    return retval;
+}
+}
+}
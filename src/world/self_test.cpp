@@ -0,0 +1,1481 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "world/self_test.h"
+#include "world/world.h"
+#include "player/player.h"
+#include "platform/platform.h"
+#include "block/builtin/air.h"
+#include "block/builtin/chest.h"
+#include "block/builtin/plant.h"
+#include "block/builtin/redstone.h"
+#include "block/builtin/sand.h"
+#include "block/builtin/stone.h"
+#include "block/builtin/water.h"
+#include "entity/builtin/falling_block.h"
+#include "entity/builtin/particles/smoke.h"
+#include "item/builtin/dirt.h"
+#include "item/builtin/stone.h"
+#include "util/object_counter.h"
+#include "util/game_version.h"
+#include "world/file_upgrades.h"
+#include "world/view_point.h"
+#include "stream/stream.h"
+#include "util/string_cast.h"
+#include "util/tls.h"
+#include <iostream>
+#include <thread>
+#include <random>
+#include <cstdint>
+#include <chrono>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace
+{
+constexpr World::SeedType selfTestSeed = 12345;
+
+/** @brief make a deterministic world with one player at playerPosition */
+std::shared_ptr<World> makeTestWorld(PositionF playerPosition, WorldLockManager &lock_manager)
+{
+    std::shared_ptr<World> world = std::make_shared<World>(selfTestSeed);
+    std::shared_ptr<Player> player = Player::make(L"self-test-player", nullptr, world);
+    Entities::builtin::PlayerEntity::addToWorld(*world, lock_manager, playerPosition, player);
+    world->setDeterministic(true, lock_manager);
+    return world;
+}
+
+/** @return how many seconds fn took */
+template <typename Fn>
+double timeSeconds(Fn fn)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void stepWorld(World &world, std::size_t stepCount, WorldLockManager &lock_manager)
+{
+    for(std::size_t i = 0; i < stepCount; i++)
+        world.stepDeterministic(lock_manager);
+    lock_manager.clear();
+}
+
+/** @brief make a deterministic world with at least chunkCountXZ by chunkCountXZ chunks around
+ * the origin generated
+ *
+ * World::stepDeterministic waits for the chunks around every player to be generated, so the world
+ * gets a grid of players far enough apart to cover the chunks.
+ */
+std::shared_ptr<World> makeGeneratedTestWorld(std::int32_t chunkCountXZ,
+                                              WorldLockManager &lock_manager)
+{
+    // the chunks within DeterministicSimulationDistance + 2 of each player are generated
+    constexpr std::int32_t playerSpacing = 2 * (World::DeterministicSimulationDistance + 2) + 1;
+    const std::int32_t playerCountXZ = (chunkCountXZ + playerSpacing - 1) / playerSpacing;
+    const std::int32_t firstPlayerChunk = -((playerCountXZ - 1) * playerSpacing) / 2;
+    auto getPlayerPosition = [&](std::int32_t xIndex, std::int32_t zIndex)
+    {
+        return PositionF(
+            (firstPlayerChunk + xIndex * playerSpacing) * BlockChunk::chunkSizeX + 0.5f,
+            World::SeaLevel + 8.5f,
+            (firstPlayerChunk + zIndex * playerSpacing) * BlockChunk::chunkSizeZ + 0.5f,
+            Dimension::Overworld);
+    };
+    std::shared_ptr<World> world = makeTestWorld(getPlayerPosition(0, 0), lock_manager);
+    for(std::int32_t xIndex = 0; xIndex < playerCountXZ; xIndex++)
+    {
+        for(std::int32_t zIndex = 0; zIndex < playerCountXZ; zIndex++)
+        {
+            if(xIndex == 0 && zIndex == 0)
+                continue;
+            std::wstring name =
+                L"self-test-player-" + std::to_wstring(xIndex * playerCountXZ + zIndex);
+            std::shared_ptr<Player> player = Player::make(name, nullptr, world);
+            Entities::builtin::PlayerEntity::addToWorld(
+                *world, lock_manager, getPlayerPosition(xIndex, zIndex), player);
+        }
+    }
+    lock_manager.clear();
+    stepWorld(*world, 1, lock_manager);
+    return world;
+}
+
+/** @return the height of the highest block at x, z that isn't air */
+std::int32_t getSurfaceHeight(World &world,
+                              std::int32_t x,
+                              std::int32_t z,
+                              Dimension d,
+                              WorldLockManager &lock_manager)
+{
+    BlockIterator bi =
+        world.getBlockIterator(PositionI(x, BlockChunk::chunkSizeY - 1, z, d), lock_manager.tls);
+    for(std::int32_t y = BlockChunk::chunkSizeY - 1; y > 0; y--, bi.moveTowardNY(lock_manager))
+    {
+        Block b = bi.get(lock_manager);
+        if(b.good() && b.descriptor != Blocks::builtin::Air::descriptor())
+        {
+            lock_manager.clear();
+            return y;
+        }
+    }
+    lock_manager.clear();
+    return 0;
+}
+
+struct Hasher final
+{
+    std::uint64_t value = 0xCBF29CE484222325ULL;
+    void add(std::uint64_t v)
+    {
+        for(int i = 0; i < 8; i++, v >>= 8)
+        {
+            value ^= v & 0xFF;
+            value *= 0x100000001B3ULL;
+        }
+    }
+};
+
+/** @brief hash the blocks, block data, and pending block updates in a box */
+std::uint64_t hashBlocks(World &world,
+                         PositionI minPosition,
+                         VectorI size,
+                         WorldLockManager &lock_manager)
+{
+    Hasher hasher;
+    BlockIterator bi = world.getBlockIterator(minPosition, lock_manager.tls);
+    for(std::int32_t x = 0; x < size.x; x++)
+    {
+        for(std::int32_t y = 0; y < size.y; y++)
+        {
+            for(std::int32_t z = 0; z < size.z; z++)
+            {
+                bi.moveTo(minPosition + VectorI(x, y, z), lock_manager);
+                Block b = bi.get(lock_manager);
+                hasher.add(reinterpret_cast<std::uintptr_t>(b.descriptor));
+                if(b.good() && b.data != nullptr)
+                {
+                    stream::MemoryWriter dataWriter;
+                    b.descriptor->writeBlockData(dataWriter, b.data);
+                    for(std::uint8_t byte : dataWriter.getBuffer())
+                        hasher.add(byte);
+                }
+                // reading a world can change the order of a block's updates
+                std::uint64_t updatesHash = 0;
+                for(BlockUpdateIterator iter = bi.updatesBegin(lock_manager);
+                    iter != bi.updatesEnd(lock_manager);
+                    ++iter)
+                {
+                    Hasher updateHasher;
+                    updateHasher.add(static_cast<std::uint64_t>(iter->getKind()));
+                    updateHasher.add(static_cast<std::uint64_t>(
+                        static_cast<std::int64_t>(iter->getTimeLeft() * 1000.0f)));
+                    updatesHash += updateHasher.value;
+                }
+                hasher.add(updatesHash);
+            }
+        }
+    }
+    lock_manager.clear();
+    return hasher.value;
+}
+
+/** @brief make a chest block holding itemStack, through the chest's block data reader */
+Block makeChestHolding(ItemStack itemStack)
+{
+    ItemStackArray<9, 3> items;
+    items.itemStacks[0][0] = itemStack;
+    stream::MemoryWriter writer;
+    stream::write<bool>(writer, false);
+    stream::write<ItemStackArray<9, 3>>(writer, items);
+    stream::MemoryReader reader(std::move(writer).getSharedBuffer());
+    BlockDescriptorPointer descriptor = Blocks::builtin::Chest::descriptor();
+    return Block(descriptor, Lighting(), descriptor->readBlockData(reader));
+}
+
+bool checkSnapshotSave(WorldLockManager &lock_manager)
+{
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    PositionI sourcePosition(4, 0, 4, Dimension::Overworld);
+    sourcePosition.y =
+        getSurfaceHeight(*world, sourcePosition.x, sourcePosition.z, sourcePosition.d, lock_manager)
+        + 1;
+    world->setBlock(world->getBlockIterator(sourcePosition, lock_manager.tls),
+                    lock_manager,
+                    Block(Blocks::builtin::Water::descriptor()));
+    // a dropped item is written before the chest's items in the chunk's record, so they have to
+    // share the record's item descriptors
+    ItemDescriptor::addToWorld(*world,
+                               lock_manager,
+                               ItemStack(Item(Items::builtin::Stone::descriptor())),
+                               (PositionF)sourcePosition + VectorF(-1.5f, 0.5f, 0.5f));
+    world->setBlock(
+        world->getBlockIterator(sourcePosition + VectorI(-3, 0, 0), lock_manager.tls),
+        lock_manager,
+        makeChestHolding(ItemStack(Item(Items::builtin::Dirt::descriptor()), 5)));
+    // let the water start flowing, so there are pending block updates when the snapshot is made
+    stepWorld(*world, 20, lock_manager);
+    const PositionI hashedMinPosition = sourcePosition - VectorI(8, 8, 8);
+    const VectorI hashedSize(17, 17, 17);
+    // keep the world paused so nothing changes between the two snapshots
+    world->paused(true, lock_manager);
+    std::uint64_t expectedHash = hashBlocks(*world, hashedMinPosition, hashedSize, lock_manager);
+    std::shared_ptr<World::Snapshot> backgroundSnapshot = world->makeSnapshot(lock_manager);
+    stream::MemoryWriter expectedWriter;
+    world->makeSnapshot(lock_manager)->write(expectedWriter);
+    world->paused(false, lock_manager);
+    stream::MemoryWriter backgroundWriter;
+    std::thread saveThread([&]()
+                           {
+                               backgroundSnapshot->write(backgroundWriter);
+                           });
+    stepWorld(*world, 30, lock_manager);
+    saveThread.join();
+    if(backgroundWriter.getBuffer() != expectedWriter.getBuffer())
+    {
+        std::cout << "the snapshot changed while it was written" << std::endl;
+        return false;
+    }
+    stream::MemoryReader reader(std::move(backgroundWriter).getSharedBuffer());
+    std::shared_ptr<World> readWorld = World::read(reader, true);
+    if(hashBlocks(*readWorld, hashedMinPosition, hashedSize, lock_manager) != expectedHash)
+    {
+        std::cout << "the read world doesn't match the world when the snapshot was made"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** @return the number of sand blocks in the column at x, z */
+std::size_t countSandInColumn(World &world,
+                              std::int32_t x,
+                              std::int32_t z,
+                              WorldLockManager &lock_manager)
+{
+    std::size_t retval = 0;
+    BlockIterator bi = world.getBlockIterator(PositionI(x, 0, z, Dimension::Overworld),
+                                              lock_manager.tls);
+    for(std::int32_t y = 0; y < BlockChunk::chunkSizeY; y++, bi.moveTowardPY(lock_manager))
+    {
+        if(bi.get(lock_manager).descriptor == Blocks::builtin::Sand::descriptor())
+            retval++;
+    }
+    lock_manager.clear();
+    return retval;
+}
+
+/** @brief count the FallingBlockColumn entities in a box, checking their physics boxes
+ *
+ * @param height the number of blocks in each column
+ * @param goodPhysicsBoxes set to false if a column's physics box doesn't fit its blocks
+ */
+std::size_t countFallingColumnsInBox(World &world,
+                                     PositionF minCorner,
+                                     VectorF maxCorner,
+                                     std::size_t height,
+                                     bool &goodPhysicsBoxes,
+                                     WorldLockManager &lock_manager)
+{
+    const VectorF expectedExtents(0.49f, 0.5f * static_cast<float>(height) - 0.01f, 0.49f);
+    std::size_t retval = 0;
+    world.forEachEntityInBox(
+        minCorner,
+        maxCorner,
+        lock_manager,
+        [&](Entity &entity)
+        {
+            if(entity.descriptor != Entities::builtin::FallingBlockColumn::descriptor())
+                return;
+            retval++;
+            if(absSquared(entity.physicsObject->getExtents() - expectedExtents) > 1e-6f)
+                goodPhysicsBoxes = false;
+        });
+    lock_manager.clear();
+    return retval;
+}
+
+/** @brief check that the sand columns under the area from minXZ to minXZ + areaSize all fell and
+ * kept their sand
+ */
+bool checkSandColumnsFell(World &world,
+                          std::int32_t minXZ,
+                          std::int32_t areaSize,
+                          std::int32_t supportHeight,
+                          const std::vector<std::size_t> &expectedSandCounts,
+                          WorldLockManager &lock_manager)
+{
+    std::size_t columnIndex = 0;
+    for(std::int32_t x = minXZ; x < minXZ + areaSize; x++)
+    {
+        for(std::int32_t z = minXZ; z < minXZ + areaSize; z++)
+        {
+            BlockIterator bi = world.getBlockIterator(
+                PositionI(x, supportHeight + 1, z, Dimension::Overworld), lock_manager.tls);
+            bool fell = bi.get(lock_manager).descriptor == Blocks::builtin::Air::descriptor();
+            lock_manager.clear();
+            if(!fell)
+            {
+                std::cout << "the sand at " << x << " " << z << " didn't fall" << std::endl;
+                return false;
+            }
+            if(countSandInColumn(world, x, z, lock_manager) != expectedSandCounts[columnIndex++])
+            {
+                std::cout << "the column at " << x << " " << z << " didn't keep all its sand"
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** @brief remove the blocks under a 64 by 64 area of sand in the sky
+ *
+ * @param inView if a ViewPoint is near the area, so the sand falls as FallingBlockColumn entities
+ * instead of landing at once. The columns are then checked while they fall, saved and read back,
+ * and both worlds are stepped until every column lands.
+ */
+bool undermineSand(bool inView, WorldLockManager &lock_manager)
+{
+    constexpr std::int32_t areaSize = 64;
+    constexpr std::int32_t minXZ = -areaSize / 2;
+    constexpr std::int32_t supportHeight = World::SeaLevel + 100;
+    constexpr std::int32_t sandDepth = 3;
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    std::vector<std::size_t> expectedSandCounts;
+    expectedSandCounts.reserve(areaSize * areaSize);
+    for(std::int32_t x = minXZ; x < minXZ + areaSize; x++)
+    {
+        for(std::int32_t z = minXZ; z < minXZ + areaSize; z++)
+        {
+            expectedSandCounts.push_back(countSandInColumn(*world, x, z, lock_manager)
+                                         + sandDepth);
+            BlockIterator bi = world->getBlockIterator(
+                PositionI(x, supportHeight, z, Dimension::Overworld), lock_manager.tls);
+            world->setBlock(bi, lock_manager, Block(Blocks::builtin::Stone::descriptor()));
+            for(std::int32_t y = 0; y < sandDepth; y++)
+            {
+                bi.moveTowardPY(lock_manager);
+                world->setBlock(bi, lock_manager, Block(Blocks::builtin::Sand::descriptor()));
+            }
+        }
+    }
+    stepWorld(*world, 1, lock_manager);
+    std::unique_ptr<ViewPoint> viewPoint;
+    if(inView)
+    {
+        // every corner of the area is within the default view distance
+        viewPoint.reset(new ViewPoint(
+            *world, PositionF(0.5f, supportHeight + 0.5f, 0.5f, Dimension::Overworld)));
+    }
+    for(std::int32_t x = minXZ; x < minXZ + areaSize; x++)
+    {
+        for(std::int32_t z = minXZ; z < minXZ + areaSize; z++)
+        {
+            world->setBlock(world->getBlockIterator(
+                                PositionI(x, supportHeight, z, Dimension::Overworld),
+                                lock_manager.tls),
+                            lock_manager,
+                            Block(Blocks::builtin::Air::descriptor()));
+        }
+    }
+    if(!inView)
+    {
+        stepWorld(*world, 300, lock_manager);
+        return checkSandColumnsFell(
+            *world, minXZ, areaSize, supportHeight, expectedSandCounts, lock_manager);
+    }
+    const std::size_t columnCount = areaSize * areaSize;
+    const PositionF columnBoxMinCorner(minXZ - 1, 0, minXZ - 1, Dimension::Overworld);
+    const VectorF columnBoxMaxCorner(
+        minXZ + areaSize + 1, supportHeight + sandDepth + 2, minXZ + areaSize + 1);
+    stepWorld(*world, 10, lock_manager);
+    world->paused(true, lock_manager);
+    bool goodPhysicsBoxes = true;
+    if(countFallingColumnsInBox(*world,
+                                columnBoxMinCorner,
+                                columnBoxMaxCorner,
+                                sandDepth,
+                                goodPhysicsBoxes,
+                                lock_manager)
+       != columnCount)
+    {
+        std::cout << "the sand in view didn't fall as one column entity per column" << std::endl;
+        return false;
+    }
+    if(!goodPhysicsBoxes)
+    {
+        std::cout << "a falling column's physics box doesn't fit its blocks" << std::endl;
+        return false;
+    }
+    // save the columns while they fall, so they're read back as entities
+    stream::MemoryWriter writer;
+    world->write(writer, lock_manager);
+    lock_manager.clear();
+    world->paused(false, lock_manager);
+    stream::MemoryReader reader(std::move(writer).getSharedBuffer());
+    std::shared_ptr<World> readWorld = World::read(reader, true);
+    if(countFallingColumnsInBox(*readWorld,
+                                columnBoxMinCorner,
+                                columnBoxMaxCorner,
+                                sandDepth,
+                                goodPhysicsBoxes,
+                                lock_manager)
+       != columnCount
+       || !goodPhysicsBoxes)
+    {
+        std::cout << "the falling columns weren't read back" << std::endl;
+        return false;
+    }
+    for(World *steppedWorld : {world.get(), readWorld.get()})
+    {
+        const char *what = steppedWorld == world.get() ? "" : " in the world read back";
+        // the sand falls about 100 blocks, which takes a few seconds
+        for(std::size_t second = 0;; second++)
+        {
+            if(second >= 30)
+            {
+                std::cout << "the falling columns" << what << " didn't land" << std::endl;
+                return false;
+            }
+            stepWorld(*steppedWorld, World::DeterministicStepsPerSecond, lock_manager);
+            if(countFallingColumnsInBox(*steppedWorld,
+                                        columnBoxMinCorner,
+                                        columnBoxMaxCorner,
+                                        sandDepth,
+                                        goodPhysicsBoxes,
+                                        lock_manager)
+               == 0)
+                break;
+        }
+        if(!checkSandColumnsFell(
+               *steppedWorld, minXZ, areaSize, supportHeight, expectedSandCounts, lock_manager))
+        {
+            if(steppedWorld != world.get())
+                std::cout << "the column was in the world read back" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkUndermineSand(WorldLockManager &lock_manager)
+{
+    return undermineSand(false, lock_manager);
+}
+
+bool checkUndermineSandInView(WorldLockManager &lock_manager)
+{
+    return undermineSand(true, lock_manager);
+}
+
+/** @brief flood a stone basin in the sky from two opposite corners
+ *
+ * @return the basin's water after it stops flowing, one block descriptor per block of its inside
+ */
+std::vector<BlockDescriptorPointer> floodBasin(bool batched, WorldLockManager &lock_manager)
+{
+    constexpr std::int32_t insideSize = 12;
+    constexpr std::int32_t floorHeight = World::SeaLevel + 100;
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    world->setBlockUpdateBatchesEnabled(batched);
+    stepWorld(*world, 1, lock_manager);
+    auto setBlock = [&](std::int32_t x, std::int32_t y, std::int32_t z, Block block)
+    {
+        world->setBlock(
+            world->getBlockIterator(PositionI(x, y, z, Dimension::Overworld), lock_manager.tls),
+            lock_manager,
+            std::move(block));
+    };
+    for(std::int32_t x = -1; x <= insideSize; x++)
+    {
+        for(std::int32_t z = -1; z <= insideSize; z++)
+        {
+            setBlock(x, floorHeight, z, Block(Blocks::builtin::Stone::descriptor()));
+            bool isWall = x < 0 || z < 0 || x >= insideSize || z >= insideSize;
+            // a pillar in the middle, so the water flows around it
+            bool isPillar = x >= 5 && x < 7 && z >= 4 && z < 8;
+            if(isWall || isPillar)
+                setBlock(x, floorHeight + 1, z, Block(Blocks::builtin::Stone::descriptor()));
+        }
+    }
+    setBlock(0, floorHeight + 1, 0, Block(Blocks::builtin::Water::descriptor()));
+    setBlock(insideSize - 1,
+             floorHeight + 1,
+             insideSize - 1,
+             Block(Blocks::builtin::Water::descriptor()));
+    stepWorld(*world, 600, lock_manager);
+    std::vector<BlockDescriptorPointer> retval;
+    retval.reserve(insideSize * insideSize);
+    BlockIterator bi = world->getBlockIterator(
+        PositionI(0, floorHeight + 1, 0, Dimension::Overworld), lock_manager.tls);
+    for(std::int32_t x = 0; x < insideSize; x++)
+    {
+        for(std::int32_t z = 0; z < insideSize; z++)
+        {
+            bi.moveTo(PositionI(x, floorHeight + 1, z, Dimension::Overworld), lock_manager);
+            retval.push_back(bi.get(lock_manager).descriptor);
+        }
+    }
+    lock_manager.clear();
+    return retval;
+}
+
+bool checkFloodBasin(WorldLockManager &lock_manager)
+{
+    std::vector<BlockDescriptorPointer> batchedBlocks = floodBasin(true, lock_manager);
+    std::vector<BlockDescriptorPointer> perBlockBlocks = floodBasin(false, lock_manager);
+    std::size_t waterCount = 0;
+    for(BlockDescriptorPointer descriptor : perBlockBlocks)
+    {
+        if(Blocks::builtin::Fluid::fromDescriptor(descriptor) != nullptr)
+            waterCount++;
+    }
+    if(waterCount <= 2)
+    {
+        std::cout << "the water didn't flow" << std::endl;
+        return false;
+    }
+    if(batchedBlocks != perBlockBlocks)
+    {
+        std::cout << "the batched fluid simulation doesn't match Fluid::tick" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** @return the number of entities with descriptor in the box from minCorner to maxCorner */
+std::size_t countEntitiesInBox(World &world,
+                               PositionF minCorner,
+                               VectorF maxCorner,
+                               EntityDescriptorPointer descriptor,
+                               WorldLockManager &lock_manager)
+{
+    std::size_t retval = 0;
+    world.forEachEntityInBox(minCorner,
+                             maxCorner,
+                             lock_manager,
+                             [&](Entity &entity)
+                             {
+                                 if(entity.descriptor == descriptor)
+                                     retval++;
+                             });
+    lock_manager.clear();
+    return retval;
+}
+
+bool checkItemPit(WorldLockManager &lock_manager)
+{
+    constexpr std::size_t itemCount = 10000;
+    constexpr std::int32_t floorHeight = World::SeaLevel + 100;
+    constexpr double simulatedSeconds = 5;
+    const PositionI pitPosition(8, floorHeight + 1, 8, Dimension::Overworld);
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    // a one block pit, so every item ends up within EntityItem::mergeDistance of the others
+    for(std::int32_t x = -1; x <= 1; x++)
+    {
+        for(std::int32_t z = -1; z <= 1; z++)
+        {
+            BlockIterator bi =
+                world->getBlockIterator(pitPosition + VectorI(x, -1, z), lock_manager.tls);
+            world->setBlock(bi, lock_manager, Block(Blocks::builtin::Stone::descriptor()));
+            for(std::int32_t y = 0; y < 8; y++)
+            {
+                bi.moveTowardPY(lock_manager);
+                if(x != 0 || z != 0)
+                    world->setBlock(bi, lock_manager, Block(Blocks::builtin::Stone::descriptor()));
+            }
+        }
+    }
+    stepWorld(*world, 1, lock_manager);
+    std::size_t startPhysicsObjectCount = ObjectCounter<PhysicsObject, 0>::count();
+    std::minstd_rand randomGenerator(selfTestSeed);
+    std::uniform_real_distribution<float> xzDistribution(0.3f, 0.7f);
+    std::uniform_real_distribution<float> yDistribution(0.5f, 7.5f);
+    ItemStack itemStack(Item(Items::builtin::Dirt::descriptor()));
+    for(std::size_t i = 0; i < itemCount; i++)
+    {
+        float x = xzDistribution(randomGenerator);
+        float y = yDistribution(randomGenerator);
+        float z = xzDistribution(randomGenerator);
+        PositionF position((VectorF)pitPosition + VectorF(x, y, z), pitPosition.d);
+        ItemDescriptor::addToWorld(*world, lock_manager, itemStack, position);
+    }
+    lock_manager.clear();
+    const PositionF minCorner((VectorF)pitPosition - VectorF(1), pitPosition.d);
+    const VectorF maxCorner = (VectorF)pitPosition + VectorF(2, 9, 2);
+    EntityDescriptorPointer itemEntityDescriptor =
+        Items::builtin::Dirt::descriptor()->getEntity();
+    std::size_t droppedCount =
+        countEntitiesInBox(*world, minCorner, maxCorner, itemEntityDescriptor, lock_manager);
+    if(droppedCount != itemCount)
+    {
+        std::cout << "only " << droppedCount << " of " << itemCount << " items were dropped"
+                  << std::endl;
+        return false;
+    }
+    stepWorld(*world,
+              static_cast<std::size_t>(simulatedSeconds * World::DeterministicStepsPerSecond),
+              lock_manager);
+    std::size_t stackCount = (itemCount + itemStack.getMaxCount() - 1) / itemStack.getMaxCount();
+    // merges happen pairwise, so allow some stacks that aren't full
+    std::size_t maxEntityCount = stackCount * 2;
+    std::size_t entityCount =
+        countEntitiesInBox(*world, minCorner, maxCorner, itemEntityDescriptor, lock_manager);
+    std::size_t physicsObjectCount = ObjectCounter<PhysicsObject, 0>::count();
+    std::cout << itemCount << " items merged into " << entityCount << " entities, "
+              << physicsObjectCount - startPhysicsObjectCount << " new physics objects"
+              << std::endl;
+    if(entityCount == 0 || entityCount > maxEntityCount)
+    {
+        std::cout << "expected at most " << maxEntityCount << " item entities" << std::endl;
+        return false;
+    }
+    if(physicsObjectCount > startPhysicsObjectCount + maxEntityCount)
+    {
+        std::cout << "the merged items' physics objects weren't destroyed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::uint8_t> readWholeUserSpecificFile(const std::wstring &fileName)
+{
+    std::shared_ptr<stream::Reader> preader = readUserSpecificFile(fileName);
+    preader->seek(0, stream::SeekPosition::End);
+    std::size_t size = static_cast<std::size_t>(preader->tell());
+    preader->seek(0, stream::SeekPosition::Start);
+    stream::SharedBytes bytes = preader->readSharedBytes(size);
+    return std::vector<std::uint8_t>(bytes.data(), bytes.data() + bytes.size());
+}
+
+void writeWholeUserSpecificFile(const std::wstring &fileName,
+                                const std::vector<std::uint8_t> &bytes)
+{
+    std::shared_ptr<stream::Writer> pwriter = createOrWriteUserSpecificFile(fileName);
+    pwriter->writeBytes(bytes.data(), bytes.size());
+    pwriter->sync();
+}
+
+bool checkWorldFileFaults(WorldLockManager &lock_manager)
+{
+    const std::wstring fileName = L"self-test-world.vw";
+    const std::wstring journalFileName = World::FileAppendJournal::getFileName(fileName);
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    const PositionI corruptedChunkBasePosition =
+        BlockChunk::getChunkBasePosition((PositionI)playerPosition);
+    const PositionI otherChunkBasePosition =
+        corruptedChunkBasePosition + VectorI(BlockChunk::chunkSizeX, 0, 0);
+    std::minstd_rand randomGenerator(selfTestSeed);
+    World::FileChunkIndex index;
+    std::vector<std::uint8_t> fileBytes;
+    std::vector<std::uint8_t> appendBytes;
+    {
+        std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+        stepWorld(*world, 1, lock_manager);
+        stream::MemoryWriter fileWriter;
+        index = world->makeSnapshot(lock_manager)->write(fileWriter);
+        fileBytes = fileWriter.getBuffer();
+        world->setBlock(world->getBlockIterator(PositionI(corruptedChunkBasePosition.x,
+                                                          World::SeaLevel + 100,
+                                                          corruptedChunkBasePosition.z,
+                                                          corruptedChunkBasePosition.d),
+                                                lock_manager.tls),
+                        lock_manager,
+                        Block(Blocks::builtin::Stone::descriptor()));
+        stream::MemoryWriter appendWriter;
+        world->makeSnapshot(lock_manager, &index)->append(appendWriter, index);
+        appendBytes = appendWriter.getBuffer();
+    }
+    auto recordIter = index.records.find(corruptedChunkBasePosition);
+    if(recordIter == index.records.end() || index.records.count(otherChunkBasePosition) == 0)
+    {
+        std::cout << "the saved world is missing chunks" << std::endl;
+        return false;
+    }
+    const World::FileChunkIndex::Record record = std::get<1>(*recordIter);
+    constexpr std::size_t corruptionCount = 4;
+    for(std::size_t i = 0; i < corruptionCount; i++)
+    {
+        std::vector<std::uint8_t> corruptedBytes = fileBytes;
+        std::size_t offset = static_cast<std::size_t>(
+            record.offset
+            + std::uniform_int_distribution<std::uint64_t>(0, record.size - 1)(randomGenerator));
+        corruptedBytes[offset] ^= static_cast<std::uint8_t>(
+            std::uniform_int_distribution<unsigned>(1, 0xFF)(randomGenerator));
+        {
+            // a full save loads the corrupted chunk itself; it must not write it as empty blocks
+            std::shared_ptr<World> world = World::readLazily(
+                std::make_shared<stream::MemoryReader>(corruptedBytes), nullptr, true);
+            stream::MemoryWriter rewrittenFileWriter;
+            World::FileChunkIndex rewrittenIndex =
+                world->makeSnapshot(lock_manager)->write(rewrittenFileWriter);
+            if(rewrittenIndex.records.count(corruptedChunkBasePosition) != 0)
+            {
+                std::cout << "a full save wrote the chunk record corrupted at " << offset
+                          << std::endl;
+                return false;
+            }
+            stream::MemoryReader rewrittenReader(std::move(rewrittenFileWriter).getSharedBuffer());
+            if(World::read(rewrittenReader, true)->loadChunk(corruptedChunkBasePosition,
+                                                             lock_manager))
+            {
+                std::cout << "the full save of the chunk record corrupted at " << offset
+                          << " was read back as a generated chunk" << std::endl;
+                return false;
+            }
+        }
+        World::FileChunkIndex corruptedIndex;
+        std::shared_ptr<World> world = World::readLazily(
+            std::make_shared<stream::MemoryReader>(corruptedBytes), &corruptedIndex, true);
+        if(world->loadChunk(corruptedChunkBasePosition, lock_manager))
+        {
+            std::cout << "the chunk record corrupted at " << offset << " was read" << std::endl;
+            return false;
+        }
+        if(!world->loadChunk(otherChunkBasePosition, lock_manager))
+        {
+            std::cout << "corrupting the chunk record at " << offset
+                      << " broke another chunk record" << std::endl;
+            return false;
+        }
+        // steps wait for the chunks around the player to be generated
+        stepWorld(*world, 1, lock_manager);
+        if(!world->loadChunk(corruptedChunkBasePosition, lock_manager))
+        {
+            std::cout << "the chunk record corrupted at " << offset << " wasn't regenerated"
+                      << std::endl;
+            return false;
+        }
+        stream::MemoryWriter appendedFileWriter;
+        appendedFileWriter.writeBytes(corruptedBytes.data(), corruptedBytes.size());
+        World::FileChunkIndex appendedIndex =
+            world->makeSnapshot(lock_manager, &corruptedIndex)
+                ->append(appendedFileWriter, corruptedIndex);
+        auto appendedRecordIter = appendedIndex.records.find(corruptedChunkBasePosition);
+        if(appendedRecordIter == appendedIndex.records.end()
+           || std::get<1>(*appendedRecordIter).offset < corruptedBytes.size())
+        {
+            std::cout << "the regenerated chunk isn't saved over the record corrupted at "
+                      << offset << std::endl;
+            return false;
+        }
+    }
+    for(std::size_t i = 0; i < corruptionCount; i++)
+    {
+        std::vector<std::uint8_t> truncatedBytes(
+            fileBytes.begin(),
+            fileBytes.begin()
+                + std::uniform_int_distribution<std::size_t>(0, fileBytes.size() - 1)(
+                      randomGenerator));
+        stream::MemoryReader reader(std::move(truncatedBytes));
+        try
+        {
+            World::read(reader, true);
+            std::cout << "a truncated world file was read" << std::endl;
+            return false;
+        }
+        catch(stream::IOException &)
+        {
+        }
+    }
+    // a save that crashed partway through appending leaves a journal and some of the new records
+    for(std::size_t i = 0; i < corruptionCount; i++)
+    {
+        writeWholeUserSpecificFile(fileName, fileBytes);
+        {
+            std::shared_ptr<stream::Writer> pwriter =
+                createOrWriteUserSpecificFile(journalFileName);
+            World::FileAppendJournal(fileBytes.size()).write(*pwriter);
+            pwriter->sync();
+        }
+        {
+            std::shared_ptr<stream::Writer> pwriter = appendUserSpecificFile(fileName);
+            pwriter->writeBytes(
+                appendBytes.data(),
+                std::uniform_int_distribution<std::size_t>(1, appendBytes.size() - 1)(
+                    randomGenerator));
+            pwriter->sync();
+        }
+        World::FileAppendJournal::rollBackInterruptedAppend(fileName);
+        if(readWholeUserSpecificFile(fileName) != fileBytes)
+        {
+            std::cout << "the interrupted append wasn't rolled back" << std::endl;
+            return false;
+        }
+        if(removeUserSpecificFile(journalFileName))
+        {
+            std::cout << "the journal wasn't removed" << std::endl;
+            return false;
+        }
+    }
+    World::read(*readUserSpecificFile(fileName), true);
+    removeUserSpecificFile(fileName);
+    return true;
+}
+
+bool checkFileVersions(WorldLockManager &lock_manager)
+{
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    PositionI sourcePosition(4, 0, 4, Dimension::Overworld);
+    sourcePosition.y =
+        getSurfaceHeight(*world, sourcePosition.x, sourcePosition.z, sourcePosition.d, lock_manager)
+        + 1;
+    world->setBlock(world->getBlockIterator(sourcePosition, lock_manager.tls),
+                    lock_manager,
+                    Block(Blocks::builtin::Water::descriptor()));
+    ItemDescriptor::addToWorld(*world,
+                               lock_manager,
+                               ItemStack(Item(Items::builtin::Stone::descriptor()), 3),
+                               (PositionF)sourcePosition + VectorF(-1.5f, 0.5f, 0.5f));
+    world->setBlock(
+        world->getBlockIterator(sourcePosition + VectorI(-3, 0, 0), lock_manager.tls),
+        lock_manager,
+        makeChestHolding(ItemStack(Item(Items::builtin::Dirt::descriptor()), 5)));
+    // let the item land and the water start flowing, so there are pending block updates
+    stepWorld(*world, 20, lock_manager);
+    const PositionI hashedMinPosition = sourcePosition - VectorI(8, 8, 8);
+    const VectorI hashedSize(17, 17, 17);
+    const PositionF entityBoxMinCorner = (PositionF)hashedMinPosition;
+    const VectorF entityBoxMaxCorner = (VectorF)(hashedMinPosition + hashedSize);
+    const EntityDescriptorPointer itemEntityDescriptor =
+        Items::builtin::Stone::descriptor()->getEntity();
+    world->paused(true, lock_manager);
+    const std::uint64_t expectedHash =
+        hashBlocks(*world, hashedMinPosition, hashedSize, lock_manager);
+    const std::size_t expectedItemCount = countEntitiesInBox(
+        *world, entityBoxMinCorner, entityBoxMaxCorner, itemEntityDescriptor, lock_manager);
+    if(expectedItemCount != 1)
+    {
+        std::cout << "the dropped item isn't in the checked box" << std::endl;
+        return false;
+    }
+    // every version the reader supports is written by the writer of that version's layout, then
+    // read back, then written again in the current version and read back again
+    for(std::uint32_t fileVersion = FileUpgrades::MinimumFileVersion;
+        fileVersion <= GameVersion::FILE_VERSION;
+        fileVersion++)
+    {
+        stream::MemoryWriter writer;
+        world->write(writer,
+                     lock_manager,
+                     World::SaveOptions(World::SaveOptions::Codec::Deflate,
+                                        stream::CompressWriter::DefaultLevel,
+                                        0,
+                                        fileVersion));
+        lock_manager.clear();
+        std::vector<std::uint8_t> fileBytes = std::move(writer).getBuffer();
+        for(int pass = 0; pass < 2; pass++)
+        {
+            stream::MemoryReader reader(fileBytes);
+            std::shared_ptr<World> readWorld = World::read(reader, true);
+            readWorld->paused(true, lock_manager);
+            const char *what = pass == 0 ? "" : " after upgrading it";
+            if(hashBlocks(*readWorld, hashedMinPosition, hashedSize, lock_manager)
+               != expectedHash)
+            {
+                std::cout << "the blocks read from a version " << fileVersion << " file" << what
+                          << " don't match" << std::endl;
+                return false;
+            }
+            if(countEntitiesInBox(*readWorld,
+                                  entityBoxMinCorner,
+                                  entityBoxMaxCorner,
+                                  itemEntityDescriptor,
+                                  lock_manager)
+               != expectedItemCount)
+            {
+                std::cout << "the entities read from a version " << fileVersion << " file"
+                          << what << " don't match" << std::endl;
+                return false;
+            }
+            stream::MemoryWriter upgradedWriter;
+            readWorld->write(upgradedWriter, lock_manager);
+            lock_manager.clear();
+            fileBytes = std::move(upgradedWriter).getBuffer();
+        }
+    }
+    world->paused(false, lock_manager);
+    return true;
+}
+
+bool checkParticleStep(WorldLockManager &lock_manager)
+{
+    constexpr std::size_t particleCount = 100000;
+    constexpr std::size_t stepCount = 60;
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    world->paused(true, lock_manager);
+    // a separate particle system, so only the timed steps move the particles
+    ParticleSystem particles;
+    std::minstd_rand randomGenerator(selfTestSeed);
+    std::uniform_real_distribution<float> xzDistribution(-24.0f, 24.0f);
+    std::uniform_real_distribution<float> yDistribution(World::SeaLevel + 8.0f,
+                                                        World::SeaLevel + 40.0f);
+    ParticleBatch batch;
+    double stepSeconds = 0;
+    std::size_t steppedParticleCount = 0;
+    for(std::size_t step = 0; step < stepCount; step++)
+    {
+        // keep the particle count up as the particles expire
+        for(std::size_t i = particles.size(); i < particleCount; i++)
+        {
+            Entities::builtin::particles::Smoke::addToBatch(
+                *world,
+                batch,
+                PositionF(xzDistribution(randomGenerator),
+                          yDistribution(randomGenerator),
+                          xzDistribution(randomGenerator),
+                          Dimension::Overworld));
+        }
+        particles.addBatch(batch, *world);
+        stepSeconds += timeSeconds(
+            [&]()
+            {
+                particles.step(*world, lock_manager, 1.0 / World::DeterministicStepsPerSecond);
+            });
+        lock_manager.clear();
+        steppedParticleCount += particles.size();
+        // no smoke particle expires in its first step
+        if(step == 0 && particles.size() != particleCount)
+        {
+            std::cout << "the first step lost particles: " << particles.size() << " of "
+                      << particleCount << " are left" << std::endl;
+            return false;
+        }
+    }
+    world->paused(false, lock_manager);
+    std::cout << "stepping " << particleCount << " particles took "
+              << stepSeconds * 1e3 / stepCount << " ms per step, "
+              << stepSeconds * 1e9 / steppedParticleCount << " ns per particle" << std::endl;
+    return true;
+}
+
+bool checkWorldSaveFormat(WorldLockManager &lock_manager)
+{
+    constexpr std::int32_t chunkCountXZ = 32;
+    constexpr std::uint32_t oldFileVersion = 7; // chunk records without subchunk palettes
+    std::shared_ptr<World> world = makeGeneratedTestWorld(chunkCountXZ, lock_manager);
+    world->paused(true, lock_manager);
+    const PositionI hashedMinPosition(-8, World::SeaLevel - 8, -8, Dimension::Overworld);
+    const VectorI hashedSize(16, 16, 16);
+    const std::uint64_t expectedHash =
+        hashBlocks(*world, hashedMinPosition, hashedSize, lock_manager);
+    for(std::uint32_t fileVersion : {oldFileVersion, GameVersion::FILE_VERSION})
+    {
+        stream::MemoryWriter writer;
+        const double saveSeconds = timeSeconds(
+            [&]()
+            {
+                world->write(writer,
+                             lock_manager,
+                             World::SaveOptions(World::SaveOptions::Codec::Deflate,
+                                                stream::CompressWriter::DefaultLevel,
+                                                0,
+                                                fileVersion));
+            });
+        lock_manager.clear();
+        const std::size_t fileSize = writer.getBuffer().size();
+        stream::MemoryReader reader(std::move(writer).getSharedBuffer());
+        std::shared_ptr<World> readWorld;
+        World::FileChunkIndex index;
+        const double loadSeconds = timeSeconds(
+            [&]()
+            {
+                readWorld = World::read(reader, true, &index);
+            });
+        if(index.records.size()
+           < static_cast<std::size_t>(chunkCountXZ) * static_cast<std::size_t>(chunkCountXZ))
+        {
+            std::cout << "only " << index.records.size() << " chunks were generated" << std::endl;
+            return false;
+        }
+        if(hashBlocks(*readWorld, hashedMinPosition, hashedSize, lock_manager) != expectedHash)
+        {
+            std::cout << "the blocks read from the version " << fileVersion
+                      << " file don't match" << std::endl;
+            return false;
+        }
+        std::cout << "version " << fileVersion << ": " << index.records.size() << " chunks in "
+                  << fileSize << " bytes, saved in " << saveSeconds * 1e3 << " ms, loaded in "
+                  << loadSeconds * 1e3 << " ms" << std::endl;
+    }
+    world->paused(false, lock_manager);
+    return true;
+}
+
+bool checkWorldSaveThroughput(WorldLockManager &lock_manager)
+{
+    // stream::write<T> and stream::read<T> through stored deflate blocks, so the stream layer is
+    // what's timed instead of zlib
+    constexpr std::size_t valueCount = 1 << 22;
+    constexpr std::size_t valueSize = sizeof(std::uint32_t) + sizeof(float) + sizeof(std::uint8_t);
+    stream::MemoryWriter compressedWriter;
+    const double writeSeconds = timeSeconds(
+        [&]()
+        {
+            stream::CompressWriter writer(compressedWriter, stream::CompressWriter::MinLevel);
+            for(std::size_t i = 0; i < valueCount; i++)
+            {
+                stream::write<std::uint32_t>(writer, static_cast<std::uint32_t>(i * 2654435761U));
+                stream::write<float32_t>(writer, static_cast<float>(i) * 0.5f);
+                stream::write<std::uint8_t>(writer, static_cast<std::uint8_t>(i));
+            }
+            writer.flush();
+        });
+    bool valuesMatch = true;
+    auto compressedReader =
+        std::make_shared<stream::MemoryReader>(std::move(compressedWriter).getSharedBuffer());
+    const double readSeconds = timeSeconds(
+        [&]()
+        {
+            stream::ExpandReader reader(compressedReader);
+            for(std::size_t i = 0; i < valueCount; i++)
+            {
+                std::uint32_t expectedInteger = static_cast<std::uint32_t>(i * 2654435761U);
+                if(stream::read<std::uint32_t>(reader) != expectedInteger
+                   || stream::read<float32_t>(reader) != static_cast<float>(i) * 0.5f
+                   || stream::read<std::uint8_t>(reader) != static_cast<std::uint8_t>(i))
+                    valuesMatch = false;
+            }
+        });
+    if(!valuesMatch)
+    {
+        std::cout << "the values read back through the compressed streams don't match"
+                  << std::endl;
+        return false;
+    }
+    const double valueMegabytes = static_cast<double>(valueCount * valueSize) / 1e6;
+    std::cout << "stream values: written at " << valueMegabytes / writeSeconds << " MB/s, read at "
+              << valueMegabytes / readSeconds << " MB/s" << std::endl;
+    // whole world saves and loads, uncompressed and on one thread for the same reason
+    constexpr std::size_t repeatCount = 3;
+    std::shared_ptr<World> world = makeGeneratedTestWorld(16, lock_manager);
+    world->paused(true, lock_manager);
+    const World::SaveOptions options(
+        World::SaveOptions::Codec::Uncompressed, stream::CompressWriter::MinLevel, 1);
+    double saveSeconds = 0, loadSeconds = 0;
+    std::size_t fileSize = 0;
+    for(std::size_t i = 0; i < repeatCount; i++)
+    {
+        stream::MemoryWriter writer;
+        saveSeconds += timeSeconds(
+            [&]()
+            {
+                world->write(writer, lock_manager, options);
+            });
+        lock_manager.clear();
+        if(i != 0 && writer.getBuffer().size() != fileSize)
+        {
+            std::cout << "saving the paused world twice gave different sizes" << std::endl;
+            return false;
+        }
+        fileSize = writer.getBuffer().size();
+        stream::MemoryReader reader(std::move(writer).getSharedBuffer());
+        std::shared_ptr<World> readWorld;
+        loadSeconds += timeSeconds(
+            [&]()
+            {
+                readWorld = World::read(reader, true);
+            });
+    }
+    world->paused(false, lock_manager);
+    const double fileMegabytes = static_cast<double>(fileSize * repeatCount) / 1e6;
+    std::cout << "world file of " << fileSize << " bytes: saved at " << fileMegabytes / saveSeconds
+              << " MB/s, loaded at " << fileMegabytes / loadSeconds << " MB/s" << std::endl;
+    return true;
+}
+
+bool checkEntityQueries(WorldLockManager &lock_manager)
+{
+    constexpr std::size_t itemCount = 50000;
+    constexpr std::size_t queryCount = 10000;
+    constexpr float queryRadius = 3;
+    constexpr float areaHalfSize = 40;
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    // items only merge when they're stepped, so they stay apart while the world is paused
+    world->paused(true, lock_manager);
+    std::minstd_rand randomGenerator(selfTestSeed);
+    std::uniform_real_distribution<float> xzDistribution(-areaHalfSize, areaHalfSize);
+    std::uniform_real_distribution<float> yDistribution(World::SeaLevel + 60.0f,
+                                                        World::SeaLevel + 76.0f);
+    const EntityDescriptorPointer itemEntityDescriptor =
+        Items::builtin::Stone::descriptor()->getEntity();
+    for(std::size_t i = 0; i < itemCount; i++)
+    {
+        ItemDescriptor::addToWorld(*world,
+                                   lock_manager,
+                                   ItemStack(Item(Items::builtin::Stone::descriptor())),
+                                   PositionF(xzDistribution(randomGenerator),
+                                             yDistribution(randomGenerator),
+                                             xzDistribution(randomGenerator),
+                                             Dimension::Overworld));
+    }
+    lock_manager.clear();
+    const PositionF areaMinCorner(
+        -areaHalfSize - 1, World::SeaLevel + 59.0f, -areaHalfSize - 1, Dimension::Overworld);
+    const VectorF areaMaxCorner(areaHalfSize + 1, World::SeaLevel + 77.0f, areaHalfSize + 1);
+    std::vector<VectorF> itemPositions;
+    world->forEachEntityInBox(areaMinCorner,
+                              areaMaxCorner,
+                              lock_manager,
+                              [&](Entity &entity)
+                              {
+                                  if(entity.descriptor == itemEntityDescriptor)
+                                      itemPositions.push_back(
+                                          (VectorF)entity.physicsObject->getPosition());
+                              });
+    lock_manager.clear();
+    if(itemPositions.size() != itemCount)
+    {
+        std::cout << "found " << itemPositions.size() << " of " << itemCount << " items"
+                  << std::endl;
+        return false;
+    }
+    std::vector<PositionF> queryCenters;
+    queryCenters.reserve(queryCount);
+    for(std::size_t i = 0; i < queryCount; i++)
+    {
+        queryCenters.push_back(PositionF(xzDistribution(randomGenerator),
+                                         yDistribution(randomGenerator),
+                                         xzDistribution(randomGenerator),
+                                         Dimension::Overworld));
+    }
+    std::vector<std::size_t> queryResults(queryCount, 0);
+    const double querySeconds = timeSeconds(
+        [&]()
+        {
+            for(std::size_t i = 0; i < queryCount; i++)
+            {
+                world->forEachEntityInSphere(queryCenters[i],
+                                             queryRadius,
+                                             lock_manager,
+                                             [&](Entity &entity)
+                                             {
+                                                 if(entity.descriptor == itemEntityDescriptor)
+                                                     queryResults[i]++;
+                                             });
+            }
+            lock_manager.clear();
+        });
+    // the same queries by checking every item, to check the results and compare the times
+    std::vector<std::size_t> expectedResults(queryCount, 0);
+    const double scanSeconds = timeSeconds(
+        [&]()
+        {
+            for(std::size_t i = 0; i < queryCount; i++)
+            {
+                VectorF center = (VectorF)queryCenters[i];
+                for(VectorF position : itemPositions)
+                {
+                    if(absSquared(position - center) <= queryRadius * queryRadius)
+                        expectedResults[i]++;
+                }
+            }
+        });
+    world->paused(false, lock_manager);
+    if(queryResults != expectedResults)
+    {
+        std::cout << "the sphere queries don't match checking every item" << std::endl;
+        return false;
+    }
+    std::cout << queryCount << " sphere queries over " << itemCount << " items took "
+              << querySeconds * 1e3 << " ms, checking every item took " << scanSeconds * 1e3
+              << " ms" << std::endl;
+    return true;
+}
+
+/** @brief call fn(BlockIterator) for every block in the box from minPosition with size size */
+template <typename Fn>
+void forEachBlockInBox(World &world,
+                       PositionI minPosition,
+                       VectorI size,
+                       WorldLockManager &lock_manager,
+                       Fn fn)
+{
+    BlockIterator bi = world.getBlockIterator(minPosition, lock_manager.tls);
+    for(std::int32_t x = 0; x < size.x; x++)
+    {
+        for(std::int32_t z = 0; z < size.z; z++)
+        {
+            for(std::int32_t y = 0; y < size.y; y++)
+            {
+                bi.moveTo(minPosition + VectorI(x, y, z), lock_manager);
+                fn(bi);
+            }
+        }
+    }
+    lock_manager.clear();
+}
+
+bool checkBlockUpdateWheel(WorldLockManager &lock_manager)
+{
+    // two updates for every block of a 64 by 123 by 64 box in the sky makes a million updates
+    constexpr std::int32_t boxSizeXZ = 64;
+    constexpr std::int32_t boxSizeY = 123;
+    constexpr std::int32_t minY = 128;
+    constexpr std::size_t stepCount = 60;
+    const BlockUpdateKind kinds[] = {BlockUpdateKind::Water, BlockUpdateKind::Redstone};
+    const PositionF playerPosition(0.5f, World::SeaLevel + 8.5f, 0.5f, Dimension::Overworld);
+    std::shared_ptr<World> world = makeTestWorld(playerPosition, lock_manager);
+    stepWorld(*world, 1, lock_manager);
+    const double emptyStepSeconds = timeSeconds(
+        [&]()
+        {
+            stepWorld(*world, stepCount, lock_manager);
+        });
+    const PositionI minPosition(-boxSizeXZ / 2, minY, -boxSizeXZ / 2, Dimension::Overworld);
+    const VectorI boxSize(boxSizeXZ, boxSizeY, boxSizeXZ);
+    // the updates are due after the timed steps, so the steps only pay for keeping them pending
+    std::minstd_rand randomGenerator(selfTestSeed);
+    std::uniform_real_distribution<float> timeDistribution(10.0f, 600.0f);
+    std::size_t updateCount = 0;
+    const double addSeconds = timeSeconds(
+        [&]()
+        {
+            forEachBlockInBox(*world,
+                              minPosition,
+                              boxSize,
+                              lock_manager,
+                              [&](BlockIterator bi)
+                              {
+                                  for(BlockUpdateKind kind : kinds)
+                                  {
+                                      float timeFromNow = timeDistribution(randomGenerator);
+                                      world->addBlockUpdate(bi, lock_manager, kind, timeFromNow);
+                                      updateCount++;
+                                  }
+                              });
+        });
+    const double rescheduleSeconds = timeSeconds(
+        [&]()
+        {
+            forEachBlockInBox(*world,
+                              minPosition,
+                              boxSize,
+                              lock_manager,
+                              [&](BlockIterator bi)
+                              {
+                                  for(BlockUpdateKind kind : kinds)
+                                  {
+                                      float timeFromNow = timeDistribution(randomGenerator);
+                                      world->rescheduleBlockUpdate(
+                                          bi, lock_manager, kind, timeFromNow);
+                                  }
+                              });
+        });
+    const double pendingStepSeconds = timeSeconds(
+        [&]()
+        {
+            stepWorld(*world, stepCount, lock_manager);
+        });
+    std::size_t missingCount = 0;
+    const double deleteSeconds = timeSeconds(
+        [&]()
+        {
+            forEachBlockInBox(*world,
+                              minPosition,
+                              boxSize,
+                              lock_manager,
+                              [&](BlockIterator bi)
+                              {
+                                  for(BlockUpdateKind kind : kinds)
+                                  {
+                                      if(world->deleteBlockUpdate(bi, lock_manager, kind) < 0)
+                                          missingCount++;
+                                  }
+                              });
+        });
+    if(missingCount != 0)
+    {
+        std::cout << missingCount << " of " << updateCount
+                  << " block updates ran or were lost before they were due" << std::endl;
+        return false;
+    }
+    std::cout << updateCount << " block updates: added in " << addSeconds * 1e3
+              << " ms, rescheduled in " << rescheduleSeconds * 1e3 << " ms, deleted in "
+              << deleteSeconds * 1e3 << " ms; a step took " << emptyStepSeconds * 1e3 / stepCount
+              << " ms without them and " << pendingStepSeconds * 1e3 / stepCount
+              << " ms with them pending" << std::endl;
+    return true;
+}
+
+bool checkDescriptorTypeTests(WorldLockManager &lock_manager)
+{
+    constexpr std::size_t sequenceLength = 1 << 16;
+    constexpr std::size_t repeatCount = 64;
+    std::vector<BlockDescriptorPointer> descriptors(BlockDescriptors.begin(),
+                                                    BlockDescriptors.end());
+    if(descriptors.empty())
+    {
+        std::cout << "there are no block descriptors" << std::endl;
+        return false;
+    }
+    // a random sequence, so the branches can't be predicted from the descriptor order
+    std::minstd_rand randomGenerator(selfTestSeed);
+    std::uniform_int_distribution<std::size_t> indexDistribution(0, descriptors.size() - 1);
+    std::vector<BlockDescriptorPointer> sequence;
+    sequence.reserve(sequenceLength);
+    for(std::size_t i = 0; i < sequenceLength; i++)
+        sequence.push_back(descriptors[indexDistribution(randomGenerator)]);
+    struct Counts final
+    {
+        std::size_t fluids = 0, redstoneDust = 0, plants = 0;
+        bool operator!=(const Counts &rt) const
+        {
+            return fluids != rt.fluids || redstoneDust != rt.redstoneDust || plants != rt.plants;
+        }
+    };
+    Counts traitCounts, castCounts;
+    const double traitSeconds = timeSeconds(
+        [&]()
+        {
+            for(std::size_t repeat = 0; repeat < repeatCount; repeat++)
+            {
+                for(BlockDescriptorPointer descriptor : sequence)
+                {
+                    if(Blocks::builtin::Fluid::fromDescriptor(descriptor) != nullptr)
+                        traitCounts.fluids++;
+                    if(Blocks::builtin::RedstoneDust::fromDescriptor(descriptor) != nullptr)
+                        traitCounts.redstoneDust++;
+                    if(Blocks::builtin::Plant::fromDescriptor(descriptor) != nullptr)
+                        traitCounts.plants++;
+                }
+            }
+        });
+    const double castSeconds = timeSeconds(
+        [&]()
+        {
+            for(std::size_t repeat = 0; repeat < repeatCount; repeat++)
+            {
+                for(BlockDescriptorPointer descriptor : sequence)
+                {
+                    if(dynamic_cast<const Blocks::builtin::Fluid *>(descriptor) != nullptr)
+                        castCounts.fluids++;
+                    if(dynamic_cast<const Blocks::builtin::RedstoneDust *>(descriptor) != nullptr)
+                        castCounts.redstoneDust++;
+                    if(dynamic_cast<const Blocks::builtin::Plant *>(descriptor) != nullptr)
+                        castCounts.plants++;
+                }
+            }
+        });
+    if(traitCounts != castCounts)
+    {
+        std::cout << "the descriptor traits don't match the descriptor classes" << std::endl;
+        return false;
+    }
+    const double testCount = static_cast<double>(3 * sequenceLength * repeatCount);
+    std::cout << "over " << descriptors.size() << " block descriptors, a trait test took "
+              << traitSeconds * 1e9 / testCount << " ns and a dynamic_cast took "
+              << castSeconds * 1e9 / testCount << " ns" << std::endl;
+    return true;
+}
+
+struct SelfTest final
+{
+    const wchar_t *name;
+    bool (*fn)(WorldLockManager &lock_manager);
+};
+
+const SelfTest selfTests[] = {
+    {L"snapshot-save", &checkSnapshotSave},
+    {L"undermine-sand", &checkUndermineSand},
+    {L"undermine-sand-in-view", &checkUndermineSandInView},
+    {L"flood-basin", &checkFloodBasin},
+    {L"item-pit", &checkItemPit},
+    {L"world-file-faults", &checkWorldFileFaults},
+    {L"file-versions", &checkFileVersions},
+    {L"particle-step", &checkParticleStep},
+    {L"world-save-format", &checkWorldSaveFormat},
+    {L"world-save-throughput", &checkWorldSaveThroughput},
+    {L"entity-queries", &checkEntityQueries},
+    {L"block-update-wheel", &checkBlockUpdateWheel},
+    {L"descriptor-type-tests", &checkDescriptorTypeTests},
+};
+}
+
+int runSelfTests(std::vector<std::wstring> args)
+{
+    if(args.empty())
+    {
+        std::cerr << "usage: --self-test (all|<check>)..." << std::endl;
+        return 2;
+    }
+    for(const std::wstring &arg : args)
+    {
+        bool found = arg == L"all";
+        for(const SelfTest &selfTest : selfTests)
+        {
+            if(arg == selfTest.name)
+                found = true;
+        }
+        if(!found)
+        {
+            std::cerr << "unknown self test : " << string_cast<std::string>(arg) << std::endl;
+            return 2;
+        }
+    }
+    WorldLockManager lock_manager(TLS::getSlow());
+    std::size_t failedCount = 0;
+    for(const SelfTest &selfTest : selfTests)
+    {
+        bool selected = false;
+        for(const std::wstring &arg : args)
+        {
+            if(arg == L"all" || arg == selfTest.name)
+                selected = true;
+        }
+        if(!selected)
+            continue;
+        bool passed;
+        try
+        {
+            passed = selfTest.fn(lock_manager);
+        }
+        catch(stream::IOException &e)
+        {
+            std::cout << "Self Test Error : " << e.what() << std::endl;
+            passed = false;
+        }
+        lock_manager.clear();
+        std::cout << string_cast<std::string>(selfTest.name) << (passed ? " passed" : " FAILED")
+                  << std::endl;
+        if(!passed)
+            failedCount++;
+    }
+    return failedCount == 0 ? 0 : 1;
+}
+}
+}
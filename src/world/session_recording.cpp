@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "world/session_recording.h"
+#include "util/logging.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace programmerjake
+{
+namespace voxels
+{
+void SessionCheckpoint::write(stream::Writer &writer) const
+{
+    stream::write<std::uint64_t>(writer, stepIndex);
+    stream::write<std::uint64_t>(writer, worldHash);
+}
+
+SessionCheckpoint SessionCheckpoint::read(stream::Reader &reader)
+{
+    SessionCheckpoint retval;
+    retval.stepIndex = stream::read<std::uint64_t>(reader);
+    retval.worldHash = stream::read<std::uint64_t>(reader);
+    return retval;
+}
+
+void SessionRecording::write(stream::Writer &writer) const
+{
+    stream::write<std::uint32_t>(writer, fileVersion);
+    stream::write<std::uint64_t>(writer, initialWorld.size());
+    writer.writeBytes(initialWorld.data(), initialWorld.size());
+    stream::write<std::uint64_t>(writer, steps.size());
+    for(const std::vector<PlayerInputFrame> &step : steps)
+    {
+        stream::write<std::uint32_t>(writer, static_cast<std::uint32_t>(step.size()));
+        for(const PlayerInputFrame &frame : step)
+            frame.write(writer);
+    }
+    stream::write<std::uint64_t>(writer, checkpoints.size());
+    for(const SessionCheckpoint &checkpoint : checkpoints)
+        checkpoint.write(writer);
+}
+
+SessionRecording SessionRecording::read(stream::Reader &reader)
+{
+    SessionRecording retval;
+    stream::read_limited<std::uint32_t>(reader, 0, fileVersion);
+    constexpr std::uint64_t maxCount = std::numeric_limits<std::uint32_t>::max();
+    retval.initialWorld = reader.readSharedBytes(
+        static_cast<std::size_t>(stream::read_limited<std::uint64_t>(reader, 0, maxCount)));
+    std::uint64_t stepCount = stream::read_limited<std::uint64_t>(reader, 0, maxCount);
+    for(std::uint64_t i = 0; i < stepCount; i++)
+    {
+        std::vector<PlayerInputFrame> step;
+        std::uint32_t frameCount = stream::read<std::uint32_t>(reader);
+        for(std::uint32_t j = 0; j < frameCount; j++)
+            step.push_back(PlayerInputFrame::read(reader));
+        retval.steps.push_back(std::move(step));
+    }
+    std::uint64_t checkpointCount = stream::read_limited<std::uint64_t>(reader, 0, maxCount);
+    for(std::uint64_t i = 0; i < checkpointCount; i++)
+        retval.checkpoints.push_back(SessionCheckpoint::read(reader));
+    return retval;
+}
+
+std::shared_ptr<World> SessionRecorder::startRecording(stream::SharedBytes initialWorld,
+                                                       std::shared_ptr<SessionRecorder> &recorder,
+                                                       std::uint64_t checkpointInterval)
+{
+    std::shared_ptr<World> world;
+    {
+        stream::MemoryReader reader(initialWorld);
+        world = World::read(reader, true);
+    }
+    recorder = std::make_shared<SessionRecorder>(std::move(initialWorld), checkpointInterval);
+    world->setDeterministicStepListener(recorder);
+    return world;
+}
+
+void SessionRecorder::beforeStep(World &world,
+                                 std::uint64_t stepIndex,
+                                 WorldLockManager &lock_manager)
+{
+    std::vector<std::shared_ptr<Player>> players;
+    for(std::shared_ptr<Player> player : world.players().lock())
+        players.push_back(player);
+    std::sort(players.begin(),
+              players.end(),
+              [](const std::shared_ptr<Player> &a, const std::shared_ptr<Player> &b)
+              {
+                  return a->name < b->name;
+              });
+    std::vector<PlayerInputFrame> step;
+    step.reserve(players.size());
+    for(const std::shared_ptr<Player> &player : players)
+    {
+        step.push_back(player->takeInputFrame());
+        // the presses were taken out of the player, so they need to be put back for this step
+        player->applyInputFrame(step.back());
+    }
+    recording.steps.push_back(std::move(step));
+}
+
+void SessionRecorder::afterStep(World &world,
+                                std::uint64_t stepIndex,
+                                WorldLockManager &lock_manager)
+{
+    if(checkpointInterval != 0 && recording.steps.size() % checkpointInterval == 0)
+        recording.checkpoints.push_back(
+            SessionCheckpoint(recording.steps.size(), world.hashDeterministicState(lock_manager)));
+}
+
+namespace
+{
+class SessionReplayer final : public DeterministicStepListener
+{
+private:
+    const SessionRecording &recording;
+    std::size_t nextCheckpoint = 0;
+
+public:
+    std::uint64_t stepCount = 0;
+    SessionReplayResult result;
+    explicit SessionReplayer(const SessionRecording &recording) : recording(recording), result()
+    {
+    }
+    virtual void beforeStep(World &world,
+                            std::uint64_t stepIndex,
+                            WorldLockManager &lock_manager) override
+    {
+        for(const PlayerInputFrame &frame : recording.steps[stepCount])
+        {
+            for(std::shared_ptr<Player> player : world.players().lock())
+            {
+                if(player->name == frame.playerName)
+                {
+                    player->applyInputFrame(frame);
+                    break;
+                }
+            }
+        }
+        stepCount++;
+    }
+    virtual void afterStep(World &world,
+                           std::uint64_t stepIndex,
+                           WorldLockManager &lock_manager) override
+    {
+        result.stepCount = stepCount;
+        if(nextCheckpoint >= recording.checkpoints.size()
+           || recording.checkpoints[nextCheckpoint].stepIndex != stepCount)
+            return;
+        const SessionCheckpoint &checkpoint = recording.checkpoints[nextCheckpoint++];
+        std::uint64_t hash = world.hashDeterministicState(lock_manager);
+        if(hash == checkpoint.worldHash)
+            return;
+        result.matched = false;
+        result.mismatchStepIndex = checkpoint.stepIndex;
+        result.expectedHash = checkpoint.worldHash;
+        result.actualHash = hash;
+    }
+};
+}
+
+SessionReplayResult replaySession(const SessionRecording &recording)
+{
+    std::shared_ptr<World> world;
+    {
+        stream::MemoryReader reader(recording.initialWorld);
+        world = World::read(reader, true);
+    }
+    std::shared_ptr<SessionReplayer> replayer = std::make_shared<SessionReplayer>(recording);
+    world->setDeterministicStepListener(replayer);
+    WorldLockManager lock_manager(TLS::getSlow());
+    while(replayer->result.matched && replayer->stepCount < recording.steps.size())
+    {
+        world->stepDeterministic(lock_manager);
+    }
+    lock_manager.clear();
+    world->setDeterministicStepListener(nullptr);
+    return replayer->result;
+}
+}
+}
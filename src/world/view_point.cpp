@@ -156,6 +156,10 @@ void dumpMeshStats()
     //ObjectCounter<PhysicsWorld, 0>::dumpCount();
     //ObjectCounter<PhysicsWorld, 1>::dumpCount();
     ObjectCounter<BlockChunk, 0>::dumpCount();
+    // block updates and block optional data are counted per magazine and per slab, not per
+    // object, so allocating them doesn't touch a shared counter
+    //ObjectCounter<shared_slab_allocator<BlockUpdate>, 0>::dumpCount();
+    //ObjectCounter<BlockOptionalData::Pool, 0>::dumpCount();
 #endif
 }
 }
@@ -881,6 +885,9 @@ struct ViewPoint::Implementation final
                 }
             }
         }
+        lock_manager.clear();
+        world.getParticleSystem().render(
+            entityMeshes[RenderLayer::Opaque], position, viewDistance, cameraToWorld);
 #ifdef USE_PER_CHUNK_BUFFER
 #if 1
         while(nextBlockRenderMeshes.size() < 32)
@@ -34,10 +34,15 @@
 #include <mutex>
 #include <chrono>
 #include <list>
+#include <algorithm>
+#include <tuple>
+#include <condition_variable>
+#include <exception>
 #include "util/logging.h"
 #include "util/global_instance_maker.h"
 #include "platform/thread_name.h"
 #include "platform/thread_priority.h"
+#include "platform/platform.h"
 #include "util/wrapped_entity.h"
 #include "generate/decorator.h"
 #include "util/decorator_cache.h"
@@ -51,10 +56,12 @@
 #include "util/util.h"
 #include "stream/compressed_stream.h"
 #include "util/game_version.h"
+#include "world/file_upgrades.h"
 #include "player/player.h"
 #include "util/chunk_cache.h"
 #include "util/tls.h"
 #include "util/usage_monitor.h"
+#include "util/xorshiftplus.h"
 
 using namespace std;
 
@@ -302,16 +309,6 @@ private:
                         if(block.descriptor == Blocks::builtin::Air::descriptor())
                         {
                             block = Block(Blocks::builtin::Water::descriptor());
-                            block.lighting = Lighting::makeSkyLighting();
-                            LightProperties waterLightProperties =
-                                Blocks::builtin::Water::descriptor()->lightProperties;
-                            for(auto i = pos.y; i <= World::SeaLevel; i++)
-                            {
-                                block.lighting = waterLightProperties.calculateTransmittedLighting(
-                                    block.lighting);
-                                if(block.lighting == Lighting(0, 0, 0))
-                                    break;
-                            }
                         }
                         if(cy > 0
                            && dynamic_cast<const Blocks::builtin::Water *>(block.descriptor)
@@ -324,14 +321,21 @@ private:
                             }
                         }
                     }
-                    else
+                }
+                // direct skylight column pass: everything above the ground and the sea is open
+                // sky, so only the rest of the column needs evaluating
+                int columnTop = std::max(groundHeight, World::SeaLevel) - chunkBasePosition.y;
+                Lighting lighting = Lighting::makeSkyLighting();
+                for(int cy = BlockChunk::chunkSizeY - 1; cy >= 0; cy--)
+                {
+                    Block &block = blocks[cx][cy][cz];
+                    if(!block.good())
+                        continue;
+                    if(cy <= columnTop || block.descriptor != Blocks::builtin::Air::descriptor())
                     {
-                        Block &block = blocks[cx][cy][cz];
-                        if(block.descriptor == Blocks::builtin::Air::descriptor())
-                        {
-                            block.lighting = Lighting::makeSkyLighting();
-                        }
+                        lighting = block.descriptor->lightProperties.eval(lighting);
                     }
+                    block.lighting = lighting;
                 }
             }
         }
@@ -606,10 +610,15 @@ World::World(SeedType seed, const WorldGenerator *worldGenerator, internal_const
       lightingThreads(),
       blockUpdateThreads(),
       particleGeneratingThread(),
+      particleSystem(),
       moveEntitiesThread(),
       chunkGeneratingThreads(),
       destructing(false),
       lightingStable(false),
+      lightingRegionsLock(),
+      lightingRegions(),
+      lightingRegionList(),
+      lightingRegionScanLock(),
       viewPointsLock(),
       viewPoints(),
       timeOfDayLock(),
@@ -617,10 +626,15 @@ World::World(SeedType seed, const WorldGenerator *worldGenerator, internal_const
       stateLock(),
       stateCond(),
       chunkUnloaderThread(),
-      blockUpdateCurrentPhase(BlockUpdatePhase::InitialPhase),
-      blockUpdateCurrentPhaseCount(ThreadCounts::get().blockUpdateThreadCount),
-      blockUpdateNextPhaseCount(0),
-      blockUpdateDidAnything(false)
+      chunkPreloadThread(),
+      blockUpdateBarrier(ThreadCounts::get().blockUpdateThreadCount),
+      blockUpdateNextTickTime(std::chrono::steady_clock::now()),
+      blockUpdateTicksPerSecond(DefaultBlockUpdateTicksPerSecond),
+      blockUpdateTickCount(0),
+      deterministic(false),
+      deterministicStepCount(0),
+      deterministicStepListener(),
+      blockUpdateBatchesEnabled(true)
 {
 }
 
@@ -628,6 +642,41 @@ World::World(std::atomic_bool *abortFlag) : World(makeRandomSeed(), abortFlag)
 {
 }
 
+void World::removeBlockUpdatesFromBlocks(BlockChunk &chunk, BlockUpdate *list, TLS &tls)
+{
+    for(BlockUpdate *node = list; node != nullptr; node = node->chunk_next)
+    {
+        VectorI subchunkIndex = BlockChunk::getSubchunkIndexFromPosition(node->position);
+        VectorI subchunkRelativePosition = BlockChunk::getSubchunkRelativePosition(node->position);
+        VectorI chunkRelativePosition = BlockChunk::getChunkRelativePosition(node->position);
+        BlockChunkSubchunk &subchunk =
+            chunk.subchunks[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z];
+        BlockChunkBlock &block =
+            chunk.blocks[chunkRelativePosition.x][chunkRelativePosition.y][chunkRelativePosition.z];
+        BlockOptionalData *blockOptionalData = nullptr;
+        if(block.hasOptionalData)
+            blockOptionalData = subchunk.blockOptionalData.get(subchunkRelativePosition);
+        if(blockOptionalData != nullptr)
+        {
+            for(BlockUpdate **pnode = &blockOptionalData->updateListHead; *pnode != nullptr;
+                pnode = &(*pnode)->block_next)
+            {
+                if(*pnode == node)
+                {
+                    *pnode = node->block_next;
+                    break;
+                }
+            }
+            if(blockOptionalData->empty())
+            {
+                subchunk.blockOptionalData.erase(subchunkRelativePosition);
+                block.hasOptionalData = false;
+            }
+        }
+        node->block_next = nullptr;
+    }
+}
+
 BlockUpdate *World::removeAllBlockUpdatesInChunk(BlockUpdateKind kind,
                                                  BlockIterator bi,
                                                  WorldLockManager &lock_manager)
@@ -637,151 +686,54 @@ BlockUpdate *World::removeAllBlockUpdatesInChunk(BlockUpdateKind kind,
     BlockChunkFullLock lockChunk(*chunk);
     auto lockIt = std::unique_lock<decltype(chunk->getChunkVariables().blockUpdateListLock)>(
         chunk->getChunkVariables().blockUpdateListLock);
-    BlockUpdate *retval = nullptr;
+    BlockUpdate *retval = chunk->getChunkVariables().blockUpdates.takeAll(kind);
     std::size_t &blockUpdatesLeft =
-        bi.chunk->getChunkVariables().blockUpdatesPerPhase[BlockUpdateKindPhase(kind)];
-    for(BlockUpdate *node = chunk->getChunkVariables().blockUpdateListHead; node != nullptr;)
-    {
-        if(node->kind == kind)
-        {
-            if(node->chunk_prev != nullptr)
-                node->chunk_prev->chunk_next = node->chunk_next;
-            else
-                chunk->getChunkVariables().blockUpdateListHead = node->chunk_next;
-            if(node->chunk_next != nullptr)
-                node->chunk_next->chunk_prev = node->chunk_prev;
-            else
-                chunk->getChunkVariables().blockUpdateListTail = node->chunk_prev;
-            BlockUpdate *next_node = node->chunk_next;
-            node->chunk_prev = nullptr;
-            node->chunk_next = retval;
-            if(retval != nullptr)
-                retval->chunk_prev = node;
-            retval = node;
-            blockUpdatesLeft--;
-            node = next_node;
-            VectorI subchunkIndex = BlockChunk::getSubchunkIndexFromPosition(retval->position);
-            VectorI subchunkRelativePosition =
-                BlockChunk::getSubchunkRelativePosition(retval->position);
-            VectorI chunkRelativePosition = BlockChunk::getChunkRelativePosition(retval->position);
-            BlockChunkSubchunk &subchunk =
-                chunk->subchunks[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z];
-            BlockChunkBlock &block =
-                chunk->blocks[chunkRelativePosition.x][chunkRelativePosition
-                                                           .y][chunkRelativePosition.z];
-            BlockOptionalData *blockOptionalData = nullptr;
-            if(block.hasOptionalData)
-                blockOptionalData = subchunk.blockOptionalData.get(subchunkRelativePosition);
-            if(blockOptionalData != nullptr)
-            {
-                for(BlockUpdate **pnode = &blockOptionalData->updateListHead; *pnode != nullptr;
-                    pnode = &(*pnode)->block_next)
-                {
-                    if(*pnode == retval)
-                    {
-                        *pnode = retval->block_next;
-                        break;
-                    }
-                }
-                if(blockOptionalData->empty())
-                {
-                    subchunk.blockOptionalData.erase(subchunkRelativePosition, lock_manager.tls);
-                    block.hasOptionalData = false;
-                }
-            }
-            retval->block_next = nullptr;
-        }
-        else
-            node = node->chunk_next;
-    }
+        chunk->getChunkVariables().blockUpdatesPerPhase[BlockUpdateKindPhase(kind)];
+    for(BlockUpdate *node = retval; node != nullptr; node = node->chunk_next)
+        blockUpdatesLeft--;
+    if(retval != nullptr)
+        chunk->getChunkVariables().saveDirty = true;
+    removeBlockUpdatesFromBlocks(*chunk, retval, lock_manager.tls);
     return retval;
 }
 
 BlockUpdate *World::removeAllReadyBlockUpdatesInChunk(BlockUpdatePhase phase,
                                                       BlockIterator bi,
-                                                      WorldLockManager &lock_manager)
+                                                      WorldLockManager &lock_manager,
+                                                      double fixedDeltaTime)
 {
     std::shared_ptr<BlockChunk> chunk = bi.chunk;
     lock_manager.clear();
     BlockChunkFullLock lockChunk(*chunk);
     auto lockIt = std::unique_lock<decltype(chunk->getChunkVariables().blockUpdateListLock)>(
         chunk->getChunkVariables().blockUpdateListLock);
-    float deltaTime = 0;
-    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-    if(chunk->getChunkVariables().lastBlockUpdateTimeValid)
-        deltaTime =
-            static_cast<float>(std::chrono::duration_cast<std::chrono::duration<double>>(
-                                   now - chunk->getChunkVariables().lastBlockUpdateTime).count());
-    chunk->getChunkVariables().lastBlockUpdateTimeValid = true;
-    chunk->getChunkVariables().lastBlockUpdateTime = now;
-    BlockUpdate *retval = nullptr;
-    std::size_t &blockUpdatesLeft = bi.chunk->getChunkVariables().blockUpdatesPerPhase[phase];
-    for(BlockUpdate *node = chunk->getChunkVariables().blockUpdateListHead; node != nullptr;)
-    {
-        if(node->kind == BlockUpdateKind::Lighting)
-        {
-            node = node->chunk_next;
-            continue;
-        }
-        auto nodePhase = BlockUpdateKindPhase(node->kind);
-        if(nodePhase != BlockUpdatePhase::Asynchronous && nodePhase != phase)
-        {
-            node = node->chunk_next;
-            continue;
-        }
-        node->time_left -= deltaTime;
-        if(node->time_left <= 0)
-        {
-            if(node->chunk_prev != nullptr)
-                node->chunk_prev->chunk_next = node->chunk_next;
-            else
-                chunk->getChunkVariables().blockUpdateListHead = node->chunk_next;
-            if(node->chunk_next != nullptr)
-                node->chunk_next->chunk_prev = node->chunk_prev;
-            else
-                chunk->getChunkVariables().blockUpdateListTail = node->chunk_prev;
-            BlockUpdate *next_node = node->chunk_next;
-            node->chunk_prev = nullptr;
-            node->chunk_next = retval;
-            if(retval != nullptr)
-                retval->chunk_prev = node;
-            retval = node;
-            node = next_node;
-            blockUpdatesLeft--;
-            VectorI subchunkIndex = BlockChunk::getSubchunkIndexFromPosition(retval->position);
-            VectorI subchunkRelativePosition =
-                BlockChunk::getSubchunkRelativePosition(retval->position);
-            VectorI chunkRelativePosition = BlockChunk::getChunkRelativePosition(retval->position);
-            BlockChunkSubchunk &subchunk =
-                chunk->subchunks[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z];
-            BlockChunkBlock &block =
-                chunk->blocks[chunkRelativePosition.x][chunkRelativePosition
-                                                           .y][chunkRelativePosition.z];
-            BlockOptionalData *blockOptionalData = nullptr;
-            if(block.hasOptionalData)
-                blockOptionalData = subchunk.blockOptionalData.get(subchunkRelativePosition);
-            if(blockOptionalData != nullptr)
-            {
-                for(BlockUpdate **pnode = &blockOptionalData->updateListHead; *pnode != nullptr;
-                    pnode = &(*pnode)->block_next)
-                {
-                    if(*pnode == retval)
-                    {
-                        *pnode = retval->block_next;
-                        break;
-                    }
-                }
-                if(blockOptionalData->empty())
-                {
-                    subchunk.blockOptionalData.erase(subchunkRelativePosition, lock_manager.tls);
-                    block.hasOptionalData = false;
-                }
-            }
-            retval->block_next = nullptr;
-        }
-        else
-            node = node->chunk_next;
+    double deltaTime = fixedDeltaTime;
+    if(fixedDeltaTime < 0)
+    {
+        deltaTime = 0;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(chunk->getChunkVariables().lastBlockUpdateTimeValid)
+            deltaTime = std::chrono::duration_cast<std::chrono::duration<double>>(
+                            now - chunk->getChunkVariables().lastBlockUpdateTime).count();
+        chunk->getChunkVariables().lastBlockUpdateTimeValid = true;
+        chunk->getChunkVariables().lastBlockUpdateTime = now;
+    }
+    else
+    {
+        // the time spent in deterministic mode was already advanced
+        chunk->getChunkVariables().lastBlockUpdateTimeValid = false;
     }
+    BlockUpdateTimingWheel &blockUpdates = chunk->getChunkVariables().blockUpdates;
+    blockUpdates.advance(deltaTime);
+    if(phase == BlockUpdatePhase::Asynchronous)
+        return nullptr; // lighting updates are removed by the lighting threads
+    BlockUpdate *retval = blockUpdates.takeReady(phase);
+    std::size_t &blockUpdatesLeft = chunk->getChunkVariables().blockUpdatesPerPhase[phase];
+    for(BlockUpdate *node = retval; node != nullptr; node = node->chunk_next)
+        blockUpdatesLeft--;
+    if(retval != nullptr)
+        chunk->getChunkVariables().saveDirty = true;
+    removeBlockUpdatesFromBlocks(*chunk, retval, lock_manager.tls);
     return retval;
 }
 
@@ -795,10 +747,15 @@ World::World(SeedType seed, const WorldGenerator *worldGenerator, std::atomic_bo
       lightingThreads(),
       blockUpdateThreads(),
       particleGeneratingThread(),
+      particleSystem(),
       moveEntitiesThread(),
       chunkGeneratingThreads(),
       destructing(false),
       lightingStable(false),
+      lightingRegionsLock(),
+      lightingRegions(),
+      lightingRegionList(),
+      lightingRegionScanLock(),
       viewPointsLock(),
       viewPoints(),
       timeOfDayLock(),
@@ -806,10 +763,15 @@ World::World(SeedType seed, const WorldGenerator *worldGenerator, std::atomic_bo
       stateLock(),
       stateCond(),
       chunkUnloaderThread(),
-      blockUpdateCurrentPhase(BlockUpdatePhase::InitialPhase),
-      blockUpdateCurrentPhaseCount(ThreadCounts::get().blockUpdateThreadCount),
-      blockUpdateNextPhaseCount(0),
-      blockUpdateDidAnything(false)
+      chunkPreloadThread(),
+      blockUpdateBarrier(ThreadCounts::get().blockUpdateThreadCount),
+      blockUpdateNextTickTime(std::chrono::steady_clock::now()),
+      blockUpdateTicksPerSecond(DefaultBlockUpdateTicksPerSecond),
+      blockUpdateTickCount(0),
+      deterministic(false),
+      deterministicStepCount(0),
+      deterministicStepListener(),
+      blockUpdateBatchesEnabled(true)
 {
     TLS &tls = TLS::getSlow();
     ([this, abortFlag, &tls]()
@@ -921,16 +883,22 @@ World::World(SeedType seed, const WorldGenerator *worldGenerator, std::atomic_bo
          }
          for(std::size_t i = 0; i < ThreadCounts::get().blockUpdateThreadCount; i++)
          {
-             bool isPhaseManager = i == 0;
-             blockUpdateThreads.emplace_back([this, isPhaseManager]()
+             blockUpdateThreads.emplace_back([this, i]()
                                              {
                                                  setThreadName(L"block update");
                                                  TLS tls;
-                                                 blockUpdateThreadFn(tls, isPhaseManager);
+                                                 blockUpdateThreadFn(tls, i);
                                              });
          }
          getDebugLog() << L"lighting initial world..." << postnl;
-         for(int i = 0; i < 500 && !isLightingStable(); i++)
+         const PositionI spawnAreaMinCorner(
+             -BlockChunk::chunkSizeX, 0, -BlockChunk::chunkSizeZ, Dimension::Overworld);
+         const PositionI spawnAreaMaxCorner(BlockChunk::chunkSizeX - 1,
+                                            BlockChunk::chunkSizeY - 1,
+                                            BlockChunk::chunkSizeZ - 1,
+                                            Dimension::Overworld);
+         for(int i = 0; i < 500 && !isLightingStable(spawnAreaMinCorner, spawnAreaMaxCorner);
+             i++)
          {
              if(abortFlag && *abortFlag)
              {
@@ -1021,6 +989,8 @@ World::~World()
         moveEntitiesThread.join();
     if(chunkUnloaderThread.joinable())
         chunkUnloaderThread.join();
+    if(chunkPreloadThread.joinable())
+        chunkPreloadThread.join();
     std::vector<std::shared_ptr<Player>> copiedPlayerList; // hold another reference to players so
     // we don't try to remove from players
     // list while destructing a list element
@@ -1042,81 +1012,259 @@ Lighting World::getBlockLighting(BlockIterator bi, WorldLockManager &lock_manage
     return b.lighting;
 }
 
+LightingRegion &World::getLightingRegion(IndirectBlockChunk &chunk)
+{
+    LightingRegion *retval = chunk.chunkVariables.lightingRegion.load();
+    if(retval != nullptr)
+        return *retval;
+    std::unique_lock<std::mutex> lockIt(lightingRegionsLock);
+    retval = chunk.chunkVariables.lightingRegion.load();
+    if(retval != nullptr)
+        return *retval;
+    PositionI regionBasePosition = LightingRegion::getRegionBasePosition(chunk.basePosition);
+    std::unique_ptr<LightingRegion> &region = lightingRegions[regionBasePosition];
+    if(region == nullptr)
+    {
+        region.reset(new LightingRegion(regionBasePosition));
+        lightingRegionList.push_back(region.get());
+    }
+    retval = region.get();
+    std::unique_lock<std::mutex> lockChunks(retval->chunksLock);
+    retval->chunks.push_back(&chunk);
+    retval->stable = false;
+    chunk.chunkVariables.lightingRegion.store(retval);
+    return *retval;
+}
+
+void World::setBlockLighting(BlockIterator bi,
+                             WorldLockManager &lock_manager,
+                             Lighting newLighting,
+                             LightingRegion &region)
+{
+    bi.getBlock(lock_manager).setLighting(newLighting);
+    bi.chunk->getChunkVariables().saveDirty = true;
+    BlockIterator bix = bi;
+    bix.moveBy(VectorI(-1, -1, -1), lock_manager);
+    for(int dx = -1; dx <= 1; dx++, bix.moveTowardPX(lock_manager))
+    {
+        BlockIterator bixy = bix;
+        for(int dy = -1; dy <= 1; dy++, bixy.moveTowardPY(lock_manager))
+        {
+            BlockIterator bi2 = bixy;
+            for(int dz = -1; dz <= 1; dz++, bi2.moveTowardPZ(lock_manager))
+            {
+                LightingRegion &destRegion = getLightingRegion(*bi2.chunk->indirectBlockChunk);
+                if(&destRegion == &region)
+                    invalidateBlock(bi2, lock_manager);
+                else
+                    destRegion.addBoundaryUpdate(bi2.position());
+            }
+        }
+    }
+}
+
+namespace
+{
+bool positionLess(PositionI a, PositionI b)
+{
+    return std::tie(a.d, a.y, a.z, a.x) < std::tie(b.d, b.y, b.z, b.x);
+}
+}
+
+bool World::lightRegion(LightingRegion &region,
+                        WorldLockManager &lock_manager,
+                        ThreadPauseGuard *pauseGuard)
+{
+    BlockChunkMap *chunks = &physicsWorld->chunks;
+    bool didAnything = false;
+    std::vector<PositionI> boundaryQueue;
+    {
+        std::unique_lock<std::mutex> lockIt(region.boundaryQueueLock);
+        boundaryQueue.swap(region.boundaryQueue);
+    }
+    for(PositionI pos : boundaryQueue)
+    {
+        if(destructing)
+            return true;
+        didAnything = true;
+        BlockIterator bi = getBlockIterator(pos, lock_manager.tls);
+        invalidateBlock(bi, lock_manager);
+    }
+    boundaryQueue.clear();
+    std::vector<IndirectBlockChunk *> regionChunks;
+    {
+        std::unique_lock<std::mutex> lockIt(region.chunksLock);
+        regionChunks = region.chunks;
+    }
+    // chunks are added in the order the lighting threads find them; sort so the order is the same
+    // every time for deterministic worlds
+    std::sort(regionChunks.begin(),
+              regionChunks.end(),
+              [](const IndirectBlockChunk *a, const IndirectBlockChunk *b)
+              {
+                  return positionLess(a->basePosition, b->basePosition);
+              });
+    for(IndirectBlockChunk *indirectChunk : regionChunks)
+    {
+        if(destructing)
+            return true;
+        if(!indirectChunk->isLoaded())
+            continue;
+        std::shared_ptr<BlockChunk> chunk = indirectChunk->getOrLoad(lock_manager.tls);
+        lock_manager.clear();
+        if(pauseGuard)
+            pauseGuard->checkForPause();
+        BlockIterator cbi(chunk, chunks, chunk->basePosition, VectorI(0));
+        for(BlockUpdate *node =
+                removeAllBlockUpdatesInChunk(BlockUpdateKind::Lighting, cbi, lock_manager);
+            node != nullptr;
+            node = removeAllBlockUpdatesInChunk(BlockUpdateKind::Lighting, cbi, lock_manager))
+        {
+            didAnything = true;
+            std::size_t litBlockCount = 0;
+            while(node != nullptr)
+            {
+                BlockIterator bi = cbi;
+                bi.moveTo(node->position, lock_manager);
+                Block b = bi.get(lock_manager);
+                if(b.good())
+                {
+                    BlockIterator binx = bi;
+                    binx.moveTowardNX(lock_manager);
+                    BlockIterator bipx = bi;
+                    bipx.moveTowardPX(lock_manager);
+                    BlockIterator biny = bi;
+                    biny.moveTowardNY(lock_manager);
+                    BlockIterator bipy = bi;
+                    bipy.moveTowardPY(lock_manager);
+                    BlockIterator binz = bi;
+                    binz.moveTowardNZ(lock_manager);
+                    BlockIterator bipz = bi;
+                    bipz.moveTowardPZ(lock_manager);
+                    if(litBlockCount++ > 500)
+                    {
+                        litBlockCount = 0;
+                        lock_manager.clear();
+                    }
+                    Lighting newLighting = b.descriptor->lightProperties.eval(
+                        getBlockLighting(binx, lock_manager, false),
+                        getBlockLighting(bipx, lock_manager, false),
+                        getBlockLighting(biny, lock_manager, false),
+                        getBlockLighting(bipy, lock_manager, true),
+                        getBlockLighting(binz, lock_manager, false),
+                        getBlockLighting(bipz, lock_manager, false));
+                    if(newLighting != b.lighting)
+                    {
+                        setBlockLighting(bi, lock_manager, newLighting, region);
+                    }
+                }
+
+                BlockUpdate *deleteMe = node;
+                node = node->chunk_next;
+                if(node != nullptr)
+                    node->chunk_prev = nullptr;
+                BlockUpdate::free(deleteMe, lock_manager.tls);
+            }
+            if(destructing)
+                return true;
+        }
+    }
+    return didAnything;
+}
+
+bool World::isLightingStable(PositionI minCorner, PositionI maxCorner)
+{
+    PositionI minRegion = LightingRegion::getRegionBasePosition(minCorner);
+    PositionI maxRegion = LightingRegion::getRegionBasePosition(maxCorner);
+    for(PositionI pos = minRegion; pos.y <= maxRegion.y; pos.y += BlockChunk::chunkSizeY)
+    {
+        for(pos.z = minRegion.z; pos.z <= maxRegion.z; pos.z += LightingRegion::regionSizeZ)
+        {
+            for(pos.x = minRegion.x; pos.x <= maxRegion.x; pos.x += LightingRegion::regionSizeX)
+            {
+                LightingRegion *region;
+                {
+                    std::unique_lock<std::mutex> lockIt(lightingRegionsLock);
+                    auto iter = lightingRegions.find(pos);
+                    if(iter == lightingRegions.end())
+                        return false;
+                    region = iter->second.get();
+                }
+                std::uint64_t startGeneration = region->generation.load();
+                if(startGeneration % 2 != 0 || !region->stable)
+                    return false;
+                {
+                    std::unique_lock<std::mutex> lockIt(region->boundaryQueueLock);
+                    if(!region->boundaryQueue.empty())
+                        return false;
+                }
+                std::unique_lock<std::mutex> lockChunks(region->chunksLock);
+                for(IndirectBlockChunk *chunk : region->chunks)
+                {
+                    BlockChunkChunkVariables &chunkVariables = chunk->chunkVariables;
+                    std::unique_lock<std::mutex> lockIt(chunkVariables.blockUpdateListLock);
+                    if(chunkVariables.blockUpdatesPerPhase[BlockUpdatePhase::Asynchronous] != 0)
+                        return false;
+                }
+                lockChunks.unlock();
+                if(region->generation.load() != startGeneration)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
 void World::lightingThreadFn(TLS &tls)
 {
     setThreadPriority(ThreadPriority::Low);
-    ThreadPauseGuard pauseGuard(*this);
+    ThreadPauseGuard pauseGuard(*this, true);
     WorldLockManager lock_manager(tls);
     BlockChunkMap *chunks = &physicsWorld->chunks;
+    std::vector<LightingRegion *> regions;
     while(!destructing)
     {
         bool didAnything = false;
-        for(auto chunkIter = chunks->begin(); chunkIter != chunks->end(); chunkIter++)
+        std::unique_lock<std::mutex> scanLock(lightingRegionScanLock, std::try_to_lock);
+        if(scanLock.owns_lock())
+        {
+            for(auto chunkIter = chunks->begin(); chunkIter != chunks->end(); chunkIter++)
+            {
+                if(destructing)
+                    break;
+                if(chunkIter->chunkVariables.lightingRegion.load() == nullptr)
+                    getLightingRegion(*chunkIter);
+            }
+            scanLock.unlock();
+        }
+        {
+            std::unique_lock<std::mutex> lockIt(lightingRegionsLock);
+            regions = lightingRegionList;
+        }
+        for(LightingRegion *region : regions)
         {
             if(destructing)
                 break;
-            if(!chunkIter->isLoaded())
-                continue;
-            std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(lock_manager.tls);
-            if(chunkIter.is_locked())
-                chunkIter.unlock();
-            lock_manager.clear();
-            pauseGuard.checkForPause();
-            BlockIterator cbi(chunk, chunks, chunk->basePosition, VectorI(0));
-            for(BlockUpdate *node =
-                    removeAllBlockUpdatesInChunk(BlockUpdateKind::Lighting, cbi, lock_manager);
-                node != nullptr;
-                node = removeAllBlockUpdatesInChunk(BlockUpdateKind::Lighting, cbi, lock_manager))
+            if(!region->tryClaim())
             {
                 didAnything = true;
-                std::size_t litBlockCount = 0;
-                while(node != nullptr)
-                {
-                    BlockIterator bi = cbi;
-                    bi.moveTo(node->position, lock_manager);
-                    Block b = bi.get(lock_manager);
-                    if(b.good())
-                    {
-                        BlockIterator binx = bi;
-                        binx.moveTowardNX(lock_manager);
-                        BlockIterator bipx = bi;
-                        bipx.moveTowardPX(lock_manager);
-                        BlockIterator biny = bi;
-                        biny.moveTowardNY(lock_manager);
-                        BlockIterator bipy = bi;
-                        bipy.moveTowardPY(lock_manager);
-                        BlockIterator binz = bi;
-                        binz.moveTowardNZ(lock_manager);
-                        BlockIterator bipz = bi;
-                        bipz.moveTowardPZ(lock_manager);
-                        if(litBlockCount++ > 500)
-                        {
-                            litBlockCount = 0;
-                            lock_manager.clear();
-                        }
-                        Lighting newLighting = b.descriptor->lightProperties.eval(
-                            getBlockLighting(binx, lock_manager, false),
-                            getBlockLighting(bipx, lock_manager, false),
-                            getBlockLighting(biny, lock_manager, false),
-                            getBlockLighting(bipy, lock_manager, true),
-                            getBlockLighting(binz, lock_manager, false),
-                            getBlockLighting(bipz, lock_manager, false));
-                        if(newLighting != b.lighting)
-                        {
-                            b.lighting = newLighting;
-                            setBlock(bi, lock_manager, b);
-                        }
-                    }
-
-                    BlockUpdate *deleteMe = node;
-                    node = node->chunk_next;
-                    if(node != nullptr)
-                        node->chunk_prev = nullptr;
-                    BlockUpdate::free(deleteMe, lock_manager.tls);
-                }
-                if(destructing)
-                    break;
+                continue;
+            }
+            bool regionDidAnything = false;
+            try
+            {
+                regionDidAnything = lightRegion(*region, lock_manager, &pauseGuard);
+            }
+            catch(...)
+            {
+                lock_manager.clear();
+                region->release(false);
+                throw;
             }
+            lock_manager.clear();
+            region->release(!regionDidAnything);
+            if(regionDidAnything)
+                didAnything = true;
         }
         lock_manager.clear();
         pauseGuard.checkForPause();
@@ -1128,106 +1276,170 @@ void World::lightingThreadFn(TLS &tls)
     }
 }
 
-void World::blockUpdateThreadFn(TLS &tls, bool isPhaseManager)
+void World::runLightingUntilStable(WorldLockManager &lock_manager)
 {
-    setThreadPriority(ThreadPriority::Low);
-    ThreadPauseGuard pauseGuard(*this);
     BlockChunkMap *chunks = &physicsWorld->chunks;
-    bool didAnything = true;
-    while(!destructing)
+    std::vector<LightingRegion *> regions;
+    for(;;)
     {
-        BlockUpdatePhase phase;
-        if(isPhaseManager)
         {
-            std::unique_lock<std::mutex> lockIt(stateLock);
-            blockUpdateCurrentPhaseCount--;
-            blockUpdateNextPhaseCount++;
-            while(blockUpdateCurrentPhaseCount != 0)
+            std::unique_lock<std::mutex> scanLock(lightingRegionScanLock);
+            for(auto chunkIter = chunks->begin(); chunkIter != chunks->end(); chunkIter++)
             {
-                stateCond.wait(lockIt);
-                if(destructing)
-                    return;
-                pauseGuard.checkForPause(lockIt);
+                if(chunkIter->chunkVariables.lightingRegion.load() == nullptr)
+                    getLightingRegion(*chunkIter);
             }
-            if(blockUpdateDidAnything)
-                didAnything = true;
-            if(didAnything && blockUpdateCurrentPhase == BlockUpdatePhase::InitialPhase)
+        }
+        {
+            std::unique_lock<std::mutex> lockIt(lightingRegionsLock);
+            regions = lightingRegionList;
+        }
+        std::sort(regions.begin(),
+                  regions.end(),
+                  [](const LightingRegion *a, const LightingRegion *b)
+                  {
+                      return positionLess(a->basePosition, b->basePosition);
+                  });
+        bool didAnything = false;
+        for(LightingRegion *region : regions)
+        {
+            if(destructing)
+                return;
+            // the lighting threads are parked, but one can be parked while it has a region claimed
+            bool claimed = region->tryClaim();
+            bool regionDidAnything = false;
+            try
+            {
+                regionDidAnything = lightRegion(*region, lock_manager, nullptr);
+            }
+            catch(...)
             {
-                blockUpdateDidAnything = false;
-                lockIt.unlock();
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                lockIt.lock();
+                lock_manager.clear();
+                if(claimed)
+                    region->release(false);
+                throw;
             }
-            std::swap(blockUpdateCurrentPhaseCount, blockUpdateNextPhaseCount);
-            blockUpdateCurrentPhase = BlockUpdatePhaseNext(blockUpdateCurrentPhase);
-            phase = blockUpdateCurrentPhase;
-            stateCond.notify_all();
+            lock_manager.clear();
+            if(claimed)
+                region->release(!regionDidAnything);
+            if(regionDidAnything)
+                didAnything = true;
         }
-        else
+        if(!didAnything)
+            break;
+    }
+    lightingStable = true;
+}
+
+void World::runBlockUpdatesInChunk(std::shared_ptr<BlockChunk> chunk,
+                                   BlockUpdatePhase phase,
+                                   WorldLockManager &lock_manager,
+                                   std::vector<BlockUpdateBatch *> &batches,
+                                   double fixedDeltaTime)
+{
+    BlockIterator cbi(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0));
+    std::size_t ranUpdateCount = 0;
+    for(BlockUpdate *node =
+            removeAllReadyBlockUpdatesInChunk(phase, cbi, lock_manager, fixedDeltaTime);
+        node != nullptr;
+        node = removeAllReadyBlockUpdatesInChunk(
+            phase, cbi, lock_manager, fixedDeltaTime < 0 ? fixedDeltaTime : 0))
+    {
+        while(node != nullptr)
         {
-            std::unique_lock<std::mutex> lockIt(stateLock);
-            blockUpdateCurrentPhaseCount--;
-            blockUpdateNextPhaseCount++;
-            if(didAnything)
-                blockUpdateDidAnything = true;
-            stateCond.notify_all();
-            phase = blockUpdateCurrentPhase;
-            while(phase == blockUpdateCurrentPhase)
+            BlockIterator bi = cbi;
+            bi.moveTo(node->position, lock_manager);
+            Block b = bi.get(lock_manager);
+            if(b.good() && b.descriptor->handledUpdateKinds[node->kind])
             {
-                stateCond.wait(lockIt);
-                if(destructing)
-                    return;
-                pauseGuard.checkForPause(lockIt);
+                BlockUpdateBatch *batch =
+                    blockUpdateBatchesEnabled ?
+                        b.descriptor->getBlockUpdateBatch(node->kind, lock_manager.tls) :
+                        nullptr;
+                if(batch != nullptr)
+                {
+                    batch->add(b, bi, lock_manager, node->kind);
+                    if(std::find(batches.begin(), batches.end(), batch) == batches.end())
+                        batches.push_back(batch);
+                }
+                else
+                {
+                    b.descriptor->tick(*this, b, bi, lock_manager, node->kind);
+                }
+            }
+
+            BlockUpdate *deleteMe = node;
+            node = node->chunk_next;
+            if(node != nullptr)
+                node->chunk_prev = nullptr;
+            BlockUpdate::free(deleteMe, lock_manager.tls);
+            if(ranUpdateCount++ > 500)
+            {
+                lock_manager.clear();
+                ranUpdateCount = 0;
             }
-            phase = blockUpdateCurrentPhase;
         }
+        for(BlockUpdateBatch *batch : batches)
+            batch->run(*this, lock_manager);
+        batches.clear();
         if(destructing)
-            return;
-        didAnything = false;
+            break;
+    }
+}
+
+void World::blockUpdateThreadFn(TLS &tls, std::size_t workerIndex)
+{
+    setThreadPriority(ThreadPriority::Low);
+    ThreadPauseGuard pauseGuard(*this, true);
+    BlockChunkMap *chunks = &physicsWorld->chunks;
+    const std::size_t workerCount = blockUpdateBarrier.getThreadCount();
+    bool barrierSense = false;
+    BlockUpdatePhase phase = BlockUpdatePhase::InitialPhase;
+    std::vector<BlockUpdateBatch *> batches;
+    while(!destructing)
+    {
         for(auto chunkIter = chunks->begin(); chunkIter != chunks->end(); chunkIter++)
         {
             if(destructing)
                 break;
+            if(std::hash<PositionI>()(chunkIter->basePosition) % workerCount != workerIndex)
+                continue;
             if(!chunkIter->isLoaded())
                 continue;
             std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(tls);
             if(chunkIter.is_locked())
                 chunkIter.unlock();
             pauseGuard.checkForPause();
-            BlockIterator cbi(chunk, chunks, chunk->basePosition, VectorI(0));
             WorldLockManager lock_manager(tls);
-            std::size_t ranUpdateCount = 0;
-            for(BlockUpdate *node = removeAllReadyBlockUpdatesInChunk(phase, cbi, lock_manager);
-                node != nullptr;
-                node = removeAllReadyBlockUpdatesInChunk(phase, cbi, lock_manager))
-            {
-                didAnything = true;
-                while(node != nullptr)
-                {
-                    BlockIterator bi = cbi;
-                    bi.moveTo(node->position, lock_manager);
-                    Block b = bi.get(lock_manager);
-                    if(b.good() && b.descriptor->handledUpdateKinds[node->kind])
-                    {
-                        b.descriptor->tick(*this, b, bi, lock_manager, node->kind);
-                    }
-
-                    BlockUpdate *deleteMe = node;
-                    node = node->chunk_next;
-                    if(node != nullptr)
-                        node->chunk_prev = nullptr;
-                    BlockUpdate::free(deleteMe, lock_manager.tls);
-                    if(ranUpdateCount++ > 500)
-                    {
-                        lock_manager.clear();
-                        ranUpdateCount = 0;
-                    }
-                }
-                if(destructing)
-                    break;
-            }
+            runBlockUpdatesInChunk(chunk, phase, lock_manager, batches, -1);
         }
         pauseGuard.checkForPause();
+        BlockUpdatePhase nextPhase = BlockUpdatePhaseNext(phase);
+        bool finishedTick = nextPhase == BlockUpdatePhase::InitialPhase;
+        if(!blockUpdateBarrier.wait(barrierSense,
+                                    [&]()
+                                    {
+                                        if(!finishedTick)
+                                            return;
+                                        blockUpdateTickCount++;
+                                        auto now = std::chrono::steady_clock::now();
+                                        auto tickDuration = std::chrono::duration_cast<
+                                            std::chrono::steady_clock::duration>(
+                                            std::chrono::duration<double>(
+                                                1.0 / blockUpdateTicksPerSecond.load()));
+                                        blockUpdateNextTickTime += tickDuration;
+                                        if(blockUpdateNextTickTime < now)
+                                            blockUpdateNextTickTime = now; // don't try to catch up
+                                    },
+                                    [&]()
+                                    {
+                                        pauseGuard.checkForPause();
+                                        return !destructing;
+                                    }))
+            return;
+        phase = nextPhase;
+        if(finishedTick)
+            std::this_thread::sleep_until(blockUpdateNextTickTime);
     }
 }
 
@@ -1300,8 +1512,10 @@ void World::generateChunk(std::shared_ptr<BlockChunk> chunk,
             {
                 srcSubchunkList.erase(
                     WrappedEntity::SubchunkListType::const_iterator(srcSubchunkIter));
+                srcSubchunk->entityCount--;
                 srcChunkIter =
                     srcChunkList.erase(WrappedEntity::ChunkListType::const_iterator(srcChunkIter));
+                gcbi.chunk->getChunkVariables().entityCount--;
                 continue;
             }
             srcChunkIter->lastEntityRunCount = 0;
@@ -1330,7 +1544,11 @@ void World::generateChunk(std::shared_ptr<BlockChunk> chunk,
             srcChunkIter->currentChunk = destBi.chunk.get();
             srcChunkIter->currentSubchunk = &destBi.getSubchunk();
             destChunkList.splice(destChunkList.end(), srcChunkList, srcChunkIter);
+            gcbi.chunk->getChunkVariables().entityCount--;
+            cbi.chunk->getChunkVariables().entityCount++;
             destSubchunkList.splice(destSubchunkList.end(), srcSubchunkList, srcSubchunkIter);
+            srcSubchunk->entityCount--;
+            destBi.getSubchunk().entityCount++;
             srcChunkIter = nextSrcIter;
         }
     }
@@ -1357,7 +1575,8 @@ void World::generateChunk(std::shared_ptr<BlockChunk> chunk,
                                                 BlockChunk::chunkSizeZ - 1),
                   lock_manager,
                   *blocks,
-                  VectorI(0));
+                  VectorI(0),
+                  true);
     lock_manager.clear();
 }
 
@@ -1482,6 +1701,22 @@ float boxDistanceSquared(VectorF minCorner, VectorF maxCorner, VectorF pos)
 }
 }
 
+bool World::isInView(PositionF position)
+{
+    std::unique_lock<std::mutex> lockIt(viewPointsLock);
+    for(ViewPoint *viewPoint : viewPoints)
+    {
+        PositionF viewPointPosition;
+        std::int32_t viewDistance;
+        viewPoint->getPositionAndViewDistance(viewPointPosition, viewDistance);
+        if(viewPointPosition.d != position.d)
+            continue;
+        if(absSquared(viewPointPosition - position) <= (float)viewDistance * viewDistance)
+            return true;
+    }
+    return false;
+}
+
 float World::getChunkGeneratePriority(
     BlockIterator bi,
     WorldLockManager &lock_manager) // low values mean high priority, NAN means don't generate
@@ -1519,13 +1754,35 @@ float World::getChunkGeneratePriority(
             retvalSet = true;
         }
     }
-    if(!retvalSet)
-        return NAN;
-    return retval;
-}
-
-namespace
-{
+    lockIt.unlock();
+    if(deterministic)
+    {
+        // World::stepDeterministic waits for the chunks around every player to be generated
+        const float maxDistance =
+            static_cast<float>((DeterministicSimulationDistance + 3) * BlockChunk::chunkSizeX);
+        LockedPlayers lockedPlayers = players().lock();
+        for(std::shared_ptr<Player> player : lockedPlayers)
+        {
+            PositionF pos = player->getPosition();
+            PositionF posXZ = pos;
+            posXZ.y = 0;
+            float distSquared = boxDistanceSquared(chunkMinCornerXZ, chunkMaxCornerXZ, posXZ);
+            if(pos.d != bi.position().d || distSquared > maxDistance * maxDistance)
+                continue;
+            if(!retvalSet || retval > distSquared)
+            {
+                retval = distSquared;
+                retvalSet = true;
+            }
+        }
+    }
+    if(!retvalSet)
+        return NAN;
+    return retval;
+}
+
+namespace
+{
 std::shared_ptr<BlockChunk> &getLoadIntoChunk(TLS &tls)
 {
     struct retval_tls_tag
@@ -1574,7 +1831,10 @@ Entity *World::addEntity(EntityDescriptorPointer descriptor,
     entity->currentChunk = bi.chunk.get();
     entity->currentSubchunk = &bi.getSubchunk();
     chunkList.push_back(entity);
+    bi.chunk->getChunkVariables().entityCount++;
+    bi.chunk->getChunkVariables().saveDirty = true;
     subchunkList.push_back(entity);
+    bi.getSubchunk().entityCount++;
     entity->verify();
     return &entity->entity;
 }
@@ -1585,6 +1845,20 @@ void World::move(double deltaTime, WorldLockManager &lock_manager)
     std::unique_lock<std::mutex> lockStateLock(stateLock);
     if(isPaused)
         return;
+    if(deterministic)
+    {
+        lockStateLock.unlock();
+        constexpr double stepDuration = 1.0 / DeterministicStepsPerSecond;
+        constexpr double maxBacklog = 0.25; // don't try to catch up after a long frame
+        deterministicTimeAccumulator =
+            std::min(deterministicTimeAccumulator + deltaTime, maxBacklog);
+        while(deterministicTimeAccumulator >= stepDuration && !destructing)
+        {
+            deterministicTimeAccumulator -= stepDuration;
+            stepDeterministic(lock_manager);
+        }
+        return;
+    }
     while(waitingForMoveEntities && !destructing)
     {
         stateCond.wait(lockStateLock);
@@ -1595,9 +1869,148 @@ void World::move(double deltaTime, WorldLockManager &lock_manager)
     stateCond.notify_all();
 }
 
+template <typename RandomGenerator>
+void World::runRandomTicksInChunk(std::shared_ptr<BlockChunk> chunk,
+                                  double deltaTime,
+                                  WorldLockManager &lock_manager,
+                                  RandomGenerator &randomGenerator)
+{
+    BlockIterator cbi(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0));
+    std::size_t ranRandomTickCount = 0;
+    // only sample subchunks that have blocks that tick randomly; the tick rate per
+    // block stays the same because the sample count scales with the sampled volume
+    checked_array<VectorI,
+                  BlockChunk::subchunkCountX * BlockChunk::subchunkCountY
+                      * BlockChunk::subchunkCountZ> tickingSubchunks;
+    std::size_t tickingSubchunkCount = 0;
+    for(VectorI subchunkIndex = VectorI(0); subchunkIndex.x < BlockChunk::subchunkCountX;
+        subchunkIndex.x++)
+    {
+        for(subchunkIndex.y = 0; subchunkIndex.y < BlockChunk::subchunkCountY; subchunkIndex.y++)
+        {
+            for(subchunkIndex.z = 0; subchunkIndex.z < BlockChunk::subchunkCountZ;
+                subchunkIndex.z++)
+            {
+                if(chunk->subchunks[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z]
+                       .randomlyTickingBlockCount.load(std::memory_order_relaxed)
+                   != 0)
+                    tickingSubchunks[tickingSubchunkCount++] = subchunkIndex;
+            }
+        }
+    }
+    double fRandomTickCount =
+        deltaTime * (20.0f * 3.0f / 16.0f / 16.0f / 16.0f * BlockChunk::subchunkSizeXYZ
+                     * BlockChunk::subchunkSizeXYZ * BlockChunk::subchunkSizeXYZ
+                     * tickingSubchunkCount);
+    // fRandomTickCount *= 5;
+    int randomTickCount = 0;
+    if(tickingSubchunkCount > 0)
+        randomTickCount = static_cast<int>(
+            std::floor(fRandomTickCount + std::generate_canonical<float, 20>(randomGenerator)));
+    for(int i = 0; i < randomTickCount; i++)
+    {
+        VectorI relativePosition =
+            BlockChunk::getChunkRelativePositionFromSubchunkIndex(
+                tickingSubchunks[std::uniform_int_distribution<std::size_t>(
+                    0, tickingSubchunkCount - 1)(randomGenerator)])
+            + VectorI(
+                  std::uniform_int_distribution<>(0, BlockChunk::subchunkSizeXYZ - 1)(
+                      randomGenerator),
+                  std::uniform_int_distribution<>(0, BlockChunk::subchunkSizeXYZ - 1)(
+                      randomGenerator),
+                  std::uniform_int_distribution<>(0, BlockChunk::subchunkSizeXYZ - 1)(
+                      randomGenerator));
+        BlockIterator bi = cbi;
+        bi.moveBy(relativePosition, lock_manager);
+        if(ranRandomTickCount++ > 500)
+        {
+            ranRandomTickCount = 0;
+            lock_manager.clear();
+        }
+        Block b = bi.get(lock_manager);
+        if(b.good())
+        {
+            b.descriptor->randomTick(b, *this, bi, lock_manager);
+        }
+    }
+}
+
+void World::moveEntitiesInChunk(std::shared_ptr<BlockChunk> chunk,
+                                double deltaTime,
+                                WorldLockManager &lock_manager)
+{
+    BlockIterator cbi(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0));
+    std::unique_lock<std::recursive_mutex> lockChunk(chunk->getChunkVariables().entityListLock);
+    WrappedEntity::ChunkListType &chunkEntityList = chunk->getChunkVariables().entityList;
+    if(chunkEntityList.begin() != chunkEntityList.end())
+        chunk->getChunkVariables().saveDirty = true; // the entities move or are removed
+    auto i = chunkEntityList.begin();
+    while(i != chunkEntityList.end())
+    {
+        WrappedEntity &entity = *i;
+        if(!entity.entity.good())
+        {
+            lock_manager.block_biome_lock.set(entity.currentSubchunk->lock);
+            WrappedEntity::SubchunkListType &subchunkEntityList =
+                entity.currentSubchunk->entityList;
+            subchunkEntityList.erase(subchunkEntityList.to_iterator(&entity));
+            entity.currentSubchunk->entityCount--;
+            i = chunkEntityList.erase(i);
+            chunk->getChunkVariables().entityCount--;
+            continue;
+        }
+        if(entity.lastEntityRunCount >= entityRunCount)
+        {
+            ++i;
+            continue;
+        }
+        entity.lastEntityRunCount = entityRunCount;
+        entity.verify();
+        BlockIterator destBi = cbi;
+        destBi.moveTo((PositionI)entity.entity.physicsObject->getPosition(), lock_manager);
+        entity.entity.descriptor->moveStep(entity.entity, *this, lock_manager, deltaTime);
+        if(entity.currentChunk == destBi.chunk.get()
+           && entity.currentSubchunk == &destBi.getSubchunk())
+        {
+            ++i;
+            entity.verify();
+            continue;
+        }
+        lock_manager.block_biome_lock.set(entity.currentSubchunk->lock);
+        WrappedEntity::SubchunkListType &subchunkEntityList = entity.currentSubchunk->entityList;
+        subchunkEntityList.detach(subchunkEntityList.to_iterator(&entity));
+        entity.currentSubchunk->entityCount--;
+        destBi.updateLock(lock_manager);
+        entity.currentSubchunk = &destBi.getSubchunk();
+        WrappedEntity::SubchunkListType &subchunkDestEntityList =
+            entity.currentSubchunk->entityList;
+        subchunkDestEntityList.push_back(&entity);
+        entity.currentSubchunk->entityCount++;
+        if(entity.currentChunk == destBi.chunk.get())
+        {
+            ++i;
+            entity.verify();
+            continue;
+        }
+        auto nextI = i;
+        ++nextI;
+        std::unique_lock<std::recursive_mutex> lockChunk(
+            destBi.chunk->getChunkVariables().entityListLock);
+        WrappedEntity::ChunkListType &chunkDestEntityList =
+            destBi.chunk->getChunkVariables().entityList;
+        chunkDestEntityList.splice(chunkDestEntityList.end(), chunkEntityList, i);
+        chunk->getChunkVariables().entityCount--;
+        destBi.chunk->getChunkVariables().entityCount++;
+        destBi.chunk->getChunkVariables().saveDirty = true;
+        entity.currentChunk = destBi.chunk.get();
+        i = nextI;
+        entity.verify();
+    }
+}
+
 void World::moveEntitiesThreadFn(TLS &tls)
 {
-    ThreadPauseGuard pauseGuard(*this);
+    ThreadPauseGuard pauseGuard(*this, true);
     ThreadUsageMonitor usageMonitor(L"move entities", 0.5f);
     auto lastUsageReportTime = std::chrono::steady_clock::now();
     while(!destructing)
@@ -1628,6 +2041,8 @@ void World::moveEntitiesThreadFn(TLS &tls)
         WorldLockManager lock_manager(tls);
         entityRunCount++;
         physicsWorld->stepTime(deltaTime, lock_manager);
+        particleSystem.step(*this, lock_manager, deltaTime);
+        lock_manager.clear();
         BlockChunkMap *chunks = &physicsWorld->chunks;
         for(auto chunkIter = chunks->begin(); chunkIter != chunks->end(); chunkIter++)
         {
@@ -1640,100 +2055,259 @@ void World::moveEntitiesThreadFn(TLS &tls)
             std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(lock_manager.tls);
             if(chunkIter.is_locked())
                 chunkIter.unlock();
-            BlockIterator cbi(chunk, chunks, chunk->basePosition, VectorI(0));
-            std::size_t ranRandomTickCount = 0;
             if(isGenerated && isChunkCloseEnough)
+                runRandomTicksInChunk(chunk, deltaTime, lock_manager, getRandomGenerator());
+            moveEntitiesInChunk(chunk, deltaTime, lock_manager);
+        }
+    }
+}
+
+namespace
+{
+/** @brief the seed for a chunk's random tick stream in a deterministic step */
+std::uint64_t getChunkRandomSeed(World::SeedType worldSeed,
+                                 PositionI chunkBasePosition,
+                                 std::uint64_t stepIndex)
+{
+    std::uint64_t retval = worldSeed;
+    auto mix = [&](std::uint64_t v)
+    {
+        // splitmix64 finalizer
+        retval += v + 0x9E3779B97F4A7C15ULL;
+        retval = (retval ^ (retval >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        retval = (retval ^ (retval >> 27)) * 0x94D049BB133111EBULL;
+        retval ^= retval >> 31;
+    };
+    mix(static_cast<std::uint32_t>(chunkBasePosition.x));
+    mix(static_cast<std::uint32_t>(chunkBasePosition.y));
+    mix(static_cast<std::uint32_t>(chunkBasePosition.z));
+    mix(static_cast<std::uint32_t>(chunkBasePosition.d));
+    mix(stepIndex);
+    return retval;
+}
+
+/** @brief 64-bit FNV-1a */
+struct StateHasher final
+{
+    std::uint64_t value = 0xCBF29CE484222325ULL;
+    void add(std::uint64_t v)
+    {
+        for(int i = 0; i < 8; i++, v >>= 8)
+        {
+            value ^= v & 0xFF;
+            value *= 0x100000001B3ULL;
+        }
+    }
+    void add(const std::wstring &str)
+    {
+        add(static_cast<std::uint64_t>(str.size()));
+        for(wchar_t ch : str)
+            add(static_cast<std::uint64_t>(ch));
+    }
+    void add(float v)
+    {
+        add(static_cast<std::uint64_t>(static_cast<std::int64_t>(std::floor(v * 256.0f + 0.5f))));
+    }
+    void add(PositionI v)
+    {
+        add(static_cast<std::uint64_t>(static_cast<std::uint32_t>(v.x)));
+        add(static_cast<std::uint64_t>(static_cast<std::uint32_t>(v.y)));
+        add(static_cast<std::uint64_t>(static_cast<std::uint32_t>(v.z)));
+        add(static_cast<std::uint64_t>(v.d));
+    }
+    void add(PositionF v)
+    {
+        add(v.x);
+        add(v.y);
+        add(v.z);
+        add(static_cast<std::uint64_t>(v.d));
+    }
+    void add(VectorF v)
+    {
+        add(v.x);
+        add(v.y);
+        add(v.z);
+    }
+};
+}
+
+void World::setDeterministic(bool newDeterministic, WorldLockManager &lock_manager)
+{
+    bool wasPaused = paused();
+    paused(true, lock_manager); // wait for every thread to stop at a pause point
+    {
+        std::unique_lock<std::mutex> lockIt(stateLock);
+        deterministic = newDeterministic;
+        deterministicTimeAccumulator = 0;
+    }
+    paused(wasPaused, lock_manager);
+}
+
+std::vector<std::shared_ptr<BlockChunk>> World::getDeterministicSimulationChunks(
+    WorldLockManager &lock_manager)
+{
+    // generate enough extra chunks that light from chunks that aren't generated yet can't reach the
+    // simulated chunks
+    constexpr std::int32_t generateMargin = 2;
+    constexpr std::int32_t generateDistance = DeterministicSimulationDistance + generateMargin;
+    lock_manager.clear();
+    std::vector<PositionI> playerChunkPositions;
+    {
+        LockedPlayers lockedPlayers = players().lock();
+        for(std::shared_ptr<Player> player : lockedPlayers)
+        {
+            PositionI position =
+                BlockChunk::getChunkBasePosition((PositionI)player->getPosition());
+            position.y = 0;
+            playerChunkPositions.push_back(position);
+        }
+    }
+    std::vector<std::shared_ptr<BlockChunk>> retval;
+    for(PositionI playerChunkPosition : playerChunkPositions)
+    {
+        for(std::int32_t dx = -generateDistance; dx <= generateDistance; dx++)
+        {
+            for(std::int32_t dz = -generateDistance; dz <= generateDistance; dz++)
             {
-                double fRandomTickCount =
-                    deltaTime * (20.0f * 3.0f / 16.0f / 16.0f / 16.0f * BlockChunk::chunkSizeX
-                                 * BlockChunk::chunkSizeY * BlockChunk::chunkSizeZ);
-                // fRandomTickCount *= 5;
-                int randomTickCount = static_cast<int>(std::floor(
-                    fRandomTickCount + std::generate_canonical<float, 20>(getRandomGenerator())));
-                for(int i = 0; i < randomTickCount; i++)
+                PositionI position =
+                    playerChunkPosition
+                    + VectorI(dx * BlockChunk::chunkSizeX, 0, dz * BlockChunk::chunkSizeZ);
+                BlockIterator bi = getBlockIterator(position, lock_manager.tls);
+                while(!bi.chunk->getChunkVariables().generated)
                 {
-                    VectorI relativePosition =
-                        VectorI(std::uniform_int_distribution<>(
-                                    0, BlockChunk::chunkSizeX - 1)(getRandomGenerator()),
-                                std::uniform_int_distribution<>(
-                                    0, BlockChunk::chunkSizeY - 1)(getRandomGenerator()),
-                                std::uniform_int_distribution<>(
-                                    0, BlockChunk::chunkSizeZ - 1)(getRandomGenerator()));
-                    BlockIterator bi = cbi;
-                    bi.moveBy(relativePosition, lock_manager);
-                    if(ranRandomTickCount++ > 500)
-                    {
-                        ranRandomTickCount = 0;
-                        lock_manager.clear();
-                    }
-                    Block b = bi.get(lock_manager);
-                    if(b.good())
-                    {
-                        b.descriptor->randomTick(b, *this, bi, lock_manager);
-                    }
+                    if(destructing)
+                        return retval;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
                 }
+                if(std::abs(dx) <= DeterministicSimulationDistance
+                   && std::abs(dz) <= DeterministicSimulationDistance)
+                    retval.push_back(bi.chunk);
             }
-            std::unique_lock<std::recursive_mutex> lockChunk(
-                chunk->getChunkVariables().entityListLock);
-            WrappedEntity::ChunkListType &chunkEntityList = chunk->getChunkVariables().entityList;
-            auto i = chunkEntityList.begin();
-            while(i != chunkEntityList.end())
+        }
+    }
+    std::sort(retval.begin(),
+              retval.end(),
+              [](const std::shared_ptr<BlockChunk> &a, const std::shared_ptr<BlockChunk> &b)
+              {
+                  return positionLess(a->basePosition, b->basePosition);
+              });
+    retval.erase(std::unique(retval.begin(), retval.end()), retval.end());
+    return retval;
+}
+
+void World::stepDeterministic(WorldLockManager &lock_manager)
+{
+    assert(deterministic);
+    constexpr double deltaTime = 1.0 / DeterministicStepsPerSecond;
+    lock_manager.clear();
+    std::uint64_t stepIndex = ++deterministicStepCount;
+    std::shared_ptr<DeterministicStepListener> listener = deterministicStepListener;
+    if(listener)
+        listener->beforeStep(*this, stepIndex, lock_manager);
+    lock_manager.clear();
+    std::vector<std::shared_ptr<BlockChunk>> chunks =
+        getDeterministicSimulationChunks(lock_manager);
+    runLightingUntilStable(lock_manager);
+    std::vector<BlockUpdateBatch *> batches;
+    BlockUpdatePhase phase = BlockUpdatePhase::InitialPhase;
+    do
+    {
+        for(const std::shared_ptr<BlockChunk> &chunk : chunks)
+        {
+            if(destructing)
+                return;
+            runBlockUpdatesInChunk(chunk,
+                                   phase,
+                                   lock_manager,
+                                   batches,
+                                   phase == BlockUpdatePhase::InitialPhase ? deltaTime : 0);
+        }
+        phase = BlockUpdatePhaseNext(phase);
+    } while(phase != BlockUpdatePhase::InitialPhase);
+    blockUpdateTickCount++;
+    advanceTimeOfDay(deltaTime);
+    entityRunCount++;
+    physicsWorld->stepTime(deltaTime, lock_manager);
+    particleSystem.step(*this, lock_manager, deltaTime);
+    lock_manager.clear();
+    for(const std::shared_ptr<BlockChunk> &chunk : chunks)
+    {
+        XorShift128Plus randomGenerator(
+            getChunkRandomSeed(worldGeneratorSeed, chunk->basePosition, stepIndex));
+        runRandomTicksInChunk(chunk, deltaTime, lock_manager, randomGenerator);
+        moveEntitiesInChunk(chunk, deltaTime, lock_manager);
+    }
+    lock_manager.clear();
+    if(listener)
+        listener->afterStep(*this, stepIndex, lock_manager);
+    lock_manager.clear();
+}
+
+std::uint64_t World::hashDeterministicState(WorldLockManager &lock_manager)
+{
+    std::vector<std::shared_ptr<BlockChunk>> chunks =
+        getDeterministicSimulationChunks(lock_manager);
+    StateHasher hasher;
+    hasher.add(deterministicStepCount.load());
+    {
+        float timeOfDayInSeconds;
+        int moonPhase;
+        getTimeOfDayInSeconds(timeOfDayInSeconds, moonPhase);
+        hasher.add(timeOfDayInSeconds);
+        hasher.add(static_cast<std::uint64_t>(moonPhase));
+    }
+    // descriptor addresses change from run to run, so hash names instead
+    std::unordered_map<const void *, std::uint64_t> nameHashes;
+    auto getNameHash = [&](const void *descriptor, const std::wstring &name) -> std::uint64_t
+    {
+        auto iter = nameHashes.find(descriptor);
+        if(iter != nameHashes.end())
+            return iter->second;
+        StateHasher nameHasher;
+        nameHasher.add(name);
+        nameHashes[descriptor] = nameHasher.value;
+        return nameHasher.value;
+    };
+    for(const std::shared_ptr<BlockChunk> &chunk : chunks)
+    {
+        hasher.add(chunk->basePosition);
+        BlockIterator cbi(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0));
+        for(std::int32_t x = 0; x < BlockChunk::chunkSizeX; x++)
+        {
+            for(std::int32_t z = 0; z < BlockChunk::chunkSizeZ; z++)
             {
-                WrappedEntity &entity = *i;
-                if(!entity.entity.good())
-                {
-                    lock_manager.block_biome_lock.set(entity.currentSubchunk->lock);
-                    WrappedEntity::SubchunkListType &subchunkEntityList =
-                        entity.currentSubchunk->entityList;
-                    subchunkEntityList.erase(subchunkEntityList.to_iterator(&entity));
-                    i = chunkEntityList.erase(i);
-                    continue;
-                }
-                if(entity.lastEntityRunCount >= entityRunCount)
-                {
-                    ++i;
-                    continue;
-                }
-                entity.lastEntityRunCount = entityRunCount;
-                entity.verify();
-                BlockIterator destBi = cbi;
-                destBi.moveTo((PositionI)entity.entity.physicsObject->getPosition(), lock_manager);
-                entity.entity.descriptor->moveStep(entity.entity, *this, lock_manager, deltaTime);
-                if(entity.currentChunk == destBi.chunk.get()
-                   && entity.currentSubchunk == &destBi.getSubchunk())
-                {
-                    ++i;
-                    entity.verify();
-                    continue;
-                }
-                lock_manager.block_biome_lock.set(entity.currentSubchunk->lock);
-                WrappedEntity::SubchunkListType &subchunkEntityList =
-                    entity.currentSubchunk->entityList;
-                subchunkEntityList.detach(subchunkEntityList.to_iterator(&entity));
-                destBi.updateLock(lock_manager);
-                entity.currentSubchunk = &destBi.getSubchunk();
-                WrappedEntity::SubchunkListType &subchunkDestEntityList =
-                    entity.currentSubchunk->entityList;
-                subchunkDestEntityList.push_back(&entity);
-                if(entity.currentChunk == destBi.chunk.get())
+                BlockIterator bi = cbi;
+                bi.moveBy(VectorI(x, 0, z), lock_manager);
+                for(std::int32_t y = 0; y < BlockChunk::chunkSizeY;
+                    y++, bi.moveTowardPY(lock_manager))
                 {
-                    ++i;
-                    entity.verify();
-                    continue;
+                    Block b = bi.get(lock_manager);
+                    if(!b.good())
+                    {
+                        hasher.add(static_cast<std::uint64_t>(0));
+                        continue;
+                    }
+                    hasher.add(getNameHash(b.descriptor, b.descriptor->name));
+                    hasher.add(static_cast<std::uint64_t>(b.lighting.directSkylight)
+                               | static_cast<std::uint64_t>(b.lighting.indirectSkylight) << 8
+                               | static_cast<std::uint64_t>(b.lighting.indirectArtificalLight)
+                                     << 16);
                 }
-                auto nextI = i;
-                ++nextI;
-                std::unique_lock<std::recursive_mutex> lockChunk(
-                    destBi.chunk->getChunkVariables().entityListLock);
-                WrappedEntity::ChunkListType &chunkDestEntityList =
-                    chunk->getChunkVariables().entityList;
-                chunkDestEntityList.splice(chunkDestEntityList.end(), chunkEntityList, i);
-                entity.currentChunk = destBi.chunk.get();
-                i = nextI;
-                entity.verify();
             }
         }
+        lock_manager.clear();
+        std::unique_lock<std::recursive_mutex> lockChunk(
+            chunk->getChunkVariables().entityListLock);
+        for(WrappedEntity &entity : chunk->getChunkVariables().entityList)
+        {
+            if(!entity.entity.good())
+                continue;
+            hasher.add(getNameHash(entity.entity.descriptor, entity.entity.descriptor->name));
+            hasher.add(entity.entity.physicsObject->getPosition());
+            hasher.add(entity.entity.physicsObject->getVelocity());
+        }
     }
+    return hasher.value;
 }
 
 RayCasting::Collision World::castRayCheckForEntitiesInSubchunk(BlockIterator bi,
@@ -1821,10 +2395,13 @@ void World::generateParticlesInSubchunk(BlockIterator sbi,
                                         WorldLockManager &lock_manager,
                                         double currentTime,
                                         double deltaTime,
-                                        std::vector<PositionI> &positions)
+                                        std::vector<PositionI> &positions,
+                                        ParticleBatch &newParticles)
 {
     positions.clear();
     BlockChunkSubchunk &subchunk = sbi.getSubchunk();
+    if(subchunk.particleGeneratingBlockCount.load(std::memory_order_relaxed) == 0)
+        return;
     sbi.updateLock(lock_manager);
     subchunk.addToParticleGeneratingBlockList(positions);
     for(PositionI pos : positions)
@@ -1833,16 +2410,18 @@ void World::generateParticlesInSubchunk(BlockIterator sbi,
         bi.moveTo(pos, lock_manager);
         Block b = bi.get(lock_manager);
         if(b.good())
-            b.descriptor->generateParticles(*this, b, bi, lock_manager, currentTime, deltaTime);
+            b.descriptor->generateParticles(
+                *this, b, bi, lock_manager, currentTime, deltaTime, newParticles);
     }
 }
 
 void World::particleGeneratingThreadFn(TLS &tls)
 {
     double currentTime = 0;
-    ThreadPauseGuard pauseGuard(*this);
+    ThreadPauseGuard pauseGuard(*this, true);
     auto lastTimePoint = std::chrono::steady_clock::now();
     std::vector<PositionI> positionsBuffer;
+    ParticleBatch newParticles;
     WorldLockManager lock_manager(tls);
     while(!destructing)
     {
@@ -1862,7 +2441,7 @@ void World::particleGeneratingThreadFn(TLS &tls)
                 PositionF position;
                 std::int32_t viewDistance;
                 viewPoint->getPositionAndViewDistance(position, viewDistance);
-                float generateDistance = 30.0f;
+                float generateDistance = std::min<float>(30.0f, viewDistance);
                 viewPointsVector.emplace_back(position, generateDistance);
             }
         }
@@ -1906,12 +2485,18 @@ void World::particleGeneratingThreadFn(TLS &tls)
                             continue;
                         BlockIterator sbi = gbi;
                         sbi.moveTo(pos, lock_manager);
-                        generateParticlesInSubchunk(
-                            sbi, lock_manager, currentTime, deltaTime, positionsBuffer);
+                        generateParticlesInSubchunk(sbi,
+                                                    lock_manager,
+                                                    currentTime,
+                                                    deltaTime,
+                                                    positionsBuffer,
+                                                    newParticles);
                     }
                 }
             }
         }
+        lock_manager.clear();
+        particleSystem.addBatch(newParticles, *this);
 
         currentTime += deltaTime;
     }
@@ -1920,8 +2505,11 @@ void World::particleGeneratingThreadFn(TLS &tls)
 void World::invalidateBlockRange(BlockIterator blockIterator,
                                  VectorI minCorner,
                                  VectorI maxCorner,
-                                 WorldLockManager &lock_manager)
+                                 WorldLockManager &lock_manager,
+                                 bool lightingPrecomputed)
 {
+    const VectorI precomputedMinCorner = minCorner + VectorI(2);
+    const VectorI precomputedMaxCorner = maxCorner - VectorI(2);
     BlockChunkSubchunk *lastSubchunk = nullptr;
     BlockChunkChunkVariables *lastChunk = nullptr;
     std::unique_lock<std::mutex> lockIt;
@@ -1979,8 +2567,7 @@ void World::invalidateBlockRange(BlockIterator blockIterator,
                             BlockOptionalData *blockOptionalData =
                                 subchunk.blockOptionalData.get_or_make(
                                     BlockChunk::getSubchunkRelativePosition(
-                                        biXYZ.currentRelativePosition),
-                                    lock_manager.tls);
+                                        biXYZ.currentRelativePosition));
                             biXYZ.getBlock().hasOptionalData = true;
                             auto blockDescriptor = subchunk.getBlockKind(b);
                             enum_array<bool, BlockUpdateKind> neededBlockUpdates;
@@ -1990,12 +2577,21 @@ void World::invalidateBlockRange(BlockIterator blockIterator,
                                     (blockDescriptor && blockDescriptor->handledUpdateKinds[kind]
                                      && BlockUpdateKindDefaultPeriod(kind) == 0);
                             }
-                            if(p.x > currentMinCorner.x && p.x < currentMaxCorner.x
-                               && p.y > currentMinCorner.y
-                               && p.y < currentMaxCorner.y
-                               && p.z > currentMinCorner.z
-                               && p.z < currentMaxCorner.z
-                               && blockDescriptor)
+                            if(lightingPrecomputed && p.x >= precomputedMinCorner.x
+                               && p.x <= precomputedMaxCorner.x
+                               && p.y >= precomputedMinCorner.y
+                               && p.y <= precomputedMaxCorner.y
+                               && p.z >= precomputedMinCorner.z
+                               && p.z <= precomputedMaxCorner.z)
+                            {
+                                neededBlockUpdates[BlockUpdateKind::Lighting] = false;
+                            }
+                            else if(p.x > currentMinCorner.x && p.x < currentMaxCorner.x
+                                    && p.y > currentMinCorner.y
+                                    && p.y < currentMaxCorner.y
+                                    && p.z > currentMinCorner.z
+                                    && p.z < currentMaxCorner.z
+                                    && blockDescriptor)
                             {
                                 BlockIterator binx = biXYZ;
                                 BlockIterator bipx = biXYZ;
@@ -2027,8 +2623,9 @@ void World::invalidateBlockRange(BlockIterator blockIterator,
                             {
                                 if(neededBlockUpdates[pnode->kind])
                                 {
-                                    if(pnode->time_left > 0)
-                                        pnode->time_left = 0;
+                                    if(pnode->getTimeLeft() > 0)
+                                        biXYZ.chunk->getChunkVariables().blockUpdates.reschedule(
+                                            pnode, 0);
                                     neededBlockUpdates[pnode->kind] = false;
                                 }
                                 ppnode = &pnode->block_next;
@@ -2042,22 +2639,13 @@ void World::invalidateBlockRange(BlockIterator blockIterator,
                                         BlockUpdate::allocate(lock_manager.tls,
                                                               kind,
                                                               biXYZ.position(),
-                                                              0.0f,
                                                               blockOptionalData->updateListHead);
+                                    biXYZ.chunk->getChunkVariables().saveDirty = true;
                                     bi.chunk->getChunkVariables()
                                         .blockUpdatesPerPhase[BlockUpdateKindPhase(kind)]++;
                                     blockOptionalData->updateListHead = pnode;
-                                    pnode->chunk_next =
-                                        biXYZ.chunk->getChunkVariables().blockUpdateListHead;
-                                    pnode->chunk_prev = nullptr;
-                                    if(biXYZ.chunk->getChunkVariables().blockUpdateListHead
-                                       != nullptr)
-                                        biXYZ.chunk->getChunkVariables()
-                                            .blockUpdateListHead->chunk_prev = pnode;
-                                    else
-                                        biXYZ.chunk->getChunkVariables().blockUpdateListTail =
-                                            pnode;
-                                    biXYZ.chunk->getChunkVariables().blockUpdateListHead = pnode;
+                                    biXYZ.chunk->getChunkVariables().blockUpdates.insert(pnode,
+                                                                                         0.0f);
                                 }
                             }
                         }
@@ -2076,174 +2664,953 @@ void World::invalidateBlockRange(BlockIterator blockIterator,
     }
 }
 
-void World::write(stream::Writer &writerIn, WorldLockManager &lock_manager)
-{
-    bool wasPaused = paused();
-    paused(true, lock_manager);
-    try
-    {
-        stream::write<std::uint32_t>(writerIn, GameVersion::FILE_VERSION);
-        stream::MemoryWriter memWriter;
-        {
-            stream::CompressWriter writer(memWriter);
-            StreamWorldGuard streamWorldGuard(writer, *this, lock_manager);
-            stream::write<SeedType>(writer, worldGeneratorSeed);
-            {
-                std::unique_lock<std::mutex> lockIt(randomGeneratorLock);
-                stream::write<rc4_random_engine>(writer, randomGenerator);
-            }
-            LockedPlayers lockedPlayers = players().lock();
-            stream::write<std::uint64_t>(writer, players().players.size());
-            for(std::shared_ptr<Player> player : lockedPlayers)
-            {
-                player->write(writer);
-            }
-            std::vector<std::shared_ptr<BlockChunk>> chunks;
-            BlockChunkMap *chunksMap = &physicsWorld->chunks;
-            {
-                for(auto chunkIter = chunksMap->begin(); chunkIter != chunksMap->end(); chunkIter++)
-                {
-                    if(!chunkIter->chunkVariables.generated)
-                        continue;
-                    std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(lock_manager.tls);
-                    if(chunkIter.is_locked())
-                        chunkIter.unlock();
-                    chunks.push_back(chunk);
-                }
-            }
-            std::uint64_t chunkCount = chunks.size();
-            stream::write<std::uint64_t>(writer, chunkCount);
-            std::vector<std::tuple<PositionI, float, BlockUpdateKind>> blockUpdates;
-            for(std::shared_ptr<BlockChunk> chunk : chunks)
-            {
-                stream::write<PositionI>(writer, chunk->basePosition);
-                std::vector<WrappedEntity *> entities;
-                {
-                    std::unique_lock<std::recursive_mutex> lockChunk(
-                        chunk->getChunkVariables().entityListLock);
-                    WrappedEntity::ChunkListType &chunkEntityList =
-                        chunk->getChunkVariables().entityList;
-                    for(auto i = chunkEntityList.begin(); i != chunkEntityList.end(); ++i)
-                    {
-                        WrappedEntity &entity = *i;
-                        if(!entity.entity.good())
-                        {
-                            continue;
-                        }
-                        entities.push_back(&entity);
-                    }
-                }
-                stream::write<std::uint64_t>(writer, entities.size());
-                for(WrappedEntity *entity : entities)
-                {
-                    entity->entity.write(writer);
-                }
-                entities.clear();
-                BlockIterator cbi(chunk, chunksMap, chunk->basePosition, VectorI(0, 0, 0));
-                for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
-                {
-                    for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
-                    {
-                        BlockIterator columnBlockIterator = cbi;
-                        columnBlockIterator.moveBy(VectorI(x, 0, z), lock_manager);
-                        stream::write<BiomeProperties>(
-                            writer, columnBlockIterator.getBiomeProperties(lock_manager));
-                        BlockIterator bi = columnBlockIterator;
-                        blockUpdates.clear();
-                        for(std::size_t y = 0; y < BlockChunk::chunkSizeY;
-                            y++, bi.moveTowardPY(lock_manager))
-                        {
-                            stream::write<Block>(writer, bi.get(lock_manager));
-                            for(BlockUpdateIterator iter = bi.updatesBegin(lock_manager);
-                                iter != bi.updatesEnd(lock_manager);
-                                ++iter)
-                            {
-                                blockUpdates.emplace_back(
-                                    iter->getPosition(), iter->getTimeLeft(), iter->getKind());
-                            }
-                        }
-                        stream::write<std::uint32_t>(
-                            writer, static_cast<std::uint32_t>(blockUpdates.size()));
-                        for(auto update : blockUpdates)
-                        {
-                            stream::write<PositionI>(writer, std::get<0>(update));
-                            stream::write<float32_t>(writer, std::get<1>(update));
-                            stream::write<BlockUpdateKind>(writer, std::get<2>(update));
-                        }
-                    }
-                }
-            }
-            std::unique_lock<std::recursive_mutex> lockTimeOfDay(timeOfDayLock);
-            stream::write<float32_t>(writer, timeOfDayInSeconds);
-            stream::write<std::uint8_t>(writer, moonPhase);
-            writer.flush();
-        }
-        lock_manager.clear();
-        writerIn.writeBytes(memWriter.getBuffer().data(), memWriter.getBuffer().size());
-    }
-    catch(stream::IOException &)
-    {
-        paused(wasPaused, lock_manager);
-        throw;
-    }
-    paused(wasPaused, lock_manager);
-}
-
 namespace
 {
-struct file_version_tag_t
+/** @brief get the size a world file record adds to its compressed contents */
+std::uint32_t getWorldFileRecordOverhead(const FileUpgrades::FileLayout &layout)
 {
-};
+    if(!layout.recordChecksums)
+        return sizeof(std::uint32_t);
+    return 2 * sizeof(std::uint32_t);
+}
 
-void setStreamFileVersion(stream::Reader &reader, std::uint32_t fileVersion)
+/** @brief read the compressed contents of a record of a world file
+ *
+ * @param reader the reader of the world file, positioned at the record
+ * @param maxSize the maximum size of the record, including its size and checksum
+ * @param layout the layout of the world file
+ * @exception stream::InvalidDataValueException the record's checksum doesn't match
+ */
+stream::SharedBytes readCompressedWorldFileRecord(stream::Reader &reader,
+                                                  std::uint64_t maxSize,
+                                                  const FileUpgrades::FileLayout &layout)
 {
-    reader.setAssociatedValue<std::uint32_t, file_version_tag_t>(
-        std::make_shared<std::uint32_t>(fileVersion));
+    std::uint32_t size = stream::read<std::uint32_t>(reader);
+    if(size > maxSize
+       || getWorldFileRecordOverhead(layout) + static_cast<std::uint64_t>(size) > maxSize)
+        throw stream::InvalidDataValueException("world file record is too big");
+    stream::SharedBytes retval = reader.readSharedBytes(size);
+    if(layout.recordChecksums)
+    {
+        std::uint32_t crc = stream::read<std::uint32_t>(reader);
+        if(crc != stream::computeCRC32(retval.data(), retval.size()))
+            throw stream::InvalidDataValueException("world file record checksum mismatch");
+    }
+    return retval;
 }
+
+std::vector<std::uint8_t> expandWorldFileRecord(stream::SharedBytes compressed)
+{
+    stream::ExpandReader reader(std::make_shared<stream::MemoryReader>(std::move(compressed)));
+    constexpr std::size_t chunkSize = 1 << 16;
+    std::vector<std::uint8_t> retval;
+    for(;;)
+    {
+        std::size_t size = retval.size();
+        retval.resize(size + chunkSize);
+        std::size_t readCount = reader.readBytes(retval.data() + size, chunkSize);
+        if(readCount < chunkSize)
+        {
+            retval.resize(size + readCount);
+            return retval;
+        }
+    }
 }
 
-std::uint32_t World::getStreamFileVersion(stream::Reader &reader)
+/** @brief read a record of a world file
+ *
+ * @param reader the reader of the world file, positioned at the record
+ * @param maxSize the maximum size of the record, including its size and checksum
+ * @param layout the layout of the world file
+ * @return a reader for the record's contents
+ */
+std::unique_ptr<stream::Reader> readWorldFileRecord(stream::Reader &reader,
+                                                    std::uint64_t maxSize,
+                                                    const FileUpgrades::FileLayout &layout)
 {
-    std::shared_ptr<std::uint32_t> version =
-        reader.getAssociatedValue<std::uint32_t, file_version_tag_t>();
-    assert(version);
-    return *version;
+    return std::unique_ptr<stream::Reader>(
+        new stream::ExpandReader(std::make_shared<stream::MemoryReader>(
+            readCompressedWorldFileRecord(reader, maxSize, layout))));
 }
 
-std::shared_ptr<World> World::read(stream::Reader &readerIn)
+std::vector<std::uint8_t> compressWorldFileRecord(const std::vector<std::uint8_t> &bytes,
+                                                  const World::SaveOptions &options)
 {
-    std::uint32_t fileVersion = stream::read<std::uint32_t>(readerIn);
-    if(fileVersion < 5)
+    int level = options.compressionLevel;
+    switch(options.codec)
     {
-        throw stream::InvalidDataValueException("old file version not supported");
+    case World::SaveOptions::Codec::Deflate:
+        break;
+    case World::SaveOptions::Codec::Uncompressed:
+        level = stream::CompressWriter::MinLevel;
+        break;
     }
-    if(fileVersion > GameVersion::FILE_VERSION)
+    stream::MemoryWriter compressed;
     {
-        throw stream::InvalidDataValueException("newer file version not supported");
+        stream::CompressWriter compressWriter(compressed, level);
+        compressWriter.writeBytes(bytes.data(), bytes.size());
+        compressWriter.flush();
     }
-    stream::ExpandReader reader(readerIn);
-    setStreamFileVersion(reader, fileVersion);
-    SeedType worldGeneratorSeed = stream::read<SeedType>(reader);
-    std::shared_ptr<World> retval = std::make_shared<World>(
-        worldGeneratorSeed, MyWorldGenerator::getInstance(), internal_construct_flag());
-    World &world = *retval;
-    world.chunkUnloaderThread = thread([&world]()
-                                       {
-                                           setThreadName(L"chunk unloader");
-                                           TLS tls;
-                                           world.chunkUnloaderThreadFn(tls);
-                                       });
-    WorldLockManager lock_manager(TLS::getSlow());
-    StreamWorldGuard streamWorldGuard(reader, world, lock_manager);
-    world.randomGenerator = stream::read<rc4_random_engine>(reader);
-    std::uint64_t playerCount = stream::read<std::uint64_t>(reader);
-    for(std::uint64_t i = 0; i < playerCount; i++)
+    return std::move(compressed).getBuffer();
+}
+
+/** @brief write a compressed record of a world file
+ *
+ * @param layout the layout of the world file
+ * @return the size of the record, including its size and checksum
+ */
+std::uint32_t writeWorldFileRecord(stream::Writer &writer,
+                                   const std::vector<std::uint8_t> &compressed,
+                                   const FileUpgrades::FileLayout &layout)
+{
+    const std::uint32_t overhead = getWorldFileRecordOverhead(layout);
+    if(compressed.size() > std::numeric_limits<std::uint32_t>::max() - overhead)
+        throw stream::IOException("world file record is too big");
+    stream::write<std::uint32_t>(writer, static_cast<std::uint32_t>(compressed.size()));
+    writer.writeBytes(compressed.data(), compressed.size());
+    if(layout.recordChecksums)
+        stream::write<std::uint32_t>(writer,
+                                     stream::computeCRC32(compressed.data(), compressed.size()));
+    return static_cast<std::uint32_t>(overhead + compressed.size());
+}
+
+/** @brief run fn(index) for every index below count on up to threadCount threads, passing the
+ * results to consumeFn(index, result) on this thread in index order
+ *
+ * at most a few results per thread are computed ahead of consumeFn. If fn or consumeFn throw, the
+ * threads are stopped and the first exception is rethrown.
+ */
+template <typename Result, typename Fn, typename ConsumeFn>
+void runInOrderOnThreads(std::size_t count,
+                         std::size_t threadCount,
+                         const std::wstring &threadName,
+                         Fn fn,
+                         ConsumeFn consumeFn)
+{
+    threadCount = std::min(threadCount, count);
+    if(threadCount <= 1)
+    {
+        for(std::size_t index = 0; index < count; index++)
+            consumeFn(index, fn(index));
+        return;
+    }
+    const std::size_t maxQueuedCount = 4 * threadCount;
+    std::mutex lock;
+    std::condition_variable resultCond, spaceCond;
+    std::vector<std::unique_ptr<Result>> results(count);
+    std::size_t nextIndex = 0, consumedCount = 0;
+    bool aborted = false;
+    std::exception_ptr exception;
+    auto abort = [&](std::exception_ptr e)
+    {
+        if(!exception)
+            exception = e;
+        aborted = true;
+        resultCond.notify_all();
+        spaceCond.notify_all();
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for(std::size_t i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back(
+            [&]()
+            {
+                setThreadName(threadName);
+                std::unique_lock<std::mutex> lockIt(lock);
+                for(;;)
+                {
+                    while(!aborted && nextIndex < count
+                          && nextIndex >= consumedCount + maxQueuedCount)
+                        spaceCond.wait(lockIt);
+                    if(aborted || nextIndex >= count)
+                        return;
+                    std::size_t index = nextIndex++;
+                    lockIt.unlock();
+                    std::unique_ptr<Result> result;
+                    std::exception_ptr e;
+                    try
+                    {
+                        result.reset(new Result(fn(index)));
+                    }
+                    catch(...)
+                    {
+                        e = std::current_exception();
+                    }
+                    lockIt.lock();
+                    if(e)
+                    {
+                        abort(e);
+                        return;
+                    }
+                    results[index] = std::move(result);
+                    resultCond.notify_all();
+                }
+            });
+    }
+    try
+    {
+        for(std::size_t index = 0; index < count; index++)
+        {
+            std::unique_ptr<Result> result;
+            {
+                std::unique_lock<std::mutex> lockIt(lock);
+                while(!aborted && !results[index])
+                    resultCond.wait(lockIt);
+                if(aborted)
+                    break;
+                result = std::move(results[index]);
+                consumedCount = index + 1;
+                spaceCond.notify_all();
+            }
+            consumeFn(index, std::move(*result));
+        }
+    }
+    catch(...)
+    {
+        std::unique_lock<std::mutex> lockIt(lock);
+        abort(std::current_exception());
+    }
+    for(std::thread &thread : threads)
+        thread.join();
+    if(exception)
+        std::rethrow_exception(exception);
+}
+
+constexpr std::size_t subchunkBlockCount = static_cast<std::size_t>(BlockChunk::subchunkSizeXYZ)
+                                           * BlockChunk::subchunkSizeXYZ
+                                           * BlockChunk::subchunkSizeXYZ;
+constexpr unsigned runLengthBitCount = 3 * BlockChunk::subchunkShiftXYZ;
+constexpr unsigned packedLightingBitCount = 3 * Lighting::lightBitWidth;
+static_assert(subchunkBlockCount == static_cast<std::size_t>(1) << runLengthBitCount,
+              "a run must be able to cover a whole subchunk");
+static_assert(BlockChunk::chunkSizeX == BlockChunk::subchunkSizeXYZ
+                  && BlockChunk::chunkSizeZ == BlockChunk::subchunkSizeXYZ,
+              "subchunks must be contiguous in y major block order");
+
+/** @brief packs values of up to 16 bits into bytes, least significant bit first */
+class BitPackWriter final
+{
+private:
+    std::vector<std::uint8_t> bytes;
+    std::uint32_t buffer = 0;
+    unsigned bufferBitCount = 0;
+
+public:
+    BitPackWriter() : bytes()
+    {
+    }
+    void write(std::uint32_t value, unsigned bitCount)
+    {
+        assert(bitCount <= 16 && value < (static_cast<std::uint32_t>(1) << bitCount));
+        buffer |= value << bufferBitCount;
+        bufferBitCount += bitCount;
+        while(bufferBitCount >= 8)
+        {
+            bytes.push_back(static_cast<std::uint8_t>(buffer & 0xFF));
+            buffer >>= 8;
+            bufferBitCount -= 8;
+        }
+    }
+    /** @brief write the packed bytes, padding the last byte with zeros */
+    void finish(stream::Writer &writer)
+    {
+        if(bufferBitCount > 0)
+            bytes.push_back(static_cast<std::uint8_t>(buffer));
+        buffer = 0;
+        bufferBitCount = 0;
+        writer.writeBytes(bytes.data(), bytes.size());
+        bytes.clear();
+    }
+};
+
+/** @brief reads values written by BitPackWriter, only reading the bytes it needs */
+class BitPackReader final
+{
+private:
+    stream::Reader &reader;
+    std::uint32_t buffer = 0;
+    unsigned bufferBitCount = 0;
+
+public:
+    explicit BitPackReader(stream::Reader &reader) : reader(reader)
+    {
+    }
+    std::uint32_t read(unsigned bitCount)
+    {
+        assert(bitCount <= 16);
+        while(bufferBitCount < bitCount)
+        {
+            buffer |= static_cast<std::uint32_t>(stream::read<std::uint8_t>(reader))
+                      << bufferBitCount;
+            bufferBitCount += 8;
+        }
+        std::uint32_t retval = buffer & ((static_cast<std::uint32_t>(1) << bitCount) - 1);
+        buffer >>= bitCount;
+        bufferBitCount -= bitCount;
+        return retval;
+    }
+};
+
+/** @brief the number of bits needed to store an index into a palette */
+unsigned getPaletteIndexBitCount(std::size_t paletteSize)
+{
+    unsigned retval = 0;
+    while((static_cast<std::size_t>(1) << retval) < paletteSize)
+        retval++;
+    return retval;
+}
+
+std::uint32_t packLightingValue(PackedLighting lighting)
+{
+    return static_cast<std::uint32_t>(lighting.directSkylight)
+           | static_cast<std::uint32_t>(lighting.indirectSkylight) << Lighting::lightBitWidth
+           | static_cast<std::uint32_t>(lighting.indirectArtificalLight)
+                 << 2 * Lighting::lightBitWidth;
+}
+
+Lighting unpackLightingValue(std::uint32_t value)
+{
+    return Lighting(value & Lighting::maxLight,
+                    (value >> Lighting::lightBitWidth) & Lighting::maxLight,
+                    (value >> 2 * Lighting::lightBitWidth) & Lighting::maxLight,
+                    Lighting::MakeDirectOnly);
+}
+
+/** @brief write a subchunk's worth of values as a run count then bit-packed runs
+ *
+ * each run is the value in valueBitCount bits then the run length minus one in
+ * runLengthBitCount bits.
+ */
+void writeRunLengthEncoded(stream::Writer &writer,
+                           const std::uint32_t *values,
+                           unsigned valueBitCount)
+{
+    BitPackWriter runs;
+    std::uint16_t runCount = 0;
+    std::size_t runEnd;
+    for(std::size_t runStart = 0; runStart < subchunkBlockCount; runStart = runEnd)
+    {
+        runEnd = runStart + 1;
+        while(runEnd < subchunkBlockCount && values[runEnd] == values[runStart])
+            runEnd++;
+        runs.write(values[runStart], valueBitCount);
+        runs.write(static_cast<std::uint32_t>(runEnd - runStart - 1), runLengthBitCount);
+        runCount++;
+    }
+    stream::write<std::uint16_t>(writer, runCount);
+    runs.finish(writer);
+}
+
+/** @brief read a subchunk's worth of values written by writeRunLengthEncoded */
+void readRunLengthEncoded(stream::Reader &reader,
+                          std::uint32_t *values,
+                          unsigned valueBitCount,
+                          std::uint32_t maxValue)
+{
+    std::uint16_t runCount = stream::read_limited<std::uint16_t>(
+        reader, 1, static_cast<std::uint16_t>(subchunkBlockCount));
+    BitPackReader runs(reader);
+    std::size_t position = 0;
+    for(; runCount > 0; runCount--)
+    {
+        std::uint32_t value = runs.read(valueBitCount);
+        std::size_t length = runs.read(runLengthBitCount) + 1;
+        if(value > maxValue)
+            throw stream::InvalidDataValueException("run value out of range");
+        if(length > subchunkBlockCount - position)
+            throw stream::InvalidDataValueException("runs are longer than a subchunk");
+        std::fill(values + position, values + position + length, value);
+        position += length;
+    }
+    if(position != subchunkBlockCount)
+        throw stream::InvalidDataValueException("runs are shorter than a subchunk");
+}
+
+void readBlockUpdates(
+    stream::Reader &reader,
+    PositionI chunkBasePosition,
+    checked_array<checked_array<checked_array<std::vector<std::tuple<PositionI,
+                                                                     float,
+                                                                     BlockUpdateKind>>,
+                                              BlockChunk::subchunkCountZ>,
+                                BlockChunk::subchunkCountY>,
+                  BlockChunk::subchunkCountX> &blockUpdates)
+{
+    std::uint32_t blockUpdateCount = stream::read<std::uint32_t>(reader);
+    for(; blockUpdateCount > 0; blockUpdateCount--)
+    {
+        PositionI position = stream::read<PositionI>(reader);
+        if(chunkBasePosition != BlockChunk::getChunkBasePosition(position))
+            throw stream::InvalidDataValueException("block update is outside of chunk");
+        float timeLeft = stream::read_limited<float32_t>(reader, 0, 1e6);
+        BlockUpdateKind blockUpdateKind = FileUpgrades::readBlockUpdateKind(reader);
+        VectorI subchunkIndex = BlockChunk::getSubchunkIndexFromPosition(position);
+        blockUpdates[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z].emplace_back(
+            position, timeLeft, blockUpdateKind);
+    }
+}
+}
+
+bool World::FileChunkIndex::canAppend() const
+{
+    return fileVersion == GameVersion::FILE_VERSION && !isMostlyGarbage();
+}
+
+void World::FileAppendJournal::write(stream::Writer &writer) const
+{
+    stream::MemoryWriter journalWriter;
+    stream::write<std::uint64_t>(journalWriter, fileSize);
+    const std::vector<std::uint8_t> &bytes = journalWriter.getBuffer();
+    writer.writeBytes(bytes.data(), bytes.size());
+    stream::write<std::uint32_t>(writer, stream::computeCRC32(bytes.data(), bytes.size()));
+}
+
+World::FileAppendJournal World::FileAppendJournal::read(stream::Reader &reader)
+{
+    stream::SharedBytes bytes = reader.readSharedBytes(sizeof(std::uint64_t));
+    if(stream::read<std::uint32_t>(reader) != stream::computeCRC32(bytes.data(), bytes.size()))
+        throw stream::InvalidDataValueException("world file journal checksum mismatch");
+    stream::MemoryReader journalReader(bytes);
+    return FileAppendJournal(stream::read<std::uint64_t>(journalReader));
+}
+
+void World::FileAppendJournal::rollBackInterruptedAppend(const std::wstring &worldFileName)
+{
+    std::wstring journalFileName = getFileName(worldFileName);
+    FileAppendJournal journal;
+    try
+    {
+        journal = read(*readUserSpecificFile(journalFileName));
+    }
+    catch(stream::IOException &)
+    {
+        // there's no journal, or it's incomplete so the append never started
+        removeUserSpecificFile(journalFileName);
+        return;
+    }
+    std::shared_ptr<stream::Writer> pwriter = appendUserSpecificFile(worldFileName);
+    if(pwriter->tell() > static_cast<std::int64_t>(journal.fileSize))
+    {
+        getDebugLog() << L"rolling back the interrupted save of " << worldFileName << postnl;
+        pwriter->truncate(journal.fileSize);
+        pwriter->sync();
+    }
+    pwriter = nullptr;
+    removeUserSpecificFile(journalFileName);
+}
+
+World::Snapshot::Snapshot() : writeLock(), indexRecord(), chunkPositions(), chunks()
+{
+}
+
+World::Snapshot::~Snapshot() = default;
+
+void World::Snapshot::writeChunkBlocks(Chunk &chunk)
+{
+    std::vector<BlockDescriptorPointer> palette;
+    std::unordered_map<std::uint16_t, std::uint32_t> paletteIndexes;
+    std::vector<std::uint32_t> values(subchunkBlockCount);
+    stream::Writer &recordWriter = *chunk.record;
+    for(const BiomeProperties &biome : chunk.biomes)
+    {
+        stream::write<BiomeProperties>(recordWriter, biome);
+    }
+    // each subchunk is a palette of block descriptors, the run-length encoded palette
+    // indexes, the run-length encoded lighting, then the data of the blocks that have any
+    auto blockDataIter = chunk.blockData.begin();
+    const std::vector<std::uint8_t> &blockDataBytes = chunk.blockDataRecord->getBuffer();
+    std::size_t blockDataStart = 0;
+    for(std::size_t subchunkStart = 0; subchunkStart < chunk.blockKinds.size();
+        subchunkStart += subchunkBlockCount)
+    {
+        palette.clear();
+        paletteIndexes.clear();
+        for(std::size_t i = 0; i < subchunkBlockCount; i++)
+        {
+            BlockDescriptorIndex blockKind = chunk.blockKinds[subchunkStart + i];
+            auto iter = paletteIndexes.find(blockKind.index);
+            if(iter == paletteIndexes.end())
+            {
+                iter = std::get<0>(paletteIndexes.emplace(
+                    blockKind.index, static_cast<std::uint32_t>(palette.size())));
+                palette.push_back(blockKind.get());
+            }
+            values[i] = std::get<1>(*iter);
+        }
+        stream::write<std::uint16_t>(recordWriter, static_cast<std::uint16_t>(palette.size()));
+        for(BlockDescriptorPointer descriptor : palette)
+        {
+            Block::writeDescriptor(recordWriter, descriptor);
+        }
+        writeRunLengthEncoded(
+            recordWriter, values.data(), getPaletteIndexBitCount(palette.size()));
+        for(std::size_t i = 0; i < subchunkBlockCount; i++)
+        {
+            values[i] = packLightingValue(chunk.blockLighting[subchunkStart + i]);
+        }
+        writeRunLengthEncoded(recordWriter, values.data(), packedLightingBitCount);
+        auto subchunkBlockDataEnd = blockDataIter;
+        while(subchunkBlockDataEnd != chunk.blockData.end()
+              && std::get<0>(*subchunkBlockDataEnd) < subchunkStart + subchunkBlockCount)
+            ++subchunkBlockDataEnd;
+        stream::write<std::uint16_t>(
+            recordWriter, static_cast<std::uint16_t>(subchunkBlockDataEnd - blockDataIter));
+        for(; blockDataIter != subchunkBlockDataEnd; ++blockDataIter)
+        {
+            std::uint32_t blockIndex = std::get<0>(*blockDataIter);
+            std::size_t blockDataEnd = std::get<1>(*blockDataIter);
+            stream::write<std::uint16_t>(recordWriter,
+                                         static_cast<std::uint16_t>(blockIndex - subchunkStart));
+            recordWriter.writeBytes(blockDataBytes.data() + blockDataStart,
+                                    blockDataEnd - blockDataStart);
+            blockDataStart = blockDataEnd;
+        }
+    }
+    stream::write<std::uint32_t>(recordWriter,
+                                 static_cast<std::uint32_t>(chunk.blockUpdates.size()));
+    for(const BlockUpdateRecord &blockUpdate : chunk.blockUpdates)
+    {
+        stream::write<PositionI>(recordWriter, blockUpdate.position);
+        stream::write<float32_t>(recordWriter, blockUpdate.timeLeft);
+        stream::write<BlockUpdateKind>(recordWriter, blockUpdate.kind);
+    }
+}
+
+World::FileChunkIndex World::Snapshot::writeRecords(stream::Writer &writer,
+                                                    std::uint64_t offset,
+                                                    const FileChunkIndex *savedChunks,
+                                                    std::uint32_t fileVersion,
+                                                    const SaveOptions &options)
+{
+    const FileUpgrades::FileLayout layout = FileUpgrades::getLayout(fileVersion);
+    assert(layout.subchunkPalettes);
+    std::unique_lock<std::mutex> lockIt(writeLock);
+    assert(!written);
+    assert(savedChunks != nullptr || copiedAllChunks);
+    written = true;
+    FileChunkIndex retval;
+    retval.fileVersion = fileVersion;
+    std::size_t threadCount = options.threadCount;
+    if(threadCount == 0)
+        threadCount = getProcessorCount();
+    // chunk records are independent, so they're encoded and compressed on several threads then
+    // written in order
+    runInOrderOnThreads<std::vector<std::uint8_t>>(
+        chunks.size(),
+        threadCount,
+        L"world save",
+        [this, &options](std::size_t chunkIndex)
+        {
+            Chunk &chunk = chunks[chunkIndex];
+            writeChunkBlocks(chunk);
+            std::vector<std::uint8_t> compressed =
+                compressWorldFileRecord(chunk.record->getBuffer(), options);
+            chunk = Chunk(chunk.basePosition); // free the copied blocks now instead of at the end
+            return compressed;
+        },
+        [this, &writer, &offset, &retval, &layout](std::size_t chunkIndex,
+                                                   std::vector<std::uint8_t> compressed)
+        {
+            std::uint32_t size = writeWorldFileRecord(writer, compressed, layout);
+            retval.records[chunks[chunkIndex].basePosition] = FileChunkIndex::Record(offset, size);
+            offset += size;
+        });
+    chunks.clear();
+    stream::write<float32_t>(indexRecord, timeOfDayInSeconds);
+    stream::write<std::uint8_t>(indexRecord, moonPhase);
+    stream::write<std::uint64_t>(indexRecord, chunkPositions.size());
+    for(PositionI chunkBasePosition : chunkPositions)
+    {
+        auto iter = retval.records.find(chunkBasePosition);
+        if(iter == retval.records.end())
+        {
+            assert(savedChunks != nullptr);
+            iter = retval.records.insert(*savedChunks->records.find(chunkBasePosition)).first;
+        }
+        stream::write<PositionI>(indexRecord, chunkBasePosition);
+        stream::write<std::uint64_t>(indexRecord, std::get<1>(*iter).offset);
+        stream::write<std::uint32_t>(indexRecord, std::get<1>(*iter).size);
+    }
+    std::uint64_t indexOffset = offset;
+    offset += writeWorldFileRecord(
+        writer, compressWorldFileRecord(indexRecord.getBuffer(), options), layout);
+    stream::write<std::uint64_t>(writer, indexOffset);
+    offset += sizeof(std::uint64_t);
+    writer.flush();
+    retval.fileSize = offset;
+    return retval;
+}
+
+World::FileChunkIndex World::Snapshot::write(stream::Writer &writer, const SaveOptions &options)
+{
+    if(!FileUpgrades::getLayout(options.fileVersion).subchunkPalettes)
+        throw stream::IOException("snapshots can't be written in that file version");
+    stream::write<std::uint32_t>(writer, options.fileVersion);
+    return writeRecords(writer, sizeof(std::uint32_t), nullptr, options.fileVersion, options);
+}
+
+World::FileChunkIndex World::Snapshot::append(stream::Writer &writer,
+                                              const FileChunkIndex &savedChunks,
+                                              const SaveOptions &options)
+{
+    return writeRecords(writer, writer.tell(), &savedChunks, savedChunks.fileVersion, options);
+}
+
+std::shared_ptr<World::Snapshot> World::makeSnapshot(WorldLockManager &lock_manager,
+                                                     const FileChunkIndex *savedChunks)
+{
+    std::shared_ptr<Snapshot> retval(new Snapshot());
+    Snapshot &snapshot = *retval;
+    snapshot.copiedAllChunks = savedChunks == nullptr;
+    bool wasPaused = paused();
+    paused(true, lock_manager);
+    try
+    {
+        {
+            stream::Writer &writer = snapshot.indexRecord;
+            StreamWorldGuard streamWorldGuard(writer, *this, lock_manager);
+            stream::write<SeedType>(writer, worldGeneratorSeed);
+            {
+                std::unique_lock<std::mutex> lockIt(randomGeneratorLock);
+                stream::write<rc4_random_engine>(writer, randomGenerator);
+            }
+            LockedPlayers lockedPlayers = players().lock();
+            stream::write<std::uint64_t>(writer, players().players.size());
+            for(std::shared_ptr<Player> player : lockedPlayers)
+            {
+                player->write(writer);
+            }
+        }
+        std::vector<std::shared_ptr<BlockChunk>> chunks;
+        BlockChunkMap *chunksMap = &physicsWorld->chunks;
+        {
+            for(auto chunkIter = chunksMap->begin(); chunkIter != chunksMap->end(); chunkIter++)
+            {
+                if(!chunkIter->chunkVariables.generated)
+                    continue;
+                if(savedChunks != nullptr && !chunkIter->isLoaded()
+                   && !chunkIter->chunkVariables.saveDirty
+                   && savedChunks->records.count(chunkIter->basePosition) != 0)
+                {
+                    // unchanged and not loaded, so don't load it just to skip writing it
+                    if(chunkIter.is_locked())
+                        chunkIter.unlock();
+                    snapshot.chunkPositions.push_back(chunkIter->basePosition);
+                    continue;
+                }
+                std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(lock_manager.tls);
+                if(chunkIter.is_locked())
+                    chunkIter.unlock();
+                // a chunk whose record couldn't be read isn't generated anymore; leave it out so
+                // it's generated again instead of being saved empty
+                if(!chunk->getChunkVariables().generated)
+                    continue;
+                snapshot.chunkPositions.push_back(chunk->basePosition);
+                bool wasDirty = chunk->getChunkVariables().saveDirty.exchange(false);
+                if(!wasDirty && savedChunks != nullptr
+                   && savedChunks->records.count(chunk->basePosition) != 0)
+                    continue;
+                chunks.push_back(chunk);
+            }
+        }
+        snapshot.chunks.reserve(chunks.size());
+        for(std::shared_ptr<BlockChunk> chunk : chunks)
+        {
+            snapshot.chunks.emplace_back(chunk->basePosition);
+            Snapshot::Chunk &snapshotChunk = snapshot.chunks.back();
+            stream::Writer &writer = *snapshotChunk.record;
+            StreamWorldGuard streamWorldGuard(writer, *this, lock_manager);
+            writeChunkPositionAndEntities(writer, *chunk);
+            constexpr std::size_t blockCount =
+                BlockChunk::chunkSizeX * BlockChunk::chunkSizeY * BlockChunk::chunkSizeZ;
+            snapshotChunk.biomes.reserve(BlockChunk::chunkSizeX * BlockChunk::chunkSizeZ);
+            snapshotChunk.blockKinds.reserve(blockCount);
+            snapshotChunk.blockLighting.reserve(blockCount);
+            BlockIterator cbi(chunk, chunksMap, chunk->basePosition, VectorI(0, 0, 0));
+            stream::MemoryWriter &blockDataWriter = *snapshotChunk.blockDataRecord;
+            // the block data is copied into the record after the entities, so it has to continue
+            // the record's descriptor tables, like the items in chests
+            blockDataWriter.shareAssociatedValues(writer);
+            StreamWorldGuard blockDataStreamWorldGuard(blockDataWriter, *this, lock_manager);
+            for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
+            {
+                for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
+                {
+                    BlockIterator columnBlockIterator = cbi;
+                    columnBlockIterator.moveBy(VectorI(x, 0, z), lock_manager);
+                    snapshotChunk.biomes.push_back(
+                        columnBlockIterator.getBiomeProperties(lock_manager));
+                }
+            }
+            for(std::size_t y = 0; y < BlockChunk::chunkSizeY; y++)
+            {
+                for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
+                {
+                    BlockIterator bi = cbi;
+                    bi.moveBy(VectorI(0, y, z), lock_manager);
+                    for(std::size_t x = 0; x < BlockChunk::chunkSizeX;
+                        x++, bi.moveTowardPX(lock_manager))
+                    {
+                        Block block = bi.get(lock_manager);
+                        if(block.data != nullptr)
+                        {
+                            // block data like chest contents is shared with the running world,
+                            // so it has to be serialized while the world is paused
+                            block.descriptor->writeBlockData(blockDataWriter, block.data);
+                            snapshotChunk.blockData.emplace_back(
+                                static_cast<std::uint32_t>(snapshotChunk.blockKinds.size()),
+                                blockDataWriter.getBuffer().size());
+                        }
+                        snapshotChunk.blockKinds.push_back(BlockDescriptorIndex(block.descriptor));
+                        snapshotChunk.blockLighting.push_back(PackedLighting(block.lighting));
+                        for(BlockUpdateIterator iter = bi.updatesBegin(lock_manager);
+                            iter != bi.updatesEnd(lock_manager);
+                            ++iter)
+                        {
+                            snapshotChunk.blockUpdates.emplace_back(
+                                iter->getPosition(), iter->getTimeLeft(), iter->getKind());
+                        }
+                    }
+                }
+            }
+        }
+        std::unique_lock<std::recursive_mutex> lockTimeOfDay(timeOfDayLock);
+        snapshot.timeOfDayInSeconds = timeOfDayInSeconds;
+        snapshot.moonPhase = moonPhase;
+        lockTimeOfDay.unlock();
+        lock_manager.clear();
+    }
+    catch(stream::IOException &)
+    {
+        paused(wasPaused, lock_manager);
+        throw;
+    }
+    paused(wasPaused, lock_manager);
+    return retval;
+}
+
+void World::writeChunkPositionAndEntities(stream::Writer &writer, BlockChunk &chunk)
+{
+    stream::write<PositionI>(writer, chunk.basePosition);
+    std::vector<WrappedEntity *> entities;
+    {
+        std::unique_lock<std::recursive_mutex> lockChunk(chunk.getChunkVariables().entityListLock);
+        WrappedEntity::ChunkListType &chunkEntityList = chunk.getChunkVariables().entityList;
+        for(auto i = chunkEntityList.begin(); i != chunkEntityList.end(); ++i)
+        {
+            WrappedEntity &entity = *i;
+            if(!entity.entity.good())
+            {
+                continue;
+            }
+            entities.push_back(&entity);
+        }
+    }
+    stream::write<std::uint64_t>(writer, entities.size());
+    for(WrappedEntity *entity : entities)
+    {
+        entity->entity.write(writer);
+    }
+}
+
+void World::writeLegacyChunkBlocks(stream::Writer &writer,
+                                   std::shared_ptr<BlockChunk> chunk,
+                                   WorldLockManager &lock_manager)
+{
+    std::vector<std::tuple<PositionI, float, BlockUpdateKind>> blockUpdates;
+    BlockIterator cbi(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0, 0, 0));
+    for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
+    {
+        for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
+        {
+            BlockIterator columnBlockIterator = cbi;
+            columnBlockIterator.moveBy(VectorI(x, 0, z), lock_manager);
+            stream::write<BiomeProperties>(writer,
+                                           columnBlockIterator.getBiomeProperties(lock_manager));
+            BlockIterator bi = columnBlockIterator;
+            blockUpdates.clear();
+            for(std::size_t y = 0; y < BlockChunk::chunkSizeY; y++, bi.moveTowardPY(lock_manager))
+            {
+                stream::write<Block>(writer, bi.get(lock_manager));
+                for(BlockUpdateIterator iter = bi.updatesBegin(lock_manager);
+                    iter != bi.updatesEnd(lock_manager);
+                    ++iter)
+                {
+                    blockUpdates.emplace_back(
+                        iter->getPosition(), iter->getTimeLeft(), iter->getKind());
+                }
+            }
+            stream::write<std::uint32_t>(writer, static_cast<std::uint32_t>(blockUpdates.size()));
+            for(auto update : blockUpdates)
+            {
+                stream::write<PositionI>(writer, std::get<0>(update));
+                stream::write<float32_t>(writer, std::get<1>(update));
+                stream::write<BlockUpdateKind>(writer, std::get<2>(update));
+            }
+        }
+    }
+}
+
+void World::writeLegacy(stream::Writer &writerIn,
+                        WorldLockManager &lock_manager,
+                        const SaveOptions &options)
+{
+    const FileUpgrades::FileLayout layout = FileUpgrades::getLayout(options.fileVersion);
+    assert(!layout.subchunkPalettes);
+    bool wasPaused = paused();
+    paused(true, lock_manager);
+    try
     {
-        std::shared_ptr<Player> player = Player::read(reader);
-        // read function already adds to world
-        ignore_unused_variable_warning(player);
+        stream::write<std::uint32_t>(writerIn, options.fileVersion);
+        std::uint64_t offset = sizeof(std::uint32_t);
+        std::vector<std::shared_ptr<BlockChunk>> chunks;
+        BlockChunkMap *chunksMap = &physicsWorld->chunks;
+        for(auto chunkIter = chunksMap->begin(); chunkIter != chunksMap->end(); chunkIter++)
+        {
+            if(!chunkIter->chunkVariables.generated)
+                continue;
+            std::shared_ptr<BlockChunk> chunk = chunkIter->getOrLoad(lock_manager.tls);
+            if(chunkIter.is_locked())
+                chunkIter.unlock();
+            if(!chunk->getChunkVariables().generated)
+                continue;
+            chunks.push_back(chunk);
+        }
+        std::vector<std::pair<PositionI, FileChunkIndex::Record>> records;
+        if(layout.chunkRecords)
+        {
+            for(std::shared_ptr<BlockChunk> chunk : chunks)
+            {
+                stream::MemoryWriter record;
+                StreamWorldGuard streamWorldGuard(record, *this, lock_manager);
+                writeChunkPositionAndEntities(record, *chunk);
+                writeLegacyChunkBlocks(record, chunk, lock_manager);
+                std::uint32_t size = writeWorldFileRecord(
+                    writerIn, compressWorldFileRecord(record.getBuffer(), options), layout);
+                records.emplace_back(chunk->basePosition, FileChunkIndex::Record(offset, size));
+                offset += size;
+            }
+        }
+        stream::MemoryWriter memWriter;
+        {
+            stream::CompressWriter writer(memWriter);
+            StreamWorldGuard streamWorldGuard(writer, *this, lock_manager);
+            stream::write<SeedType>(writer, worldGeneratorSeed);
+            {
+                std::unique_lock<std::mutex> lockIt(randomGeneratorLock);
+                stream::write<rc4_random_engine>(writer, randomGenerator);
+            }
+            LockedPlayers lockedPlayers = players().lock();
+            stream::write<std::uint64_t>(writer, players().players.size());
+            for(std::shared_ptr<Player> player : lockedPlayers)
+            {
+                player->write(writer);
+            }
+            if(layout.chunkRecords)
+            {
+                std::unique_lock<std::recursive_mutex> lockTimeOfDay(timeOfDayLock);
+                stream::write<float32_t>(writer, timeOfDayInSeconds);
+                stream::write<std::uint8_t>(writer, moonPhase);
+                stream::write<std::uint64_t>(writer, records.size());
+                for(const auto &v : records)
+                {
+                    stream::write<PositionI>(writer, std::get<0>(v));
+                    stream::write<std::uint64_t>(writer, std::get<1>(v).offset);
+                    stream::write<std::uint32_t>(writer, std::get<1>(v).size);
+                }
+            }
+            else
+            {
+                stream::write<std::uint64_t>(writer, chunks.size());
+                if(layout.chunkEntitiesBeforeBlocks)
+                {
+                    for(std::shared_ptr<BlockChunk> chunk : chunks)
+                    {
+                        writeChunkPositionAndEntities(writer, *chunk);
+                    }
+                }
+                for(std::shared_ptr<BlockChunk> chunk : chunks)
+                {
+                    if(!layout.chunkEntitiesBeforeBlocks)
+                        writeChunkPositionAndEntities(writer, *chunk);
+                    writeLegacyChunkBlocks(writer, chunk, lock_manager);
+                }
+                std::unique_lock<std::recursive_mutex> lockTimeOfDay(timeOfDayLock);
+                stream::write<float32_t>(writer, timeOfDayInSeconds);
+                stream::write<std::uint8_t>(writer, moonPhase);
+            }
+            writer.flush();
+        }
+        lock_manager.clear();
+        if(layout.chunkRecords)
+        {
+            // memWriter already holds the compressed index record
+            writeWorldFileRecord(writerIn, memWriter.getBuffer(), layout);
+            stream::write<std::uint64_t>(writerIn, offset);
+        }
+        else
+        {
+            writerIn.writeBytes(memWriter.getBuffer().data(), memWriter.getBuffer().size());
+        }
+        writerIn.flush();
+    }
+    catch(stream::IOException &)
+    {
+        paused(wasPaused, lock_manager);
+        throw;
     }
-    std::uint64_t chunkCount = stream::read<std::uint64_t>(reader);
+    paused(wasPaused, lock_manager);
+}
+
+void World::write(stream::Writer &writer,
+                  WorldLockManager &lock_manager,
+                  const SaveOptions &options)
+{
+    if(!FileUpgrades::getLayout(options.fileVersion).subchunkPalettes)
+    {
+        writeLegacy(writer, lock_manager, options);
+        return;
+    }
+    makeSnapshot(lock_manager)->write(writer, options);
+}
+
+std::uint32_t World::getStreamFileVersion(stream::Reader &reader)
+{
+    return FileUpgrades::getStreamFileVersion(reader);
+}
+
+void World::readChunkEntities(stream::Reader &reader, WorldLockManager &lock_manager)
+{
+    std::uint64_t entityCount = stream::read<std::uint64_t>(reader);
+    for(std::uint64_t entityIndex = 0; entityIndex < entityCount; entityIndex++)
+    {
+        Entity().read(reader,
+                      [this, &lock_manager](Entity &e, PositionF position, VectorF velocity)
+                      {
+                          addEntity(e.descriptor, position, velocity, lock_manager, e.data);
+                      });
+    }
+}
+
+PositionI World::readChunkPositionAndEntities(stream::Reader &reader,
+                                              WorldLockManager &lock_manager)
+{
+    PositionI chunkBasePosition = stream::read<PositionI>(reader);
+    if(chunkBasePosition != BlockChunk::getChunkBasePosition(chunkBasePosition))
+        throw stream::InvalidDataValueException("block chunk base is not a valid position");
+    BlockIterator cbi = getBlockIterator(chunkBasePosition, lock_manager.tls);
+    cbi.chunk->getChunkVariables().generated = true;
+    cbi.chunk->getChunkVariables().generateStarted = true;
+    readChunkEntities(reader, lock_manager);
+    return chunkBasePosition;
+}
+
+void World::readChunkBlocks(stream::Reader &reader,
+                            BlockIterator cbi,
+                            WorldLockManager &lock_manager)
+{
+    const PositionI chunkBasePosition = cbi.position();
     struct BlocksTLSTag
     {
     };
@@ -2263,24 +3630,8 @@ std::shared_ptr<World> World::read(stream::Reader &readerIn)
                                                   BlockChunk::subchunkCountZ>,
                                     BlockChunk::subchunkCountY>,
                       BlockChunk::subchunkCountX>();
-    for(std::uint64_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
-    {
-        PositionI chunkBasePosition = stream::read<PositionI>(reader);
-        if(chunkBasePosition != BlockChunk::getChunkBasePosition(chunkBasePosition))
-            throw stream::InvalidDataValueException("block chunk base is not a valid position");
-        BlockIterator cbi = world.getBlockIterator(chunkBasePosition, lock_manager.tls);
-        cbi.chunk->getChunkVariables().generated = true;
-        cbi.chunk->getChunkVariables().generateStarted = true;
-        std::uint64_t entityCount = stream::read<std::uint64_t>(reader);
-        for(std::uint64_t entityIndex = 0; entityIndex < entityCount; entityIndex++)
-        {
-            Entity().read(reader,
-                          [&world, &lock_manager](Entity &e, PositionF position, VectorF velocity)
-                          {
-                              world.addEntity(
-                                  e.descriptor, position, velocity, lock_manager, e.data);
-                          });
-        }
+    if(!FileUpgrades::getStreamLayout(reader).subchunkPalettes)
+    {
         for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
         {
             for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
@@ -2290,100 +3641,149 @@ std::shared_ptr<World> World::read(stream::Reader &readerIn)
                 {
                     blocks[x][y][z] = stream::read<Block>(reader);
                 }
-                std::uint32_t blockUpdateCount = stream::read<std::uint32_t>(reader);
-                for(; blockUpdateCount > 0; blockUpdateCount--)
-                {
-                    PositionI position = stream::read<PositionI>(reader);
-                    if(chunkBasePosition != BlockChunk::getChunkBasePosition(position))
-                        throw stream::InvalidDataValueException("block update is outside of chunk");
-                    float timeLeft = stream::read_limited<float32_t>(reader, 0, 1e6);
-                    BlockUpdateKind blockUpdateKind = stream::read<BlockUpdateKind>(reader);
-                    VectorI subchunkIndex = BlockChunk::getSubchunkIndexFromPosition(position);
-                    blockUpdates[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z].emplace_back(
-                        position, timeLeft, blockUpdateKind);
-                }
+                readBlockUpdates(reader, chunkBasePosition, blockUpdates);
             }
         }
-        for(int dx = 0; dx < BlockChunk::chunkSizeX; dx++)
+    }
+    else
+    {
+        // the biomes, then each subchunk as a palette with run-length encoded indexes and
+        // lighting, then all the block updates
+        for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
         {
-            for(int dz = 0; dz < BlockChunk::chunkSizeZ; dz++)
+            for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
             {
-                BlockIterator bi = cbi;
-                bi.moveBy(VectorI(dx, 0, dz), lock_manager);
-                bi.updateLock(lock_manager);
-                biomes[dx][dz].swap(bi.getBiome().biomeProperties);
+                biomes[x][z] = stream::read<BiomeProperties>(reader);
+            }
+        }
+        std::vector<BlockDescriptorPointer> palette;
+        std::vector<std::uint32_t> values(subchunkBlockCount);
+        for(std::size_t subchunkY = 0; subchunkY < BlockChunk::subchunkCountY; subchunkY++)
+        {
+            auto getBlock = [&](std::size_t index) -> Block &
+            {
+                return blocks[index % BlockChunk::chunkSizeX]
+                             [subchunkY * BlockChunk::subchunkSizeXYZ
+                              + index / (BlockChunk::chunkSizeX * BlockChunk::chunkSizeZ)]
+                             [index / BlockChunk::chunkSizeX % BlockChunk::chunkSizeZ];
+            };
+            std::size_t paletteSize = stream::read_limited<std::uint16_t>(
+                reader, 1, static_cast<std::uint16_t>(subchunkBlockCount));
+            palette.clear();
+            for(std::size_t i = 0; i < paletteSize; i++)
+            {
+                palette.push_back(Block::readDescriptor(reader));
+            }
+            readRunLengthEncoded(reader,
+                                 values.data(),
+                                 getPaletteIndexBitCount(paletteSize),
+                                 static_cast<std::uint32_t>(paletteSize - 1));
+            for(std::size_t i = 0; i < subchunkBlockCount; i++)
+            {
+                getBlock(i) = Block(palette[values[i]]);
+            }
+            readRunLengthEncoded(reader,
+                                 values.data(),
+                                 packedLightingBitCount,
+                                 (static_cast<std::uint32_t>(1) << packedLightingBitCount) - 1);
+            for(std::size_t i = 0; i < subchunkBlockCount; i++)
+            {
+                Block &block = getBlock(i);
+                if(block.good())
+                    block.lighting = unpackLightingValue(values[i]);
+            }
+            std::uint16_t blockDataCount = stream::read_limited<std::uint16_t>(
+                reader, 0, static_cast<std::uint16_t>(subchunkBlockCount));
+            for(; blockDataCount > 0; blockDataCount--)
+            {
+                Block &block = getBlock(stream::read_limited<std::uint16_t>(
+                    reader, 0, static_cast<std::uint16_t>(subchunkBlockCount - 1)));
+                if(!block.good())
+                    throw stream::InvalidDataValueException("block data for empty block");
+                block.data = block.descriptor->readBlockData(reader);
             }
         }
-        for(VectorI subchunkPos = VectorI(0); subchunkPos.x < BlockChunk::chunkSizeX;
-            subchunkPos.x += BlockChunk::subchunkSizeXYZ)
+        readBlockUpdates(reader, chunkBasePosition, blockUpdates);
+    }
+    for(int dx = 0; dx < BlockChunk::chunkSizeX; dx++)
+    {
+        for(int dz = 0; dz < BlockChunk::chunkSizeZ; dz++)
+        {
+            BlockIterator bi = cbi;
+            bi.moveBy(VectorI(dx, 0, dz), lock_manager);
+            bi.updateLock(lock_manager);
+            biomes[dx][dz].swap(bi.getBiome().biomeProperties);
+        }
+    }
+    for(VectorI subchunkPos = VectorI(0); subchunkPos.x < BlockChunk::chunkSizeX;
+        subchunkPos.x += BlockChunk::subchunkSizeXYZ)
+    {
+        for(subchunkPos.y = 0; subchunkPos.y < BlockChunk::chunkSizeY;
+            subchunkPos.y += BlockChunk::subchunkSizeXYZ)
         {
-            for(subchunkPos.y = 0; subchunkPos.y < BlockChunk::chunkSizeY;
-                subchunkPos.y += BlockChunk::subchunkSizeXYZ)
+            for(subchunkPos.z = 0; subchunkPos.z < BlockChunk::chunkSizeZ;
+                subchunkPos.z += BlockChunk::subchunkSizeXYZ)
             {
-                for(subchunkPos.z = 0; subchunkPos.z < BlockChunk::chunkSizeZ;
-                    subchunkPos.z += BlockChunk::subchunkSizeXYZ)
+                BlockIterator sbi = cbi;
+                sbi.moveBy(subchunkPos, lock_manager);
+                BlockChunkSubchunk &subchunk = sbi.getSubchunk();
+                VectorI subchunkIndex =
+                    BlockChunk::getSubchunkIndexFromChunkRelativePosition(subchunkPos);
+                std::vector<std::tuple<PositionI, float, BlockUpdateKind>> &
+                    currentBlockUpdates =
+                        blockUpdates[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z];
+                for(auto update : currentBlockUpdates)
                 {
-                    BlockIterator sbi = cbi;
-                    sbi.moveBy(subchunkPos, lock_manager);
-                    BlockChunkSubchunk &subchunk = sbi.getSubchunk();
-                    VectorI subchunkIndex =
-                        BlockChunk::getSubchunkIndexFromChunkRelativePosition(subchunkPos);
-                    std::vector<std::tuple<PositionI, float, BlockUpdateKind>> &
-                        currentBlockUpdates =
-                            blockUpdates[subchunkIndex.x][subchunkIndex.y][subchunkIndex.z];
-                    for(auto update : currentBlockUpdates)
-                    {
-                        BlockIterator bi = sbi;
-                        bi.moveTo(std::get<0>(update), lock_manager);
-                        world.addBlockUpdate(
-                            bi, lock_manager, std::get<2>(update), std::get<1>(update));
-                    }
-                    currentBlockUpdates.clear();
-                    for(VectorI subchunkRelativePos = VectorI(0);
-                        subchunkRelativePos.x < BlockChunk::subchunkSizeXYZ;
-                        subchunkRelativePos.x++)
+                    BlockIterator bi = sbi;
+                    bi.moveTo(std::get<0>(update), lock_manager);
+                    addBlockUpdate(
+                        bi, lock_manager, std::get<2>(update), std::get<1>(update));
+                }
+                currentBlockUpdates.clear();
+                for(VectorI subchunkRelativePos = VectorI(0);
+                    subchunkRelativePos.x < BlockChunk::subchunkSizeXYZ;
+                    subchunkRelativePos.x++)
+                {
+                    for(subchunkRelativePos.y = 0;
+                        subchunkRelativePos.y < BlockChunk::subchunkSizeXYZ;
+                        subchunkRelativePos.y++)
                     {
-                        for(subchunkRelativePos.y = 0;
-                            subchunkRelativePos.y < BlockChunk::subchunkSizeXYZ;
-                            subchunkRelativePos.y++)
+                        for(subchunkRelativePos.z = 0;
+                            subchunkRelativePos.z < BlockChunk::subchunkSizeXYZ;
+                            subchunkRelativePos.z++)
                         {
-                            for(subchunkRelativePos.z = 0;
-                                subchunkRelativePos.z < BlockChunk::subchunkSizeXYZ;
-                                subchunkRelativePos.z++)
+                            BlockIterator bi = sbi;
+                            bi.moveBy(subchunkRelativePos, lock_manager);
+                            VectorI newBlocksPosition = subchunkRelativePos + subchunkPos;
+                            Block newBlock =
+                                blocks[newBlocksPosition.x][newBlocksPosition
+                                                                .y][newBlocksPosition.z];
+                            BlockChunkBlock &b = bi.getBlock(lock_manager);
+                            BlockDescriptorPointer bd = subchunk.getBlockKind(b);
+                            if(bd != nullptr && bd->generatesParticles())
                             {
-                                BlockIterator bi = sbi;
-                                bi.moveBy(subchunkRelativePos, lock_manager);
-                                VectorI newBlocksPosition = subchunkRelativePos + subchunkPos;
-                                Block newBlock =
-                                    blocks[newBlocksPosition.x][newBlocksPosition
-                                                                    .y][newBlocksPosition.z];
-                                BlockChunkBlock &b = bi.getBlock(lock_manager);
-                                BlockDescriptorPointer bd = subchunk.getBlockKind(b);
-                                if(bd != nullptr && bd->generatesParticles())
-                                {
-                                    subchunk.removeParticleGeneratingBlock(bi.position());
-                                }
-                                bd = newBlock.descriptor;
-                                BlockChunk::putBlockIntoArray(
-                                    BlockChunk::getSubchunkRelativePosition(
-                                        bi.currentRelativePosition),
-                                    b,
-                                    subchunk,
-                                    std::move(newBlock),
-                                    lock_manager.tls);
-                                if(bd != nullptr && bd->generatesParticles())
-                                {
-                                    subchunk.addParticleGeneratingBlock(bi.position());
-                                }
+                                subchunk.removeParticleGeneratingBlock(bi.position());
+                            }
+                            bd = newBlock.descriptor;
+                            BlockChunk::putBlockIntoArray(
+                                BlockChunk::getSubchunkRelativePosition(
+                                    bi.currentRelativePosition),
+                                b,
+                                subchunk,
+                                std::move(newBlock),
+                                lock_manager.tls);
+                            if(bd != nullptr && bd->generatesParticles())
+                            {
+                                subchunk.addParticleGeneratingBlock(bi.position());
                             }
                         }
                     }
-                    world.lightingStable = false;
                 }
+                lightingStable = false;
             }
         }
-        world.lightingStable = false;
     }
+    lightingStable = false;
     for(std::size_t x = 0; x < BlockChunk::chunkSizeX; x++)
     {
         for(std::size_t z = 0; z < BlockChunk::chunkSizeZ; z++)
@@ -2394,9 +3794,262 @@ std::shared_ptr<World> World::read(stream::Reader &readerIn)
             }
         }
     }
-    float timeOfDayInSeconds = stream::read_limited<float32_t>(reader, 0, dayDurationInSeconds);
-    std::uint8_t moonPhase = stream::read_limited<std::uint8_t>(reader, 0, moonPhaseCount);
-    world.setTimeOfDayInSeconds(timeOfDayInSeconds, moonPhase);
+}
+
+struct World::LazyChunkSource final
+{
+    std::mutex readerLock;
+    const std::shared_ptr<stream::Reader> reader;
+    std::uint32_t fileVersion = 0;
+    FileUpgrades::FileLayout layout;
+    explicit LazyChunkSource(std::shared_ptr<stream::Reader> reader) : readerLock(), reader(reader)
+    {
+    }
+};
+
+std::shared_ptr<World> World::read(stream::Reader &reader,
+                                   bool deterministic,
+                                   FileChunkIndex *fileChunkIndex)
+{
+    return read(reader, deterministic, fileChunkIndex, nullptr);
+}
+
+std::shared_ptr<World> World::readLazily(std::shared_ptr<stream::Reader> reader,
+                                         FileChunkIndex *fileChunkIndex,
+                                         bool deterministic)
+{
+    return read(
+        *reader, deterministic, fileChunkIndex, std::make_shared<LazyChunkSource>(reader));
+}
+
+bool World::loadChunk(PositionI chunkBasePosition, WorldLockManager &lock_manager)
+{
+    lock_manager.clear();
+    std::shared_ptr<BlockChunk> chunk = getBlockIterator(chunkBasePosition, lock_manager.tls).chunk;
+    return chunk->getChunkVariables().generated;
+}
+
+bool World::pruneChunk(PositionI chunkBasePosition)
+{
+    IndirectBlockChunk &indirectChunk = physicsWorld->chunks[chunkBasePosition];
+    if(indirectChunk.isLoaded())
+        return false;
+    indirectChunk.chunkVariables.generated = false;
+    indirectChunk.chunkVariables.generateStarted = false;
+    return true;
+}
+
+std::shared_ptr<World> World::read(stream::Reader &readerIn,
+                                   bool deterministic,
+                                   FileChunkIndex *fileChunkIndex,
+                                   std::shared_ptr<LazyChunkSource> lazyChunkSource)
+{
+    std::uint32_t fileVersion = stream::read<std::uint32_t>(readerIn);
+    const FileUpgrades::FileLayout layout = FileUpgrades::getLayout(fileVersion);
+    std::unique_ptr<stream::Reader> preader;
+    FileChunkIndex index;
+    std::uint64_t indexOffset = 0;
+    if(layout.chunkRecords)
+    {
+        // the file is chunk records then an index record
+        readerIn.seek(0, stream::SeekPosition::End);
+        std::int64_t fileSize = readerIn.tell();
+        if(fileSize < static_cast<std::int64_t>(sizeof(std::uint32_t) + sizeof(std::uint64_t)))
+            throw stream::InvalidDataValueException("world file is truncated");
+        readerIn.seek(-static_cast<std::int64_t>(sizeof(std::uint64_t)), stream::SeekPosition::End);
+        indexOffset = stream::read_limited<std::uint64_t>(
+            readerIn, sizeof(std::uint32_t), fileSize - sizeof(std::uint64_t));
+        readerIn.seek(indexOffset, stream::SeekPosition::Start);
+        preader = readWorldFileRecord(
+            readerIn, fileSize - sizeof(std::uint64_t) - indexOffset, layout);
+        index.fileSize = fileSize;
+        index.fileVersion = fileVersion;
+    }
+    else
+    {
+        preader.reset(new stream::ExpandReader(readerIn));
+    }
+    stream::Reader &reader = *preader;
+    FileUpgrades::setStreamFileVersion(reader, fileVersion);
+    SeedType worldGeneratorSeed = stream::read<SeedType>(reader);
+    std::shared_ptr<World> retval = std::make_shared<World>(
+        worldGeneratorSeed, MyWorldGenerator::getInstance(), internal_construct_flag());
+    World &world = *retval;
+    world.deterministic = deterministic;
+    world.chunkUnloaderThread = thread([&world]()
+                                       {
+                                           setThreadName(L"chunk unloader");
+                                           TLS tls;
+                                           world.chunkUnloaderThreadFn(tls);
+                                       });
+    WorldLockManager lock_manager(TLS::getSlow());
+    StreamWorldGuard streamWorldGuard(reader, world, lock_manager);
+    world.randomGenerator = stream::read<rc4_random_engine>(reader);
+    std::uint64_t playerCount = stream::read<std::uint64_t>(reader);
+    for(std::uint64_t i = 0; i < playerCount; i++)
+    {
+        std::shared_ptr<Player> player = Player::read(reader);
+        // read function already adds to world
+        ignore_unused_variable_warning(player);
+    }
+    if(layout.chunkRecords)
+    {
+        float timeOfDayInSeconds =
+            stream::read_limited<float32_t>(reader, 0, dayDurationInSeconds);
+        std::uint8_t moonPhase = stream::read_limited<std::uint8_t>(reader, 0, moonPhaseCount);
+        world.setTimeOfDayInSeconds(timeOfDayInSeconds, moonPhase);
+        std::uint64_t chunkCount = stream::read<std::uint64_t>(reader);
+        for(std::uint64_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+        {
+            PositionI chunkBasePosition = stream::read<PositionI>(reader);
+            FileChunkIndex::Record record;
+            record.offset = stream::read_limited<std::uint64_t>(
+                reader, sizeof(std::uint32_t), indexOffset - sizeof(std::uint32_t));
+            record.size = stream::read_limited<std::uint32_t>(
+                reader,
+                sizeof(std::uint32_t),
+                std::min<std::uint64_t>(indexOffset - record.offset,
+                                        std::numeric_limits<std::uint32_t>::max()));
+            if(!std::get<1>(index.records.emplace(chunkBasePosition, record)))
+                throw stream::InvalidDataValueException("world file has duplicate chunk");
+        }
+    }
+    std::vector<PositionI> preloadChunkBasePositions;
+    if(layout.chunkRecords && lazyChunkSource)
+    {
+        // the chunks are read when they're first loaded; the reader isn't used here after this
+        lazyChunkSource->fileVersion = fileVersion;
+        lazyChunkSource->layout = layout;
+        World *pworld = &world;
+        for(const auto &v : index.records)
+        {
+            IndirectBlockChunk &indirectChunk = world.physicsWorld->chunks[std::get<0>(v)];
+            indirectChunk.chunkVariables.generated = true;
+            indirectChunk.chunkVariables.generateStarted = true;
+            FileChunkIndex::Record record = std::get<1>(v);
+            bool unloaded = indirectChunk.setUnloaded(
+                [pworld, lazyChunkSource, record](std::shared_ptr<BlockChunk> chunk)
+                {
+                    pworld->loadChunkLazily(*lazyChunkSource, record, chunk);
+                });
+            assert(unloaded);
+            ignore_unused_variable_warning(unloaded);
+        }
+        std::vector<PositionI> playerChunkBasePositions;
+        for(std::shared_ptr<Player> player : world.players().lock())
+        {
+            playerChunkBasePositions.push_back(
+                BlockChunk::getChunkBasePosition((PositionI)player->getPosition()));
+        }
+        std::vector<std::pair<std::int32_t, PositionI>> preloadChunks;
+        for(const auto &v : index.records)
+        {
+            PositionI chunkBasePosition = std::get<0>(v);
+            std::int32_t distance = -1;
+            for(PositionI playerChunkBasePosition : playerChunkBasePositions)
+            {
+                if(playerChunkBasePosition.d != chunkBasePosition.d)
+                    continue;
+                VectorI displacement = playerChunkBasePosition - chunkBasePosition;
+                std::int32_t playerDistance =
+                    std::max(std::abs(displacement.x) / BlockChunk::chunkSizeX,
+                             std::abs(displacement.z) / BlockChunk::chunkSizeZ);
+                if(distance < 0 || playerDistance < distance)
+                    distance = playerDistance;
+            }
+            if(distance >= 0 && distance <= LazyChunkPreloadDistance)
+                preloadChunks.emplace_back(distance, chunkBasePosition);
+        }
+        std::sort(preloadChunks.begin(),
+                  preloadChunks.end(),
+                  [](const std::pair<std::int32_t, PositionI> &a,
+                     const std::pair<std::int32_t, PositionI> &b)
+                  {
+                      if(std::get<0>(a) != std::get<0>(b))
+                          return std::get<0>(a) < std::get<0>(b);
+                      return positionLess(std::get<1>(a), std::get<1>(b));
+                  });
+        for(const auto &v : preloadChunks)
+        {
+            preloadChunkBasePositions.push_back(std::get<1>(v));
+        }
+    }
+    else if(layout.chunkRecords)
+    {
+        // read the records in file order, decompressing them on several threads
+        std::vector<std::pair<PositionI, FileChunkIndex::Record>> records(index.records.begin(),
+                                                                          index.records.end());
+        std::sort(records.begin(),
+                  records.end(),
+                  [](const std::pair<PositionI, FileChunkIndex::Record> &a,
+                     const std::pair<PositionI, FileChunkIndex::Record> &b)
+                  {
+                      return std::get<1>(a).offset < std::get<1>(b).offset;
+                  });
+        std::mutex readerLock;
+        runInOrderOnThreads<std::vector<std::uint8_t>>(
+            records.size(),
+            getProcessorCount(),
+            L"world load",
+            [&](std::size_t recordIndex)
+            {
+                const FileChunkIndex::Record &record = std::get<1>(records[recordIndex]);
+                try
+                {
+                    std::unique_lock<std::mutex> lockReader(readerLock);
+                    readerIn.seek(record.offset, stream::SeekPosition::Start);
+                    stream::SharedBytes compressed =
+                        readCompressedWorldFileRecord(readerIn, record.size, layout);
+                    lockReader.unlock();
+                    return expandWorldFileRecord(std::move(compressed));
+                }
+                catch(stream::IOException &e)
+                {
+                    getDebugLog() << L"loading chunk " << std::get<0>(records[recordIndex])
+                                  << L" failed : " << e.what() << postnl;
+                    return std::vector<std::uint8_t>(); // records are never empty
+                }
+            },
+            [&](std::size_t recordIndex, std::vector<std::uint8_t> bytes)
+            {
+                std::shared_ptr<BlockChunk> chunk =
+                    world.getBlockIterator(std::get<0>(records[recordIndex]), lock_manager.tls)
+                        .chunk;
+                if(bytes.empty())
+                {
+                    // the chunk is generated again and replaces the bad record on the next save
+                    chunk->getChunkVariables().saveDirty = true;
+                    return;
+                }
+                world.readChunkRecord(std::move(bytes), fileVersion, chunk, lock_manager);
+            });
+    }
+    else
+    {
+        std::uint64_t chunkCount = stream::read<std::uint64_t>(reader);
+        std::vector<PositionI> chunkBasePositions;
+        if(layout.chunkEntitiesBeforeBlocks)
+        {
+            for(std::uint64_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+            {
+                chunkBasePositions.push_back(
+                    world.readChunkPositionAndEntities(reader, lock_manager));
+            }
+        }
+        for(std::uint64_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+        {
+            PositionI chunkBasePosition =
+                layout.chunkEntitiesBeforeBlocks ?
+                    chunkBasePositions[chunkIndex] :
+                    world.readChunkPositionAndEntities(reader, lock_manager);
+            world.readChunkBlocks(
+                reader, world.getBlockIterator(chunkBasePosition, lock_manager.tls), lock_manager);
+        }
+        float timeOfDayInSeconds =
+            stream::read_limited<float32_t>(reader, 0, dayDurationInSeconds);
+        std::uint8_t moonPhase = stream::read_limited<std::uint8_t>(reader, 0, moonPhaseCount);
+        world.setTimeOfDayInSeconds(timeOfDayInSeconds, moonPhase);
+    }
     bool hasAnyPlayers = false;
     for(std::shared_ptr<Player> p : world.players().lock())
     {
@@ -2427,12 +4080,11 @@ std::shared_ptr<World> World::read(stream::Reader &readerIn)
     }
     for(std::size_t i = 0; i < ThreadCounts::get().blockUpdateThreadCount; i++)
     {
-        bool isPhaseManager = i == 0;
-        world.blockUpdateThreads.emplace_back([&world, isPhaseManager]()
+        world.blockUpdateThreads.emplace_back([&world, i]()
                                               {
                                                   setThreadName(L"block update");
                                                   TLS tls;
-                                                  world.blockUpdateThreadFn(tls, isPhaseManager);
+                                                  world.blockUpdateThreadFn(tls, i);
                                               });
     }
     world.particleGeneratingThread = thread([&world]()
@@ -2447,9 +4099,112 @@ std::shared_ptr<World> World::read(stream::Reader &readerIn)
                                           TLS tls;
                                           world.moveEntitiesThreadFn(tls);
                                       });
+    // a deterministic world only loads the chunks its steps use
+    if(!deterministic && !preloadChunkBasePositions.empty())
+    {
+        world.chunkPreloadThread = thread([&world, preloadChunkBasePositions]()
+                                          {
+                                              setThreadName(L"chunk preload");
+                                              setThreadPriority(ThreadPriority::Low);
+                                              TLS tls;
+                                              world.chunkPreloadThreadFn(
+                                                  preloadChunkBasePositions, tls);
+                                          });
+    }
+    if(fileChunkIndex)
+        *fileChunkIndex = std::move(index);
     return retval;
 }
 
+bool World::readChunk(stream::Reader &reader,
+                      const FileChunkIndex &fileChunkIndex,
+                      PositionI chunkBasePosition,
+                      WorldLockManager &lock_manager)
+{
+    auto iter = fileChunkIndex.records.find(chunkBasePosition);
+    if(iter == fileChunkIndex.records.end())
+        return false;
+    const FileChunkIndex::Record &record = std::get<1>(*iter);
+    reader.seek(record.offset, stream::SeekPosition::Start);
+    std::vector<std::uint8_t> bytes = expandWorldFileRecord(readCompressedWorldFileRecord(
+        reader, record.size, FileUpgrades::getLayout(fileChunkIndex.fileVersion)));
+    readChunkRecord(std::move(bytes),
+                    fileChunkIndex.fileVersion,
+                    getBlockIterator(chunkBasePosition, lock_manager.tls).chunk,
+                    lock_manager);
+    return true;
+}
+
+void World::readChunkRecord(std::vector<std::uint8_t> bytes,
+                            std::uint32_t fileVersion,
+                            std::shared_ptr<BlockChunk> chunk,
+                            WorldLockManager &lock_manager)
+{
+    stream::MemoryReader recordReader(std::move(bytes));
+    FileUpgrades::setStreamFileVersion(recordReader, fileVersion);
+    StreamWorldGuard streamWorldGuard(recordReader, *this, lock_manager);
+    if(stream::read<PositionI>(recordReader) != chunk->basePosition)
+        throw stream::InvalidDataValueException("world file chunk record is for the wrong chunk");
+    chunk->getChunkVariables().generated = true;
+    chunk->getChunkVariables().generateStarted = true;
+    // add the entities to chunk directly, since it might not be in the chunk map yet
+    std::shared_ptr<BlockChunk> &loadIntoChunk = getLoadIntoChunk(lock_manager.tls);
+    loadIntoChunk = chunk;
+    try
+    {
+        readChunkEntities(recordReader, lock_manager);
+    }
+    catch(...)
+    {
+        loadIntoChunk = nullptr;
+        throw;
+    }
+    loadIntoChunk = nullptr;
+    readChunkBlocks(recordReader,
+                    BlockIterator(chunk, &physicsWorld->chunks, chunk->basePosition, VectorI(0)),
+                    lock_manager);
+    lock_manager.clear();
+    // a chunk from an older file was upgraded as it was read, so it needs to be written again
+    chunk->getChunkVariables().saveDirty = fileVersion < GameVersion::FILE_VERSION;
+}
+
+void World::loadChunkLazily(LazyChunkSource &source,
+                            FileChunkIndex::Record record,
+                            std::shared_ptr<BlockChunk> chunk)
+{
+    WorldLockManager lock_manager(TLS::getSlow());
+    try
+    {
+        std::unique_lock<std::mutex> lockReader(source.readerLock);
+        source.reader->seek(record.offset, stream::SeekPosition::Start);
+        stream::SharedBytes compressed =
+            readCompressedWorldFileRecord(*source.reader, record.size, source.layout);
+        lockReader.unlock();
+        readChunkRecord(
+            expandWorldFileRecord(std::move(compressed)), source.fileVersion, chunk, lock_manager);
+    }
+    catch(stream::IOException &e)
+    {
+        lock_manager.clear();
+        getDebugLog() << L"loading chunk " << chunk->basePosition << L" failed : " << e.what()
+                      << postnl;
+        // generate the chunk again instead of leaving it partly read
+        chunk->getChunkVariables().generated = false;
+        chunk->getChunkVariables().generateStarted = false;
+        chunk->getChunkVariables().saveDirty = true;
+    }
+}
+
+void World::chunkPreloadThreadFn(std::vector<PositionI> chunkBasePositions, TLS &tls)
+{
+    for(PositionI chunkBasePosition : chunkBasePositions)
+    {
+        if(destructing)
+            return;
+        physicsWorld->chunks[chunkBasePosition].getOrLoad(tls);
+    }
+}
+
 bool World::isChunkCloseEnoughToPlayerToGetRandomUpdates(PositionI chunkBasePosition)
 {
     LockedPlayers lockedPlayers = players().lock();
@@ -2485,7 +4240,7 @@ auto reloadFn = [chunkCache, this](std::shared_ptr<BlockChunk> chunk)
         chunkCache->getChunk(chunk->basePosition, buffer);
         stream::MemoryReader readerIn(std::move(buffer));
         stream::ExpandReader reader(readerIn);
-        setStreamFileVersion(reader, GameVersion::FILE_VERSION);
+        FileUpgrades::setStreamFileVersion(reader, GameVersion::FILE_VERSION);
         WorldLockManager lock_manager(false, tls);
         StreamWorldGuard streamWorldGuard(reader, *this, lock_manager);
         BlockChunkMap *chunksMap = &physicsWorld->chunks;
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2012-2017 Jacob R. Lifshay
+ * This file is part of Voxels.
+ *
+ * Voxels is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Voxels is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Voxels; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include "world/world_tool.h"
+#include "world/world.h"
+#include "player/player.h"
+#include "platform/platform.h"
+#include "stream/stream.h"
+#include "util/string_cast.h"
+#include "util/tls.h"
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <cerrno>
+#include <utility>
+
+namespace programmerjake
+{
+namespace voxels
+{
+namespace
+{
+void writeChunkPosition(std::ostream &os, PositionI chunkBasePosition)
+{
+    os << chunkBasePosition.x << " " << chunkBasePosition.y << " " << chunkBasePosition.z << " "
+       << static_cast<int>(chunkBasePosition.d);
+}
+
+bool parseInteger(const std::wstring &str, long minValue, long maxValue, long &value)
+{
+    if(str.empty())
+        return false;
+    wchar_t *end = nullptr;
+    errno = 0;
+    value = std::wcstol(str.c_str(), &end, 10);
+    return errno == 0 && *end == L'\0' && value >= minValue && value <= maxValue;
+}
+
+std::vector<std::pair<PositionI, World::FileChunkIndex::Record>> getRecordsInFileOrder(
+    const World::FileChunkIndex &index)
+{
+    std::vector<std::pair<PositionI, World::FileChunkIndex::Record>> retval(index.records.begin(),
+                                                                            index.records.end());
+    std::sort(retval.begin(),
+              retval.end(),
+              [](const std::pair<PositionI, World::FileChunkIndex::Record> &a,
+                 const std::pair<PositionI, World::FileChunkIndex::Record> &b)
+              {
+                  return std::get<1>(a).offset < std::get<1>(b).offset;
+              });
+    return retval;
+}
+
+/** @brief read the chunk records that are going to be rewritten
+ *
+ * the world is paused, so a chunk whose record can't be read isn't generated again; the snapshot
+ * leaves it out of the new file instead of saving it as empty blocks.
+ * @return the number of bad chunk records, which are dropped from the new file
+ */
+std::size_t loadChunksToRewrite(World &world,
+                                const std::vector<PositionI> &chunkBasePositions,
+                                WorldLockManager &lock_manager)
+{
+    std::size_t badCount = 0;
+    for(PositionI chunkBasePosition : chunkBasePositions)
+    {
+        if(world.loadChunk(chunkBasePosition, lock_manager))
+            continue;
+        std::cout << "dropping bad chunk record at ";
+        writeChunkPosition(std::cout, chunkBasePosition);
+        std::cout << "\n";
+        badCount++;
+    }
+    return badCount;
+}
+
+/** @brief write world to a temporary file then replace fileName with it */
+void replaceWorldFile(World &world,
+                      const std::wstring &fileName,
+                      WorldLockManager &lock_manager,
+                      const World::SaveOptions &options)
+{
+    std::wstring tempFileName = fileName + L".tmp";
+    {
+        std::shared_ptr<stream::Writer> pwriter = createOrWriteUserSpecificFile(tempFileName);
+        world.makeSnapshot(lock_manager)->write(*pwriter, options);
+        pwriter->sync();
+    }
+    renameUserSpecificFile(tempFileName, fileName);
+    // the journal was for the replaced file, so rolling back with it would corrupt the new one
+    removeUserSpecificFile(World::FileAppendJournal::getFileName(fileName));
+}
+
+int listChunks(World &, const World::FileChunkIndex &index)
+{
+    std::cout << "x y z dimension offset size\n";
+    for(const auto &v : getRecordsInFileOrder(index))
+    {
+        writeChunkPosition(std::cout, std::get<0>(v));
+        std::cout << " " << std::get<1>(v).offset << " " << std::get<1>(v).size << "\n";
+    }
+    std::cout << index.records.size() << " chunks, " << index.getRecordsSize() << " of "
+              << index.fileSize << " bytes in use" << std::endl;
+    return 0;
+}
+
+int dumpBlockStats(World &world, const World::FileChunkIndex &index, WorldLockManager &lock_manager)
+{
+    std::map<std::wstring, std::uint64_t> blockCounts;
+    for(const auto &v : getRecordsInFileOrder(index))
+    {
+        if(!world.loadChunk(std::get<0>(v), lock_manager))
+            continue;
+        BlockIterator cbi = world.getBlockIterator(std::get<0>(v), lock_manager.tls);
+        for(std::int32_t x = 0; x < BlockChunk::chunkSizeX; x++)
+        {
+            for(std::int32_t z = 0; z < BlockChunk::chunkSizeZ; z++)
+            {
+                BlockIterator bi = cbi;
+                bi.moveBy(VectorI(x, 0, z), lock_manager);
+                for(std::int32_t y = 0; y < BlockChunk::chunkSizeY; y++)
+                {
+                    Block b = bi.get(lock_manager);
+                    blockCounts[b.good() ? b.descriptor->name : L"(empty)"]++;
+                    if(y + 1 < BlockChunk::chunkSizeY)
+                        bi.moveTowardPY(lock_manager);
+                }
+            }
+        }
+        lock_manager.clear();
+    }
+    for(const auto &v : blockCounts)
+    {
+        std::cout << string_cast<std::string>(std::get<0>(v)) << " " << std::get<1>(v) << "\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
+
+int validateChunks(World &world, const World::FileChunkIndex &index, WorldLockManager &lock_manager)
+{
+    std::size_t badCount = 0;
+    for(const auto &v : getRecordsInFileOrder(index))
+    {
+        if(world.loadChunk(std::get<0>(v), lock_manager))
+            continue;
+        std::cout << "bad chunk record at ";
+        writeChunkPosition(std::cout, std::get<0>(v));
+        std::cout << "\n";
+        badCount++;
+    }
+    std::cout << badCount << " of " << index.records.size() << " chunk records are bad"
+              << std::endl;
+    return badCount == 0 ? 0 : 1;
+}
+
+int recompress(World &world,
+               const World::FileChunkIndex &index,
+               WorldLockManager &lock_manager,
+               const std::wstring &fileName,
+               const std::vector<std::wstring> &args)
+{
+    World::SaveOptions options;
+    if(args.size() > 2)
+    {
+        long level;
+        if(args.size() > 3
+           || !parseInteger(args[2],
+                            stream::CompressWriter::MinLevel,
+                            stream::CompressWriter::MaxLevel,
+                            level))
+        {
+            std::cerr << "usage: recompress <file> [level]" << std::endl;
+            return 2;
+        }
+        options.compressionLevel = static_cast<int>(level);
+    }
+    std::vector<PositionI> chunkBasePositions;
+    for(const auto &v : getRecordsInFileOrder(index))
+    {
+        chunkBasePositions.push_back(std::get<0>(v));
+    }
+    std::size_t badCount = loadChunksToRewrite(world, chunkBasePositions, lock_manager);
+    replaceWorldFile(world, fileName, lock_manager, options);
+    std::cout << "rewrote " << index.records.size() - badCount << " chunks, dropped " << badCount
+              << " bad chunk records" << std::endl;
+    return 0;
+}
+
+int pruneChunks(World &world,
+                const World::FileChunkIndex &index,
+                WorldLockManager &lock_manager,
+                const std::wstring &fileName,
+                const std::vector<std::wstring> &args)
+{
+    long radius;
+    if(args.size() != 3 || !parseInteger(args[2], 0, 1L << 20, radius))
+    {
+        std::cerr << "usage: prune <file> <radius>" << std::endl;
+        return 2;
+    }
+    std::vector<PositionI> playerChunkBasePositions;
+    for(std::shared_ptr<Player> player : world.players().lock())
+    {
+        playerChunkBasePositions.push_back(
+            BlockChunk::getChunkBasePosition((PositionI)player->getPosition()));
+    }
+    std::size_t prunedCount = 0;
+    std::vector<PositionI> keptChunkBasePositions;
+    for(const auto &v : getRecordsInFileOrder(index))
+    {
+        PositionI chunkBasePosition = std::get<0>(v);
+        bool keep = false;
+        for(PositionI playerChunkBasePosition : playerChunkBasePositions)
+        {
+            if(playerChunkBasePosition.d != chunkBasePosition.d)
+                continue;
+            VectorI displacement = playerChunkBasePosition - chunkBasePosition;
+            if(std::abs(displacement.x) / BlockChunk::chunkSizeX <= radius
+               && std::abs(displacement.z) / BlockChunk::chunkSizeZ <= radius)
+            {
+                keep = true;
+                break;
+            }
+        }
+        if(keep)
+            keptChunkBasePositions.push_back(chunkBasePosition);
+        else if(world.pruneChunk(chunkBasePosition))
+            prunedCount++;
+    }
+    std::size_t badCount = loadChunksToRewrite(world, keptChunkBasePositions, lock_manager);
+    replaceWorldFile(world, fileName, lock_manager, World::SaveOptions());
+    std::cout << "pruned " << prunedCount << " of " << index.records.size()
+              << " chunks, dropped " << badCount << " bad chunk records" << std::endl;
+    return 0;
+}
+}
+
+int runWorldTool(std::vector<std::wstring> args)
+{
+    if(args.size() < 2)
+    {
+        std::cerr << "usage: --world-tool (list|stats|validate|recompress|prune) <file> ..."
+                  << std::endl;
+        return 2;
+    }
+    const std::wstring &command = args[0];
+    const std::wstring &fileName = args[1];
+    if(command != L"list" && command != L"stats" && command != L"validate"
+       && command != L"recompress" && command != L"prune")
+    {
+        std::cerr << "unknown world tool command : " << string_cast<std::string>(command)
+                  << std::endl;
+        return 2;
+    }
+    WorldLockManager lock_manager(TLS::getSlow());
+    try
+    {
+        World::FileAppendJournal::rollBackInterruptedAppend(fileName);
+        World::FileChunkIndex index;
+        std::shared_ptr<World> world =
+            World::readLazily(readUserSpecificFile(fileName), &index, true);
+        // the simulation threads don't load or generate chunks while the world is paused
+        world->paused(true, lock_manager);
+        if(index.fileVersion == 0)
+        {
+            std::cerr << "the world file is too old to have chunk records" << std::endl;
+            return 1;
+        }
+        int retval;
+        if(command == L"list")
+            retval = listChunks(*world, index);
+        else if(command == L"stats")
+            retval = dumpBlockStats(*world, index, lock_manager);
+        else if(command == L"validate")
+            retval = validateChunks(*world, index, lock_manager);
+        else if(command == L"recompress")
+            retval = recompress(*world, index, lock_manager, fileName, args);
+        else
+            retval = pruneChunks(*world, index, lock_manager, fileName, args);
+        lock_manager.clear();
+        return retval;
+    }
+    catch(stream::IOException &e)
+    {
+        lock_manager.clear();
+        std::cerr << "World Tool Error : " << e.what() << std::endl;
+        return 1;
+    }
+}
+}
+}